@@ -0,0 +1,1488 @@
+/**
+ * @file main.c
+ * @author Fern Lane
+ * @brief Microbenchmarks of kernels and end-to-end training throughput
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "activation.h"
+#include "bit_array.h"
+#include "dropout.h"
+#include "errors.h"
+#include "flower.h"
+#include "loss.h"
+#include "optimizers.h"
+#include "petal.h"
+#include "random.h"
+#include "shuffle.h"
+#include "sparse.h"
+#include "timer.h"
+#include "weights.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+// Maximum number of benchmarks
+#define BENCH_RESULTS_MAX 128U
+
+// Minimum duration of one timed sample. Fast kernels are called multiple times per sample
+#define BENCH_SAMPLE_MIN_NS 200000ULL
+
+// Length of arrays for activation and loss benchmarks
+#define BENCH_LAYER_LENGTH 1024U
+
+// Number of weights for optimizer benchmarks
+#define BENCH_WEIGHTS_LENGTH 65536U
+
+// Hardware performance counters (read only with --perf on Linux)
+#define BENCH_COUNTER_CYCLES        0U
+#define BENCH_COUNTER_INSTRUCTIONS  1U
+#define BENCH_COUNTER_L1D_MISSES    2U
+#define BENCH_COUNTER_LLC_MISSES    3U
+#define BENCH_COUNTER_BRANCH_MISSES 4U
+
+// For error check and tests
+#define BENCH_COUNTER_MAX BENCH_COUNTER_BRANCH_MISSES
+
+// Compiler, compiler flags and build type written into JSON results (defined by CMakeLists.txt)
+#ifndef BENCH_COMPILER
+#define BENCH_COMPILER "unknown"
+#endif
+#ifndef BENCH_FLAGS
+#define BENCH_FLAGS "unknown"
+#endif
+#ifndef BENCH_BUILD_TYPE
+#define BENCH_BUILD_TYPE "unknown"
+#endif
+
+/**
+ * @brief Benchmarked kernel
+ *
+ * @param context pointer to kernel's data
+ */
+typedef void (*bench_kernel_f)(void *context);
+
+/**
+ * @struct bench_result_s
+ * Stores results of one benchmark
+ *
+ * @param name unique name of benchmark
+ * @param repetitions number of timed samples
+ * @param calls_per_sample number of kernel calls per timed sample
+ * @param time_median_ns median time of one kernel call
+ * @param time_p95_ns 95th percentile time of one kernel call
+ * @param flops estimated floating-point operations of one kernel call (0 if not applicable)
+ * @param bytes estimated bytes read and written by one kernel call
+ * @param items number of processed items (ex. samples) by one kernel call
+ * @param counters hardware counters (BENCH_COUNTER_...) per one kernel call or negative if not available
+ */
+typedef struct {
+    char name[64];
+    uint32_t repetitions;
+    uint64_t calls_per_sample;
+    double time_median_ns, time_p95_ns;
+    double flops, bytes, items;
+    double counters[BENCH_COUNTER_MAX + 1U];
+} bench_result_s;
+
+/**
+ * @struct bench_config_s
+ * Stores command-line options
+ *
+ * @param warmup number of untimed samples before measurement
+ * @param repetitions number of timed samples
+ * @param filter run only benchmarks which name contains this string or NULL to run all
+ * @param json_path path to file to write JSON results into or NULL
+ * @param baseline_path path to JSON file with baseline results to compare with or NULL
+ * @param threshold maximum allowed slowdown of median time (in percents) compared to baseline
+ * @param perf true to read hardware performance counters (Linux only)
+ */
+typedef struct {
+    uint32_t warmup, repetitions;
+    const char *filter;
+    const char *json_path;
+    const char *baseline_path;
+    double threshold;
+    bool perf;
+} bench_config_s;
+
+static bench_config_s config = {3U, 30U, NULL, NULL, NULL, 10., false};
+static bench_result_s results[BENCH_RESULTS_MAX];
+static uint32_t results_length = 0U;
+
+// File descriptors of opened hardware counters (-1 if not available)
+static int counters_fds[BENCH_COUNTER_MAX + 1U] = {-1, -1, -1, -1, -1};
+static const char *counters_names[BENCH_COUNTER_MAX + 1U] = {"cycles", "instructions", "l1d_misses", "llc_misses",
+                                                             "branch_misses"};
+
+/**
+ * @brief Opens hardware performance counters of current thread (user space only) using perf_event_open()
+ *
+ * @return uint32_t number of successfully opened counters (0 if not supported or not permitted)
+ */
+static uint32_t bench_counters_open(void) {
+    uint32_t opened = 0U;
+#ifdef __linux__
+    const uint32_t types[BENCH_COUNTER_MAX + 1U] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                                    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+    const uint64_t configs[BENCH_COUNTER_MAX + 1U] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+    for (uint8_t i = 0; i <= BENCH_COUNTER_MAX; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = types[i];
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        // Each counter is opened separately so missing one (ex. in VM) doesn't disable the others
+        counters_fds[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counters_fds[i] >= 0)
+            opened++;
+        else
+            fprintf(stderr, "Hardware counter %s is not available\n", counters_names[i]);
+    }
+#endif
+    return opened;
+}
+
+/**
+ * @brief Closes all opened hardware performance counters
+ */
+static void bench_counters_close(void) {
+#ifdef __linux__
+    for (uint8_t i = 0; i <= BENCH_COUNTER_MAX; ++i) {
+        if (counters_fds[i] >= 0)
+            close(counters_fds[i]);
+        counters_fds[i] = -1;
+    }
+#endif
+}
+
+/**
+ * @brief Runs one sample with hardware counters enabled and stores counters per one kernel call
+ *
+ * @param result pointer to bench_result_s struct to write counters into
+ * @param kernel kernel to benchmark
+ * @param context pointer to kernel's data
+ */
+static void bench_counters_measure(bench_result_s *result, bench_kernel_f kernel, void *context) {
+    for (uint8_t i = 0; i <= BENCH_COUNTER_MAX; ++i)
+        result->counters[i] = -1.;
+    if (!config.perf)
+        return;
+#ifdef __linux__
+    for (uint8_t i = 0; i <= BENCH_COUNTER_MAX; ++i) {
+        if (counters_fds[i] < 0)
+            continue;
+        ioctl(counters_fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    for (uint64_t j = 0; j < result->calls_per_sample; ++j)
+        kernel(context);
+    for (uint8_t i = 0; i <= BENCH_COUNTER_MAX; ++i)
+        if (counters_fds[i] >= 0)
+            ioctl(counters_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (uint8_t i = 0; i <= BENCH_COUNTER_MAX; ++i) {
+        uint64_t count;
+        if (counters_fds[i] >= 0 && read(counters_fds[i], &count, sizeof(count)) == sizeof(count))
+            result->counters[i] = (double) count / (double) result->calls_per_sample;
+    }
+#else
+    (void) kernel;
+    (void) context;
+#endif
+}
+
+/**
+ * @brief Calculates instructions per cycle
+ *
+ * @param result pointer to bench_result_s struct
+ * @return double IPC or negative if not available
+ */
+static double bench_counters_ipc(bench_result_s *result) {
+    if (result->counters[BENCH_COUNTER_CYCLES] <= 0. || result->counters[BENCH_COUNTER_INSTRUCTIONS] < 0.)
+        return -1.;
+    return result->counters[BENCH_COUNTER_INSTRUCTIONS] / result->counters[BENCH_COUNTER_CYCLES];
+}
+
+/**
+ * @brief Prints hardware counters of all results with IPC and cache misses per FLOP
+ */
+static void bench_counters_print(void) {
+    printf("\n%-40s %12s %12s %6s %11s %11s %11s %10s %10s\n", "Benchmark", "Cycles", "Instructions", "IPC",
+           "L1D misses", "LLC misses", "Br. misses", "L1D/FLOP", "LLC/FLOP");
+    for (uint32_t i = 0; i < results_length; ++i) {
+        bench_result_s *result = &results[i];
+        printf("%-40s", result->name);
+        for (uint8_t j = 0; j <= BENCH_COUNTER_MAX; ++j) {
+            // IPC column goes right after instructions
+            if (j == BENCH_COUNTER_L1D_MISSES) {
+                double ipc = bench_counters_ipc(result);
+                if (ipc >= 0.)
+                    printf(" %6.2f", ipc);
+                else
+                    printf(" %6s", "-");
+            }
+            int width = j <= BENCH_COUNTER_INSTRUCTIONS ? 12 : 11;
+            if (result->counters[j] >= 0.)
+                printf(" %*.0f", width, result->counters[j]);
+            else
+                printf(" %*s", width, "-");
+        }
+
+        // Misses per FLOP (high values mean memory-bound kernel)
+        for (uint8_t j = BENCH_COUNTER_L1D_MISSES; j <= BENCH_COUNTER_LLC_MISSES; ++j) {
+            if (result->flops > 0. && result->counters[j] >= 0.)
+                printf(" %10.5f", result->counters[j] / result->flops);
+            else
+                printf(" %10s", "-");
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Comparator for qsort() of doubles
+ */
+static int compare_doubles(const void *a, const void *b) {
+    double diff = *(const double *) a - *(const double *) b;
+    return diff < 0. ? -1 : (diff > 0. ? 1 : 0);
+}
+
+/**
+ * @brief Runs benchmark with warmup and repetitions and stores it's result
+ *
+ * @param name unique name of benchmark
+ * @param kernel kernel to benchmark
+ * @param context pointer to kernel's data
+ * @param flops estimated floating-point operations of one kernel call (0 if not applicable)
+ * @param bytes estimated bytes read and written by one kernel call
+ * @param items number of processed items by one kernel call
+ */
+static void bench_run(const char *name, bench_kernel_f kernel, void *context, double flops, double bytes,
+                      double items) {
+    if (config.filter && !strstr(name, config.filter))
+        return;
+    if (results_length >= BENCH_RESULTS_MAX) {
+        fprintf(stderr, "Too many benchmarks. Skipping %s\n", name);
+        return;
+    }
+
+    // Find number of calls per sample to make each sample long enough for the timer
+    uint64_t calls_per_sample = 1U;
+    while (true) {
+        uint64_t time_start = timer_get_ns();
+        for (uint64_t i = 0; i < calls_per_sample; ++i)
+            kernel(context);
+        if (timer_get_ns() - time_start >= BENCH_SAMPLE_MIN_NS || calls_per_sample >= (1ULL << 30))
+            break;
+        calls_per_sample *= 2U;
+    }
+
+    // Warmup
+    for (uint32_t i = 0; i < config.warmup; ++i)
+        for (uint64_t j = 0; j < calls_per_sample; ++j)
+            kernel(context);
+
+    // Measure
+    uint32_t repetitions = config.repetitions > 0U ? config.repetitions : 1U;
+    double *samples = malloc(repetitions * sizeof(double));
+    if (!samples) {
+        fprintf(stderr, "Error allocating memory for samples\n");
+        return;
+    }
+    for (uint32_t i = 0; i < repetitions; ++i) {
+        uint64_t time_start = timer_get_ns();
+        for (uint64_t j = 0; j < calls_per_sample; ++j)
+            kernel(context);
+        samples[i] = (double) (timer_get_ns() - time_start) / (double) calls_per_sample;
+    }
+    qsort(samples, repetitions, sizeof(double), compare_doubles);
+
+    // Save result
+    bench_result_s *result = &results[results_length++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->repetitions = repetitions;
+    result->calls_per_sample = calls_per_sample;
+
+    // Separate sample with counters enabled to not affect timings
+    bench_counters_measure(result, kernel, context);
+
+    if (repetitions % 2U == 0U)
+        result->time_median_ns = (samples[repetitions / 2U - 1U] + samples[repetitions / 2U]) / 2.;
+    else
+        result->time_median_ns = samples[repetitions / 2U];
+    uint32_t p95_index = (uint32_t) ceil(.95 * (double) repetitions);
+    result->time_p95_ns = samples[p95_index > 0U ? p95_index - 1U : 0U];
+    result->flops = flops;
+    result->bytes = bytes;
+    result->items = items;
+    free(samples);
+
+    // Print row
+    printf("%-40s %10.3f %10.3f", result->name, result->time_median_ns / 1e3, result->time_p95_ns / 1e3);
+    if (flops > 0.)
+        printf(" %9.3f", flops / result->time_median_ns);
+    else
+        printf(" %9s", "-");
+    printf(" %9.3f %14.1f\n", bytes / result->time_median_ns, items * 1e9 / result->time_median_ns);
+    fflush(stdout);
+}
+
+/**
+ * @brief Writes string as JSON string value (quotes, backslashes and control characters are skipped)
+ *
+ * @param file pointer to opened file
+ * @param string string to write
+ */
+static void bench_json_string(FILE *file, const char *string) {
+    fputc('"', file);
+    for (; *string; ++string)
+        if (*string != '"' && *string != '\\' && (unsigned char) *string >= 0x20U)
+            fputc(*string, file);
+    fputc('"', file);
+}
+
+/**
+ * @brief Writes CPU model, number of online CPUs and OS into JSON file to know where results were recorded
+ *
+ * @param file pointer to opened file
+ */
+static void bench_json_machine(FILE *file) {
+    char cpu[256] = "unknown", os[256] = "unknown";
+    long cpus = 0L;
+#ifdef __linux__
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (cpuinfo) {
+        char line[256];
+        while (fgets(line, sizeof(line), cpuinfo)) {
+            char *value = strchr(line, ':');
+            if (strncmp(line, "model name", strlen("model name")) != 0 || !value)
+                continue;
+            value += strspn(value + 1, " \t") + 1;
+            value[strcspn(value, "\n")] = '\0';
+            snprintf(cpu, sizeof(cpu), "%s", value);
+            break;
+        }
+        fclose(cpuinfo);
+    }
+    struct utsname system_info;
+    if (uname(&system_info) == 0)
+        snprintf(os, sizeof(os), "%s %s %s", system_info.sysname, system_info.release, system_info.machine);
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#elif defined(_WIN32)
+    snprintf(os, sizeof(os), "Windows");
+#endif
+
+    fprintf(file, "  \"machine\": {\"cpu\": ");
+    bench_json_string(file, cpu);
+    fprintf(file, ", \"cpus\": %ld, \"os\": ", cpus);
+    bench_json_string(file, os);
+    fprintf(file, ", \"compiler\": ");
+    bench_json_string(file, BENCH_COMPILER);
+    fprintf(file, ", \"flags\": ");
+    bench_json_string(file, BENCH_FLAGS);
+    fprintf(file, ", \"build_type\": ");
+    bench_json_string(file, BENCH_BUILD_TYPE);
+    fprintf(file, "},\n");
+}
+
+/**
+ * @brief Writes all results into JSON file
+ *
+ * @param path path to file
+ * @return true if written successfully
+ */
+static bool bench_write_json(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error opening %s for writing\n", path);
+        return false;
+    }
+    fprintf(file, "{\n");
+    bench_json_machine(file);
+    fprintf(file, "  \"warmup\": %u,\n  \"repetitions\": %u,\n  \"benchmarks\": [", config.warmup,
+            config.repetitions);
+    for (uint32_t i = 0; i < results_length; ++i) {
+        bench_result_s *result = &results[i];
+        fprintf(file,
+                "%s\n    {\"name\": \"%s\", \"calls_per_sample\": %lu, \"median_ns\": %.3f, \"p95_ns\": %.3f, "
+                "\"gflops\": %.6f, \"gbps\": %.6f, \"items_per_second\": %.3f",
+                i > 0U ? "," : "", result->name, (unsigned long) result->calls_per_sample, result->time_median_ns,
+                result->time_p95_ns, result->flops / result->time_median_ns, result->bytes / result->time_median_ns,
+                result->items * 1e9 / result->time_median_ns);
+
+        // Hardware counters
+        if (config.perf) {
+            for (uint8_t j = 0; j <= BENCH_COUNTER_MAX; ++j) {
+                if (result->counters[j] >= 0.)
+                    fprintf(file, ", \"%s\": %.3f", counters_names[j], result->counters[j]);
+                else
+                    fprintf(file, ", \"%s\": null", counters_names[j]);
+            }
+            double ipc = bench_counters_ipc(result);
+            if (ipc >= 0.)
+                fprintf(file, ", \"ipc\": %.4f", ipc);
+            else
+                fprintf(file, ", \"ipc\": null");
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+/**
+ * @brief Compares results with baseline JSON file (written previously by bench_write_json()) and prints per-kernel diff
+ *
+ * @param path path to baseline file
+ * @param threshold maximum allowed slowdown of median time in percents
+ * @return uint32_t number of regressed benchmarks or UINT32_MAX in case of error
+ */
+static uint32_t bench_compare_baseline(const char *path, double threshold) {
+    // Read entire file
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error opening baseline %s\n", path);
+        return UINT32_MAX;
+    }
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *json = malloc(file_size + 1);
+    if (!json || file_size < 0 || fread(json, 1, file_size, file) != (size_t) file_size) {
+        fprintf(stderr, "Error reading baseline %s\n", path);
+        fclose(file);
+        free(json);
+        return UINT32_MAX;
+    }
+    json[file_size] = '\0';
+    fclose(file);
+
+    printf("\nComparing with baseline %s (threshold: %.1f%%)\n", path, threshold);
+
+    // Print where baseline was recorded (entries are matched only by "name", so header is skipped below)
+    char *machine = strstr(json, "\"machine\": ");
+    if (machine) {
+        machine += strlen("\"machine\": ");
+        size_t machine_length = strcspn(machine, "\n");
+        if (machine_length > 0U && machine[machine_length - 1U] == ',')
+            machine_length--;
+        printf("Baseline machine: %.*s\n", (int) machine_length, machine);
+    }
+    printf("%-40s %12s %12s %9s  %s\n", "Benchmark", "Baseline us", "Current us", "Change", "Status");
+
+    uint32_t regressions = 0U;
+    bool *found = calloc(results_length > 0U ? results_length : 1U, sizeof(bool));
+    if (!found) {
+        free(json);
+        return UINT32_MAX;
+    }
+
+    // Iterate each baseline entry: {"name": "...", ..., "median_ns": ...}
+    char *position = json;
+    while ((position = strstr(position, "\"name\": \""))) {
+        position += strlen("\"name\": \"");
+        char *name_end = strchr(position, '"');
+        char *median = strstr(position, "\"median_ns\": ");
+        if (!name_end || !median)
+            break;
+        size_t name_length = name_end - position;
+        double baseline_ns = strtod(median + strlen("\"median_ns\": "), NULL);
+
+        // Find current result with the same name
+        int32_t result_index = -1;
+        for (uint32_t i = 0; i < results_length; ++i)
+            if (strlen(results[i].name) == name_length && strncmp(results[i].name, position, name_length) == 0) {
+                result_index = (int32_t) i;
+                break;
+            }
+
+        // Not benchmarked (filtered or removed)
+        if (result_index < 0) {
+            if (!config.filter)
+                printf("%-40.*s %12.3f %12s %9s  %s\n", (int) name_length, position, baseline_ns / 1e3, "-", "-",
+                       "MISSING");
+            position = name_end;
+            continue;
+        }
+        found[result_index] = true;
+
+        double current_ns = results[result_index].time_median_ns;
+        double change = baseline_ns > 0. ? 100. * (current_ns - baseline_ns) / baseline_ns : 0.;
+        bool regressed = change > threshold;
+        if (regressed)
+            regressions++;
+        printf("%-40s %12.3f %12.3f %+8.1f%%  %s\n", results[result_index].name, baseline_ns / 1e3, current_ns / 1e3,
+               change, regressed ? "REGRESSION" : (change < -threshold ? "FASTER" : "OK"));
+        position = name_end;
+    }
+
+    // New benchmarks
+    for (uint32_t i = 0; i < results_length; ++i)
+        if (!found[i])
+            printf("%-40s %12s %12.3f %9s  %s\n", results[i].name, "-", results[i].time_median_ns / 1e3, "-", "NEW");
+
+    free(found);
+    free(json);
+
+    if (regressions > 0U)
+        printf("%u benchmark(s) regressed by more than %.1f%%\n", regressions, threshold);
+    else
+        printf("No regressions\n");
+    return regressions;
+}
+
+/**
+ * @brief Allocates array and fills it with random values from low to high
+ *
+ * @param length number of elements
+ * @param low lowest value
+ * @param high highest value
+ * @return float* pointer to array (exits in case of allocation error)
+ */
+static float *bench_random_array(uint32_t length, float low, float high) {
+    float *array = malloc(length * sizeof(float));
+    if (!array) {
+        fprintf(stderr, "Error allocating memory for benchmark data\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < length; ++i)
+        array[i] = low + rk_float_() * (high - low);
+    return array;
+}
+
+/**
+ * @brief Copies struct into newly allocated memory (petal_destroy() frees activation and weights structs)
+ *
+ * @param source pointer to struct
+ * @param size size of struct in bytes
+ * @return void* pointer to copy (exits in case of allocation error)
+ */
+static void *bench_copy(const void *source, size_t size) {
+    void *copy = malloc(size);
+    if (!copy) {
+        fprintf(stderr, "Error allocating memory for benchmark data\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, source, size);
+    return copy;
+}
+
+// ------------------------------- //
+// -----  DENSE PETAL KERNELS ----- //
+// ------------------------------- //
+
+/**
+ * @struct bench_dense_s
+ * Data of dense petal benchmarks
+ */
+typedef struct {
+    petal_shape_s input_shape, output_shape;
+    weights_s weights, bias_weights;
+    petal_s *petal;
+    float *input, *error_right;
+    bool training;
+} bench_dense_s;
+
+static void bench_dense_forward(void *context) {
+    bench_dense_s *dense = (bench_dense_s *) context;
+    petal_forward(dense->petal, dense->input, dense->training);
+}
+
+static void bench_dense_backward(void *context) {
+    bench_dense_s *dense = (bench_dense_s *) context;
+    petal_backward(dense->petal, dense->error_right, dense->input);
+}
+
+/**
+ * @brief Benchmarks forward and backward propagation of dense petal with linear activation
+ *
+ * @param input_length petal's input size
+ * @param output_length petal's output size
+ * @param dropout dropout ratio (forward is benchmarked in training mode if > 0)
+ */
+static void bench_dense(uint32_t input_length, uint32_t output_length, float dropout) {
+    bench_dense_s dense;
+    dense.training = dropout > 0.f;
+    dense.input_shape = (petal_shape_s){1U, input_length, 1U, 0U};
+    dense.output_shape = (petal_shape_s){1U, output_length, 1U, 0U};
+    dense.weights = (weights_s){true, WEIGHTS_INIT_XAVIER_GLOROT_GAUSSIAN, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    dense.bias_weights = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    dense.petal = petal_init(PETAL_TYPE_DENSE_1D, false, &dense.input_shape, &dense.output_shape, &dense.weights,
+                             &dense.bias_weights,
+                             bench_copy(&(activation_s){ACTIVATION_LINEAR, 1.f, 0.f, 0.f, 0.f, 1.f, NULL},
+                                        sizeof(activation_s)),
+                             &(petal_params_s){dropout, 0.f, 1.f});
+    if (!dense.petal || dense.petal->error_code != ERROR_NONE) {
+        fprintf(stderr, "Error initializing dense petal %ux%u\n", input_length, output_length);
+        return;
+    }
+    dense.input = bench_random_array(input_length, -1.f, 1.f);
+    dense.error_right = bench_random_array(output_length, -1.f, 1.f);
+
+    // Name suffix for dropout (ex. dense_forward_dropout50_256x256)
+    char dropout_suffix[32] = "";
+    if (dense.training)
+        snprintf(dropout_suffix, sizeof(dropout_suffix), "dropout%u_", (unsigned) (dropout * 100.f + .5f));
+
+    char name[64];
+    uint64_t flops, bytes;
+    petal_estimate_cost(dense.petal, false, &flops, &bytes);
+    snprintf(name, sizeof(name), "dense_forward_%s%ux%u", dropout_suffix, input_length, output_length);
+    bench_run(name, bench_dense_forward, &dense, (double) flops, (double) bytes, 1.);
+
+    petal_forward(dense.petal, dense.input, true);
+    petal_estimate_cost(dense.petal, true, &flops, &bytes);
+    snprintf(name, sizeof(name), "dense_backward_%s%ux%u", dropout_suffix, input_length, output_length);
+    bench_run(name, bench_dense_backward, &dense, (double) flops, (double) bytes, 1.);
+
+    petal_destroy(dense.petal, false, true, true);
+    free(dense.input);
+    free(dense.error_right);
+}
+
+/**
+ * @struct bench_sparse_dense_s
+ * Data of dense petal with sparse input benchmark
+ */
+typedef struct {
+    bench_dense_s petal;
+    sparse_s *input;
+    optimizer_s optimizer;
+} bench_sparse_dense_s;
+
+static void bench_sparse_dense_forward(void *context) {
+    bench_sparse_dense_s *data = (bench_sparse_dense_s *) context;
+    petal_forward_sparse(data->petal.petal, data->input, false);
+}
+
+static void bench_sparse_dense_backward(void *context) {
+    bench_sparse_dense_s *data = (bench_sparse_dense_s *) context;
+    petal_backward_sparse(data->petal.petal, data->petal.error_right, data->input);
+    weights_update(&data->petal.weights, &data->optimizer);
+    weights_update(&data->petal.bias_weights, &data->optimizer);
+}
+
+/**
+ * @brief Benchmarks forward propagation and backward propagation with weights update (Adam) of dense petal with
+ * sparse input and linear activation (only columns of weights of non-zero inputs are updated)
+ *
+ * @param input_length petal's input size
+ * @param output_length petal's output size
+ * @param nonzeros number of non-zero inputs
+ */
+static void bench_sparse_dense(uint32_t input_length, uint32_t output_length, uint32_t nonzeros) {
+    bench_sparse_dense_s data;
+    bench_dense_s *dense = &data.petal;
+    dense->input_shape = (petal_shape_s){1U, input_length, 1U, 0U};
+    dense->output_shape = (petal_shape_s){1U, output_length, 1U, 0U};
+    dense->weights = (weights_s){true, WEIGHTS_INIT_XAVIER_GLOROT_GAUSSIAN, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    dense->bias_weights = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    dense->petal = petal_init(PETAL_TYPE_DENSE_1D, true, &dense->input_shape, &dense->output_shape, &dense->weights,
+                              &dense->bias_weights,
+                              bench_copy(&(activation_s){ACTIVATION_LINEAR, 1.f, 0.f, 0.f, 0.f, 1.f, NULL},
+                                         sizeof(activation_s)),
+                              NULL);
+    if (!dense->petal || dense->petal->error_code != ERROR_NONE) {
+        fprintf(stderr, "Error initializing dense petal %ux%u\n", input_length, output_length);
+        return;
+    }
+
+    // Random positions of non-zero inputs
+    dense->input = calloc(input_length, sizeof(float));
+    for (uint32_t i = 0; i < nonzeros; ++i)
+        dense->input[rk_bounded(&rk_state_global, input_length)] = rk_float_() * 2.f - 1.f;
+    data.input = dense_to_sparse(dense->input, input_length);
+    dense->error_right = bench_random_array(output_length, -1.f, 1.f);
+
+    char name[64];
+    uint64_t flops, bytes;
+    petal_estimate_cost_sparse(dense->petal, data.input->length, false, &flops, &bytes);
+    snprintf(name, sizeof(name), "sparse_dense_forward_%ux%u_nnz%u", input_length, output_length, nonzeros);
+    bench_run(name, bench_sparse_dense_forward, &data, (double) flops, (double) bytes, 1.);
+
+    // Weights, gradients, velocities and moments of updated columns and bias weights are read and written
+    petal_forward_sparse(dense->petal, data.input, true);
+    petal_estimate_cost_sparse(dense->petal, data.input->length, true, &flops, &bytes);
+    bytes += 2U * 4U * ((uint64_t) data.input->length + 1U) * output_length * sizeof(float);
+    data.optimizer = (optimizer_s){OPTIMIZER_ADAM, .01f, 0.f, .9f, .999f, NULL};
+    snprintf(name, sizeof(name), "sparse_dense_backward_update_%ux%u_nnz%u", input_length, output_length, nonzeros);
+    bench_run(name, bench_sparse_dense_backward, &data, (double) flops, (double) bytes, 1.);
+
+    petal_destroy(dense->petal, false, true, true);
+    sparse_destroy(data.input);
+    free(dense->input);
+    free(dense->error_right);
+}
+
+// ------------------------------------- //
+// -----  CONVOLUTION PETAL KERNELS ----- //
+// ------------------------------------- //
+
+static const char *conv_algorithm_names[CONV_ALGORITHM_MAX + 1U] = {"auto", "im2col", "direct", "winograd"};
+
+/**
+ * @brief Benchmarks forward and backward propagation of 2D convolution petal (same padding, stride 1) with
+ * linear activation
+ *
+ * @param size input rows and cols
+ * @param channels input depth
+ * @param filters output depth
+ * @param kernel_size kernel rows and cols
+ * @param algorithm CONV_ALGORITHM_...
+ */
+static void bench_conv_2d(uint32_t size, uint32_t channels, uint32_t filters, uint32_t kernel_size, uint8_t algorithm) {
+    bench_dense_s conv;
+    conv.training = false;
+    conv.input_shape = (petal_shape_s){size, size, channels, 0U};
+    conv.output_shape = (petal_shape_s){size, size, filters, 0U};
+    conv.weights = (weights_s){true, WEIGHTS_INIT_XAVIER_GLOROT_GAUSSIAN, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    conv.bias_weights = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    conv.petal = petal_init(
+        PETAL_TYPE_CONV_2D, false, &conv.input_shape, &conv.output_shape, &conv.weights, &conv.bias_weights,
+        bench_copy(&(activation_s){ACTIVATION_LINEAR, 1.f, 0.f, 0.f, 0.f, 1.f, NULL}, sizeof(activation_s)),
+        &(petal_params_s){0.f, 0.f, 1.f, DROPOUT_MODE_EXACT, kernel_size, kernel_size, 1U, kernel_size / 2U, 1U,
+                          algorithm});
+    if (!conv.petal || conv.petal->error_code != ERROR_NONE) {
+        fprintf(stderr, "Error initializing convolution petal %ux%ux%u\n", size, size, channels);
+        return;
+    }
+    conv.input = bench_random_array(conv.input_shape.length, -1.f, 1.f);
+    conv.error_right = bench_random_array(conv.output_shape.length, -1.f, 1.f);
+
+    char name[64];
+    uint64_t flops, bytes;
+    petal_estimate_cost(conv.petal, false, &flops, &bytes);
+    snprintf(name, sizeof(name), "conv_2d_%s_forward_%ux%ux%u_k%u_f%u", conv_algorithm_names[algorithm], size, size,
+             channels, kernel_size, filters);
+    bench_run(name, bench_dense_forward, &conv, (double) flops, (double) bytes, 1.);
+
+    petal_forward(conv.petal, conv.input, true);
+    petal_estimate_cost(conv.petal, true, &flops, &bytes);
+    snprintf(name, sizeof(name), "conv_2d_%s_backward_%ux%ux%u_k%u_f%u", conv_algorithm_names[algorithm], size,
+             size, channels, kernel_size, filters);
+    bench_run(name, bench_dense_backward, &conv, (double) flops, (double) bytes, 1.);
+
+    petal_destroy(conv.petal, false, true, true);
+    free(conv.input);
+    free(conv.error_right);
+}
+
+/**
+ * @brief Benchmarks forward (training) and backward propagation of 2D pooling petal (window size equal to stride)
+ * without activation
+ *
+ * @param petal_type PETAL_TYPE_MAX_POOL_2D or PETAL_TYPE_AVG_POOL_2D
+ * @param size input rows and cols
+ * @param channels input and output depth
+ * @param kernel_size window rows and cols
+ */
+static void bench_pool_2d(uint8_t petal_type, uint32_t size, uint32_t channels, uint32_t kernel_size) {
+    bench_dense_s pool;
+    pool.training = true;
+    pool.input_shape = (petal_shape_s){size, size, channels, 0U};
+    pool.output_shape = (petal_shape_s){size / kernel_size, size / kernel_size, channels, 0U};
+    pool.petal = petal_init(petal_type, false, &pool.input_shape, &pool.output_shape, NULL, NULL, NULL,
+                            &(petal_params_s){0.f, 0.f, 1.f, DROPOUT_MODE_EXACT, kernel_size, kernel_size,
+                                              kernel_size, 0U, 1U});
+    if (!pool.petal || pool.petal->error_code != ERROR_NONE) {
+        fprintf(stderr, "Error initializing pooling petal %ux%ux%u\n", size, size, channels);
+        return;
+    }
+    pool.input = bench_random_array(pool.input_shape.length, -1.f, 1.f);
+    pool.error_right = bench_random_array(pool.output_shape.length, -1.f, 1.f);
+    const char *type_name = petal_type == PETAL_TYPE_MAX_POOL_2D ? "max" : "avg";
+
+    char name[64];
+    uint64_t flops, bytes;
+    petal_estimate_cost(pool.petal, false, &flops, &bytes);
+    snprintf(name, sizeof(name), "%s_pool_2d_forward_%ux%ux%u_k%u", type_name, size, size, channels, kernel_size);
+    bench_run(name, bench_dense_forward, &pool, (double) flops, (double) bytes, 1.);
+
+    petal_forward(pool.petal, pool.input, true);
+    petal_estimate_cost(pool.petal, true, &flops, &bytes);
+    snprintf(name, sizeof(name), "%s_pool_2d_backward_%ux%ux%u_k%u", type_name, size, size, channels, kernel_size);
+    bench_run(name, bench_dense_backward, &pool, (double) flops, (double) bytes, 1.);
+
+    petal_destroy(pool.petal, false, true, true);
+    free(pool.input);
+    free(pool.error_right);
+}
+
+/**
+ * @brief Benchmarks forward (training) and backward propagation of layer normalization petal without activation
+ *
+ * @param rows number of normalized rows
+ * @param row_length length of each row
+ */
+static void bench_layer_norm(uint32_t rows, uint32_t row_length) {
+    bench_dense_s norm;
+    norm.training = true;
+    norm.input_shape = (petal_shape_s){rows, row_length, 1U, 0U};
+    norm.output_shape = (petal_shape_s){rows, row_length, 1U, 0U};
+    norm.weights = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 1.f, 0.f, NULL, NULL, 0U};
+    norm.bias_weights = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 0.f, NULL, NULL, 0U};
+    norm.petal = petal_init(PETAL_TYPE_LAYER_NORM, false, &norm.input_shape, &norm.output_shape, &norm.weights,
+                            &norm.bias_weights, NULL, NULL);
+    if (!norm.petal || norm.petal->error_code != ERROR_NONE) {
+        fprintf(stderr, "Error initializing layer normalization petal %ux%u\n", rows, row_length);
+        return;
+    }
+    norm.input = bench_random_array(norm.input_shape.length, -1.f, 1.f);
+    norm.error_right = bench_random_array(norm.output_shape.length, -1.f, 1.f);
+
+    char name[64];
+    uint64_t flops, bytes;
+    petal_estimate_cost(norm.petal, false, &flops, &bytes);
+    snprintf(name, sizeof(name), "layer_norm_forward_%ux%u", rows, row_length);
+    bench_run(name, bench_dense_forward, &norm, (double) flops, (double) bytes, 1.);
+
+    petal_forward(norm.petal, norm.input, true);
+    petal_estimate_cost(norm.petal, true, &flops, &bytes);
+    snprintf(name, sizeof(name), "layer_norm_backward_%ux%u", rows, row_length);
+    bench_run(name, bench_dense_backward, &norm, (double) flops, (double) bytes, 1.);
+
+    petal_destroy(norm.petal, false, true, true);
+    free(norm.input);
+    free(norm.error_right);
+}
+
+/**
+ * @struct bench_embedding_s
+ * Data of embedding benchmark
+ */
+typedef struct {
+    bench_dense_s petal;
+    optimizer_s optimizer;
+} bench_embedding_s;
+
+static void bench_embedding_step(void *context) {
+    bench_embedding_s *data = (bench_embedding_s *) context;
+    petal_forward(data->petal.petal, data->petal.input, true);
+    petal_backward(data->petal.petal, data->petal.error_right, data->petal.input);
+    weights_update(data->petal.petal->weights, &data->optimizer);
+}
+
+/**
+ * @brief Benchmarks training step (forward, backward and Adam update of looked up rows) of embedding petal
+ *
+ * @param vocabulary_size number of rows of embedding table
+ * @param embedding_size length of each row
+ * @param ids number of looked up ids
+ */
+static void bench_embedding(uint32_t vocabulary_size, uint32_t embedding_size, uint32_t ids) {
+    bench_embedding_s data;
+    bench_dense_s *embedding = &data.petal;
+    embedding->input_shape = (petal_shape_s){ids, 1U, 1U, 0U};
+    embedding->output_shape = (petal_shape_s){ids, embedding_size, 1U, 0U};
+    embedding->weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    petal_params_s params = (petal_params_s){0.f, 0.f, 1.f, DROPOUT_MODE_EXACT};
+    params.vocabulary_size = vocabulary_size;
+    embedding->petal = petal_init(PETAL_TYPE_EMBEDDING, true, &embedding->input_shape, &embedding->output_shape,
+                                  &embedding->weights, NULL, NULL, &params);
+    if (!embedding->petal || embedding->petal->error_code != ERROR_NONE) {
+        fprintf(stderr, "Error initializing embedding petal %ux%u\n", vocabulary_size, embedding_size);
+        return;
+    }
+    embedding->input = malloc(ids * sizeof(float));
+    for (uint32_t i = 0; i < ids; ++i)
+        embedding->input[i] = (float) rk_bounded(&rk_state_global, vocabulary_size);
+    embedding->error_right = bench_random_array(embedding->output_shape.length, -1.f, 1.f);
+    data.optimizer = (optimizer_s){OPTIMIZER_ADAM, .01f, .9f, .9f, .999f, NULL};
+
+    // Rows are read and written by forward, backward and update (weights, gradients, moments and velocities) and bits
+    // of looked up rows are scanned
+    char name[64];
+    snprintf(name, sizeof(name), "embedding_step_%ux%u_ids%u", vocabulary_size, embedding_size, ids);
+    bench_run(name, bench_embedding_step, &data, 0.,
+              12. * embedding->output_shape.length * sizeof(float) + vocabulary_size / 8., 1.);
+
+    petal_destroy(embedding->petal, false, true, true);
+    free(embedding->input);
+    free(embedding->error_right);
+}
+
+/**
+ * @brief Benchmarks forward propagation and backpropagation through time of LSTM or GRU petal
+ *
+ * @param petal_type PETAL_TYPE_LSTM or PETAL_TYPE_GRU
+ * @param timesteps number of timesteps (input rows)
+ * @param features number of input features
+ * @param hidden_size number of hidden units (hidden state of each timestep is output)
+ */
+static void bench_rnn(uint8_t petal_type, uint32_t timesteps, uint32_t features, uint32_t hidden_size) {
+    bench_dense_s rnn;
+    rnn.training = true;
+    rnn.input_shape = (petal_shape_s){timesteps, features, 1U, 0U};
+    rnn.output_shape = (petal_shape_s){timesteps, hidden_size, 1U, 0U};
+    rnn.weights = (weights_s){true, WEIGHTS_INIT_XAVIER_GLOROT_GAUSSIAN, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    rnn.bias_weights = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    rnn.petal = petal_init(petal_type, false, &rnn.input_shape, &rnn.output_shape, &rnn.weights, &rnn.bias_weights,
+                           NULL, NULL);
+    if (!rnn.petal || rnn.petal->error_code != ERROR_NONE) {
+        fprintf(stderr, "Error initializing recurrent petal %ux%u->%u\n", timesteps, features, hidden_size);
+        return;
+    }
+    rnn.input = bench_random_array(rnn.input_shape.length, -1.f, 1.f);
+    rnn.error_right = bench_random_array(rnn.output_shape.length, -1.f, 1.f);
+
+    const char *type_name = petal_type == PETAL_TYPE_LSTM ? "lstm" : "gru";
+    char name[64];
+    uint64_t flops, bytes;
+    petal_estimate_cost(rnn.petal, false, &flops, &bytes);
+    snprintf(name, sizeof(name), "%s_forward_%ux%u_h%u", type_name, timesteps, features, hidden_size);
+    bench_run(name, bench_dense_forward, &rnn, (double) flops, (double) bytes, 1.);
+
+    petal_forward(rnn.petal, rnn.input, true);
+    petal_estimate_cost(rnn.petal, true, &flops, &bytes);
+    snprintf(name, sizeof(name), "%s_backward_%ux%u_h%u", type_name, timesteps, features, hidden_size);
+    bench_run(name, bench_dense_backward, &rnn, (double) flops, (double) bytes, 1.);
+
+    petal_destroy(rnn.petal, false, true, true);
+    free(rnn.input);
+    free(rnn.error_right);
+}
+
+/**
+ * @brief Benchmarks forward propagation and backpropagation of multi-head self-attention petal
+ *
+ * @param sequence number of rows of input and output
+ * @param row_length number of features of each row
+ * @param heads number of heads
+ */
+static void bench_attention(uint32_t sequence, uint32_t row_length, uint32_t heads) {
+    bench_dense_s attention;
+    attention.training = true;
+    attention.input_shape = (petal_shape_s){sequence, row_length, 1U, 0U};
+    attention.output_shape = (petal_shape_s){sequence, row_length, 1U, 0U};
+    attention.weights =
+        (weights_s){true, WEIGHTS_INIT_XAVIER_GLOROT_GAUSSIAN, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    attention.bias_weights = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    petal_params_s params = (petal_params_s){0};
+    params.heads = heads;
+    attention.petal = petal_init(PETAL_TYPE_ATTENTION, false, &attention.input_shape, &attention.output_shape,
+                                 &attention.weights, &attention.bias_weights, NULL, &params);
+    if (!attention.petal || attention.petal->error_code != ERROR_NONE) {
+        fprintf(stderr, "Error initializing attention petal %ux%u with %u heads\n", sequence, row_length, heads);
+        return;
+    }
+    attention.input = bench_random_array(attention.input_shape.length, -1.f, 1.f);
+    attention.error_right = bench_random_array(attention.output_shape.length, -1.f, 1.f);
+
+    char name[64];
+    uint64_t flops, bytes;
+    petal_estimate_cost(attention.petal, false, &flops, &bytes);
+    snprintf(name, sizeof(name), "attention_forward_%ux%u_heads%u", sequence, row_length, heads);
+    bench_run(name, bench_dense_forward, &attention, (double) flops, (double) bytes, 1.);
+
+    petal_forward(attention.petal, attention.input, true);
+    petal_estimate_cost(attention.petal, true, &flops, &bytes);
+    snprintf(name, sizeof(name), "attention_backward_%ux%u_heads%u", sequence, row_length, heads);
+    bench_run(name, bench_dense_backward, &attention, (double) flops, (double) bytes, 1.);
+
+    petal_destroy(attention.petal, false, true, true);
+    free(attention.input);
+    free(attention.error_right);
+}
+
+// ------------------------------ //
+// -----  ACTIVATION KERNELS ----- //
+// ------------------------------ //
+
+static const char *activation_names[ACTIVATION_MAX + 1U] = {"linear",       "relu",  "elu",     "softsign", "sigmoid",
+                                                            "hard_sigmoid", "swish", "softmax", "tanh"};
+
+/**
+ * @struct bench_activation_s
+ * Data of activation benchmarks
+ */
+typedef struct {
+    activation_s activation;
+    float *layer;
+} bench_activation_s;
+
+static void bench_activation_forward(void *context) {
+    bench_activation_s *data = (bench_activation_s *) context;
+    activation_forward(&data->activation, data->layer, BENCH_LAYER_LENGTH);
+}
+
+static void bench_activation_backward(void *context) {
+    bench_activation_s *data = (bench_activation_s *) context;
+    activation_backward(&data->activation, data->layer, BENCH_LAYER_LENGTH);
+}
+
+/**
+ * @brief Benchmarks forward and backward pass of each activation function
+ */
+static void bench_activations(void) {
+    for (uint8_t type = 0; type <= ACTIVATION_MAX; ++type) {
+        bench_activation_s data;
+        data.activation = (activation_s){type, 1.f, 0.f, 0.01f, 0.01f, 1.f, NULL};
+
+        // Softmax derivative is a jacobian matrix
+        uint32_t layer_size = type == ACTIVATION_SOFTMAX ? BENCH_LAYER_LENGTH * BENCH_LAYER_LENGTH : BENCH_LAYER_LENGTH;
+        data.layer = bench_random_array(layer_size, -2.f, 2.f);
+
+        char name[64];
+        snprintf(name, sizeof(name), "activation_forward_%s", activation_names[type]);
+        bench_run(name, bench_activation_forward, &data, 0., 2. * BENCH_LAYER_LENGTH * sizeof(float),
+                  BENCH_LAYER_LENGTH);
+
+        snprintf(name, sizeof(name), "activation_backward_%s", activation_names[type]);
+        bench_run(name, bench_activation_backward, &data, 0.,
+                  (type == ACTIVATION_SOFTMAX ? layer_size + BENCH_LAYER_LENGTH : 2. * BENCH_LAYER_LENGTH) *
+                      sizeof(float),
+                  BENCH_LAYER_LENGTH);
+
+        free(data.activation._derivatives_temp);
+        free(data.layer);
+    }
+}
+
+// ------------------------ //
+// -----  LOSS KERNELS ----- //
+// ------------------------ //
+
+static const char *loss_names[LOSS_MAX + 1U] = {"mse", "msle", "rmsle", "mae", "binary_crossentropy",
+                                                "categorical_crossentropy"};
+
+/**
+ * @struct bench_loss_s
+ * Data of loss benchmarks
+ */
+typedef struct {
+    loss_s loss;
+    float *predicted, *expected;
+} bench_loss_s;
+
+static void bench_loss_forward(void *context) {
+    bench_loss_s *data = (bench_loss_s *) context;
+    loss_forward(&data->loss, data->predicted, data->expected, BENCH_LAYER_LENGTH);
+}
+
+static void bench_loss_backward(void *context) {
+    bench_loss_s *data = (bench_loss_s *) context;
+    loss_backward(&data->loss, BENCH_LAYER_LENGTH);
+}
+
+/**
+ * @brief Benchmarks forward and backward pass of each loss function
+ */
+static void bench_losses(void) {
+    for (uint8_t type = 0; type <= LOSS_MAX; ++type) {
+        bench_loss_s data = {0};
+        data.loss.type = type;
+        data.predicted = bench_random_array(BENCH_LAYER_LENGTH, .01f, .99f);
+        data.expected = bench_random_array(BENCH_LAYER_LENGTH, 0.f, 1.f);
+
+        char name[64];
+        snprintf(name, sizeof(name), "loss_forward_%s", loss_names[type]);
+        bench_run(name, bench_loss_forward, &data, 0., 3. * BENCH_LAYER_LENGTH * sizeof(float), BENCH_LAYER_LENGTH);
+
+        snprintf(name, sizeof(name), "loss_backward_%s", loss_names[type]);
+        bench_run(name, bench_loss_backward, &data, 0., 3. * BENCH_LAYER_LENGTH * sizeof(float), BENCH_LAYER_LENGTH);
+
+        free(data.loss.loss);
+        free(data.loss._derivatives_temp_1);
+        free(data.loss._derivatives_temp_2);
+        free(data.predicted);
+        free(data.expected);
+    }
+}
+
+// ----------------------------- //
+// -----  OPTIMIZER KERNELS ----- //
+// ----------------------------- //
+
+static const char *optimizer_names[OPTIMIZER_MAX + 1U] = {"sgd_momentum", "rms_prop", "ada_grad", "adam"};
+
+/**
+ * @struct bench_optimizer_s
+ * Data of optimizer benchmarks
+ */
+typedef struct {
+    weights_s weights;
+    optimizer_s optimizer;
+} bench_optimizer_s;
+
+static void bench_optimizer_update(void *context) {
+    bench_optimizer_s *data = (bench_optimizer_s *) context;
+    weights_update(&data->weights, &data->optimizer);
+}
+
+/**
+ * @brief Benchmarks weights update with each optimizer
+ */
+static void bench_optimizers(void) {
+    for (uint8_t type = 0; type <= OPTIMIZER_MAX; ++type) {
+        bench_optimizer_s data;
+        data.weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+        if (weights_check_init(&data.weights, BENCH_WEIGHTS_LENGTH) != ERROR_NONE) {
+            fprintf(stderr, "Error initializing weights\n");
+            return;
+        }
+        data.optimizer = (optimizer_s){type, .01f, .9f, .9f, .999f, NULL};
+
+        // Weights, gradients and velocities / cache are read and written (+ moments for Adam)
+        double arrays = type == OPTIMIZER_ADAM ? 4. : 3.;
+
+        char name[64];
+        snprintf(name, sizeof(name), "optimizer_update_%s", optimizer_names[type]);
+        bench_run(name, bench_optimizer_update, &data, 0., 2. * arrays * BENCH_WEIGHTS_LENGTH * sizeof(float),
+                  BENCH_WEIGHTS_LENGTH);
+
+        weights_destroy(&data.weights, false, true);
+    }
+}
+
+// ---------------------------------- //
+// -----  RANDOM FILL KERNELS ----- //
+// ---------------------------------- //
+
+static void bench_fill_uniform(void *context) {
+    rk_fill_uniform(&rk_state_global, (float *) context, BENCH_WEIGHTS_LENGTH, -1.f, 1.f);
+}
+
+static void bench_fill_gaussian(void *context) {
+    rk_fill_gaussian(&rk_state_global, (float *) context, BENCH_WEIGHTS_LENGTH, 0.f, 1.f);
+}
+
+/**
+ * @brief Benchmarks bulk random fill (used by weights_init())
+ */
+static void bench_random_fill(void) {
+    float *array = malloc(BENCH_WEIGHTS_LENGTH * sizeof(float));
+    if (!array) {
+        fprintf(stderr, "Error allocating memory for array\n");
+        return;
+    }
+    bench_run("rk_fill_uniform_65536", bench_fill_uniform, array, 2. * BENCH_WEIGHTS_LENGTH,
+              BENCH_WEIGHTS_LENGTH * sizeof(float), BENCH_WEIGHTS_LENGTH);
+    bench_run("rk_fill_gaussian_65536", bench_fill_gaussian, array, 0., BENCH_WEIGHTS_LENGTH * sizeof(float),
+              BENCH_WEIGHTS_LENGTH);
+    free(array);
+}
+
+// ------------------------------------- //
+// -----  DROPOUT AND SHUFFLE KERNELS ----- //
+// ------------------------------------- //
+
+static void bench_dropout_generate(void *context) {
+    bit_array_s *bit_array = (bit_array_s *) context;
+    bit_array_clear(bit_array);
+    dropout_generate_indices(bit_array, .5f, NULL);
+}
+
+static void bench_dropout_generate_stream(void *context) {
+    bit_array_s *bit_array = (bit_array_s *) context;
+    rk_stream_s stream;
+    rk_stream_init(&stream, 0U, 0U, 0U, 0U);
+    bit_array_clear(bit_array);
+    dropout_generate_indices(bit_array, .5f, &stream);
+}
+
+static void bench_dropout_generate_bernoulli(void *context) {
+    dropout_generate_bernoulli((bit_array_s *) context, .3f, NULL);
+}
+
+/**
+ * @struct bench_dropout_mask_s
+ * Data of dropout mask benchmark
+ */
+typedef struct {
+    float *layer, *mask;
+} bench_dropout_mask_s;
+
+static void bench_dropout_apply(void *context) {
+    bench_dropout_mask_s *data = (bench_dropout_mask_s *) context;
+    dropout_apply_mask(data->layer, data->mask, BENCH_WEIGHTS_LENGTH);
+}
+
+/**
+ * @struct bench_shuffle_s
+ * Data of shuffle benchmark
+ */
+typedef struct {
+    float **inputs, **outputs;
+    uint32_t length, input_length, output_length;
+} bench_shuffle_s;
+
+static void bench_shuffle(void *context) {
+    bench_shuffle_s *data = (bench_shuffle_s *) context;
+    shuffle_2d(data->inputs, data->outputs, data->length, data->input_length * sizeof(float),
+               data->output_length * sizeof(float), NULL);
+}
+
+/**
+ * @brief Benchmarks dropout mask generation and dataset shuffling
+ */
+static void bench_dropout_and_shuffle(void) {
+    bit_array_s *bit_array = bit_array_init(BENCH_WEIGHTS_LENGTH);
+    if (bit_array && bit_array->error_code == ERROR_NONE)
+        bench_run("dropout_generate_indices_65536", bench_dropout_generate, bit_array, 0., BENCH_WEIGHTS_LENGTH / 8.,
+                  BENCH_WEIGHTS_LENGTH);
+    if (bit_array && bit_array->error_code == ERROR_NONE)
+        bench_run("dropout_generate_indices_philox_65536", bench_dropout_generate_stream, bit_array, 0.,
+                  BENCH_WEIGHTS_LENGTH / 8., BENCH_WEIGHTS_LENGTH);
+    if (bit_array && bit_array->error_code == ERROR_NONE)
+        bench_run("dropout_generate_bernoulli_65536", bench_dropout_generate_bernoulli, bit_array, 0.,
+                  BENCH_WEIGHTS_LENGTH / 8., BENCH_WEIGHTS_LENGTH);
+
+    // Keep-mask with 1.0 scaling (ratio 0) to keep layer values finite between calls
+    bench_dropout_mask_s mask_data = {bench_random_array(BENCH_WEIGHTS_LENGTH, -1.f, 1.f),
+                                      calloc(BENCH_WEIGHTS_LENGTH, sizeof(float))};
+    if (bit_array && bit_array->error_code == ERROR_NONE && mask_data.layer && mask_data.mask &&
+        dropout_generate_mask(bit_array, mask_data.mask, 0.f, DROPOUT_MODE_EXACT, NULL) == ERROR_NONE)
+        bench_run("dropout_apply_mask_65536", bench_dropout_apply, &mask_data, BENCH_WEIGHTS_LENGTH,
+                  3. * BENCH_WEIGHTS_LENGTH * sizeof(float), BENCH_WEIGHTS_LENGTH);
+    free(mask_data.layer);
+    free(mask_data.mask);
+    bit_array_destroy(bit_array);
+
+    bench_shuffle_s data = {NULL, NULL, 1024U, 64U, 10U};
+    data.inputs = malloc(data.length * sizeof(float *));
+    data.outputs = malloc(data.length * sizeof(float *));
+    if (!data.inputs || !data.outputs) {
+        fprintf(stderr, "Error allocating memory for dataset\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < data.length; ++i) {
+        data.inputs[i] = bench_random_array(data.input_length, 0.f, 1.f);
+        data.outputs[i] = bench_random_array(data.output_length, 0.f, 1.f);
+    }
+
+    // Each row is copied 3 times (read + write)
+    bench_run("shuffle_2d_1024x64", bench_shuffle, &data, 0.,
+              6. * data.length * (data.input_length + data.output_length) * sizeof(float), data.length);
+
+    for (uint32_t i = 0; i < data.length; ++i) {
+        free(data.inputs[i]);
+        free(data.outputs[i]);
+    }
+    free(data.inputs);
+    free(data.outputs);
+}
+
+// ---------------------------------- //
+// -----  END-TO-END TRAINING ----- //
+// ---------------------------------- //
+
+/**
+ * @struct bench_train_s
+ * Data of end-to-end training benchmark
+ */
+typedef struct {
+    flower_s *flower;
+    optimizer_s optimizer;
+    float **inputs, **outputs;
+    uint32_t length, batch_size;
+} bench_train_s;
+
+static void bench_train_epoch(void *context) {
+    bench_train_s *data = (bench_train_s *) context;
+    flower_train(data->flower, LOSS_CATEGORICAL_CROSSENTROPY, &data->optimizer, NULL, data->inputs, data->outputs,
+                 NULL, data->length, NULL, NULL, NULL, 0U, data->batch_size, 1U);
+}
+
+/**
+ * @brief Benchmarks one epoch of training of 64-128-10 MLP on synthetic dataset (reports samples/s)
+ */
+static void bench_train(void) {
+    petal_shape_s shape_input = {1U, 64U, 1U, 0U};
+    petal_shape_s shape_hidden = {1U, 128U, 1U, 0U};
+    petal_shape_s shape_output = {1U, 10U, 1U, 0U};
+    weights_s weights_hidden = {true, WEIGHTS_INIT_KAIMING_HE_GAUSSIAN, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s weights_output = {true, WEIGHTS_INIT_XAVIER_GLOROT_GAUSSIAN, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s bias = {true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    activation_s activation_hidden = {ACTIVATION_RELU, 1.f, 0.f, 0.01f, 0.01f, 1.f, NULL};
+    activation_s activation_output = {ACTIVATION_SOFTMAX, 1.f, 0.f, 0.01f, 0.01f, 1.f, NULL};
+
+    petal_s *petals[2];
+    petals[0] = petal_init(PETAL_TYPE_DENSE_1D, true, &shape_input, &shape_hidden,
+                           bench_copy(&weights_hidden, sizeof(weights_s)), bench_copy(&bias, sizeof(weights_s)),
+                           bench_copy(&activation_hidden, sizeof(activation_s)), NULL);
+    petals[1] = petal_init(PETAL_TYPE_DENSE_1D, false, &shape_hidden, &shape_output,
+                           bench_copy(&weights_output, sizeof(weights_s)), bench_copy(&bias, sizeof(weights_s)),
+                           bench_copy(&activation_output, sizeof(activation_s)), NULL);
+
+    bench_train_s data;
+    data.flower = flower_init(petals, 2U);
+    data.optimizer = (optimizer_s){OPTIMIZER_ADAM, .001f, 0.f, .9f, .999f, NULL};
+    data.length = 1024U;
+    data.batch_size = 32U;
+
+    // Synthetic dataset: class is the index of the largest of first 10 inputs
+    data.inputs = malloc(data.length * sizeof(float *));
+    data.outputs = malloc(data.length * sizeof(float *));
+    if (!data.inputs || !data.outputs) {
+        fprintf(stderr, "Error allocating memory for dataset\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < data.length; ++i) {
+        data.inputs[i] = bench_random_array(shape_input.length, 0.f, 1.f);
+        data.outputs[i] = calloc(shape_output.length, sizeof(float));
+        if (!data.outputs[i]) {
+            fprintf(stderr, "Error allocating memory for dataset\n");
+            exit(EXIT_FAILURE);
+        }
+        uint32_t label = 0U;
+        for (uint32_t j = 1; j < shape_output.length; ++j)
+            if (data.inputs[i][j] > data.inputs[i][label])
+                label = j;
+        data.outputs[i][label] = 1.f;
+    }
+
+    uint64_t flops_forward = 0U, flops_backward = 0U, bytes_forward = 0U, bytes_backward = 0U, temp_flops, temp_bytes;
+    for (uint8_t i = 0; i < 2U; ++i) {
+        petal_estimate_cost(petals[i], false, &temp_flops, &temp_bytes);
+        flops_forward += temp_flops;
+        bytes_forward += temp_bytes;
+        petal_estimate_cost(petals[i], true, &temp_flops, &temp_bytes);
+        flops_backward += temp_flops;
+        bytes_backward += temp_bytes;
+    }
+
+    bench_run("flower_train_epoch_mlp_64_128_10", bench_train_epoch, &data,
+              (double) (flops_forward + flops_backward) * data.length,
+              (double) (bytes_forward + bytes_backward) * data.length, data.length);
+
+    for (uint32_t i = 0; i < data.length; ++i) {
+        free(data.inputs[i]);
+        free(data.outputs[i]);
+    }
+    free(data.inputs);
+    free(data.outputs);
+    flower_destroy(data.flower, true, true, true);
+}
+
+/**
+ * @brief Prints usage
+ *
+ * @param program name of executable
+ */
+static void print_usage(const char *program) {
+    printf("Usage: %s [--warmup N] [--reps N] [--filter SUBSTRING] [--json FILE] [--baseline FILE] "
+           "[--threshold PERCENT] [--perf]\n",
+           program);
+    printf("  --warmup N          untimed samples before measurement (default: 3)\n");
+    printf("  --reps N            timed samples (default: 30)\n");
+    printf("  --filter SUBSTRING  run only benchmarks which name contains SUBSTRING\n");
+    printf("  --json FILE         write results into FILE as JSON\n");
+    printf("  --baseline FILE     compare results with FILE (JSON written by --json) and exit with 1 on regression\n");
+    printf("  --threshold PERCENT maximum allowed slowdown of median time compared to baseline (default: 10)\n");
+    printf("  --perf              read hardware counters (Linux perf_event_open): cycles, instructions, IPC,\n"
+           "                      L1D / LLC / branch misses and cache misses per FLOP\n");
+}
+
+int main(int argc, char *argv[]) {
+    // Parse arguments
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            config.warmup = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+            config.repetitions = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            config.filter = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            config.json_path = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            config.baseline_path = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            config.threshold = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--perf") == 0)
+            config.perf = true;
+        else {
+            print_usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    // Hardware counters (run without them if not permitted, ex. perf_event_paranoid or VM without PMU)
+    if (config.perf && bench_counters_open() == 0U) {
+        fprintf(stderr, "Hardware counters are not available. Running without them\n");
+        config.perf = false;
+    }
+
+    // Same data on each run
+    rk_seed_(0);
+
+    printf("%-40s %10s %10s %9s %9s %14s\n", "Benchmark", "Median us", "P95 us", "GFLOPS", "GB/s", "Items/s");
+
+    bench_dense(64U, 64U, 0.f);
+    bench_dense(256U, 256U, 0.f);
+    bench_dense(784U, 128U, 0.f);
+    bench_dense(1024U, 1024U, 0.f);
+    bench_dense(1024U, 1024U, .5f);
+    bench_sparse_dense(100000U, 64U, 500U);
+    for (uint8_t algorithm = CONV_ALGORITHM_IM2COL; algorithm <= CONV_ALGORITHM_MAX; ++algorithm) {
+        bench_conv_2d(28U, 8U, 16U, 3U, algorithm);
+        bench_conv_2d(14U, 32U, 64U, 3U, algorithm);
+    }
+    bench_pool_2d(PETAL_TYPE_MAX_POOL_2D, 28U, 16U, 2U);
+    bench_pool_2d(PETAL_TYPE_AVG_POOL_2D, 28U, 16U, 2U);
+    bench_layer_norm(64U, 512U);
+    bench_embedding(1000000U, 32U, 16U);
+    bench_rnn(PETAL_TYPE_LSTM, 64U, 64U, 128U);
+    bench_rnn(PETAL_TYPE_GRU, 64U, 64U, 128U);
+    bench_attention(128U, 64U, 4U);
+    bench_attention(512U, 64U, 4U);
+    bench_activations();
+    bench_losses();
+    bench_optimizers();
+    bench_random_fill();
+    bench_dropout_and_shuffle();
+    bench_train();
+
+    if (config.perf)
+        bench_counters_print();
+    bench_counters_close();
+
+    if (config.json_path && !bench_write_json(config.json_path))
+        return EXIT_FAILURE;
+
+    // Fail in case of regression
+    if (config.baseline_path && bench_compare_baseline(config.baseline_path, config.threshold) != 0U)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
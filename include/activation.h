@@ -25,8 +25,6 @@
 
 #include <stdint.h>
 
-#include "dropout.h"
-
 #define ACTIVATION_LINEAR       0U
 #define ACTIVATION_RELU         1U
 #define ACTIVATION_ELU          2U
@@ -58,10 +56,9 @@ typedef struct {
     float *_derivatives_temp;
 } activation_s;
 
-uint8_t activation_forward(activation_s *activation, float *layer, uint32_t layer_length, bit_array_s *bit_array);
+uint8_t activation_forward(activation_s *activation, float *layer, uint32_t layer_length);
 
-uint8_t activation_backward(activation_s *activation, float *layer_activated, uint32_t layer_activated_length,
-                            bit_array_s *bit_array);
+uint8_t activation_backward(activation_s *activation, float *layer_activated, uint32_t layer_activated_length);
 
 void activation_destroy(activation_s *activation);
 
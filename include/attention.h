@@ -0,0 +1,40 @@
+/**
+ * @file attention.h
+ * @author Fern Lane
+ * @brief Multi-head self-attention with tiled online softmax (memory-efficient attention)
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ATTENTION_H__
+#define ATTENTION_H__
+
+#include <stdint.h>
+
+#include "petal.h"
+
+// Number of queries and keys in one tile of scores (scores of all queries and keys are never stored)
+#define ATTENTION_TILE_QUERIES 32U
+#define ATTENTION_TILE_KEYS    64U
+
+uint32_t attention_heads(petal_s *petal);
+
+void attention_forward(petal_s *petal, const float *input);
+
+void attention_backward(petal_s *petal, const float *input);
+
+#endif
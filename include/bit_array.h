@@ -26,15 +26,31 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#define BIT_ARRAY_TYPE uint8_t
-#define BIT_ARRAY_BITS 8U
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#define BIT_ARRAY_TYPE uint64_t
+#define BIT_ARRAY_BITS 64U
+
+// Number of set bits and number of trailing zeros (word must not be 0) of one BIT_ARRAY_TYPE word
+#if defined(__GNUC__) || defined(__clang__)
+#define BIT_ARRAY_POPCOUNT(word) ((uint32_t) __builtin_popcountll(word))
+#define BIT_ARRAY_CTZ(word)      ((uint32_t) __builtin_ctzll(word))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define BIT_ARRAY_POPCOUNT(word) ((uint32_t) __popcnt64(word))
+#define BIT_ARRAY_CTZ(word)      bit_array_ctz_(word)
+#else
+#define BIT_ARRAY_POPCOUNT(word) bit_array_popcount_(word)
+#define BIT_ARRAY_CTZ(word)      bit_array_ctz_(word)
+#endif
 
 /**
  * @struct bit_array_s
  * Stores "array of bits"
  *
- * @param data pointer to array of BIT_ARRAY_TYPE numbers
- * @param length length of array in BIT_ARRAY_TYPE
+ * @param data pointer to array of BIT_ARRAY_TYPE numbers (bits after length are always 0)
+ * @param length length of array in bits
  * @param error_code initialization or runtime error code
  * @param _length_in_types internal length of *data array measured in BIT_ARRAY_TYPEs
  */
@@ -46,6 +62,14 @@ typedef struct {
     uint32_t _length_in_types;
 } bit_array_s;
 
+// Iterates over indices of set / cleared bits in ascending order (index is declared as uint32_t)
+#define BIT_ARRAY_FOR_EACH_SET(bit_array, index)                                                                       \
+    for (uint32_t index = bit_array_next_set(bit_array, 0U); index < (bit_array)->length;                              \
+         index = bit_array_next_set(bit_array, index + 1U))
+#define BIT_ARRAY_FOR_EACH_CLEAR(bit_array, index)                                                                     \
+    for (uint32_t index = bit_array_next_clear(bit_array, 0U); index < (bit_array)->length;                            \
+         index = bit_array_next_clear(bit_array, index + 1U))
+
 bit_array_s *bit_array_init(uint32_t size_bits);
 
 void bit_array_set_bit(bit_array_s *bit_array, uint32_t index);
@@ -58,6 +82,79 @@ void bit_array_not(bit_array_s *bit_array);
 
 void bit_array_clear(bit_array_s *bit_array);
 
+uint32_t bit_array_count(const bit_array_s *bit_array);
+
 void bit_array_destroy(bit_array_s *bit_array);
 
+/**
+ * Portable fallbacks of popcount and count trailing zeros
+ */
+static inline uint32_t bit_array_popcount_(BIT_ARRAY_TYPE word) {
+    uint32_t count = 0U;
+    for (; word; word &= word - 1U)
+        count++;
+    return count;
+}
+
+static inline uint32_t bit_array_ctz_(BIT_ARRAY_TYPE word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (uint32_t) index;
+#else
+    uint32_t count = 0U;
+    for (; !(word & 1U); word >>= 1U)
+        count++;
+    return count;
+#endif
+}
+
+/**
+ * Unchecked accessors for hot loops (index must be less than bit_array->length)
+ */
+static inline bool bit_array_get_bit_unchecked(const bit_array_s *bit_array, uint32_t index) {
+    return (bit_array->data[index / BIT_ARRAY_BITS] >> (index % BIT_ARRAY_BITS)) & 1U;
+}
+
+static inline void bit_array_set_bit_unchecked(bit_array_s *bit_array, uint32_t index) {
+    bit_array->data[index / BIT_ARRAY_BITS] |= (BIT_ARRAY_TYPE) 1U << (index % BIT_ARRAY_BITS);
+}
+
+static inline void bit_array_clear_bit_unchecked(bit_array_s *bit_array, uint32_t index) {
+    bit_array->data[index / BIT_ARRAY_BITS] &= ~((BIT_ARRAY_TYPE) 1U << (index % BIT_ARRAY_BITS));
+}
+
+/**
+ * Finds index of next set / cleared bit starting from index "from" (inclusive)
+ * Returns bit_array->length if there is no such bit
+ */
+static inline uint32_t bit_array_next_set(const bit_array_s *bit_array, uint32_t from) {
+    if (from >= bit_array->length)
+        return bit_array->length;
+    uint32_t word_i = from / BIT_ARRAY_BITS;
+    BIT_ARRAY_TYPE word = bit_array->data[word_i] & (~(BIT_ARRAY_TYPE) 0U << (from % BIT_ARRAY_BITS));
+    while (!word) {
+        if (++word_i >= bit_array->_length_in_types)
+            return bit_array->length;
+        word = bit_array->data[word_i];
+    }
+    return word_i * BIT_ARRAY_BITS + BIT_ARRAY_CTZ(word);
+}
+
+static inline uint32_t bit_array_next_clear(const bit_array_s *bit_array, uint32_t from) {
+    if (from >= bit_array->length)
+        return bit_array->length;
+    uint32_t word_i = from / BIT_ARRAY_BITS;
+    BIT_ARRAY_TYPE word = ~bit_array->data[word_i] & (~(BIT_ARRAY_TYPE) 0U << (from % BIT_ARRAY_BITS));
+    while (!word) {
+        if (++word_i >= bit_array->_length_in_types)
+            return bit_array->length;
+        word = ~bit_array->data[word_i];
+    }
+
+    // Padding bits after length are cleared
+    uint32_t index = word_i * BIT_ARRAY_BITS + BIT_ARRAY_CTZ(word);
+    return index < bit_array->length ? index : bit_array->length;
+}
+
 #endif
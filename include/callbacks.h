@@ -0,0 +1,100 @@
+/**
+ * @file callbacks.h
+ * @author Fern Lane
+ * @brief Training callbacks data and definitions
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CALLBACKS_H__
+#define CALLBACKS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Training events
+#define CALLBACK_ON_BATCH_END  0U
+#define CALLBACK_ON_EPOCH_END  1U
+#define CALLBACK_ON_VALIDATION 2U
+
+// For error check and tests
+#define CALLBACK_MAX CALLBACK_ON_VALIDATION
+
+/**
+ * @struct callback_data_s
+ * Stores training stats passed into each callback
+ *
+ * @param epoch_index index of current epoch (from 0 to epochs_total - 1)
+ * @param epochs_total number of epochs
+ * @param batch_index index of current batch (from 0 to batches_per_epoch - 1)
+ * @param batches_per_epoch number of batches per epoch
+ * @param samples_batch number of training samples in current batch
+ * @param samples_validation number of samples used for last validation
+ * @param samples_trained total number of trained samples since start of training
+ * @param loss_train average training loss of current batch (CALLBACK_ON_BATCH_END) or epoch (CALLBACK_ON_EPOCH_END)
+ * @param accuracy_train average training accuracy of current batch or epoch
+ * @param loss_validation last average validation loss
+ * @param accuracy_validation last average validation accuracy
+ * @param learning_rate learning rate of last weights update
+ * @param time_epoch seconds since start of current epoch
+ * @param time_training seconds since start of training
+ * @param time_batch seconds spent on training current batch (forward, backward and weights update)
+ * (sum of all batches of epoch for CALLBACK_ON_EPOCH_END)
+ * @param time_forward seconds spent on forward propagation and loss calculation of current batch (or epoch)
+ * @param time_backward seconds spent on backpropagation of current batch (or epoch)
+ * @param time_optimizer seconds spent on weights update of current batch (or epoch)
+ * @param time_validation seconds spent on last validation (or on all validations of epoch)
+ * @param samples_per_second training throughput of current batch (or epoch)
+ */
+typedef struct {
+    uint32_t epoch_index, epochs_total;
+    uint32_t batch_index, batches_per_epoch;
+    uint32_t samples_batch, samples_validation;
+    uint64_t samples_trained;
+    float loss_train, accuracy_train;
+    float loss_validation, accuracy_validation;
+    float learning_rate;
+    double time_epoch, time_training;
+    double time_batch, time_forward, time_backward, time_optimizer, time_validation;
+    float samples_per_second;
+} callback_data_s;
+
+/**
+ * @brief Training callback function
+ *
+ * @param data pointer to callback_data_s struct with current training stats (valid only during the call)
+ * @param user_data user_data pointer of callbacks_s struct
+ */
+typedef void (*callback_f)(callback_data_s *data, void *user_data);
+
+/**
+ * @struct callbacks_s
+ * Stores set of training callbacks
+ *
+ * @param on_batch_end called after each weights update (and validation if it was performed) or NULL
+ * @param on_epoch_end called at the end of each epoch with average training stats of this epoch or NULL
+ * @param on_validation called after each validation or NULL
+ * @param user_data any pointer that will be passed into each callback (ex. pointer to custom metrics sink)
+ */
+typedef struct {
+    callback_f on_batch_end, on_epoch_end, on_validation;
+    void *user_data;
+} callbacks_s;
+
+void callbacks_call(callbacks_s **callbacks, uint32_t callbacks_length, uint8_t event, callback_data_s *data);
+
+#endif
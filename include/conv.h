@@ -0,0 +1,52 @@
+/**
+ * @file conv.h
+ * @author Fern Lane
+ * @brief Convolution kernels definitions
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CONV_H__
+#define CONV_H__
+
+#include <stdint.h>
+
+#include "petal.h"
+
+// Max. number of input channels to choose direct convolution in CONV_ALGORITHM_AUTO mode
+#define CONV_DIRECT_MAX_CHANNELS 16U
+
+uint32_t conv_output_size(uint32_t input_size, uint32_t kernel_size, uint32_t stride, uint32_t padding,
+                          uint32_t dilation);
+
+void conv_im2col(petal_s *petal, const float *input, float *columns);
+
+void conv_col2im(petal_s *petal, const float *columns, float *input);
+
+uint8_t conv_select_algorithm(petal_s *petal);
+
+uint64_t conv_kernel_buffer_length(petal_s *petal);
+
+uint64_t conv_columns_length(petal_s *petal);
+
+void conv_direct_forward(petal_s *petal, const float *input);
+
+void conv_direct_backward(petal_s *petal, const float *input);
+
+void conv_winograd_forward(petal_s *petal, const float *input);
+
+#endif
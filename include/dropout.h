@@ -26,7 +26,27 @@
 #include <stdint.h>
 
 #include "bit_array.h"
+#include "random.h"
 
-void dropout_generate_indices(bit_array_s *bit_array, float dropout_ratio);
+// Exactly length * dropout_ratio indices are dropped
+#define DROPOUT_MODE_EXACT 0U
+
+// Each index is dropped independently with dropout_ratio probability (faster on wide petals)
+#define DROPOUT_MODE_BERNOULLI 1U
+
+// For error check and tests
+#define DROPOUT_MODE_MAX DROPOUT_MODE_BERNOULLI
+
+// Precision of probability in DROPOUT_MODE_BERNOULLI (max. number of random words per 64 bits)
+#define DROPOUT_BERNOULLI_BITS 16U
+
+void dropout_generate_indices(bit_array_s *bit_array, float dropout_ratio, rk_stream_s *stream);
+
+void dropout_generate_bernoulli(bit_array_s *bit_array, float dropout_ratio, rk_stream_s *stream);
+
+uint8_t dropout_generate_mask(bit_array_s *bit_array, float *mask, float dropout_ratio, uint8_t mode,
+                              rk_stream_s *stream);
+
+void dropout_apply_mask(float *layer, const float *mask, uint32_t length);
 
 #endif
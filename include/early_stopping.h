@@ -0,0 +1,72 @@
+/**
+ * @file early_stopping.h
+ * @author Fern Lane
+ * @brief Early stopping data and definitions
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef EARLY_STOPPING_H__
+#define EARLY_STOPPING_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "petal.h"
+
+// Weights, bias weights, running mean and running variance (PETAL_TYPE_BATCH_NORM)
+#define EARLY_STOPPING_SNAPSHOTS_PER_PETAL 4U
+
+/**
+ * @struct early_stopping_s
+ * Stores early stopping policy and snapshot of the best weights
+ *
+ * @param monitor metric to monitor at the end of each epoch: METRICS_LOSS_TRAIN, METRICS_ACCURACY_TRAIN,
+ * METRICS_LOSS_VALIDATION or METRICS_ACCURACY_VALIDATION (accuracy requires at least one enabled metric)
+ * @param patience number of epochs without improvement after which training will be stopped
+ * @param min_delta minimum change of monitored metric to count as improvement
+ * @param restore_best true to restore weights from the best epoch at the end of training
+ * @param _value_best internal best value of monitored metric
+ * @param _epoch_best internal index of the best epoch
+ * @param _epochs_waiting internal number of epochs without improvement
+ * @param _snapshots internal array of copies of weights (EARLY_STOPPING_SNAPSHOTS_PER_PETAL per petal: weights,
+ * bias weights and running statistics of batch normalization)
+ * @param _snapshots_length internal length of _snapshots array
+ */
+typedef struct {
+    uint8_t monitor;
+    uint32_t patience;
+    float min_delta;
+    bool restore_best;
+
+    float _value_best;
+    uint32_t _epoch_best, _epochs_waiting;
+    float **_snapshots;
+    uint32_t _snapshots_length;
+} early_stopping_s;
+
+void early_stopping_reset(early_stopping_s *early_stopping);
+
+uint8_t early_stopping_epoch_end(early_stopping_s *early_stopping, petal_s **petals, uint32_t petals_length,
+                                 uint32_t epoch_index, float loss_train, float accuracy_train, float loss_validation,
+                                 float accuracy_validation, bool *stop);
+
+void early_stopping_restore(early_stopping_s *early_stopping, petal_s **petals, uint32_t petals_length);
+
+void early_stopping_destroy(early_stopping_s *early_stopping);
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * @file embedding.h
+ * @author Fern Lane
+ * @brief Embedding lookup (gathers rows of table by ids) with sparse gradients
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef EMBEDDING_H__
+#define EMBEDDING_H__
+
+#include <stdint.h>
+
+#include "petal.h"
+
+uint8_t embedding_forward(petal_s *petal, const float *input);
+
+void embedding_backward(petal_s *petal, const float *input);
+
+#endif
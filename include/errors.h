@@ -40,7 +40,11 @@
 #define ERROR_FLOWER_NO_PETALS            12U
 #define ERROR_LOSS_WRONG_TYPE             13U
 #define ERROR_WRONG_BATCH_SIZE            14U
+#define ERROR_PETAL_WRONG_DROPOUT_MODE    15U
+#define ERROR_PETAL_WRONG_KERNEL          16U
+#define ERROR_PETAL_WRONG_INDEX           17U
+#define ERROR_FLOWER_WRONG_GRAPH          18U
 
-extern const char *error_to_str[15];
+extern const char *error_to_str[19];
 
 #endif
@@ -23,14 +23,64 @@
 #ifndef FLOWER_H__
 #define FLOWER_H__
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
+#include "callbacks.h"
+#include "early_stopping.h"
 #include "labeling.h"
 #include "loss.h"
 #include "metrics.h"
 #include "optimizers.h"
 #include "petal.h"
+#include "profile.h"
+#include "sparse.h"
+
+// Input of graph node that is flower's input data (instead of index of petal)
+#define FLOWER_INPUT UINT32_MAX
+
+// Merging of multiple inputs of graph node
+#define FLOWER_MERGE_ADD    0U
+#define FLOWER_MERGE_CONCAT 1U
+#define FLOWER_MERGE_MAX    FLOWER_MERGE_CONCAT
+
+// Validation intervals
+#define VALIDATION_INTERVAL_BATCHES        0U
+#define VALIDATION_INTERVAL_EPOCH_FRACTION 1U
+
+/**
+ * @struct validation_s
+ * Stores validation cadence during training
+ * NOTE: validation is always performed after the last batch of each epoch
+ *
+ * @param interval_type VALIDATION_INTERVAL_BATCHES or VALIDATION_INTERVAL_EPOCH_FRACTION
+ * @param interval number of batches between validations (for VALIDATION_INTERVAL_BATCHES) or fraction of epoch
+ * (for VALIDATION_INTERVAL_EPOCH_FRACTION, ex. 1.0 to validate once per epoch, 0.25 to validate 4 times per epoch)
+ * Default: 1.0
+ * @param subset_ratio ratio (0 to 1] of validation dataset randomly picked for each validation. Default: 1.0
+ */
+typedef struct {
+    uint8_t interval_type;
+    float interval, subset_ratio;
+} validation_s;
+
+/**
+ * @struct flower_node_s
+ * Stores inputs of one petal of graph flower (see flower_init_graph())
+ *
+ * @param inputs pointer to array of indices of petals which outputs are inputs of this petal or FLOWER_INPUT
+ * (must be the only input)
+ * @param inputs_length number of inputs (length of inputs array)
+ * @param merge FLOWER_MERGE_ADD to sum inputs (each must have petal's input length) or FLOWER_MERGE_CONCAT to
+ * concatenate them one after another (total length must be petal's input length)
+ */
+typedef struct {
+    uint32_t *inputs;
+    uint32_t inputs_length;
+    uint8_t merge;
+} flower_node_s;
 
 /**
  * @struct flower_s
@@ -38,28 +88,91 @@
  *
  * @param petals pointer to array of pointers of petals
  * @param petals_length number of petals (length of petals array)
+ * @param validation validation cadence during training (see validation_s). Default: after each batch on entire
+ * validation dataset
+ * @param early_stopping pointer to early_stopping_s struct or NULL to always train for all epochs. Default: NULL
+ * @param callbacks pointer to array of pointers of callbacks_s structs or NULL. Default: NULL
+ * @param callbacks_length number of sets of callbacks (length of callbacks array)
+ * @param rng_streams true to use counter-based random streams (keyed by rng_seed, epoch, sample and petal indices)
+ * for shuffling, dropout and validation subsets instead of rk_state_global. Results don't depend on the order in
+ * which streams are used (ex. number of threads). Default: false
+ * @param rng_seed seed of counter-based random streams (if rng_streams is true). Default: 0
  * @param _loss internal pointer to _loss struct
  * @param error_code initialization or runtime error code
+ * @param _nodes internal pointer to array of nodes (one per petal) passed into flower_init_graph() or built by
+ * flower_init() for chain of petals
+ * @param _nodes_owned internal true if _nodes is built by flower_init()
+ * @param _chain_inputs internal input of each petal of chain (for _nodes built by flower_init())
+ * @param _order internal topological order of petals (forward propagation order)
+ * @param _merged internal merged input of each petal with multiple inputs (kept for backpropagation, allocated by the
+ * first training forward pass) or NULL
+ * @param _errors internal errors on output of each petal: "error_on_input" of its only consumer or shared buffer
+ * into which errors of consumers are summed (NULL for the last petal)
+ * @param _errors_first internal index of consumer which backpropagates into _errors first (it overwrites them)
+ * @param _buffers internal buffers shared by _errors of petals which errors are not needed at the same time
+ * @param _buffers_lengths internal length of each buffer
+ * @param _buffers_length internal number of buffers
+ * @param _outputs internal output of each petal during inference: shared buffer of _pool (own output for the last
+ * petal)
+ * @param _outputs_own internal own output of each petal (restored after inference)
+ * @param _merged_inference internal merged input of each petal with multiple inputs during inference (shared buffer of
+ * _pool) or NULL
+ * @param _pool internal buffers shared by outputs and merged inputs which are not needed at the same time during
+ * inference (own outputs of petals or allocated buffers)
+ * @param _pool_lengths internal length of each buffer of _pool
+ * @param _pool_allocated internal true for each buffer of _pool allocated by flower (not own output of petal)
+ * @param _pool_length internal number of buffers of _pool
  */
 typedef struct {
     petal_s **petals;
     uint32_t petals_length;
+    validation_s validation;
+    early_stopping_s *early_stopping;
+    callbacks_s **callbacks;
+    uint32_t callbacks_length;
+    bool rng_streams;
+    uint64_t rng_seed;
 
     loss_s *_loss;
     uint8_t error_code;
+
+    flower_node_s *_nodes;
+    bool _nodes_owned;
+    uint32_t *_chain_inputs;
+    uint32_t *_order;
+    float **_merged, **_errors;
+    uint32_t *_errors_first;
+    float **_buffers;
+    uint32_t *_buffers_lengths;
+    uint32_t _buffers_length;
+    float **_outputs, **_outputs_own, **_merged_inference, **_pool;
+    uint32_t *_pool_lengths;
+    bool *_pool_allocated;
+    uint32_t _pool_length;
 } flower_s;
 
 flower_s *flower_init(petal_s **petals, uint32_t petals_length);
 
+flower_s *flower_init_graph(petal_s **petals, uint32_t petals_length, flower_node_s *nodes);
+
 float *flower_predict(flower_s *flower, float *input);
 
 float *flower_forward(flower_s *flower, float *input, bool training);
 
+float *flower_forward_sparse(flower_s *flower, const sparse_s *input, bool training);
+
+uint32_t flower_fold_batchnorm(flower_s *flower, bool destroy_petals, bool destroy_weights_array,
+                               bool destroy_bias_weights_array);
+
 void flower_train(flower_s *flower, uint8_t loss_type, optimizer_s *optimizer, metrics_s *metrics, float **inputs_train,
                   float **outputs_true_train, labels_s **outputs_true_train_sparse, uint32_t train_length,
                   float **inputs_validation, float **outputs_true_validation, labels_s **outputs_true_validation_sparse,
                   uint32_t validation_length, uint32_t batch_size, uint32_t epochs);
 
+void flower_profile_reset(flower_s *flower);
+
+void flower_profile_report(flower_s *flower, FILE *stream, uint8_t format);
+
 size_t flower_estimate_min_size(flower_s *flower);
 
 void flower_destroy(flower_s *flower, bool destroy_petals, bool destroy_weights_array, bool destroy_bias_weights_array);
@@ -0,0 +1,41 @@
+/**
+ * @file gemm.h
+ * @author Fern Lane
+ * @brief Blocked single-precision matrix multiplication definitions
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef GEMM_H__
+#define GEMM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Block sizes (op(B) block of GEMM_BLOCK_K x GEMM_BLOCK_N floats is packed on stack)
+#define GEMM_BLOCK_K 64U
+#define GEMM_BLOCK_N 256U
+
+// Number of independent partial sums of each dot product in gemv() (lets compiler vectorize reduction)
+#define GEMV_LANES 8U
+
+void gemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, float alpha, const float *a,
+          const float *b, float beta, float *c);
+
+void gemv(bool transpose_a, uint32_t m, uint32_t n, float alpha, const float *a, const float *x, float beta, float *y);
+
+#endif
@@ -24,13 +24,23 @@
 #define METRICS_H__
 
 #include <stdint.h>
-#include <time.h>
+
+#include "callbacks.h"
 
 #define METRICS_TIME_ELAPSED        0U
 #define METRICS_LOSS_TRAIN          1U
 #define METRICS_ACCURACY_TRAIN      2U
 #define METRICS_LOSS_VALIDATION     3U
 #define METRICS_ACCURACY_VALIDATION 4U
+#define METRICS_SAMPLES_PER_SECOND  5U
+#define METRICS_MS_PER_BATCH        6U
+#define METRICS_TIME_FORWARD        7U
+#define METRICS_TIME_BACKWARD       8U
+#define METRICS_TIME_OPTIMIZER      9U
+#define METRICS_TIME_VALIDATION     10U
+
+// For error check and tests
+#define METRICS_MAX METRICS_TIME_VALIDATION
 
 #ifndef METRICS_PROGRESS_BAR_WIDTH
 #define METRICS_PROGRESS_BAR_WIDTH 20U
@@ -42,27 +52,24 @@
  *
  * @param *metrics array of enabled metrics
  * @param metrics_length size of metrics array
- * @param _epoch_index_prev index of last epoch (for checking if epoch was changed)
- * @param _time_now internal variable to store current batch time
- * @param _epoch_time_start internal variable to store each epoch start time
+ * @param callbacks built-in callbacks that print progress bar with enabled metrics after each batch
+ * (set callbacks.on_batch_end to NULL to calculate accuracy without printing anything)
  */
 typedef struct {
     uint8_t *metrics;
     uint8_t metrics_length;
-
-    int32_t _epoch_index_prev;
-    time_t _time_now, _epoch_time_start, _training_time_start;
+    callbacks_s callbacks;
 } metrics_s;
 
-metrics_s *metrics_init();
+metrics_s *metrics_init(uint32_t log_interval);
 
 void metrics_add(metrics_s *metrics, uint8_t metric);
 
 void metrics_remove(metrics_s *metrics, uint8_t metric);
 
-void metrics_calculate_batch(metrics_s *metrics, uint32_t epoch_index, uint32_t epochs_total, uint32_t batch_index,
-                             uint32_t batches_per_epoch, float loss_train, float loss_validation, float accuracy_train,
-                             float accuracy_validation);
+void metrics_calculate_batch(metrics_s *metrics, callback_data_s *data);
+
+void metrics_on_batch_end(callback_data_s *data, void *user_data);
 
 float metrics_calculate_accuracy(metrics_s *metrics, float *predicted, float *expected, uint32_t length,
                                  float threshold);
@@ -0,0 +1,47 @@
+/**
+ * @file norm.h
+ * @author Fern Lane
+ * @brief Normalization petals with trainable scale and shift
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NORM_H__
+#define NORM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "petal.h"
+
+uint32_t batch_norm_features(petal_s *petal);
+
+void batch_norm_forward(petal_s *petal, const float *input, bool training);
+
+void batch_norm_backward(petal_s *petal);
+
+void batch_norm_batch_begin(petal_s *petal);
+
+void batch_norm_batch_statistics(petal_s *petal);
+
+void batch_norm_batch_errors(petal_s *petal);
+
+void layer_norm_forward(petal_s *petal, const float *input, bool training);
+
+void layer_norm_backward(petal_s *petal);
+
+#endif
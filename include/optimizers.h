@@ -26,6 +26,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "scheduler.h"
+
 #define OPTIMIZER_SGD_MOMENTUM 0U
 #define OPTIMIZER_RMS_PROP     1U
 #define OPTIMIZER_ADA_GRAD     2U
@@ -43,10 +45,12 @@
  * @param momentum accelerates gradient descent and dampens oscillations (for OPTIMIZER_SGD_MOMENTUM)
  * @param beta_1 hyperparameter (for OPTIMIZER_RMS_PROP and OPTIMIZER_ADAM) Default: 0.9
  * @param beta_2 hyperparameter (for OPTIMIZER_ADAM) Default: 0.999
+ * @param scheduler pointer to scheduler_s struct or NULL to keep learning rate constant during training
  */
 typedef struct {
     uint8_t type;
     float learning_rate, momentum, beta_1, beta_2;
+    scheduler_s *scheduler;
 } optimizer_s;
 
 #endif
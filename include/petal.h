@@ -29,6 +29,8 @@
 
 #include "activation.h"
 #include "dropout.h"
+#include "profile.h"
+#include "sparse.h"
 #include "weights.h"
 
 // Petal types
@@ -37,9 +39,43 @@
 #define PETAL_TYPE_NORMALIZE_IN_ROWS     2U
 #define PETAL_TYPE_NORMALIZE_IN_CHANNELS 3U
 #define PETAL_TYPE_DENSE_1D              4U
+#define PETAL_TYPE_CONV_2D               5U
+#define PETAL_TYPE_MAX_POOL_2D           6U
+#define PETAL_TYPE_AVG_POOL_2D           7U
+#define PETAL_TYPE_BATCH_NORM            8U
+#define PETAL_TYPE_LAYER_NORM            9U
+#define PETAL_TYPE_EMBEDDING             10U
+#define PETAL_TYPE_LSTM                  11U
+#define PETAL_TYPE_GRU                   12U
+#define PETAL_TYPE_ATTENTION             13U
 
 // For error check and tests
-#define PETAL_TYPE_MAX PETAL_TYPE_DENSE_1D
+#define PETAL_TYPE_MAX PETAL_TYPE_ATTENTION
+
+// Convolution algorithms (CONV_ALGORITHM_AUTO chooses one from shapes during petal_init())
+#define CONV_ALGORITHM_AUTO     0U
+#define CONV_ALGORITHM_IM2COL   1U
+#define CONV_ALGORITHM_DIRECT   2U
+#define CONV_ALGORITHM_WINOGRAD 3U
+#define CONV_ALGORITHM_MAX      CONV_ALGORITHM_WINOGRAD
+
+// Default momentum of running statistics of PETAL_TYPE_BATCH_NORM (weight of each new mini-batch)
+#define BATCH_NORM_MOMENTUM_DEFAULT 0.01f
+
+// Statistics used by training forward pass of PETAL_TYPE_BATCH_NORM: running statistics updated by each sample
+// (outside of flower_train()), accumulation of statistics of mini-batch or statistics of mini-batch
+#define BATCH_NORM_STAGE_RUNNING    0U
+#define BATCH_NORM_STAGE_STATISTICS 1U
+#define BATCH_NORM_STAGE_BATCH      2U
+
+// Number of arrays of features in _batch_stats of PETAL_TYPE_BATCH_NORM
+#define BATCH_NORM_BATCH_STATS 5U
+
+// Max. vocabulary size of PETAL_TYPE_EMBEDDING (ids are passed as floats, so they must be exactly representable)
+#define EMBEDDING_MAX_VOCABULARY_SIZE (1U << 24U)
+
+// Added to variance before calculating inverse standard deviation in normalization petals
+#define NORM_EPSILON 1e-5f
 
 // Epsilon to prevent division by zero and other undefined states
 #ifndef EPSILON
@@ -62,14 +98,34 @@ typedef struct {
 
 /**
  * @struct petal_params_s
- * Stores simple (non-pointers) optional parameters for dropout and normalization
+ * Stores simple (non-pointers) optional parameters for dropout, normalization and convolution
  *
  * @param dropout ratio of dropped outputs (0 to 1)
  * @param center center of normalization for PETAL_TYPE_NORMALIZE_...
  * @param deviation deviation of normalization for PETAL_TYPE_NORMALIZE_...
+ * @param dropout_mode DROPOUT_MODE_EXACT (default) or DROPOUT_MODE_BERNOULLI
+ * @param kernel_rows height of kernel or pooling window (for PETAL_TYPE_CONV_2D and PETAL_TYPE_..._POOL_2D)
+ * @param kernel_cols width of kernel or pooling window (for PETAL_TYPE_CONV_2D and PETAL_TYPE_..._POOL_2D)
+ * @param stride step of kernel in both dimensions (for PETAL_TYPE_CONV_2D and PETAL_TYPE_..._POOL_2D). 0 means 1
+ * @param padding number of zeros on each side of input in both dimensions (for PETAL_TYPE_CONV_2D) or number of
+ * ignored elements (for PETAL_TYPE_..._POOL_2D)
+ * @param dilation step between kernel elements in both dimensions (for PETAL_TYPE_CONV_2D and
+ * PETAL_TYPE_..._POOL_2D). 0 means 1
+ * @param conv_algorithm CONV_ALGORITHM_AUTO (default), CONV_ALGORITHM_IM2COL, CONV_ALGORITHM_DIRECT or
+ * CONV_ALGORITHM_WINOGRAD (only for 3x3 kernels with stride 1 and without dilation)
+ * @param momentum weight of each mini-batch (or each training sample outside of flower_train()) in running mean and
+ * variance (for PETAL_TYPE_BATCH_NORM). 0 means BATCH_NORM_MOMENTUM_DEFAULT
+ * @param vocabulary_size number of rows of embedding table (for PETAL_TYPE_EMBEDDING)
+ * @param heads number of attention heads (for PETAL_TYPE_ATTENTION). 0 means 1
  */
 typedef struct {
     float dropout, center, deviation;
+    uint8_t dropout_mode;
+    uint32_t kernel_rows, kernel_cols, stride, padding, dilation;
+    uint8_t conv_algorithm;
+    float momentum;
+    uint32_t vocabulary_size;
+    uint32_t heads;
 } petal_params_s;
 
 /**
@@ -86,6 +142,41 @@ typedef struct {
  * @param output - petal outputs
  * @param error_on_input - petal input state during backpropagation
  * @param error_code - initialization or runtime error code
+ * @param _profile - internal accumulated profiling stats (exists only if compiled with PROFILING definition)
+ * @param _dropout_mask - internal scaled keep-mask generated on each training forward pass (if dropout > 0)
+ * @param _rng_stream - internal counter-based random stream for dropout (set by flower_train() if flower->rng_streams)
+ * @param _rng_stream_enabled - internal true to use _rng_stream instead of rk_state_global
+ * @param _columns - internal im2col matrix or Winograd tile (for PETAL_TYPE_CONV_2D)
+ * @param _conv_kernel - internal repacked or transformed weights (for direct and Winograd PETAL_TYPE_CONV_2D)
+ * @param _conv_algorithm - internal selected CONV_ALGORITHM_... (for PETAL_TYPE_CONV_2D)
+ * @param _pool_indices - internal input index of each output recorded during training forward pass
+ * (for PETAL_TYPE_MAX_POOL_2D if not first)
+ * @param _running_mean - internal running mean of each feature (for PETAL_TYPE_BATCH_NORM)
+ * @param _running_variance - internal running variance of each feature (for PETAL_TYPE_BATCH_NORM)
+ * @param _inv_std - internal inverse standard deviation of each feature (for PETAL_TYPE_BATCH_NORM) or each row
+ * (for PETAL_TYPE_LAYER_NORM) used by the last forward pass
+ * @param _normalized - internal normalized input (before scale and shift) of the last training forward pass
+ * (for PETAL_TYPE_BATCH_NORM and PETAL_TYPE_LAYER_NORM)
+ * @param _batch_norm_stage - internal BATCH_NORM_STAGE_... (for PETAL_TYPE_BATCH_NORM, set by flower_train())
+ * @param _batch_samples - internal number of samples of mini-batch accumulated into _batch_stats
+ * @param _batch_stats - internal mean of mini-batch, two sums being accumulated, mean of errors and mean of errors *
+ * normalized input of mini-batch of each feature (for PETAL_TYPE_BATCH_NORM)
+ * @param _rnn_gates - internal input projections and then activated gates of each timestep (for PETAL_TYPE_LSTM and
+ * PETAL_TYPE_GRU)
+ * @param _rnn_cells - internal cell state (for PETAL_TYPE_LSTM) or recurrent part of new gate (for PETAL_TYPE_GRU) of
+ * each timestep
+ * @param _rnn_hidden - internal hidden state of each timestep after initial zero state (for PETAL_TYPE_LSTM and
+ * PETAL_TYPE_GRU)
+ * @param _rnn_gates_grad - internal errors of gates of each timestep (for PETAL_TYPE_LSTM and PETAL_TYPE_GRU)
+ * @param _rnn_temp - internal recurrent part of gates or errors of hidden and cell states of one timestep
+ * (for PETAL_TYPE_LSTM and PETAL_TYPE_GRU)
+ * @param _attention_qkv - internal queries, keys and values of each head (for PETAL_TYPE_ATTENTION)
+ * @param _attention_heads - internal output of each head before output projection (for PETAL_TYPE_ATTENTION)
+ * @param _attention_temp - internal projections before splitting into heads or their errors (for PETAL_TYPE_ATTENTION)
+ * @param _attention_grad - internal errors of queries, keys and values of each head (for PETAL_TYPE_ATTENTION)
+ * @param _attention_stats - internal log of sum of exponents of scores of each head and query and temp sums of
+ * output errors * output (for PETAL_TYPE_ATTENTION)
+ * @param _attention_tile - internal scores (probabilities) and their errors of one tile (for PETAL_TYPE_ATTENTION)
  */
 typedef struct {
     uint8_t petal_type;
@@ -98,16 +189,59 @@ typedef struct {
     bit_array_s *bit_array;
     float *output, *error_on_input;
     uint8_t error_code;
+
+#ifdef PROFILING
+    profile_s _profile;
+#endif
+    float *_dropout_mask;
+    rk_stream_s _rng_stream;
+    bool _rng_stream_enabled;
+    float *_columns, *_conv_kernel;
+    uint8_t _conv_algorithm;
+    uint32_t *_pool_indices;
+    float *_running_mean, *_running_variance, *_inv_std, *_normalized;
+    uint8_t _batch_norm_stage;
+    uint32_t _batch_samples;
+    float *_batch_stats;
+    float *_rnn_gates, *_rnn_cells, *_rnn_hidden, *_rnn_gates_grad, *_rnn_temp;
+    float *_attention_qkv, *_attention_heads, *_attention_temp, *_attention_grad, *_attention_stats, *_attention_tile;
 } petal_s;
 
+// Adds estimated FLOPs and bytes of one forward / backward call into petal's profile (only with PROFILING)
+#ifdef PROFILING
+#define PETAL_PROFILE_COST(petal, backward)                   petal_profile_cost(petal, backward)
+#define PETAL_PROFILE_COST_SPARSE(petal, nonzeros, backward) petal_profile_cost_sparse(petal, nonzeros, backward)
+#else
+#define PETAL_PROFILE_COST(petal, backward)
+#define PETAL_PROFILE_COST_SPARSE(petal, nonzeros, backward)
+#endif
+
 petal_s *petal_init(uint8_t petal_type, bool first, petal_shape_s *input_shape, petal_shape_s *output_shape,
                     weights_s *weights, weights_s *bias_weights, activation_s *activation,
                     petal_params_s *petal_params);
 
+uint32_t petal_conv_2d_kernel_length(petal_s *petal);
+
 void petal_forward(petal_s *petal, float *input, bool training);
 
 void petal_backward(petal_s *petal, float *error_right, float *output_left);
 
+void petal_forward_sparse(petal_s *petal, const sparse_s *input, bool training);
+
+void petal_backward_sparse(petal_s *petal, float *error_right, const sparse_s *input);
+
+void petal_estimate_cost(petal_s *petal, bool backward, uint64_t *flops, uint64_t *bytes);
+
+#ifdef PROFILING
+void petal_profile_cost(petal_s *petal, bool backward);
+#endif
+
+void petal_estimate_cost_sparse(petal_s *petal, uint32_t nonzeros, bool backward, uint64_t *flops, uint64_t *bytes);
+
+#ifdef PROFILING
+void petal_profile_cost_sparse(petal_s *petal, uint32_t nonzeros, bool backward);
+#endif
+
 size_t petal_estimate_min_size(petal_s *petal);
 
 void petal_destroy(petal_s *petal, bool destroy_weights_structs, bool destroy_weights_array,
@@ -0,0 +1,41 @@
+/**
+ * @file pool.h
+ * @author Fern Lane
+ * @brief Max and average 2D pooling
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef POOL_H__
+#define POOL_H__
+
+#include <stdint.h>
+
+#include "petal.h"
+
+// Index of max-pooling window without any input element (window is entirely inside padding)
+#define POOL_INDEX_NONE UINT32_MAX
+
+void pool_max_forward(petal_s *petal, const float *input, uint32_t *indices);
+
+void pool_max_backward(petal_s *petal, const uint32_t *indices);
+
+void pool_avg_forward(petal_s *petal, const float *input);
+
+void pool_avg_backward(petal_s *petal);
+
+#endif
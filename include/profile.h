@@ -0,0 +1,65 @@
+/**
+ * @file profile.h
+ * @author Fern Lane
+ * @brief Per-petal profiling data and zero-cost instrumentation macros
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PROFILE_H__
+#define PROFILE_H__
+
+#include <stdint.h>
+
+#include "timer.h"
+
+// Formats of flower_profile_report()
+#define PROFILE_REPORT_TABLE 0U
+#define PROFILE_REPORT_JSON  1U
+
+/**
+ * @struct profile_s
+ * Stores accumulated profiling stats of petal (filled only if compiled with PROFILING definition)
+ *
+ * @param calls_forward number of forward propagations
+ * @param calls_backward number of backpropagations
+ * @param calls_update number of weights updates
+ * @param time_forward nanoseconds spent on forward propagation (including activation)
+ * @param time_backward nanoseconds spent on backpropagation (including activation derivatives)
+ * @param time_activation nanoseconds spent on activation and it's derivatives
+ * @param time_update nanoseconds spent on weights and bias weights update
+ * @param flops estimated number of floating-point operations of forward and backward propagation
+ * @param bytes estimated number of bytes read and written during forward and backward propagation
+ */
+typedef struct {
+    uint64_t calls_forward, calls_backward, calls_update;
+    uint64_t time_forward, time_backward, time_activation, time_update;
+    uint64_t flops, bytes;
+} profile_s;
+
+// Instrumentation macros (compiled out without PROFILING definition)
+#ifdef PROFILING
+#define PROFILE_START(timestamp)                uint64_t timestamp = timer_get_ns()
+#define PROFILE_STOP(profile, field, timestamp) ((profile).field += timer_get_ns() - (timestamp))
+#define PROFILE_ADD(profile, field, value)      ((profile).field += (value))
+#else
+#define PROFILE_START(timestamp)
+#define PROFILE_STOP(profile, field, timestamp)
+#define PROFILE_ADD(profile, field, value)
+#endif
+
+#endif
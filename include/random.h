@@ -46,6 +46,38 @@ typedef struct {
     uint32_t pos;
 } rk_state_s;
 
+// Number of random words generated at once by rk_fill_...() and rk_stream_fill_...() (buffer on stack)
+#define RK_FILL_CHUNK 256U
+
+#define RK_TWO_PI 6.28318530717958647692f
+
+// Philox4x32-10 constants
+#define RK_PHILOX_M0     0xD2511F53UL
+#define RK_PHILOX_M1     0xCD9E8D57UL
+#define RK_PHILOX_W0     0x9E3779B9UL
+#define RK_PHILOX_W1     0xBB67AE85UL
+#define RK_PHILOX_ROUNDS 10U
+
+// Stream id that is never used as sample or petal index (for streams that are not bound to them)
+#define RK_STREAM_ID_NONE 0xFFFFFFFFUL
+
+/**
+ * @struct rk_stream_s
+ * Counter-based (Philox4x32-10) random stream. Each stream is fully defined by its key (seed) and 3 ids
+ * (ex. epoch, sample and petal indices), so streams don't share any state and can be created anywhere in any order
+ *
+ * @param key seed as 2 32-bit words
+ * @param counter block index (counter[0]) and stream ids (counter[1 - 3])
+ * @param buffer last generated block of 4 random words
+ * @param pos index of next word in buffer
+ */
+typedef struct {
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t buffer[4];
+    uint32_t pos;
+} rk_stream_s;
+
 extern rk_state_s rk_state_global;
 
 void rk_seed_(uint32_t seed);
@@ -60,4 +92,24 @@ extern double rk_double(rk_state_s *state);
 extern float rk_float_();
 extern float rk_float(rk_state_s *state);
 
+uint32_t rk_bounded_(uint32_t bound);
+uint32_t rk_bounded(rk_state_s *state, uint32_t bound);
+
+void rk_fill_uniform(rk_state_s *state, float *dst, uint32_t length, float low, float high);
+void rk_fill_gaussian(rk_state_s *state, float *dst, uint32_t length, float mean, float deviation);
+
+void rk_philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t output[4]);
+
+void rk_stream_init(rk_stream_s *stream, uint64_t seed, uint32_t id_1, uint32_t id_2, uint32_t id_3);
+
+uint32_t rk_stream_random(rk_stream_s *stream);
+
+float rk_stream_float(rk_stream_s *stream);
+
+uint32_t rk_stream_bounded(rk_stream_s *stream, uint32_t bound);
+
+void rk_stream_fill_uniform(rk_stream_s *stream, float *dst, uint32_t length, float low, float high);
+
+void rk_stream_fill_gaussian(rk_stream_s *stream, float *dst, uint32_t length, float mean, float deviation);
+
 #endif
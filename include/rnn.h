@@ -0,0 +1,38 @@
+/**
+ * @file rnn.h
+ * @author Fern Lane
+ * @brief Recurrent (LSTM and GRU) petals over time dimension (rows)
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RNN_H__
+#define RNN_H__
+
+#include <stdint.h>
+
+#include "petal.h"
+
+uint32_t rnn_gates(petal_s *petal);
+
+uint32_t rnn_hidden_size(petal_s *petal);
+
+void rnn_forward(petal_s *petal, const float *input);
+
+void rnn_backward(petal_s *petal, const float *input);
+
+#endif
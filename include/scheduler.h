@@ -0,0 +1,80 @@
+/**
+ * @file scheduler.h
+ * @author Fern Lane
+ * @brief Learning rate schedulers data and definitions
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SCHEDULER_H__
+#define SCHEDULER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHEDULER_CONSTANT          0U
+#define SCHEDULER_STEP              1U
+#define SCHEDULER_EXPONENTIAL       2U
+#define SCHEDULER_COSINE_WARMUP     3U
+#define SCHEDULER_ONE_CYCLE         4U
+#define SCHEDULER_REDUCE_ON_PLATEAU 5U
+
+// For error check and tests
+#define SCHEDULER_MAX SCHEDULER_REDUCE_ON_PLATEAU
+
+/**
+ * @struct scheduler_s
+ * Stores learning rate scheduler's data
+ * Learning rate is calculated from optimizer's learning_rate (base learning rate) before each weights update
+ *
+ * @param type scheduler type (SCHEDULER_...)
+ * @param decay_steps number of optimizer steps (batches) per decay (for SCHEDULER_STEP and SCHEDULER_EXPONENTIAL)
+ * @param gamma multiplicative factor of learning rate decay
+ * (for SCHEDULER_STEP, SCHEDULER_EXPONENTIAL and SCHEDULER_REDUCE_ON_PLATEAU) Default: 0.1
+ * @param warmup_steps number of optimizer steps of linear warmup (for SCHEDULER_COSINE_WARMUP)
+ * @param warmup_ratio fraction of total steps spent increasing learning rate (for SCHEDULER_ONE_CYCLE) Default: 0.3
+ * @param learning_rate_min lowest learning rate
+ * (for SCHEDULER_COSINE_WARMUP, SCHEDULER_ONE_CYCLE and SCHEDULER_REDUCE_ON_PLATEAU)
+ * @param patience number of epochs without improvement before reducing learning rate
+ * (for SCHEDULER_REDUCE_ON_PLATEAU)
+ * @param min_delta minimum decrease of monitored loss to count as improvement (for SCHEDULER_REDUCE_ON_PLATEAU)
+ * @param _factor internal current learning rate multiplier (for SCHEDULER_REDUCE_ON_PLATEAU)
+ * @param _loss_best internal best monitored loss (for SCHEDULER_REDUCE_ON_PLATEAU)
+ * @param _epochs_waiting internal number of epochs without improvement (for SCHEDULER_REDUCE_ON_PLATEAU)
+ */
+typedef struct {
+    uint8_t type;
+    uint32_t decay_steps;
+    float gamma;
+    uint32_t warmup_steps;
+    float warmup_ratio;
+    float learning_rate_min;
+    uint32_t patience;
+    float min_delta;
+
+    float _factor, _loss_best;
+    uint32_t _epochs_waiting;
+} scheduler_s;
+
+void scheduler_reset(scheduler_s *scheduler);
+
+float scheduler_get_learning_rate(scheduler_s *scheduler, float learning_rate_base, uint64_t step,
+                                  uint64_t steps_total);
+
+void scheduler_epoch_end(scheduler_s *scheduler, float loss);
+
+#endif
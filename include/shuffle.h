@@ -26,7 +26,12 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "labeling.h"
+#include "random.h"
+
 bool shuffle_2d(float **array_1, float **array_2, uint32_t array_length, uint32_t element_size_1,
-                uint32_t element_size_2);
+                uint32_t element_size_2, rk_stream_s *stream);
+
+void shuffle_labels(labels_s **labels, uint32_t labels_length, rk_stream_s *stream);
 
 #endif
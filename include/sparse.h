@@ -0,0 +1,48 @@
+/**
+ * @file sparse.h
+ * @author Fern Lane
+ * @brief Sparse vectors (indices and values of non-zero elements)
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SPARSE_H__
+#define SPARSE_H__
+
+#include <stdint.h>
+
+/**
+ * @struct sparse_s
+ * Stores non-zero elements of vector (like labels_s but with values)
+ *
+ * @param indices pointer to array of indices of non-zero elements
+ * @param values pointer to array of values of non-zero elements
+ * @param length number of non-zero elements (length of indices and values arrays)
+ */
+typedef struct {
+    uint32_t *indices;
+    float *values;
+    uint32_t length;
+} sparse_s;
+
+sparse_s *dense_to_sparse(const float *dense, uint32_t dense_length);
+
+void sparse_to_dense(const sparse_s *sparse, float *dense, uint32_t dense_length);
+
+void sparse_destroy(sparse_s *sparse);
+
+#endif
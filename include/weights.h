@@ -27,6 +27,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "bit_array.h"
 #include "optimizers.h"
 
 // Weights (and bias weights) initializers
@@ -38,8 +39,14 @@
 #define WEIGHTS_INIT_KAIMING_HE_UNIFORM     5U
 #define WEIGHTS_INIT_KAIMING_HE_GAUSSIAN    6U
 
+// Only allocates zeroed weights (ex. if they will be loaded from file)
+#define WEIGHTS_INIT_NONE 7U
+
 // For error check and tests
-#define WEIGHTS_INIT_MAX WEIGHTS_INIT_KAIMING_HE_GAUSSIAN
+#define WEIGHTS_INIT_MAX WEIGHTS_INIT_NONE
+
+// Number of weights initialized with one random stream (chunks are initialized in parallel if compiled with OpenMP)
+#define WEIGHTS_INIT_CHUNK 65536U
 
 // Epsilon to prevent division by zero and other undefined states
 #ifndef EPSILON
@@ -62,6 +69,10 @@
  * @param velocities_or_cache pointer to 1D internal temp array of velocities or gradients cache (for
  * OPTIMIZER_ADA_GRAD)
  * @param _learning_step index of weights update from start of training (for OPTIMIZER_ADAM)
+ * @param _sparse_row_length number of weights in each row (if sparse updates are enabled by weights_sparse_init() or
+ * weights_sparse_cols_init())
+ * @param _sparse_rows rows with gradients since previous update or NULL to update all weights
+ * @param _sparse_cols columns with gradients since previous update or NULL to update all weights
  */
 typedef struct {
     bool trainable;
@@ -71,12 +82,51 @@ typedef struct {
     float center, deviation;
     float *moments, *velocities_or_cache;
     uint64_t _learning_step;
+    uint32_t _sparse_row_length;
+    bit_array_s *_sparse_rows;
+    bit_array_s *_sparse_cols;
 } weights_s;
 
 uint8_t weights_check_init(weights_s *weights, uint32_t length_total);
 
 uint8_t weights_init(weights_s *weights, bool from_self);
 
+uint8_t weights_sparse_init(weights_s *weights, uint32_t row_length);
+
+/**
+ * @brief Marks row of weights to be updated by the next weights_update() (sparse updates must be enabled)
+ *
+ * @param weights pointer to weights_s struct
+ * @param row index of row
+ */
+static inline void weights_sparse_mark_row(weights_s *weights, uint32_t row) {
+    bit_array_set_bit_unchecked(weights->_sparse_rows, row);
+}
+
+uint8_t weights_sparse_cols_init(weights_s *weights, uint32_t row_length);
+
+/**
+ * @brief Marks column of weights to be updated by the next weights_update() (column sparse updates must be enabled)
+ *
+ * @param weights pointer to weights_s struct
+ * @param col index of column
+ */
+static inline void weights_sparse_mark_col(weights_s *weights, uint32_t col) {
+    bit_array_set_bit_unchecked(weights->_sparse_cols, col);
+}
+
+/**
+ * @brief Marks each column of weights to be updated by the next weights_update() (if column sparse updates are enabled)
+ *
+ * @param weights pointer to weights_s struct or NULL
+ */
+static inline void weights_sparse_mark_cols(weights_s *weights) {
+    if (weights && weights->_sparse_cols) {
+        bit_array_clear(weights->_sparse_cols);
+        bit_array_not(weights->_sparse_cols);
+    }
+}
+
 uint8_t weights_update(weights_s *weights, optimizer_s *optimizer);
 
 size_t weights_estimate_min_size(weights_s *weights);
@@ -27,7 +27,6 @@
 #include <string.h>
 
 #include "activation.h"
-#include "dropout.h"
 #include "errors.h"
 #include "logger.h"
 #include "petal.h"
@@ -47,10 +46,9 @@
  * swish_beta - beta for turning Swish into E-Swish (for ACTIVATION_SWISH only). Default = 1.0
  * @param layer pointer to 1D array of data to activate
  * @param layer_length size of 1D array of data to activate
- * @param bit_array pointer to bit array for dropout (indices with set bits (1) will be ignored) or NULL
  * @return uint8_t ERROR_NONE or error code in case of error
  */
-uint8_t activation_forward(activation_s *activation, float *layer, uint32_t layer_length, bit_array_s *bit_array) {
+uint8_t activation_forward(activation_s *activation, float *layer, uint32_t layer_length) {
     // Allocate temp array for activation functions derivatives
     if (!activation->_derivatives_temp) {
         activation->_derivatives_temp = calloc(layer_length, sizeof(float));
@@ -60,19 +58,15 @@ uint8_t activation_forward(activation_s *activation, float *layer, uint32_t laye
         }
     }
 
-    // if (!bit_array || !bit_array_get_bit(bit_array, i)) will ignore activation and derivatives for some indices
-
     // Linear
     // f(x) = ax + c
     if (activation->type == ACTIVATION_LINEAR) {
         if (activation->linear_alpha != 1.f)
             for (uint32_t i = 0; i < layer_length; ++i)
-                if (!bit_array || !bit_array_get_bit(bit_array, i))
-                    layer[i] *= activation->linear_alpha;
+                layer[i] *= activation->linear_alpha;
         if (activation->linear_const != 0.f)
             for (uint32_t i = 0; i < layer_length; ++i)
-                if (!bit_array || !bit_array_get_bit(bit_array, i))
-                    layer[i] += activation->linear_const;
+                layer[i] += activation->linear_const;
     }
 
     // Leaky ReLU
@@ -83,14 +77,12 @@ uint8_t activation_forward(activation_s *activation, float *layer, uint32_t laye
 
         if (activation->relu_leak != 0.f) {
             for (uint32_t i = 0; i < layer_length; ++i)
-                if (!bit_array || !bit_array_get_bit(bit_array, i))
-                    if (layer[i] < 0.f)
-                        layer[i] *= activation->relu_leak;
+                if (layer[i] < 0.f)
+                    layer[i] *= activation->relu_leak;
         } else {
             for (uint32_t i = 0; i < layer_length; ++i)
-                if (!bit_array || !bit_array_get_bit(bit_array, i))
-                    if (layer[i] < 0.f)
-                        layer[i] = 0.f;
+                if (layer[i] < 0.f)
+                    layer[i] = 0.f;
         }
     }
 
@@ -102,35 +94,31 @@ uint8_t activation_forward(activation_s *activation, float *layer, uint32_t laye
 
         if (activation->elu_alpha != 0.f) {
             for (uint32_t i = 0; i < layer_length; ++i)
-                if (!bit_array || !bit_array_get_bit(bit_array, i))
-                    if (layer[i] < 0.f)
-                        layer[i] = activation->elu_alpha * (expf(layer[i]) - 1.f);
+                if (layer[i] < 0.f)
+                    layer[i] = activation->elu_alpha * (expf(layer[i]) - 1.f);
         } else {
             for (uint32_t i = 0; i < layer_length; ++i)
-                if (!bit_array || !bit_array_get_bit(bit_array, i))
-                    if (layer[i] < 0.f)
-                        layer[i] = 0.f;
+                if (layer[i] < 0.f)
+                    layer[i] = 0.f;
         }
     }
 
     // Softsign
     // f(x) = x / (|x| + 1)
     else if (activation->type == ACTIVATION_SOFTSIGN) {
-        for (uint32_t i = 0; i < layer_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i)) {
-                // Save |x| + 1 for differentiation
-                activation->_derivatives_temp[i] = fabsf(layer[i]) + 1.f;
+        for (uint32_t i = 0; i < layer_length; ++i) {
+            // Save |x| + 1 for differentiation
+            activation->_derivatives_temp[i] = fabsf(layer[i]) + 1.f;
 
-                layer[i] /= activation->_derivatives_temp[i] + EPSILON;
-            }
+            layer[i] /= activation->_derivatives_temp[i] + EPSILON;
+        }
     }
 
     // Sigmoid
     // f(x) = 1 / (1 + e^(-x))
     else if (activation->type == ACTIVATION_SIGMOID) {
         for (uint32_t i = 0; i < layer_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i))
-                layer[i] = 1.f / (1.f + expf(-layer[i]));
+            layer[i] = 1.f / (1.f + expf(-layer[i]));
     }
 
     // Hard sigmoid
@@ -139,27 +127,25 @@ uint8_t activation_forward(activation_s *activation, float *layer, uint32_t laye
         // Save x for differentiation
         memcpy(activation->_derivatives_temp, layer, layer_length * sizeof(float));
 
-        for (uint32_t i = 0; i < layer_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i)) {
-                if (layer[i] < -2.5f)
-                    layer[i] = 0.f;
-                else if (layer[i] > 2.5f)
-                    layer[i] = 1.f;
-                else
-                    layer[i] = 0.2f * layer[i] + 0.5f;
-            }
+        for (uint32_t i = 0; i < layer_length; ++i) {
+            if (layer[i] < -2.5f)
+                layer[i] = 0.f;
+            else if (layer[i] > 2.5f)
+                layer[i] = 1.f;
+            else
+                layer[i] = 0.2f * layer[i] + 0.5f;
+        }
     }
 
     // Swish, E-Swish
     // f(x) = Bx * sigmoid(x)
     else if (activation->type == ACTIVATION_SWISH) {
-        for (uint32_t i = 0; i < layer_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i)) {
-                // Save 1 + exp(-x) for differentiation
-                activation->_derivatives_temp[i] = 1.f + expf(-layer[i]);
+        for (uint32_t i = 0; i < layer_length; ++i) {
+            // Save 1 + exp(-x) for differentiation
+            activation->_derivatives_temp[i] = 1.f + expf(-layer[i]);
 
-                layer[i] *= activation->swish_beta / (activation->_derivatives_temp[i] + +EPSILON);
-            }
+            layer[i] *= activation->swish_beta / (activation->_derivatives_temp[i] + +EPSILON);
+        }
     }
 
     // Softmax
@@ -173,24 +159,21 @@ uint8_t activation_forward(activation_s *activation, float *layer, uint32_t laye
 
         // Calculate sum of exponents
         float exp_sum = 0.f;
-        for (uint32_t i = 0; i < layer_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i)) {
-                layer[i] = expf(layer[i] - layer_max);
-                exp_sum += layer[i];
-            }
+        for (uint32_t i = 0; i < layer_length; ++i) {
+            layer[i] = expf(layer[i] - layer_max);
+            exp_sum += layer[i];
+        }
 
         // Divide each exponent by sum
         for (uint32_t i = 0; i < layer_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i))
-                layer[i] /= exp_sum;
+            layer[i] /= exp_sum;
     }
 
     // tanh
     // f(x) = tanh(x)
     else if (activation->type == ACTIVATION_TANH) {
         for (uint32_t i = 0; i < layer_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i))
-                layer[i] = tanhf(layer[i]);
+            layer[i] = tanhf(layer[i]);
     }
 
     // Wrong type
@@ -221,11 +204,9 @@ uint8_t activation_forward(activation_s *activation, float *layer, uint32_t laye
  * @param layer_activated pointer to 1D array of activated data:
  * NOTE: (for softmax allocated size must be layer_activated_length * layer_activated_length)
  * @param layer_activated_length size of 1D array of activated data
- * @param bit_array pointer to bit array for dropout (indices with set bits (1) will be ignored) or NULL
  * @return uint8_t ERROR_NONE or error code in case of error
  */
-uint8_t activation_backward(activation_s *activation, float *layer_activated, uint32_t layer_activated_length,
-                            bit_array_s *bit_array) {
+uint8_t activation_backward(activation_s *activation, float *layer_activated, uint32_t layer_activated_length) {
     // Check temp array
     if (!activation->_derivatives_temp) {
         logger(LOG_E, "activation_backward", "activation->_derivatives_temp is NULL");
@@ -236,50 +217,44 @@ uint8_t activation_backward(activation_s *activation, float *layer_activated, ui
     // f'(x) = a
     if (activation->type == ACTIVATION_LINEAR) {
         for (uint32_t i = 0; i < layer_activated_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i))
-                layer_activated[i] = activation->linear_alpha;
+            layer_activated[i] = activation->linear_alpha;
     }
 
     // Leaky ReLU derivative
     // f'(x) = [a {x < 0}, 1 {x >= 0}]
     else if (activation->type == ACTIVATION_RELU) {
-        for (uint32_t i = 0; i < layer_activated_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i)) {
-                if (activation->_derivatives_temp[i] < 0.f)
-                    layer_activated[i] = activation->relu_leak;
-                else
-                    layer_activated[i] = 1.f;
-            }
+        for (uint32_t i = 0; i < layer_activated_length; ++i) {
+            if (activation->_derivatives_temp[i] < 0.f)
+                layer_activated[i] = activation->relu_leak;
+            else
+                layer_activated[i] = 1.f;
+        }
     }
 
     // Exponential Linear Unit derivative
     // f'(x) = [f(x) + a {x < 0}, 1 {x >= 0}]
     else if (activation->type == ACTIVATION_ELU) {
-        for (uint32_t i = 0; i < layer_activated_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i)) {
-                if (activation->_derivatives_temp[i] < 0.f)
-                    layer_activated[i] += activation->elu_alpha;
-                else
-                    layer_activated[i] = 1.f;
-            }
+        for (uint32_t i = 0; i < layer_activated_length; ++i) {
+            if (activation->_derivatives_temp[i] < 0.f)
+                layer_activated[i] += activation->elu_alpha;
+            else
+                layer_activated[i] = 1.f;
+        }
     }
 
     // Softsign derivative
     // f'(x) = 1 / (|x| + 1)^2
     else if (activation->type == ACTIVATION_SOFTSIGN) {
-        for (uint32_t i = 0; i < layer_activated_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i)) {
-                layer_activated[i] =
-                    1.f / (activation->_derivatives_temp[i] * activation->_derivatives_temp[i] + EPSILON);
-            }
+        for (uint32_t i = 0; i < layer_activated_length; ++i) {
+            layer_activated[i] = 1.f / (activation->_derivatives_temp[i] * activation->_derivatives_temp[i] + EPSILON);
+        }
     }
 
     // Sigmoid derivative
     // f'(x) = f(x) * (1 - f(x))
     else if (activation->type == ACTIVATION_SIGMOID) {
         for (uint32_t i = 0; i < layer_activated_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i))
-                layer_activated[i] *= (1.f - layer_activated[i]);
+            layer_activated[i] *= (1.f - layer_activated[i]);
 
         // TODO
         // layer_activated[i] = (1.f / (1.f + expf(-layer_activated[i]))) * (1.f - (1.f / (1.f +
@@ -289,24 +264,22 @@ uint8_t activation_backward(activation_s *activation, float *layer_activated, ui
     // Hard sigmoid derivative
     // f(x) = [0 {x < -2.5}, 0 {x > 2.5}, 0.2 {-2.5 <= x <= 2.5}]
     else if (activation->type == ACTIVATION_HARD_SIGMOID) {
-        for (uint32_t i = 0; i < layer_activated_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i)) {
-                if (activation->_derivatives_temp[i] < -2.5f)
-                    layer_activated[i] = 0.f;
-                else if (activation->_derivatives_temp[i] > 2.5f)
-                    layer_activated[i] = 0.f;
-                else
-                    layer_activated[i] = 0.2f;
-            }
+        for (uint32_t i = 0; i < layer_activated_length; ++i) {
+            if (activation->_derivatives_temp[i] < -2.5f)
+                layer_activated[i] = 0.f;
+            else if (activation->_derivatives_temp[i] > 2.5f)
+                layer_activated[i] = 0.f;
+            else
+                layer_activated[i] = 0.2f;
+        }
     }
 
     // Swish derivative
     // f'(x) = f(x) + sigmoid(x) * (B - f(x))
     else if (activation->type == ACTIVATION_SWISH) {
         for (uint32_t i = 0; i < layer_activated_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i))
-                layer_activated[i] = layer_activated[i] + (1.f / (activation->_derivatives_temp[i] + EPSILON)) *
-                                                              (activation->swish_beta - layer_activated[i]);
+            layer_activated[i] = layer_activated[i] + (1.f / (activation->_derivatives_temp[i] + EPSILON)) *
+                                                          (activation->swish_beta - layer_activated[i]);
     }
 
     // Softmax derivative (2D output as jacobian matrix)
@@ -327,8 +300,7 @@ uint8_t activation_backward(activation_s *activation, float *layer_activated, ui
     // f'(x) = 1 - f(x)^2
     else if (activation->type == ACTIVATION_TANH) {
         for (uint32_t i = 0; i < layer_activated_length; ++i)
-            if (!bit_array || !bit_array_get_bit(bit_array, i))
-                layer_activated[i] = 1. - layer_activated[i] * layer_activated[i];
+            layer_activated[i] = 1. - layer_activated[i] * layer_activated[i];
     }
 
     // Wrong type
@@ -0,0 +1,330 @@
+/**
+ * @file attention.c
+ * @author Fern Lane
+ * @brief Multi-head self-attention forward propagation and backpropagation in tiles with online softmax
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "attention.h"
+#include "gemm.h"
+#include "petal.h"
+
+/**
+ * @brief Number of heads of attention petal
+ *
+ * @param petal pointer to PETAL_TYPE_ATTENTION petal
+ * @return uint32_t params.heads or 1 if it's 0
+ */
+uint32_t attention_heads(petal_s *petal) { return petal->params.heads > 0U ? petal->params.heads : 1U; }
+
+/**
+ * @brief Converts rows x (blocks * block_size) matrix into blocks of rows x block_size matrices (each head's queries,
+ * keys and values are contiguous, so they can be passed into gemm()) or back
+ *
+ * @param rows pointer to rows x (blocks * block_size) matrix
+ * @param blocks pointer to blocks x rows x block_size array
+ * @param rows_length number of rows
+ * @param blocks_length number of blocks
+ * @param block_size number of columns of each block
+ * @param to_blocks true to convert rows into blocks or false to convert blocks into rows
+ */
+static void attention_repack(float *rows, float *blocks, uint32_t rows_length, uint32_t blocks_length,
+                             uint32_t block_size, bool to_blocks) {
+    for (uint32_t row = 0; row < rows_length; ++row)
+        for (uint32_t block = 0; block < blocks_length; ++block) {
+            float *row_block = rows + ((size_t) row * blocks_length + block) * block_size;
+            float *block_row = blocks + ((size_t) block * rows_length + row) * block_size;
+            if (to_blocks)
+                memcpy(block_row, row_block, block_size * sizeof(float));
+            else
+                memcpy(row_block, block_row, block_size * sizeof(float));
+        }
+}
+
+/**
+ * @brief Calculates attention of one tile of queries of one head: softmax(queries * keys^T * scale) * values
+ * Scores are calculated for ATTENTION_TILE_KEYS keys at once and softmax is calculated online: running max. and sum
+ * of exponents of each query are updated with each tile and previously accumulated output is rescaled
+ *
+ * @param queries pointer to queries_length x head_size queries
+ * @param keys pointer to keys_length x head_size keys
+ * @param values pointer to keys_length x head_size values
+ * @param queries_length number of queries (up to ATTENTION_TILE_QUERIES)
+ * @param keys_length number of keys and values
+ * @param head_size number of features of each query, key and value
+ * @param scale factor of scores (1 / sqrt(head_size))
+ * @param scores pointer to temp array of ATTENTION_TILE_QUERIES x ATTENTION_TILE_KEYS scores
+ * @param output pointer to queries_length x head_size output
+ * @param lse pointer to array to store log of sum of exponents of scores of each query into (for backpropagation)
+ */
+static void attention_queries_forward(const float *queries, const float *keys, const float *values,
+                                      uint32_t queries_length, uint32_t keys_length, uint32_t head_size, float scale,
+                                      float *scores, float *output, float *lse) {
+    float max[ATTENTION_TILE_QUERIES], sum[ATTENTION_TILE_QUERIES];
+    for (uint32_t query = 0; query < queries_length; ++query) {
+        max[query] = -INFINITY;
+        sum[query] = 0.f;
+    }
+    memset(output, 0, (size_t) queries_length * head_size * sizeof(float));
+
+    for (uint32_t key_from = 0; key_from < keys_length; key_from += ATTENTION_TILE_KEYS) {
+        uint32_t tile_keys =
+            keys_length - key_from < ATTENTION_TILE_KEYS ? keys_length - key_from : ATTENTION_TILE_KEYS;
+
+        // Scores of tile (queries_length x tile_keys)
+        gemm(false, true, queries_length, tile_keys, head_size, scale, queries, keys + (size_t) key_from * head_size,
+             0.f, scores);
+
+        // Exponents relative to new max. and rescaling of previous ones
+        for (uint32_t query = 0; query < queries_length; ++query) {
+            float *scores_row = scores + query * tile_keys;
+            float max_new = max[query];
+            for (uint32_t key = 0; key < tile_keys; ++key)
+                max_new = fmaxf(max_new, scores_row[key]);
+            float correction = expf(max[query] - max_new);
+            float sum_tile = 0.f;
+            for (uint32_t key = 0; key < tile_keys; ++key) {
+                scores_row[key] = expf(scores_row[key] - max_new);
+                sum_tile += scores_row[key];
+            }
+            sum[query] = sum[query] * correction + sum_tile;
+            max[query] = max_new;
+            if (correction != 1.f)
+                for (uint32_t i = 0; i < head_size; ++i)
+                    output[query * head_size + i] *= correction;
+        }
+
+        // Output += exponents * values of tile
+        gemm(false, false, queries_length, head_size, tile_keys, 1.f, scores, values + (size_t) key_from * head_size,
+             1.f, output);
+    }
+
+    // Normalize
+    for (uint32_t query = 0; query < queries_length; ++query) {
+        float sum_inv = 1.f / sum[query];
+        for (uint32_t i = 0; i < head_size; ++i)
+            output[query * head_size + i] *= sum_inv;
+        lse[query] = max[query] + logf(sum[query]);
+    }
+}
+
+/**
+ * @brief Backpropagates one tile of queries of one head. Probabilities are recalculated from scores and log of sum of
+ * exponents of each query (so they are never stored for all queries and keys)
+ *
+ * @param queries pointer to queries_length x head_size queries
+ * @param keys pointer to keys_length x head_size keys
+ * @param values pointer to keys_length x head_size values
+ * @param output_errors pointer to queries_length x head_size errors of output
+ * @param lse pointer to log of sum of exponents of each query (from forward propagation)
+ * @param dots pointer to sum of output errors * output of each query
+ * @param queries_length number of queries (up to ATTENTION_TILE_QUERIES)
+ * @param keys_length number of keys and values
+ * @param head_size number of features of each query, key and value
+ * @param scale factor of scores (1 / sqrt(head_size))
+ * @param tile pointer to temp array of 2 x ATTENTION_TILE_QUERIES x ATTENTION_TILE_KEYS
+ * @param queries_errors pointer to queries_length x head_size errors of queries to add into
+ * @param keys_errors pointer to keys_length x head_size errors of keys to add into
+ * @param values_errors pointer to keys_length x head_size errors of values to add into
+ */
+static void attention_queries_backward(const float *queries, const float *keys, const float *values,
+                                       const float *output_errors, const float *lse, const float *dots,
+                                       uint32_t queries_length, uint32_t keys_length, uint32_t head_size, float scale,
+                                       float *tile, float *queries_errors, float *keys_errors, float *values_errors) {
+    float *probabilities = tile;
+    float *scores_errors = tile + ATTENTION_TILE_QUERIES * ATTENTION_TILE_KEYS;
+    for (uint32_t key_from = 0; key_from < keys_length; key_from += ATTENTION_TILE_KEYS) {
+        uint32_t tile_keys =
+            keys_length - key_from < ATTENTION_TILE_KEYS ? keys_length - key_from : ATTENTION_TILE_KEYS;
+        const float *tile_keys_data = keys + (size_t) key_from * head_size;
+        const float *tile_values = values + (size_t) key_from * head_size;
+
+        // Probabilities of tile
+        gemm(false, true, queries_length, tile_keys, head_size, scale, queries, tile_keys_data, 0.f, probabilities);
+        for (uint32_t query = 0; query < queries_length; ++query)
+            for (uint32_t key = 0; key < tile_keys; ++key)
+                probabilities[query * tile_keys + key] = expf(probabilities[query * tile_keys + key] - lse[query]);
+
+        // Errors of values += probabilities^T * output errors
+        gemm(true, false, tile_keys, head_size, queries_length, 1.f, probabilities, output_errors, 1.f,
+             values_errors + (size_t) key_from * head_size);
+
+        // Errors of scores = probabilities * (output errors * values^T - dots)
+        gemm(false, true, queries_length, tile_keys, head_size, 1.f, output_errors, tile_values, 0.f, scores_errors);
+        for (uint32_t query = 0; query < queries_length; ++query)
+            for (uint32_t key = 0; key < tile_keys; ++key) {
+                uint32_t i = query * tile_keys + key;
+                scores_errors[i] = probabilities[i] * (scores_errors[i] - dots[query]);
+            }
+
+        // Errors of queries += scores errors * keys * scale and errors of keys += scores errors^T * queries * scale
+        gemm(false, false, queries_length, head_size, tile_keys, scale, scores_errors, tile_keys_data, 1.f,
+             queries_errors);
+        gemm(true, false, tile_keys, head_size, queries_length, scale, scores_errors, queries, 1.f,
+             keys_errors + (size_t) key_from * head_size);
+    }
+}
+
+/**
+ * @brief Multi-head self-attention forward propagation over rows of input (sequence)
+ * Weights are row_length x (3 * row_length) queries, keys and values projections (heads are consecutive head_size
+ * columns of each) followed by row_length x row_length output projection, bias weights are 3 * row_length bias of
+ * projections followed by row_length bias of output. Projections are calculated with a single gemm() call, then
+ * attention of each head is calculated in tiles of queries and keys with online softmax, so memory is linear in
+ * sequence length (full sequence x sequence scores are never stored)
+ *
+ * @param petal pointer to PETAL_TYPE_ATTENTION petal
+ * @param input pointer to sequence x row_length input
+ */
+void attention_forward(petal_s *petal, const float *input) {
+    uint32_t sequence = petal->input_shape->rows;
+    uint32_t row_length = petal->input_shape->cols * petal->input_shape->depth;
+    uint32_t heads = attention_heads(petal);
+    uint32_t head_size = row_length / heads;
+    size_t head_length = (size_t) sequence * head_size;
+    const float *weights_output = petal->weights->weights + (size_t) row_length * 3U * row_length;
+    const float *bias = petal->bias_weights ? petal->bias_weights->weights : NULL;
+    float scale = 1.f / sqrtf((float) head_size);
+
+    // Queries, keys and values (sequence x 3 * row_length) = input * weights + bias, then split into heads
+    gemm(false, false, sequence, 3U * row_length, row_length, 1.f, input, petal->weights->weights, 0.f,
+         petal->_attention_temp);
+    if (bias)
+        for (uint32_t position = 0; position < sequence; ++position)
+            for (uint32_t i = 0; i < 3U * row_length; ++i)
+                petal->_attention_temp[(size_t) position * 3U * row_length + i] += bias[i];
+    attention_repack(petal->_attention_temp, petal->_attention_qkv, sequence, 3U * heads, head_size, true);
+
+    // Attention of each head in tiles of queries
+    for (uint32_t head = 0; head < heads; ++head) {
+        const float *queries = petal->_attention_qkv + head * head_length;
+        const float *keys = petal->_attention_qkv + (heads + head) * head_length;
+        const float *values = petal->_attention_qkv + (2U * heads + head) * head_length;
+        for (uint32_t query_from = 0; query_from < sequence; query_from += ATTENTION_TILE_QUERIES) {
+            uint32_t tile_queries =
+                sequence - query_from < ATTENTION_TILE_QUERIES ? sequence - query_from : ATTENTION_TILE_QUERIES;
+            attention_queries_forward(queries + (size_t) query_from * head_size, keys, values, tile_queries, sequence,
+                                      head_size, scale, petal->_attention_tile,
+                                      petal->_attention_heads + head * head_length + (size_t) query_from * head_size,
+                                      petal->_attention_stats + (size_t) head * sequence + query_from);
+        }
+    }
+
+    // Output (sequence x row_length) = sum of each head's output * it's rows of output weights + bias
+    for (uint32_t head = 0; head < heads; ++head)
+        gemm(false, false, sequence, row_length, head_size, 1.f, petal->_attention_heads + head * head_length,
+             weights_output + (size_t) head * head_size * row_length, head > 0U ? 1.f : 0.f, petal->output);
+    if (bias)
+        for (uint32_t position = 0; position < sequence; ++position)
+            for (uint32_t i = 0; i < row_length; ++i)
+                petal->output[(size_t) position * row_length + i] += bias[3U * row_length + i];
+}
+
+/**
+ * @brief Multi-head self-attention backpropagation
+ * Gradients of output projection and errors of heads are calculated with gemm(), then errors of queries, keys and
+ * values are calculated in the same tiles as in forward propagation, then gradients of projections and errors on
+ * input are calculated with a single gemm() call each
+ *
+ * @param petal pointer to PETAL_TYPE_ATTENTION petal (petal->output must contain errors on output before activation,
+ * see petal_backward())
+ * @param input pointer to the same input as in the last attention_forward() call
+ */
+void attention_backward(petal_s *petal, const float *input) {
+    uint32_t sequence = petal->input_shape->rows;
+    uint32_t row_length = petal->input_shape->cols * petal->input_shape->depth;
+    uint32_t heads = attention_heads(petal);
+    uint32_t head_size = row_length / heads;
+    size_t head_length = (size_t) sequence * head_size;
+    size_t weights_qkv_length = (size_t) row_length * 3U * row_length;
+    const float *weights_output = petal->weights->weights + weights_qkv_length;
+    const float *output_errors = petal->output;
+    bool bias_trainable = petal->bias_weights && petal->bias_weights->trainable;
+    float scale = 1.f / sqrtf((float) head_size);
+
+    // Gradients of output projection (rows of each head) += output of head^T * output errors
+    if (petal->weights->trainable)
+        for (uint32_t head = 0; head < heads; ++head)
+            gemm(true, false, head_size, row_length, sequence, 1.f, petal->_attention_heads + head * head_length,
+                 output_errors, 1.f,
+                 petal->weights->gradients + weights_qkv_length + (size_t) head * head_size * row_length);
+    if (bias_trainable)
+        for (uint32_t position = 0; position < sequence; ++position)
+            for (uint32_t i = 0; i < row_length; ++i)
+                petal->bias_weights->gradients[3U * row_length + i] +=
+                    output_errors[(size_t) position * row_length + i];
+
+    // Errors of output of each head (stored in temp array) = output errors * rows of output weights^T
+    float *heads_errors = petal->_attention_temp;
+    for (uint32_t head = 0; head < heads; ++head)
+        gemm(false, true, sequence, head_size, row_length, 1.f, output_errors,
+             weights_output + (size_t) head * head_size * row_length, 0.f, heads_errors + head * head_length);
+
+    // Errors of queries, keys and values of each head
+    memset(petal->_attention_grad, 0, 3U * (size_t) heads * head_length * sizeof(float));
+    float *dots = petal->_attention_stats + (size_t) heads * sequence;
+    for (uint32_t head = 0; head < heads; ++head) {
+        const float *head_output = petal->_attention_heads + head * head_length;
+        const float *head_errors = heads_errors + head * head_length;
+        for (uint32_t position = 0; position < sequence; ++position) {
+            float dot = 0.f;
+            for (uint32_t i = 0; i < head_size; ++i)
+                dot += head_output[position * head_size + i] * head_errors[position * head_size + i];
+            dots[position] = dot;
+        }
+
+        const float *queries = petal->_attention_qkv + head * head_length;
+        const float *keys = petal->_attention_qkv + (heads + head) * head_length;
+        const float *values = petal->_attention_qkv + (2U * heads + head) * head_length;
+        float *queries_errors = petal->_attention_grad + head * head_length;
+        for (uint32_t query_from = 0; query_from < sequence; query_from += ATTENTION_TILE_QUERIES) {
+            uint32_t tile_queries =
+                sequence - query_from < ATTENTION_TILE_QUERIES ? sequence - query_from : ATTENTION_TILE_QUERIES;
+            size_t offset = (size_t) query_from * head_size;
+            attention_queries_backward(queries + offset, keys, values, head_errors + offset,
+                                       petal->_attention_stats + (size_t) head * sequence + query_from,
+                                       dots + query_from, tile_queries, sequence, head_size, scale,
+                                       petal->_attention_tile, queries_errors + offset,
+                                       petal->_attention_grad + (heads + head) * head_length,
+                                       petal->_attention_grad + (2U * heads + head) * head_length);
+        }
+    }
+
+    // Errors of projections (sequence x 3 * row_length)
+    float *projections_errors = petal->_attention_temp;
+    attention_repack(projections_errors, petal->_attention_grad, sequence, 3U * heads, head_size, false);
+
+    // Gradients of projections (row_length x 3 * row_length) += input^T * projections errors
+    if (petal->weights->trainable)
+        gemm(true, false, row_length, 3U * row_length, sequence, 1.f, input, projections_errors, 1.f,
+             petal->weights->gradients);
+    if (bias_trainable)
+        for (uint32_t position = 0; position < sequence; ++position)
+            for (uint32_t i = 0; i < 3U * row_length; ++i)
+                petal->bias_weights->gradients[i] += projections_errors[(size_t) position * 3U * row_length + i];
+
+    // Errors on input (sequence x row_length) = projections errors * weights of projections^T
+    if (!petal->first)
+        gemm(false, true, sequence, row_length, 3U * row_length, 1.f, projections_errors, petal->weights->weights, 0.f,
+             petal->error_on_input);
+}
@@ -25,10 +25,156 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "attention.h"
+#include "conv.h"
 #include "dropout.h"
+#include "embedding.h"
 #include "errors.h"
+#include "gemm.h"
 #include "logger.h"
+#include "norm.h"
 #include "petal.h"
+#include "pool.h"
+#include "profile.h"
+#include "rnn.h"
+#include "sparse.h"
+
+/**
+ * @brief Backpropagates errors of 1D dense petal and accumulates it's gradients using gemv() and gemm()
+ * Errors of dropped outputs are zeros, so their rows are skipped by both of them
+ *
+ * @param petal pointer to petal struct (petal->output must contain derivatives multiplied by error)
+ * @param output_left pointer to output of previous (left) petal or input data in case of first petal
+ */
+static void dense_1d_backward(petal_s *petal, float *output_left) {
+    uint32_t outputs = petal->output_shape->length;
+    uint32_t inputs = petal->input_shape->length;
+
+    // Backpropagate error for next left petal: weights^T (inputs x outputs) * errors
+    if (!petal->first) {
+        if (petal->weights && petal->weights->weights)
+            gemv(true, outputs, inputs, 1.f, petal->weights->weights, petal->output, 0.f, petal->error_on_input);
+        else {
+            float error_sum = 0.f;
+            for (uint32_t grad_right_i = 0; grad_right_i < outputs; ++grad_right_i)
+                error_sum += petal->output[grad_right_i];
+            for (uint32_t grad_left_i = 0; grad_left_i < inputs; ++grad_left_i)
+                petal->error_on_input[grad_left_i] = error_sum;
+        }
+    }
+
+    // Gradient of each weight is error * previous petal's forward output (outer product of errors and output_left)
+    // Calculate as sum because of batch processing (each column has gradients if petal also takes sparse input)
+    if (petal->weights && petal->weights->trainable) {
+        gemm(false, false, outputs, inputs, 1U, 1.f, petal->output, output_left, 1.f, petal->weights->gradients);
+        weights_sparse_mark_cols(petal->weights);
+    }
+
+    // Calculate gradients for bias weights
+    // Calculate as sum because of batch processing
+    if (petal->bias_weights && petal->bias_weights->trainable)
+        for (uint32_t grad_right_i = 0; grad_right_i < outputs; ++grad_right_i)
+            petal->bias_weights->gradients[grad_right_i] += petal->output[grad_right_i];
+}
+
+/**
+ * @brief Accumulates gradients of one output of 1D dense petal with sparse input (only weights of non-zero inputs
+ * have non-zero gradients)
+ *
+ * @param petal pointer to petal struct (petal->output must contain derivatives multiplied by error)
+ * @param input pointer to sparse_s struct with indices and values of non-zero inputs
+ * @param grad_right_i index of output
+ */
+static inline void dense_1d_backward_row_sparse(petal_s *petal, const sparse_s *input, uint32_t grad_right_i) {
+    float error = petal->output[grad_right_i];
+
+    // Scatter-add gradients into weights of non-zero inputs
+    if (petal->weights && petal->weights->trainable) {
+        float *gradients_row = petal->weights->gradients + (size_t) grad_right_i * petal->input_shape->length;
+        for (uint32_t nonzero_i = 0; nonzero_i < input->length; ++nonzero_i)
+            gradients_row[input->indices[nonzero_i]] += error * input->values[nonzero_i];
+    }
+
+    // Calculate gradients for bias weights
+    if (petal->bias_weights && petal->bias_weights->trainable)
+        petal->bias_weights->gradients[grad_right_i] += error;
+}
+
+/**
+ * @brief Replaces petal's output with error on output before activation (activation derivatives multiplied by
+ * error_right and dropout keep-mask)
+ *
+ * @param petal pointer to petal struct (petal->output must contain activated output of the last forward pass)
+ * @param error_right pointer to "error_on_input" array from next (right) petal or array of loss function derivatives
+ * @return true if no errors
+ * @return false in case of activation error (petal->error_code is set)
+ */
+static bool petal_backward_activation(petal_s *petal, float *error_right) {
+    // TODO
+    // printf("Activated output:\n");
+    // print_array(petal->output, 1U, petal->output_shape->length, 1U);
+
+    // Undo dropout scaling of kept outputs (dropped outputs are multiplied by keep-mask below)
+    bool dropout_enabled = petal->params.dropout > 0.f && petal->_dropout_mask && petal->bit_array;
+    if (dropout_enabled) {
+        float dropout_unscaling = 1.f - petal->params.dropout;
+        for (uint32_t i = 0; i < petal->output_shape->length; ++i)
+            petal->output[i] *= dropout_unscaling;
+    }
+
+    // Calculate activation derivatives (1 without activation)
+    PROFILE_START(time_activation);
+    uint8_t activation_error = ERROR_NONE;
+    if (petal->activation)
+        activation_error = activation_backward(petal->activation, petal->output, petal->output_shape->length);
+    else
+        for (uint32_t i = 0; i < petal->output_shape->length; ++i)
+            petal->output[i] = 1.f;
+    PROFILE_STOP(petal->_profile, time_activation, time_activation);
+
+    // printf("Activation derivatives:\n");
+    // print_array(petal->output, 1U, petal->output_shape->length, 1U);
+
+    if (activation_error != ERROR_NONE) {
+        logger(LOG_E, "petal_backward", "Error calculating activation derivatives: %s",
+               error_to_str[activation_error]);
+        petal->error_code = activation_error;
+        return false;
+    }
+
+    // Multiply derivatives (rows of softmax jacobian) by keep-mask
+    if (dropout_enabled) {
+        if (petal->activation && petal->activation->type == ACTIVATION_SOFTMAX) {
+            for (uint32_t row = 0; row < petal->output_shape->length; ++row)
+                for (uint32_t col = 0; col < petal->output_shape->length; ++col)
+                    petal->output[row * petal->output_shape->length + col] *= petal->_dropout_mask[row];
+        } else
+            dropout_apply_mask(petal->output, petal->_dropout_mask, petal->output_shape->length);
+    }
+
+    // Dot error_right with activation derivatives
+    uint32_t row_index;
+    for (uint32_t jacobian_col = 0; jacobian_col < petal->output_shape->length; ++jacobian_col) {
+        // Dot if softmax
+        if (petal->activation && petal->activation->type == ACTIVATION_SOFTMAX) {
+            for (uint32_t jacobian_row = 0; jacobian_row < petal->output_shape->length; ++jacobian_row) {
+                row_index = jacobian_row * petal->output_shape->length;
+                if (jacobian_row == 0)
+                    petal->output[jacobian_col] =
+                        petal->output[row_index + jacobian_col] * error_right[jacobian_row];
+                else
+                    petal->output[jacobian_col] +=
+                        petal->output[row_index + jacobian_col] * error_right[jacobian_row];
+            }
+        }
+
+        // Otherwise just multiplication
+        else
+            petal->output[jacobian_col] *= error_right[jacobian_col];
+    }
+
+    return true;
+}
 
 /**
  * @brief
@@ -45,83 +191,114 @@ void petal_backward(petal_s *petal, float *error_right, float *output_left) {
     if (petal->petal_type == PETAL_TYPE_DIRECT || petal->petal_type == PETAL_TYPE_NORMALIZE_ALL ||
         petal->petal_type == PETAL_TYPE_NORMALIZE_IN_ROWS || petal->petal_type == PETAL_TYPE_NORMALIZE_IN_CHANNELS) {
         // Just copy temp error (input and output sizes must match)
-        if (!petal->first)
+        if (!petal->first) {
             for (uint32_t i = 0; i < petal->output_shape->length; ++i)
                 petal->error_on_input[i] = error_right[i];
+
+            // Dropped outputs don't depend on inputs
+            if (petal->params.dropout > 0.f && petal->_dropout_mask)
+                dropout_apply_mask(petal->error_on_input, petal->_dropout_mask, petal->output_shape->length);
+        }
     }
 
     // 1D dense petal (fully-connected 1D petal with 2D weights and 1D bias weights)
     // We need to calculate activation derivative, next error and gradients
     else if (petal->petal_type == PETAL_TYPE_DENSE_1D) {
 
-        // TODO
-        // printf("Activated output:\n");
-        // print_array(petal->output, 1U, petal->output_shape->length, 1U);
-
-        // Calculate activation derivatives
-        uint8_t activation_error =
-            activation_backward(petal->activation, petal->output, petal->output_shape->length, petal->bit_array);
+        // Calculate error before activation
+        if (!petal_backward_activation(petal, error_right))
+            return;
 
-        // printf("Activation derivatives:\n");
-        // print_array(petal->output, 1U, petal->output_shape->length, 1U);
+        // Backpropagate errors, calculate gradients (dropped outputs have zero errors and are skipped)
+        dense_1d_backward(petal, output_left);
+    }
 
-        if (activation_error != ERROR_NONE) {
-            logger(LOG_E, "petal_backward", "Error calculating activation derivatives: %s",
-                   error_to_str[activation_error]);
-            petal->error_code = activation_error;
+    // 2D convolution
+    else if (petal->petal_type == PETAL_TYPE_CONV_2D) {
+        if (!petal_backward_activation(petal, error_right))
             return;
-        }
 
-        // Dot error_right with activation derivatives
-        uint32_t row_index;
-        for (uint32_t jacobian_col = 0; jacobian_col < petal->output_shape->length; ++jacobian_col) {
-            // Dot if softmax
-            if (petal->activation && petal->activation->type == ACTIVATION_SOFTMAX) {
-                for (uint32_t jacobian_row = 0; jacobian_row < petal->output_shape->length; ++jacobian_row) {
-                    row_index = jacobian_row * petal->output_shape->length;
-                    if (jacobian_row == 0)
-                        petal->output[jacobian_col] =
-                            petal->output[row_index + jacobian_col] * error_right[jacobian_row];
-                    else
-                        petal->output[jacobian_col] +=
-                            petal->output[row_index + jacobian_col] * error_right[jacobian_row];
-                }
-            }
+        uint32_t positions = petal->output_shape->rows * petal->output_shape->cols;
+        uint32_t filters = petal->output_shape->depth;
+        uint32_t kernel_length = petal_conv_2d_kernel_length(petal);
+
+        // Direct backpropagation for direct and Winograd algorithms (doesn't need im2col matrix)
+        if (petal->_conv_algorithm != CONV_ALGORITHM_IM2COL)
+            conv_direct_backward(petal, output_left);
 
-            // Otherwise just multiplication
-            else
-                petal->output[jacobian_col] *= error_right[jacobian_col];
+        // Weights gradients (filters x kernel length) += errors^T (filters x positions) * im2col of input
+        else if (petal->weights->trainable) {
+            conv_im2col(petal, output_left, petal->_columns);
+            gemm(true, false, filters, kernel_length, positions, 1.f, petal->output, petal->_columns, 1.f,
+                 petal->weights->gradients);
         }
 
-        // Reset temp errors in petal's input
-        if (!petal->first)
-            for (uint32_t grad_left_i = 0; grad_left_i < petal->input_shape->length; ++grad_left_i)
-                petal->error_on_input[grad_left_i] = 0.f;
-
-        // Backpropagate errors, calculate and apply gradients
-        uint32_t grad_right_index;
-        for (uint32_t grad_right_i = 0; grad_right_i < petal->output_shape->length; ++grad_right_i) {
-            grad_right_index = grad_right_i * petal->input_shape->length;
-            for (uint32_t grad_left_i = 0; grad_left_i < petal->input_shape->length; ++grad_left_i) {
-                // Backpropagate error for next left petal
-                if (!petal->first)
-                    petal->error_on_input[grad_left_i] +=
-                        petal->weights->weights[grad_right_index + grad_left_i] * petal->output[grad_right_i];
-
-                // Calculate gradient for each weight as backward activation * previous petal's forward output
-                // Calculate as sum because of batch processing
-                if (petal->weights && petal->weights->trainable)
-                    petal->weights->gradients[grad_right_index + grad_left_i] +=
-                        petal->output[grad_right_i] * output_left[grad_left_i];
-            }
+        // Bias weights gradients
+        if (petal->bias_weights && petal->bias_weights->trainable)
+            for (uint32_t position = 0; position < positions; ++position)
+                for (uint32_t filter = 0; filter < filters; ++filter)
+                    petal->bias_weights->gradients[filter] += petal->output[position * filters + filter];
 
-            // Calculate gradients for bias weights
-            // Calculate as sum because of batch processing
-            if (petal->bias_weights && petal->bias_weights->trainable)
-                petal->bias_weights->gradients[grad_right_i] += petal->output[grad_right_i];
+        // Input errors: errors (positions x filters) * weights (filters x kernel length) and col2im
+        if (petal->_conv_algorithm == CONV_ALGORITHM_IM2COL && !petal->first) {
+            gemm(false, false, positions, kernel_length, filters, 1.f, petal->output, petal->weights->weights, 0.f,
+                 petal->_columns);
+            memset(petal->error_on_input, 0, petal->input_shape->length * sizeof(float));
+            conv_col2im(petal, petal->_columns, petal->error_on_input);
         }
     }
 
+    // 2D pooling (no weights, so nothing to do if it's the first petal)
+    else if (petal->petal_type == PETAL_TYPE_MAX_POOL_2D || petal->petal_type == PETAL_TYPE_AVG_POOL_2D) {
+        if (petal->first)
+            return;
+        if (!petal_backward_activation(petal, error_right))
+            return;
+
+        // Scatter errors into recorded argmax in O(output)
+        if (petal->petal_type == PETAL_TYPE_MAX_POOL_2D)
+            pool_max_backward(petal, petal->_pool_indices);
+
+        // Spread errors over each window
+        else
+            pool_avg_backward(petal);
+    }
+
+    // Batch normalization (gradients of scale and shift and input errors)
+    else if (petal->petal_type == PETAL_TYPE_BATCH_NORM) {
+        if (!petal_backward_activation(petal, error_right))
+            return;
+        batch_norm_backward(petal);
+    }
+
+    // Layer normalization (gradients of scale and shift and input errors through statistics of each row)
+    else if (petal->petal_type == PETAL_TYPE_LAYER_NORM) {
+        if (!petal_backward_activation(petal, error_right))
+            return;
+        layer_norm_backward(petal);
+    }
+
+    // Embedding (sparse gradients of looked up rows)
+    else if (petal->petal_type == PETAL_TYPE_EMBEDDING) {
+        if (!petal_backward_activation(petal, error_right))
+            return;
+        embedding_backward(petal, output_left);
+    }
+
+    // LSTM or GRU (backpropagation through time)
+    else if (petal->petal_type == PETAL_TYPE_LSTM || petal->petal_type == PETAL_TYPE_GRU) {
+        if (!petal_backward_activation(petal, error_right))
+            return;
+        rnn_backward(petal, output_left);
+    }
+
+    // Multi-head self-attention (probabilities are recalculated in tiles)
+    else if (petal->petal_type == PETAL_TYPE_ATTENTION) {
+        if (!petal_backward_activation(petal, error_right))
+            return;
+        attention_backward(petal, output_left);
+    }
+
     // Wrong type
     else {
         logger(LOG_E, "petal_backward", "Wrong petal type: %u", petal->petal_type);
@@ -129,3 +306,49 @@ void petal_backward(petal_s *petal, float *error_right, float *output_left) {
         return;
     }
 }
+
+/**
+ * @brief Petal backpropagation with sparse input (only for PETAL_TYPE_DENSE_1D). Calculates only gradients (sparse
+ * input is input data, so "error_on_input" is not calculated) and only for weights of non-zero inputs. Their columns
+ * of weights are marked, so weights_update() updates only them (see weights_sparse_cols_init())
+ *
+ * @param petal pointer to current petal to which calculate weights gradients
+ * @param error_right pointer to "error_on_input" array from next (right) petal or array of loss function derivatives
+ * @param input pointer to the same sparse_s struct that was passed into petal_forward_sparse()
+ */
+void petal_backward_sparse(petal_s *petal, float *error_right, const sparse_s *input) {
+    if (petal->petal_type != PETAL_TYPE_DENSE_1D) {
+        logger(LOG_E, "petal_backward_sparse", "Sparse input is supported only by PETAL_TYPE_DENSE_1D");
+        petal->error_code = ERROR_PETAL_WRONG_TYPE;
+        return;
+    }
+
+    // Enable column sparse updates and mark columns of non-zero inputs
+    if (petal->weights && petal->weights->trainable) {
+        uint8_t error_temp = weights_sparse_cols_init(petal->weights, petal->input_shape->length);
+        if (error_temp != ERROR_NONE) {
+            logger(LOG_E, "petal_backward_sparse", "Error enabling column sparse updates: %s",
+                   error_to_str[error_temp]);
+            petal->error_code = error_temp;
+            return;
+        }
+        for (uint32_t nonzero_i = 0; nonzero_i < input->length; ++nonzero_i)
+            weights_sparse_mark_col(petal->weights, input->indices[nonzero_i]);
+    }
+
+    // Calculate error before activation
+    if (!petal_backward_activation(petal, error_right))
+        return;
+
+    // Calculate gradients only for kept outputs (dropped outputs don't depend on weights)
+    if (petal->params.dropout > 0.f && petal->_dropout_mask && petal->bit_array) {
+        BIT_ARRAY_FOR_EACH_CLEAR(petal->bit_array, grad_right_i) {
+            dense_1d_backward_row_sparse(petal, input, grad_right_i);
+        }
+    }
+
+    // Calculate gradients
+    else
+        for (uint32_t grad_right_i = 0; grad_right_i < petal->output_shape->length; ++grad_right_i)
+            dense_1d_backward_row_sparse(petal, input, grad_right_i);
+}
@@ -41,8 +41,7 @@ bit_array_s *bit_array_init(uint32_t size_bits) {
     bit_array_s *bit_array = (bit_array_s *) calloc(1U, sizeof(bit_array_s));
     if (!bit_array) {
         logger(LOG_E, "bit_array_init", "Error allocating memory for bit_array");
-        bit_array->error_code = ERROR_MALLOC;
-        return bit_array;
+        return NULL;
     }
 
     // Reset error
@@ -79,7 +78,7 @@ void bit_array_set_bit(bit_array_s *bit_array, uint32_t index) {
     }
 
     // Set bit
-    bit_array->data[index / BIT_ARRAY_BITS] |= (BIT_ARRAY_TYPE) 1 << index % (BIT_ARRAY_TYPE) BIT_ARRAY_BITS;
+    bit_array_set_bit_unchecked(bit_array, index);
 }
 
 /**
@@ -98,7 +97,7 @@ void bit_array_clear_bit(bit_array_s *bit_array, uint32_t index) {
     }
 
     // Clear bit
-    bit_array->data[index / BIT_ARRAY_BITS] &= ~((BIT_ARRAY_TYPE) 1 << index % (BIT_ARRAY_TYPE) BIT_ARRAY_BITS);
+    bit_array_clear_bit_unchecked(bit_array, index);
 }
 
 /**
@@ -119,8 +118,7 @@ bool bit_array_get_bit(bit_array_s *bit_array, uint32_t index) {
     }
 
     // Return bit state
-    return ((bit_array->data[index / BIT_ARRAY_BITS] >> index % (BIT_ARRAY_TYPE) BIT_ARRAY_BITS) &
-            (BIT_ARRAY_TYPE) 1) != (BIT_ARRAY_TYPE) 0;
+    return bit_array_get_bit_unchecked(bit_array, index);
 }
 
 /**
@@ -132,6 +130,11 @@ void bit_array_not(bit_array_s *bit_array) {
     for (uint32_t i = 0; i < bit_array->_length_in_types; ++i) {
         bit_array->data[i] = ~bit_array->data[i];
     }
+
+    // Keep padding bits after length cleared for bit_array_count() and bit_array_next_...()
+    if (bit_array->length % BIT_ARRAY_BITS)
+        bit_array->data[bit_array->_length_in_types - 1U] &=
+            ((BIT_ARRAY_TYPE) 1U << (bit_array->length % BIT_ARRAY_BITS)) - 1U;
 }
 
 /**
@@ -139,7 +142,22 @@ void bit_array_not(bit_array_s *bit_array) {
  *
  * @param bit_array pointer to bit_array_s struct
  */
-void bit_array_clear(bit_array_s *bit_array) { memset(bit_array->data, 0, bit_array->length * sizeof(BIT_ARRAY_TYPE)); }
+void bit_array_clear(bit_array_s *bit_array) {
+    memset(bit_array->data, 0, bit_array->_length_in_types * sizeof(BIT_ARRAY_TYPE));
+}
+
+/**
+ * @brief Counts set bits
+ *
+ * @param bit_array pointer to bit_array_s struct
+ * @return uint32_t number of bits set to 1
+ */
+uint32_t bit_array_count(const bit_array_s *bit_array) {
+    uint32_t count = 0U;
+    for (uint32_t i = 0; i < bit_array->_length_in_types; ++i)
+        count += BIT_ARRAY_POPCOUNT(bit_array->data[i]);
+    return count;
+}
 
 /**
  * @brief Frees memory allocated by bit_array struct
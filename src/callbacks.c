@@ -0,0 +1,55 @@
+/**
+ * @file callbacks.c
+ * @author Fern Lane
+ * @brief Training callbacks
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "callbacks.h"
+
+/**
+ * @brief Calls callback of specified event of each set of callbacks
+ *
+ * @param callbacks pointer to array of pointers of callbacks_s structs or NULL
+ * @param callbacks_length number of sets of callbacks (length of callbacks array)
+ * @param event CALLBACK_ON_BATCH_END, CALLBACK_ON_EPOCH_END or CALLBACK_ON_VALIDATION
+ * @param data pointer to callback_data_s struct with current training stats
+ */
+void callbacks_call(callbacks_s **callbacks, uint32_t callbacks_length, uint8_t event, callback_data_s *data) {
+    if (!callbacks)
+        return;
+
+    for (uint32_t i = 0; i < callbacks_length; ++i) {
+        if (!callbacks[i])
+            continue;
+
+        callback_f callback = NULL;
+        if (event == CALLBACK_ON_BATCH_END)
+            callback = callbacks[i]->on_batch_end;
+        else if (event == CALLBACK_ON_EPOCH_END)
+            callback = callbacks[i]->on_epoch_end;
+        else if (event == CALLBACK_ON_VALIDATION)
+            callback = callbacks[i]->on_validation;
+
+        if (callback)
+            callback(data, callbacks[i]->user_data);
+    }
+}
@@ -0,0 +1,400 @@
+/**
+ * @file conv.c
+ * @author Fern Lane
+ * @brief Convolution kernels: lowering into matrix multiplication (im2col / col2im), direct and Winograd
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "conv.h"
+#include "petal.h"
+
+/**
+ * @brief Calculates size of convolution output in one dimension
+ *
+ * @param input_size size of input (rows or cols)
+ * @param kernel_size size of kernel (rows or cols)
+ * @param stride step of kernel (must be greater than 0)
+ * @param padding number of zeros on each side of input
+ * @param dilation step between kernel elements (must be greater than 0)
+ * @return uint32_t size of output or 0 if kernel doesn't fit into padded input
+ */
+uint32_t conv_output_size(uint32_t input_size, uint32_t kernel_size, uint32_t stride, uint32_t padding,
+                          uint32_t dilation) {
+    if (kernel_size == 0U || stride == 0U || dilation == 0U)
+        return 0U;
+    uint64_t kernel_span = (uint64_t) dilation * (kernel_size - 1U) + 1U;
+    uint64_t input_padded = (uint64_t) input_size + 2U * (uint64_t) padding;
+    if (kernel_span > input_padded)
+        return 0U;
+    return (uint32_t) ((input_padded - kernel_span) / stride + 1U);
+}
+
+/**
+ * @brief Copies each receptive field of input into row of columns matrix
+ * Input is rows x cols x depth (channels are interleaved), columns matrix has output rows * output cols rows and
+ * kernel_rows * kernel_cols * input depth columns (in the same order as weights of each filter)
+ *
+ * @param petal pointer to PETAL_TYPE_CONV_2D petal
+ * @param input pointer to input data (petal->input_shape)
+ * @param columns pointer to columns matrix
+ */
+void conv_im2col(petal_s *petal, const float *input, float *columns) {
+    petal_shape_s *input_shape = petal->input_shape;
+    petal_params_s *params = &petal->params;
+    uint32_t depth = input_shape->depth;
+    for (uint32_t output_row = 0; output_row < petal->output_shape->rows; ++output_row) {
+        for (uint32_t output_col = 0; output_col < petal->output_shape->cols; ++output_col) {
+            for (uint32_t kernel_row = 0; kernel_row < params->kernel_rows; ++kernel_row) {
+                int64_t input_row = (int64_t) output_row * params->stride + (int64_t) kernel_row * params->dilation -
+                                    params->padding;
+                for (uint32_t kernel_col = 0; kernel_col < params->kernel_cols; ++kernel_col) {
+                    int64_t input_col = (int64_t) output_col * params->stride +
+                                        (int64_t) kernel_col * params->dilation - params->padding;
+
+                    // Zero padding
+                    if (input_row < 0 || input_row >= input_shape->rows || input_col < 0 ||
+                        input_col >= input_shape->cols)
+                        memset(columns, 0, depth * sizeof(float));
+
+                    // Copy all channels at once
+                    else
+                        memcpy(columns, input + ((uint64_t) input_row * input_shape->cols + input_col) * depth,
+                               depth * sizeof(float));
+                    columns += depth;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Adds each row of columns matrix back into it's receptive field of input (reverse of conv_im2col())
+ * NOTE: input must be cleared
+ *
+ * @param petal pointer to PETAL_TYPE_CONV_2D petal
+ * @param columns pointer to columns matrix
+ * @param input pointer to input data to accumulate into (petal->input_shape)
+ */
+void conv_col2im(petal_s *petal, const float *columns, float *input) {
+    petal_shape_s *input_shape = petal->input_shape;
+    petal_params_s *params = &petal->params;
+    uint32_t depth = input_shape->depth;
+    for (uint32_t output_row = 0; output_row < petal->output_shape->rows; ++output_row) {
+        for (uint32_t output_col = 0; output_col < petal->output_shape->cols; ++output_col) {
+            for (uint32_t kernel_row = 0; kernel_row < params->kernel_rows; ++kernel_row) {
+                int64_t input_row = (int64_t) output_row * params->stride + (int64_t) kernel_row * params->dilation -
+                                    params->padding;
+                for (uint32_t kernel_col = 0; kernel_col < params->kernel_cols; ++kernel_col) {
+                    int64_t input_col = (int64_t) output_col * params->stride +
+                                        (int64_t) kernel_col * params->dilation - params->padding;
+
+                    // Skip padding
+                    if (input_row >= 0 && input_row < input_shape->rows && input_col >= 0 &&
+                        input_col < input_shape->cols) {
+                        float *input_pixel = input + ((uint64_t) input_row * input_shape->cols + input_col) * depth;
+                        for (uint32_t channel = 0; channel < depth; ++channel)
+                            input_pixel[channel] += columns[channel];
+                    }
+                    columns += depth;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Chooses convolution algorithm from shapes (for CONV_ALGORITHM_AUTO) and checks requested one
+ * Winograd F(2x2, 3x3) is used for all 3x3 stride 1 kernels without dilation, direct convolution for small number of
+ * input channels (im2col matrix would be kernel area times bigger than input with almost no reuse) and
+ * im2col + GEMM for everything else
+ *
+ * @param petal pointer to PETAL_TYPE_CONV_2D petal
+ * @return uint8_t CONV_ALGORITHM_IM2COL, CONV_ALGORITHM_DIRECT, CONV_ALGORITHM_WINOGRAD or CONV_ALGORITHM_AUTO if
+ * requested algorithm is not available for this petal
+ */
+uint8_t conv_select_algorithm(petal_s *petal) {
+    petal_params_s *params = &petal->params;
+    bool winograd_available =
+        params->kernel_rows == 3U && params->kernel_cols == 3U && params->stride == 1U && params->dilation == 1U;
+
+    if (params->conv_algorithm == CONV_ALGORITHM_AUTO) {
+        if (winograd_available)
+            return CONV_ALGORITHM_WINOGRAD;
+        if (petal->input_shape->depth <= CONV_DIRECT_MAX_CHANNELS)
+            return CONV_ALGORITHM_DIRECT;
+        return CONV_ALGORITHM_IM2COL;
+    }
+
+    if (params->conv_algorithm == CONV_ALGORITHM_WINOGRAD && !winograd_available)
+        return CONV_ALGORITHM_AUTO;
+    if (params->conv_algorithm > CONV_ALGORITHM_MAX)
+        return CONV_ALGORITHM_AUTO;
+    return params->conv_algorithm;
+}
+
+/**
+ * @brief Calculates number of floats of petal->_conv_kernel buffer (repacked weights) for selected algorithm
+ *
+ * @param petal pointer to PETAL_TYPE_CONV_2D petal with selected algorithm
+ * @return uint64_t kernel length * filters for CONV_ALGORITHM_DIRECT, 16 * input depth * filters for
+ * CONV_ALGORITHM_WINOGRAD and 0 for CONV_ALGORITHM_IM2COL
+ */
+uint64_t conv_kernel_buffer_length(petal_s *petal) {
+    if (petal->_conv_algorithm == CONV_ALGORITHM_DIRECT)
+        return (uint64_t) petal_conv_2d_kernel_length(petal) * petal->output_shape->depth;
+    if (petal->_conv_algorithm == CONV_ALGORITHM_WINOGRAD)
+        return 16U * (uint64_t) petal->input_shape->depth * petal->output_shape->depth;
+    return 0U;
+}
+
+/**
+ * @brief Calculates number of floats of petal->_columns buffer for selected algorithm
+ *
+ * @param petal pointer to PETAL_TYPE_CONV_2D petal with selected algorithm
+ * @return uint64_t size of im2col matrix for CONV_ALGORITHM_IM2COL, size of one transformed tile of input and output
+ * for CONV_ALGORITHM_WINOGRAD and 0 for CONV_ALGORITHM_DIRECT
+ */
+uint64_t conv_columns_length(petal_s *petal) {
+    if (petal->_conv_algorithm == CONV_ALGORITHM_IM2COL)
+        return (uint64_t) petal->output_shape->rows * petal->output_shape->cols * petal_conv_2d_kernel_length(petal);
+    if (petal->_conv_algorithm == CONV_ALGORITHM_WINOGRAD)
+        return 16U * ((uint64_t) petal->input_shape->depth + petal->output_shape->depth);
+    return 0U;
+}
+
+/**
+ * @brief Direct convolution. Weights are repacked into kernel length x filters matrix, so inner loop is a
+ * vectorizable multiply-add over all output channels of one output pixel (no im2col matrix)
+ * NOTE: petal->output must be cleared
+ *
+ * @param petal pointer to PETAL_TYPE_CONV_2D petal
+ * @param input pointer to input data (petal->input_shape)
+ */
+void conv_direct_forward(petal_s *petal, const float *input) {
+    petal_shape_s *input_shape = petal->input_shape;
+    petal_params_s *params = &petal->params;
+    uint32_t depth = input_shape->depth;
+    uint32_t filters = petal->output_shape->depth;
+    uint32_t kernel_length = petal_conv_2d_kernel_length(petal);
+
+    // Repack weights (filters x kernel length -> kernel length x filters)
+    float *kernel = petal->_conv_kernel;
+    for (uint32_t filter = 0; filter < filters; ++filter)
+        for (uint32_t i = 0; i < kernel_length; ++i)
+            kernel[i * filters + filter] = petal->weights->weights[filter * kernel_length + i];
+
+    float *output = petal->output;
+    for (uint32_t output_row = 0; output_row < petal->output_shape->rows; ++output_row) {
+        for (uint32_t output_col = 0; output_col < petal->output_shape->cols; ++output_col) {
+            for (uint32_t kernel_row = 0; kernel_row < params->kernel_rows; ++kernel_row) {
+                int64_t input_row = (int64_t) output_row * params->stride + (int64_t) kernel_row * params->dilation -
+                                    params->padding;
+                if (input_row < 0 || input_row >= input_shape->rows)
+                    continue;
+                for (uint32_t kernel_col = 0; kernel_col < params->kernel_cols; ++kernel_col) {
+                    int64_t input_col = (int64_t) output_col * params->stride +
+                                        (int64_t) kernel_col * params->dilation - params->padding;
+                    if (input_col < 0 || input_col >= input_shape->cols)
+                        continue;
+                    const float *input_pixel = input + ((uint64_t) input_row * input_shape->cols + input_col) * depth;
+                    const float *kernel_pixel =
+                        kernel + (uint64_t) (kernel_row * params->kernel_cols + kernel_col) * depth * filters;
+                    for (uint32_t channel = 0; channel < depth; ++channel) {
+                        float value = input_pixel[channel];
+                        const float *kernel_channel = kernel_pixel + channel * filters;
+                        for (uint32_t filter = 0; filter < filters; ++filter)
+                            output[filter] += value * kernel_channel[filter];
+                    }
+                }
+            }
+            output += filters;
+        }
+    }
+}
+
+/**
+ * @brief Direct convolution backpropagation: accumulates weights gradients and calculates input errors without
+ * im2col matrix (used by CONV_ALGORITHM_DIRECT and CONV_ALGORITHM_WINOGRAD)
+ *
+ * @param petal pointer to PETAL_TYPE_CONV_2D petal (petal->output must contain errors before activation)
+ * @param input pointer to input data of the forward pass (petal->input_shape)
+ */
+void conv_direct_backward(petal_s *petal, const float *input) {
+    petal_shape_s *input_shape = petal->input_shape;
+    petal_params_s *params = &petal->params;
+    uint32_t depth = input_shape->depth;
+    uint32_t filters = petal->output_shape->depth;
+    uint32_t kernel_length = petal_conv_2d_kernel_length(petal);
+    bool trainable = petal->weights->trainable;
+
+    if (!petal->first)
+        memset(petal->error_on_input, 0, input_shape->length * sizeof(float));
+
+    const float *errors = petal->output;
+    for (uint32_t output_row = 0; output_row < petal->output_shape->rows; ++output_row) {
+        for (uint32_t output_col = 0; output_col < petal->output_shape->cols; ++output_col) {
+            for (uint32_t kernel_row = 0; kernel_row < params->kernel_rows; ++kernel_row) {
+                int64_t input_row = (int64_t) output_row * params->stride + (int64_t) kernel_row * params->dilation -
+                                    params->padding;
+                if (input_row < 0 || input_row >= input_shape->rows)
+                    continue;
+                for (uint32_t kernel_col = 0; kernel_col < params->kernel_cols; ++kernel_col) {
+                    int64_t input_col = (int64_t) output_col * params->stride +
+                                        (int64_t) kernel_col * params->dilation - params->padding;
+                    if (input_col < 0 || input_col >= input_shape->cols)
+                        continue;
+                    uint64_t input_index = ((uint64_t) input_row * input_shape->cols + input_col) * depth;
+                    uint32_t kernel_index = (kernel_row * params->kernel_cols + kernel_col) * depth;
+                    for (uint32_t filter = 0; filter < filters; ++filter) {
+                        float error = errors[filter];
+                        if (error == 0.f)
+                            continue;
+                        uint64_t weights_index = (uint64_t) filter * kernel_length + kernel_index;
+                        if (trainable)
+                            for (uint32_t channel = 0; channel < depth; ++channel)
+                                petal->weights->gradients[weights_index + channel] +=
+                                    error * input[input_index + channel];
+                        if (!petal->first)
+                            for (uint32_t channel = 0; channel < depth; ++channel)
+                                petal->error_on_input[input_index + channel] +=
+                                    error * petal->weights->weights[weights_index + channel];
+                    }
+                }
+            }
+            errors += filters;
+        }
+    }
+}
+
+/**
+ * @brief Winograd F(2x2, 3x3) convolution (3x3 kernel, stride 1, no dilation). Each 2x2 block of output is
+ * calculated from 4x4 tile of input with 16 * input depth * filters multiplications instead of 36 * input depth *
+ * filters. Kernels are transformed on each call (U = G * g * G^T) into 16 x input depth x filters matrix
+ * NOTE: petal->output must be cleared
+ *
+ * @param petal pointer to PETAL_TYPE_CONV_2D petal
+ * @param input pointer to input data (petal->input_shape)
+ */
+void conv_winograd_forward(petal_s *petal, const float *input) {
+    petal_shape_s *input_shape = petal->input_shape;
+    petal_shape_s *output_shape = petal->output_shape;
+    uint32_t depth = input_shape->depth;
+    uint32_t filters = output_shape->depth;
+    int64_t padding = petal->params.padding;
+
+    // Transform kernels (G * g * G^T) into kernel[xi][channel][filter]
+    float *kernel = petal->_conv_kernel;
+    float g[3][3], g_rows[4][3];
+    for (uint32_t filter = 0; filter < filters; ++filter) {
+        for (uint32_t channel = 0; channel < depth; ++channel) {
+            for (uint8_t row = 0; row < 3U; ++row)
+                for (uint8_t col = 0; col < 3U; ++col)
+                    g[row][col] = petal->weights->weights[(uint64_t) filter * 9U * depth + (row * 3U + col) * depth +
+                                                          channel];
+
+            // G * g
+            for (uint8_t col = 0; col < 3U; ++col) {
+                g_rows[0][col] = g[0][col];
+                g_rows[1][col] = .5f * (g[0][col] + g[1][col] + g[2][col]);
+                g_rows[2][col] = .5f * (g[0][col] - g[1][col] + g[2][col]);
+                g_rows[3][col] = g[2][col];
+            }
+
+            // (G * g) * G^T
+            for (uint8_t row = 0; row < 4U; ++row) {
+                float u[4] = {g_rows[row][0], .5f * (g_rows[row][0] + g_rows[row][1] + g_rows[row][2]),
+                              .5f * (g_rows[row][0] - g_rows[row][1] + g_rows[row][2]), g_rows[row][2]};
+                for (uint8_t col = 0; col < 4U; ++col)
+                    kernel[((uint64_t) (row * 4U + col) * depth + channel) * filters + filter] = u[col];
+            }
+        }
+    }
+
+    // Scratch: transformed input tile (16 x depth) and transformed output tile (16 x filters)
+    float *tile_input = petal->_columns;
+    float *tile_output = petal->_columns + 16U * depth;
+    float d[4][4], b_d[4][4];
+
+    for (uint32_t tile_row = 0; tile_row < output_shape->rows; tile_row += 2U) {
+        for (uint32_t tile_col = 0; tile_col < output_shape->cols; tile_col += 2U) {
+            // V = B^T * d * B for each channel
+            for (uint32_t channel = 0; channel < depth; ++channel) {
+                for (uint8_t row = 0; row < 4U; ++row) {
+                    int64_t input_row = (int64_t) tile_row + row - padding;
+                    for (uint8_t col = 0; col < 4U; ++col) {
+                        int64_t input_col = (int64_t) tile_col + col - padding;
+                        d[row][col] = (input_row < 0 || input_row >= input_shape->rows || input_col < 0 ||
+                                       input_col >= input_shape->cols)
+                                          ? 0.f
+                                          : input[((uint64_t) input_row * input_shape->cols + input_col) * depth +
+                                                  channel];
+                    }
+                }
+                for (uint8_t col = 0; col < 4U; ++col) {
+                    b_d[0][col] = d[0][col] - d[2][col];
+                    b_d[1][col] = d[1][col] + d[2][col];
+                    b_d[2][col] = d[2][col] - d[1][col];
+                    b_d[3][col] = d[1][col] - d[3][col];
+                }
+                for (uint8_t row = 0; row < 4U; ++row) {
+                    tile_input[(row * 4U + 0U) * depth + channel] = b_d[row][0] - b_d[row][2];
+                    tile_input[(row * 4U + 1U) * depth + channel] = b_d[row][1] + b_d[row][2];
+                    tile_input[(row * 4U + 2U) * depth + channel] = b_d[row][2] - b_d[row][1];
+                    tile_input[(row * 4U + 3U) * depth + channel] = b_d[row][1] - b_d[row][3];
+                }
+            }
+
+            // M[xi] = V[xi] * U[xi] (1 x depth times depth x filters for each of 16 elements)
+            for (uint8_t xi = 0; xi < 16U; ++xi) {
+                float *m_row = tile_output + xi * filters;
+                memset(m_row, 0, filters * sizeof(float));
+                for (uint32_t channel = 0; channel < depth; ++channel) {
+                    float value = tile_input[xi * depth + channel];
+                    const float *kernel_row = kernel + ((uint64_t) xi * depth + channel) * filters;
+                    for (uint32_t filter = 0; filter < filters; ++filter)
+                        m_row[filter] += value * kernel_row[filter];
+                }
+            }
+
+            // Y = A^T * M * A for each filter
+            for (uint32_t filter = 0; filter < filters; ++filter) {
+                float m[4][4], a_m[2][4];
+                for (uint8_t xi = 0; xi < 16U; ++xi)
+                    m[xi / 4U][xi % 4U] = tile_output[xi * filters + filter];
+                for (uint8_t col = 0; col < 4U; ++col) {
+                    a_m[0][col] = m[0][col] + m[1][col] + m[2][col];
+                    a_m[1][col] = m[1][col] - m[2][col] - m[3][col];
+                }
+                for (uint8_t row = 0; row < 2U; ++row) {
+                    if (tile_row + row >= output_shape->rows)
+                        break;
+                    float y[2] = {a_m[row][0] + a_m[row][1] + a_m[row][2], a_m[row][1] - a_m[row][2] - a_m[row][3]};
+                    for (uint8_t col = 0; col < 2U; ++col)
+                        if (tile_col + col < output_shape->cols)
+                            petal->output[((uint64_t) (tile_row + row) * output_shape->cols + tile_col + col) *
+                                              filters +
+                                          filter] = y[col];
+                }
+            }
+        }
+    }
+}
@@ -1,7 +1,7 @@
 /**
  * @file dropout.c
  * @author Fern Lane
- * @brief Handles petal's dropout as bit map
+ * @brief Handles petal's dropout as bit map and scaled keep-mask
  *
  * @copyright Copyright (c) 2023-2024 Fern Lane
  *
@@ -30,12 +30,24 @@
 #include "random.h"
 
 /**
- * @brief Sets bits to 1 on indices to drop
+ * @brief Generates random word from counter-based stream or from rk_state_global
+ *
+ * @param stream pointer to rk_stream_s struct or NULL to use rk_state_global
+ * @return uint32_t uniformly distributed value in the [0, 4294967295] interval (including both ends)
+ */
+static inline uint32_t dropout_random(rk_stream_s *stream) {
+    return stream ? rk_stream_random(stream) : rk_random_();
+}
+
+/**
+ * @brief Sets bits to 1 on indices to drop (exactly length * dropout_ratio bits)
+ * NOTE: bit_array must be cleared
  *
  * @param bit_array pointer to bit_array struct
  * @param dropout_ratio 0 to 1
+ * @param stream pointer to rk_stream_s struct or NULL to use rk_state_global
  */
-void dropout_generate_indices(bit_array_s *bit_array, float dropout_ratio) {
+void dropout_generate_indices(bit_array_s *bit_array, float dropout_ratio, rk_stream_s *stream) {
     uint32_t indices_n_to_drop_or_keep = 0U;
 
     // Calculate how many indices we need to drop for [0.0, 0.5] interval
@@ -58,23 +70,17 @@ void dropout_generate_indices(bit_array_s *bit_array, float dropout_ratio) {
     // Handle 100% keep / drop
     if (indices_n_to_drop_or_keep == bit_array->length)
         for (uint32_t i = 0; i < bit_array->length; ++i)
-            bit_array_set_bit(bit_array, i);
+            bit_array_set_bit_unchecked(bit_array, i);
 
-    // Set random indexes
+    // Set random indexes using Floyd's sampling (exactly one random number per index without rejection loops)
     else {
-        uint32_t set_counter = 0U;
         uint32_t index_to_set;
-        while (set_counter < indices_n_to_drop_or_keep) {
-            // Generate random index
-            index_to_set = rk_random_() % bit_array->length;
-
-            // Ignore if already set
-            if (bit_array_get_bit(bit_array, index_to_set))
-                continue;
-
-            // Set bit and increment counter
-            bit_array_set_bit(bit_array, index_to_set);
-            set_counter++;
+        for (uint32_t i = bit_array->length - indices_n_to_drop_or_keep; i < bit_array->length; ++i) {
+            // Random index from [0, i]. If it's already set, i is not set yet, so use it instead
+            index_to_set = stream ? rk_stream_bounded(stream, i + 1U) : rk_bounded_(i + 1U);
+            if (bit_array_get_bit_unchecked(bit_array, index_to_set))
+                index_to_set = i;
+            bit_array_set_bit_unchecked(bit_array, index_to_set);
         }
     }
 
@@ -82,3 +88,92 @@ void dropout_generate_indices(bit_array_s *bit_array, float dropout_ratio) {
     if (dropout_ratio <= 1.f && dropout_ratio >= .5f)
         bit_array_not(bit_array);
 }
+
+/**
+ * @brief Sets each bit to 1 (drop) independently with dropout_ratio probability
+ * 64 bits are generated at once by bit-sliced comparison with probability: going from the lowest bit of probability
+ * (as fixed-point fraction) to the highest one, word = bit ? (word | random) : (word & random).
+ * So each word requires at most DROPOUT_BERNOULLI_BITS random words (only 1 for 0.5)
+ *
+ * @param bit_array pointer to bit_array struct
+ * @param dropout_ratio 0 to 1
+ * @param stream pointer to rk_stream_s struct or NULL to use rk_state_global
+ */
+void dropout_generate_bernoulli(bit_array_s *bit_array, float dropout_ratio, rk_stream_s *stream) {
+    // Probability as fixed-point fraction
+    uint32_t probability = 0U;
+    if (dropout_ratio > 0.f)
+        probability = (uint32_t) (dropout_ratio * (float) (1U << DROPOUT_BERNOULLI_BITS) + .5f);
+
+    // Drop nothing or everything
+    if (probability == 0U || probability >= (1U << DROPOUT_BERNOULLI_BITS)) {
+        bit_array_clear(bit_array);
+        if (probability != 0U)
+            bit_array_not(bit_array);
+        return;
+    }
+
+    // Skip trailing zero bits of probability
+    uint32_t bits = DROPOUT_BERNOULLI_BITS - BIT_ARRAY_CTZ(probability);
+    probability >>= BIT_ARRAY_CTZ(probability);
+
+    BIT_ARRAY_TYPE word, random;
+    for (uint32_t i = 0; i < bit_array->_length_in_types; ++i) {
+        word = 0U;
+        for (uint32_t bit = 0; bit < bits; ++bit) {
+            random = ((BIT_ARRAY_TYPE) dropout_random(stream) << 32U) | (BIT_ARRAY_TYPE) dropout_random(stream);
+            if ((probability >> bit) & 1U)
+                word |= random;
+            else
+                word &= random;
+        }
+        bit_array->data[i] = word;
+    }
+
+    // Clear padding bits after length
+    if (bit_array->length % BIT_ARRAY_BITS)
+        bit_array->data[bit_array->_length_in_types - 1U] &=
+            ((BIT_ARRAY_TYPE) 1U << (bit_array->length % BIT_ARRAY_BITS)) - 1U;
+}
+
+/**
+ * @brief Generates new indices to drop and converts them into scaled keep-mask
+ * (0 for dropped indices and 1 / (1 - dropout_ratio) for kept ones), so dropout can be applied
+ * with a single multiplication by dropout_apply_mask()
+ *
+ * @param bit_array pointer to bit_array_s struct to generate indices into (will be cleared)
+ * @param mask pointer to array of bit_array->length floats to write keep-mask into
+ * @param dropout_ratio 0 to 1
+ * @param mode DROPOUT_MODE_EXACT or DROPOUT_MODE_BERNOULLI
+ * @param stream pointer to rk_stream_s struct or NULL to use rk_state_global
+ * @return uint8_t ERROR_NONE or error code in case of error
+ */
+uint8_t dropout_generate_mask(bit_array_s *bit_array, float *mask, float dropout_ratio, uint8_t mode,
+                              rk_stream_s *stream) {
+    if (mode == DROPOUT_MODE_BERNOULLI)
+        dropout_generate_bernoulli(bit_array, dropout_ratio, stream);
+    else {
+        bit_array_clear(bit_array);
+        dropout_generate_indices(bit_array, dropout_ratio, stream);
+    }
+    if (bit_array->error_code != ERROR_NONE)
+        return bit_array->error_code;
+
+    // Scale kept values to preserve expected sum
+    float scaling = dropout_ratio < 1.f ? 1.f / (1.f - dropout_ratio) : 0.f;
+    for (uint32_t i = 0; i < bit_array->length; ++i)
+        mask[i] = bit_array_get_bit_unchecked(bit_array, i) ? 0.f : scaling;
+    return bit_array->error_code;
+}
+
+/**
+ * @brief Multiplies layer by keep-mask generated by dropout_generate_mask()
+ *
+ * @param layer pointer to 1D array to apply dropout to
+ * @param mask pointer to keep-mask
+ * @param length length of layer and mask
+ */
+void dropout_apply_mask(float *layer, const float *mask, uint32_t length) {
+    for (uint32_t i = 0; i < length; ++i)
+        layer[i] *= mask[i];
+}
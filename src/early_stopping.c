@@ -0,0 +1,210 @@
+/**
+ * @file early_stopping.c
+ * @author Fern Lane
+ * @brief Early stopping and best weights snapshotting
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "early_stopping.h"
+#include "errors.h"
+#include "logger.h"
+#include "metrics.h"
+#include "norm.h"
+
+/**
+ * @brief Resets internal state of early stopping (called at the beginning of each flower_train())
+ *
+ * @param early_stopping pointer to early_stopping_s struct or NULL
+ */
+void early_stopping_reset(early_stopping_s *early_stopping) {
+    if (!early_stopping)
+        return;
+    early_stopping_destroy(early_stopping);
+    early_stopping->_value_best = INFINITY;
+    early_stopping->_epoch_best = 0U;
+    early_stopping->_epochs_waiting = 0U;
+}
+
+/**
+ * @brief Returns array of petal's values that is stored in snapshot with given index
+ *
+ * @param petal pointer to petal_s struct
+ * @param snapshot_i index of snapshot of this petal (0 - weights, 1 - bias weights, 2 - running mean,
+ * 3 - running variance)
+ * @param length will be set to length of returned array
+ * @return float* pointer to array or NULL if it doesn't exist or never changes during training
+ */
+static float *early_stopping_values(petal_s *petal, uint32_t snapshot_i, uint32_t *length) {
+    *length = 0U;
+
+    // Running statistics of batch normalization (updated by each forward pass in training mode)
+    if (snapshot_i >= 2U) {
+        if (petal->petal_type != PETAL_TYPE_BATCH_NORM)
+            return NULL;
+        *length = batch_norm_features(petal);
+        return snapshot_i == 2U ? petal->_running_mean : petal->_running_variance;
+    }
+
+    // Non-trainable weights never change
+    weights_s *weights = snapshot_i == 0U ? petal->weights : petal->bias_weights;
+    if (!weights || !weights->trainable || !weights->weights || weights->length_total == 0U)
+        return NULL;
+    *length = weights->length_total;
+    return weights->weights;
+}
+
+/**
+ * @brief Copies weights, bias weights and running statistics of each petal into snapshots (allocates them on the
+ * first call)
+ *
+ * @param early_stopping pointer to early_stopping_s struct
+ * @param petals pointer to array of pointers of petals
+ * @param petals_length number of petals
+ * @return uint8_t ERROR_NONE or error code in case of error
+ */
+static uint8_t early_stopping_snapshot(early_stopping_s *early_stopping, petal_s **petals, uint32_t petals_length) {
+    // Allocate array of snapshots
+    if (!early_stopping->_snapshots) {
+        early_stopping->_snapshots = calloc(petals_length * EARLY_STOPPING_SNAPSHOTS_PER_PETAL, sizeof(float *));
+        if (!early_stopping->_snapshots) {
+            logger(LOG_E, "early_stopping_snapshot", "Error allocating memory for _snapshots array");
+            return ERROR_MALLOC;
+        }
+        early_stopping->_snapshots_length = petals_length * EARLY_STOPPING_SNAPSHOTS_PER_PETAL;
+    }
+
+    for (uint32_t i = 0; i < early_stopping->_snapshots_length; ++i) {
+        uint32_t length;
+        float *values = early_stopping_values(petals[i / EARLY_STOPPING_SNAPSHOTS_PER_PETAL],
+                                              i % EARLY_STOPPING_SNAPSHOTS_PER_PETAL, &length);
+        if (!values || length == 0U)
+            continue;
+
+        // Allocate snapshot
+        if (!early_stopping->_snapshots[i]) {
+            early_stopping->_snapshots[i] = malloc(length * sizeof(float));
+            if (!early_stopping->_snapshots[i]) {
+                logger(LOG_E, "early_stopping_snapshot", "Error allocating memory for snapshot of weights");
+                return ERROR_MALLOC;
+            }
+        }
+
+        memcpy(early_stopping->_snapshots[i], values, length * sizeof(float));
+    }
+
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Checks monitored metric at the end of each epoch and takes snapshot of weights in case of improvement
+ *
+ * @param early_stopping pointer to early_stopping_s struct or NULL
+ * @param petals pointer to array of pointers of petals
+ * @param petals_length number of petals
+ * @param epoch_index index of current epoch
+ * @param loss_train average training loss of this epoch
+ * @param accuracy_train average training accuracy of this epoch
+ * @param loss_validation last validation loss
+ * @param accuracy_validation last validation accuracy
+ * @param stop will be set to true if training should be stopped
+ * @return uint8_t ERROR_NONE or error code in case of error
+ */
+uint8_t early_stopping_epoch_end(early_stopping_s *early_stopping, petal_s **petals, uint32_t petals_length,
+                                 uint32_t epoch_index, float loss_train, float accuracy_train, float loss_validation,
+                                 float accuracy_validation, bool *stop) {
+    *stop = false;
+    if (!early_stopping)
+        return ERROR_NONE;
+
+    // Convert monitored metric into "lower is better" value
+    float value;
+    if (early_stopping->monitor == METRICS_ACCURACY_TRAIN)
+        value = -accuracy_train;
+    else if (early_stopping->monitor == METRICS_LOSS_VALIDATION)
+        value = loss_validation;
+    else if (early_stopping->monitor == METRICS_ACCURACY_VALIDATION)
+        value = -accuracy_validation;
+    else
+        value = loss_train;
+
+    // Improved
+    if (value < early_stopping->_value_best - early_stopping->min_delta) {
+        early_stopping->_value_best = value;
+        early_stopping->_epoch_best = epoch_index;
+        early_stopping->_epochs_waiting = 0U;
+        if (early_stopping->restore_best)
+            return early_stopping_snapshot(early_stopping, petals, petals_length);
+        return ERROR_NONE;
+    }
+
+    // Stop if there were no improvements for too long
+    early_stopping->_epochs_waiting++;
+    if (early_stopping->_epochs_waiting >= early_stopping->patience) {
+        logger(LOG_I, "early_stopping_epoch_end", "No improvement for %u epochs. Best epoch: %u",
+               early_stopping->_epochs_waiting, early_stopping->_epoch_best + 1U);
+        *stop = true;
+    }
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Restores weights and running statistics from the best epoch (if restore_best is true) and frees snapshots
+ *
+ * @param early_stopping pointer to early_stopping_s struct or NULL
+ * @param petals pointer to array of pointers of petals
+ * @param petals_length number of petals
+ */
+void early_stopping_restore(early_stopping_s *early_stopping, petal_s **petals, uint32_t petals_length) {
+    if (!early_stopping || !early_stopping->_snapshots)
+        return;
+
+    logger(LOG_I, "early_stopping_restore", "Restoring weights from epoch %u", early_stopping->_epoch_best + 1U);
+    uint32_t snapshots_length = petals_length * EARLY_STOPPING_SNAPSHOTS_PER_PETAL;
+    if (snapshots_length > early_stopping->_snapshots_length)
+        snapshots_length = early_stopping->_snapshots_length;
+    for (uint32_t i = 0; i < snapshots_length; ++i) {
+        uint32_t length;
+        float *values = early_stopping_values(petals[i / EARLY_STOPPING_SNAPSHOTS_PER_PETAL],
+                                              i % EARLY_STOPPING_SNAPSHOTS_PER_PETAL, &length);
+        if (early_stopping->_snapshots[i] && values)
+            memcpy(values, early_stopping->_snapshots[i], length * sizeof(float));
+    }
+
+    early_stopping_destroy(early_stopping);
+}
+
+/**
+ * @brief Frees snapshots of weights (struct itself is not destroyed)
+ *
+ * @param early_stopping pointer to early_stopping_s struct or NULL
+ */
+void early_stopping_destroy(early_stopping_s *early_stopping) {
+    if (!early_stopping || !early_stopping->_snapshots)
+        return;
+    for (uint32_t i = 0; i < early_stopping->_snapshots_length; ++i)
+        free(early_stopping->_snapshots[i]);
+    free(early_stopping->_snapshots);
+    early_stopping->_snapshots = NULL;
+    early_stopping->_snapshots_length = 0U;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file embedding.c
+ * @author Fern Lane
+ * @brief Embedding lookup (gathers rows of table by ids) with sparse gradients
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "embedding.h"
+#include "errors.h"
+#include "logger.h"
+#include "petal.h"
+#include "weights.h"
+
+/**
+ * @brief Copies row of embedding table (petal->weights) for each id and adds bias weights (if present)
+ * Input is array of ids (one id per row of output, passed as floats), output is rows x embedding size
+ *
+ * @param petal pointer to PETAL_TYPE_EMBEDDING petal
+ * @param input pointer to array of ids (petal->input_shape->length)
+ * @return uint8_t ERROR_NONE or ERROR_PETAL_WRONG_INDEX if id is not an integer in [0, vocabulary_size)
+ */
+uint8_t embedding_forward(petal_s *petal, const float *input) {
+    uint32_t embedding_size = petal->output_shape->cols * petal->output_shape->depth;
+    for (uint32_t row = 0; row < petal->input_shape->length; ++row) {
+        float id_float = input[row];
+        uint32_t id = (uint32_t) id_float;
+        if (!(id_float >= 0.f) || (float) id != id_float || id >= petal->params.vocabulary_size) {
+            logger(LOG_E, "embedding_forward", "Wrong id %f in row %u", id_float, row);
+            return ERROR_PETAL_WRONG_INDEX;
+        }
+
+        float *output_row = petal->output + row * embedding_size;
+        memcpy(output_row, petal->weights->weights + (uint64_t) id * embedding_size, embedding_size * sizeof(float));
+        if (petal->bias_weights && petal->bias_weights->weights)
+            for (uint32_t i = 0; i < embedding_size; ++i)
+                output_row[i] += petal->bias_weights->weights[i];
+    }
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Accumulates gradients only into rows of embedding table that were looked up and marks them for
+ * weights_update() (ids are not differentiable, so error_on_input is zeroed)
+ *
+ * @param petal pointer to PETAL_TYPE_EMBEDDING petal (petal->output must contain errors before activation)
+ * @param input pointer to array of ids used by the last forward pass
+ */
+void embedding_backward(petal_s *petal, const float *input) {
+    uint32_t embedding_size = petal->output_shape->cols * petal->output_shape->depth;
+    for (uint32_t row = 0; row < petal->input_shape->length; ++row) {
+        const float *error_row = petal->output + row * embedding_size;
+        if (petal->weights->trainable) {
+            uint32_t id = (uint32_t) input[row];
+            float *gradients_row = petal->weights->gradients + (uint64_t) id * embedding_size;
+            for (uint32_t i = 0; i < embedding_size; ++i)
+                gradients_row[i] += error_row[i];
+            weights_sparse_mark_row(petal->weights, id);
+        }
+        if (petal->bias_weights && petal->bias_weights->trainable)
+            for (uint32_t i = 0; i < embedding_size; ++i)
+                petal->bias_weights->gradients[i] += error_row[i];
+    }
+    if (!petal->first)
+        memset(petal->error_on_input, 0, petal->input_shape->length * sizeof(float));
+}
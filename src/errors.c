@@ -28,7 +28,7 @@
  * @brief Maps each error to string
  *
  */
-const char *error_to_str[15] = {
+const char *error_to_str[19] = {
     "No error",                                                         // 0 (ERROR_NONE)
     "Memory allocation error",                                          // 1 (ERROR_MALLOC)
     "Wrong petal type",                                                 // 2 (ERROR_PETAL_WRONG_TYPE)
@@ -43,5 +43,9 @@ const char *error_to_str[15] = {
     "Wrong optimizer type",                                             // 11 (ERROR_OPTIMIZER_WRONG_TYPE)
     "No petals in flower",                                              // 12 (ERROR_FLOWER_NO_PETALS)
     "Wrong loss type",                                                  // 13 (ERROR_LOSS_WRONG_TYPE)
-    "Wrong number of batches / length of train dataset"                 // 14 (ERROR_WRONG_BATCH_SIZE)
+    "Wrong number of batches / length of train dataset",                // 14 (ERROR_WRONG_BATCH_SIZE)
+    "Wrong dropout mode",                                               // 15 (ERROR_PETAL_WRONG_DROPOUT_MODE)
+    "Wrong kernel, stride, padding or dilation",                        // 16 (ERROR_PETAL_WRONG_KERNEL)
+    "Index (id) is out of range of petal's input",                      // 17 (ERROR_PETAL_WRONG_INDEX)
+    "Wrong inputs of flower's petals (graph)"                           // 18 (ERROR_FLOWER_WRONG_GRAPH)
 };
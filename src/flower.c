@@ -20,27 +20,528 @@
  * You should have received a copy of the GNU Affero General Public License
  * long with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "activation.h"
+#include "callbacks.h"
+#include "early_stopping.h"
 #include "errors.h"
 #include "flower.h"
 #include "labeling.h"
 #include "logger.h"
 #include "loss.h"
 #include "metrics.h"
+#include "norm.h"
+#include "petal.h"
+#include "profile.h"
+#include "random.h"
+#include "scheduler.h"
 #include "shuffle.h"
+#include "sparse.h"
+#include "timer.h"
 
 /**
- * @brief Initializes flower using array of petals
+ * @brief Frees topological order, merged inputs, errors buffers and inference buffers of flower
+ *
+ * @param flower pointer to flower_s struct
+ */
+static void flower_schedule_destroy(flower_s *flower) {
+    if (flower->_merged) {
+        for (uint32_t i = 0; i < flower->petals_length; ++i)
+            if (flower->_merged[i])
+                free(flower->_merged[i]);
+        free(flower->_merged);
+    }
+    if (flower->_buffers) {
+        for (uint32_t i = 0; i < flower->_buffers_length; ++i)
+            if (flower->_buffers[i])
+                free(flower->_buffers[i]);
+        free(flower->_buffers);
+    }
+    if (flower->_order)
+        free(flower->_order);
+    if (flower->_errors)
+        free(flower->_errors);
+    if (flower->_errors_first)
+        free(flower->_errors_first);
+    if (flower->_buffers_lengths)
+        free(flower->_buffers_lengths);
+    if (flower->_pool) {
+        for (uint32_t i = 0; i < flower->_pool_length; ++i)
+            if (flower->_pool_allocated && flower->_pool_allocated[i])
+                free(flower->_pool[i]);
+        free(flower->_pool);
+    }
+    if (flower->_pool_lengths)
+        free(flower->_pool_lengths);
+    if (flower->_pool_allocated)
+        free(flower->_pool_allocated);
+    if (flower->_outputs)
+        free(flower->_outputs);
+    if (flower->_outputs_own)
+        free(flower->_outputs_own);
+    if (flower->_merged_inference)
+        free(flower->_merged_inference);
+    flower->_merged = NULL;
+    flower->_buffers = NULL;
+    flower->_order = NULL;
+    flower->_errors = NULL;
+    flower->_errors_first = NULL;
+    flower->_buffers_lengths = NULL;
+    flower->_buffers_length = 0U;
+    flower->_pool = NULL;
+    flower->_pool_lengths = NULL;
+    flower->_pool_allocated = NULL;
+    flower->_pool_length = 0U;
+    flower->_outputs = NULL;
+    flower->_outputs_own = NULL;
+    flower->_merged_inference = NULL;
+}
+
+/**
+ * @brief Connects petals into a chain (input of each petal is output of previous one)
+ *
+ * @param flower pointer to flower_s struct
+ * @return uint8_t ERROR_NONE or ERROR_MALLOC
+ */
+static uint8_t flower_chain_nodes(flower_s *flower) {
+    if (flower->_nodes_owned) {
+        free(flower->_nodes);
+        free(flower->_chain_inputs);
+    }
+    flower->_nodes = (flower_node_s *) malloc(flower->petals_length * sizeof(flower_node_s));
+    flower->_chain_inputs = (uint32_t *) malloc(flower->petals_length * sizeof(uint32_t));
+    flower->_nodes_owned = true;
+    if (!flower->_nodes || !flower->_chain_inputs) {
+        logger(LOG_E, "flower_init", "Error allocating memory for nodes of chain");
+        return ERROR_MALLOC;
+    }
+    for (uint32_t i = 0; i < flower->petals_length; ++i) {
+        flower->_chain_inputs[i] = i > 0U ? i - 1U : FLOWER_INPUT;
+        flower->_nodes[i] = (flower_node_s){&flower->_chain_inputs[i], 1U, FLOWER_MERGE_ADD};
+    }
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Checks inputs of each petal and counts consumers of each petal
+ * Each input must be index of other petal or FLOWER_INPUT (the only input of it's petal), merged length must match
+ * petal's input length, petals with inputs from other petals must not be first, the first petal must take flower's
+ * input data and the last petal must be the only petal without consumers (it's output is flower's output)
+ *
+ * @param flower pointer to flower_s struct
+ * @param consumers pointer to array to store number of consumers of each petal
+ * @return uint8_t ERROR_NONE or ERROR_FLOWER_WRONG_GRAPH
+ */
+static uint8_t flower_check_nodes(flower_s *flower, uint32_t *consumers) {
+    memset(consumers, 0, flower->petals_length * sizeof(uint32_t));
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i) {
+        flower_node_s *node = &flower->_nodes[petal_i];
+        petal_s *petal = flower->petals[petal_i];
+        if (!node->inputs || node->inputs_length == 0U || node->merge > FLOWER_MERGE_MAX) {
+            logger(LOG_E, "flower_init", "Petal %u has no inputs or wrong merge type", petal_i);
+            return ERROR_FLOWER_WRONG_GRAPH;
+        }
+
+        bool add = node->merge == FLOWER_MERGE_ADD && node->inputs_length > 1U;
+        uint64_t merged_length = 0U;
+        for (uint32_t input_i = 0; input_i < node->inputs_length; ++input_i) {
+            uint32_t input = node->inputs[input_i];
+
+            // Input data (it's length is defined by petal)
+            if (input == FLOWER_INPUT) {
+                if (node->inputs_length != 1U) {
+                    logger(LOG_E, "flower_init", "Flower's input must be the only input of petal %u", petal_i);
+                    return ERROR_FLOWER_WRONG_GRAPH;
+                }
+                merged_length = petal->input_shape->length;
+                continue;
+            }
+
+            // Output of other petal
+            bool duplicate = false;
+            for (uint32_t i = 0; i < input_i; ++i)
+                duplicate |= node->inputs[i] == input;
+            if (input >= flower->petals_length || input == petal_i || duplicate) {
+                logger(LOG_E, "flower_init", "Wrong or duplicated input %u of petal %u", input, petal_i);
+                return ERROR_FLOWER_WRONG_GRAPH;
+            }
+            if (petal->first) {
+                logger(LOG_E, "flower_init", "Petal %u takes output of other petal, so it must not be first", petal_i);
+                return ERROR_FLOWER_WRONG_GRAPH;
+            }
+            uint32_t input_length = flower->petals[input]->output_shape->length;
+            if (add && input_length != petal->input_shape->length) {
+                logger(LOG_E, "flower_init", "Length of input %u of petal %u is %u, but must be %u", input, petal_i,
+                       input_length, petal->input_shape->length);
+                return ERROR_FLOWER_WRONG_GRAPH;
+            }
+            merged_length += add ? 0U : input_length;
+            consumers[input]++;
+        }
+        if (!add && merged_length != petal->input_shape->length) {
+            logger(LOG_E, "flower_init", "Length of inputs of petal %u is %lu, but must be %u", petal_i,
+                   (unsigned long) merged_length, petal->input_shape->length);
+            return ERROR_FLOWER_WRONG_GRAPH;
+        }
+    }
+
+    // Input data must be the input of the first petal and output of the last petal is flower's output
+    if (flower->_nodes[0].inputs[0] != FLOWER_INPUT) {
+        logger(LOG_E, "flower_init", "The first petal must take flower's input");
+        return ERROR_FLOWER_WRONG_GRAPH;
+    }
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i)
+        if ((consumers[petal_i] == 0U) != (petal_i == flower->petals_length - 1U)) {
+            logger(LOG_E, "flower_init", "Only output of the last petal must be unused (petal %u has %u consumers)",
+                   petal_i, consumers[petal_i]);
+            return ERROR_FLOWER_WRONG_GRAPH;
+        }
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Sorts petals topologically into flower->_order using Kahn's algorithm: petals which inputs are calculated
+ * are queued (flower->_order itself is the queue) and each dequeued petal releases it's consumers, so sorting takes
+ * O(petals + inputs). Petals which are ready earlier go first (petals which take flower's input by the lowest index),
+ * so order of chain doesn't change
+ *
+ * @param flower pointer to flower_s struct
+ * @param consumers pointer to array of number of consumers of each petal
+ * @return uint8_t ERROR_NONE, ERROR_FLOWER_WRONG_GRAPH if graph has a cycle or ERROR_MALLOC
+ */
+static uint8_t flower_sort(flower_s *flower, const uint32_t *consumers) {
+    uint32_t petals_length = flower->petals_length;
+    uint64_t edges = 0U;
+    for (uint32_t petal_i = 0; petal_i < petals_length; ++petal_i)
+        edges += consumers[petal_i];
+
+    // Consumers of each petal are stored from consumers_of[offsets[petal]] to consumers_of[offsets[petal + 1]]
+    uint32_t *inputs_left = (uint32_t *) malloc((2U * (uint64_t) petals_length + 1U + edges) * sizeof(uint32_t));
+    if (!inputs_left) {
+        logger(LOG_E, "flower_init", "Error allocating memory for consumers of petals");
+        return ERROR_MALLOC;
+    }
+    uint32_t *offsets = inputs_left + petals_length;
+    uint32_t *consumers_of = offsets + petals_length + 1U;
+    offsets[0] = 0U;
+    for (uint32_t petal_i = 0; petal_i < petals_length; ++petal_i) {
+        offsets[petal_i + 1U] = offsets[petal_i] + consumers[petal_i];
+        inputs_left[petal_i] = offsets[petal_i];
+    }
+    for (uint32_t petal_i = 0; petal_i < petals_length; ++petal_i) {
+        flower_node_s *node = &flower->_nodes[petal_i];
+        for (uint32_t input_i = 0; input_i < node->inputs_length; ++input_i)
+            if (node->inputs[input_i] != FLOWER_INPUT)
+                consumers_of[inputs_left[node->inputs[input_i]]++] = petal_i;
+    }
+
+    // Queue petals which take flower's input
+    uint32_t head = 0U, tail = 0U;
+    for (uint32_t petal_i = 0; petal_i < petals_length; ++petal_i) {
+        flower_node_s *node = &flower->_nodes[petal_i];
+        inputs_left[petal_i] = node->inputs[0] == FLOWER_INPUT ? 0U : node->inputs_length;
+        if (inputs_left[petal_i] == 0U)
+            flower->_order[tail++] = petal_i;
+    }
+
+    // It's output is ready for consumers
+    while (head < tail) {
+        uint32_t petal_ready = flower->_order[head++];
+        for (uint32_t i = offsets[petal_ready]; i < offsets[petal_ready + 1U]; ++i)
+            if (--inputs_left[consumers_of[i]] == 0U)
+                flower->_order[tail++] = consumers_of[i];
+    }
+    free(inputs_left);
+
+    // Petals of cycle are never ready
+    if (tail < petals_length) {
+        logger(LOG_E, "flower_init", "Petals have cyclic dependencies");
+        return ERROR_FLOWER_WRONG_GRAPH;
+    }
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Takes the first free buffer (or adds a new one) and extends it to the required length
+ *
+ * @param buffers_free pointer to array of flags of free buffers
+ * @param lengths pointer to array of lengths of buffers
+ * @param buffers_length pointer to number of buffers
+ * @param length required length
+ * @return uint32_t index of buffer
+ */
+static uint32_t flower_buffer_take(bool *buffers_free, uint32_t *lengths, uint32_t *buffers_length, uint32_t length) {
+    uint32_t buffer = 0U;
+    while (buffer < *buffers_length && !buffers_free[buffer])
+        buffer++;
+    if (buffer == *buffers_length)
+        lengths[(*buffers_length)++] = 0U;
+    buffers_free[buffer] = false;
+    if (lengths[buffer] < length)
+        lengths[buffer] = length;
+    return buffer;
+}
+
+/**
+ * @brief Assigns errors on output of each petal: "error_on_input" of it's consumer if it's the only consumer with
+ * the only input, or buffer into which errors of all consumers are summed. Buffer is needed from backpropagation of
+ * it's first consumer until backpropagation of petal itself, so petals which buffers are not needed at the same time
+ * share them (buffer is reused as soon as it's last consumer has run)
+ *
+ * @param flower pointer to flower_s struct (flower->_order must be calculated)
+ * @param consumers pointer to array of number of consumers of each petal
+ * @param temp pointer to temp array of 2 * petals_length
+ * @return uint8_t ERROR_NONE or ERROR_MALLOC
+ */
+static uint8_t flower_plan_errors(flower_s *flower, const uint32_t *consumers, uint32_t *temp) {
+    uint32_t *position = temp;
+    uint32_t *buffer_of = temp + flower->petals_length;
+    for (uint32_t i = 0; i < flower->petals_length; ++i) {
+        position[flower->_order[i]] = i;
+        buffer_of[i] = UINT32_MAX;
+        flower->_errors_first[i] = UINT32_MAX;
+    }
+
+    // Errors are backpropagated in reverse order, so consumer with the highest position is the first one
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i) {
+        flower_node_s *node = &flower->_nodes[petal_i];
+        for (uint32_t input_i = 0; input_i < node->inputs_length; ++input_i) {
+            uint32_t input = node->inputs[input_i];
+            if (input == FLOWER_INPUT)
+                continue;
+            uint32_t first = flower->_errors_first[input];
+            if (first == UINT32_MAX || position[petal_i] > position[first])
+                flower->_errors_first[input] = petal_i;
+        }
+    }
+
+    // Use errors of the only consumer directly
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i)
+        if (consumers[petal_i] == 1U && flower->_nodes[flower->_errors_first[petal_i]].inputs_length == 1U)
+            flower->_errors[petal_i] = flower->petals[flower->_errors_first[petal_i]]->error_on_input;
+
+    // Assign buffers in order of backpropagation
+    bool *buffers_free = (bool *) calloc(flower->petals_length, sizeof(bool));
+    if (!buffers_free) {
+        logger(LOG_E, "flower_init", "Error allocating memory for buffers_free array");
+        return ERROR_MALLOC;
+    }
+    for (uint32_t position_i = flower->petals_length; position_i-- > 0U;) {
+        uint32_t petal_i = flower->_order[position_i];
+
+        // Errors of this petal are not needed after it's backpropagation
+        if (buffer_of[petal_i] != UINT32_MAX)
+            buffers_free[buffer_of[petal_i]] = true;
+
+        // It's inputs start receiving errors
+        flower_node_s *node = &flower->_nodes[petal_i];
+        for (uint32_t input_i = 0; input_i < node->inputs_length; ++input_i) {
+            uint32_t input = node->inputs[input_i];
+            if (input == FLOWER_INPUT || flower->_errors[input] || flower->_errors_first[input] != petal_i)
+                continue;
+            buffer_of[input] = flower_buffer_take(buffers_free, flower->_buffers_lengths, &flower->_buffers_length,
+                                                  flower->petals[input]->output_shape->length);
+        }
+    }
+    free(buffers_free);
+
+    // Allocate buffers
+    if (flower->_buffers_length > 0U) {
+        flower->_buffers = (float **) calloc(flower->_buffers_length, sizeof(float *));
+        if (!flower->_buffers) {
+            logger(LOG_E, "flower_init", "Error allocating memory for flower->_buffers");
+            return ERROR_MALLOC;
+        }
+        for (uint32_t buffer = 0; buffer < flower->_buffers_length; ++buffer) {
+            flower->_buffers[buffer] = (float *) malloc(flower->_buffers_lengths[buffer] * sizeof(float));
+            if (!flower->_buffers[buffer]) {
+                logger(LOG_E, "flower_init", "Error allocating memory for errors buffer");
+                return ERROR_MALLOC;
+            }
+        }
+    }
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i)
+        if (buffer_of[petal_i] != UINT32_MAX)
+            flower->_errors[petal_i] = flower->_buffers[buffer_of[petal_i]];
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Assigns buffers to outputs and merged inputs of petals during inference. Output is needed from forward
+ * propagation of petal until forward propagation of it's last consumer and merged input only during forward
+ * propagation of it's petal, so buffer is reused as soon as it's last consumer has run. Each buffer is backed by own
+ * output of one of petals if it's long enough (so inference doesn't need extra memory) or allocated. The last petal
+ * always uses it's own output (it's flower's output)
+ *
+ * @param flower pointer to flower_s struct (flower->_order must be calculated)
+ * @param consumers pointer to array of number of consumers of each petal
+ * @param temp pointer to temp array of 2 * petals_length
+ * @return uint8_t ERROR_NONE or ERROR_MALLOC
+ */
+static uint8_t flower_plan_outputs(flower_s *flower, const uint32_t *consumers, uint32_t *temp) {
+    uint32_t petals_length = flower->petals_length;
+    uint32_t petal_last = petals_length - 1U;
+    uint32_t *consumers_left = temp;
+    uint32_t *buffer_of = temp + petals_length;
+    memcpy(consumers_left, consumers, petals_length * sizeof(uint32_t));
+
+    // Each petal needs up to 2 buffers (output and merged input)
+    uint32_t *merged_buffer_of = (uint32_t *) malloc(petals_length * sizeof(uint32_t));
+    bool *buffers_free = (bool *) calloc(2U * (size_t) petals_length, sizeof(bool));
+    flower->_pool_lengths = (uint32_t *) malloc(2U * (size_t) petals_length * sizeof(uint32_t));
+    if (!merged_buffer_of || !buffers_free || !flower->_pool_lengths) {
+        logger(LOG_E, "flower_init", "Error allocating memory for planning of inference buffers");
+        free(merged_buffer_of);
+        free(buffers_free);
+        return ERROR_MALLOC;
+    }
+
+    // Assign buffers in order of forward propagation
+    for (uint32_t position = 0; position < petals_length; ++position) {
+        uint32_t petal_i = flower->_order[position];
+        flower_node_s *node = &flower->_nodes[petal_i];
+        petal_s *petal = flower->petals[petal_i];
+        merged_buffer_of[petal_i] = UINT32_MAX;
+        if (node->inputs_length > 1U)
+            merged_buffer_of[petal_i] = flower_buffer_take(buffers_free, flower->_pool_lengths, &flower->_pool_length,
+                                                           petal->input_shape->length);
+        buffer_of[petal_i] = UINT32_MAX;
+        if (petal_i != petal_last)
+            buffer_of[petal_i] = flower_buffer_take(buffers_free, flower->_pool_lengths, &flower->_pool_length,
+                                                    petal->output_shape->length);
+
+        // Merged input and outputs of inputs are not needed after their last consumer
+        if (merged_buffer_of[petal_i] != UINT32_MAX)
+            buffers_free[merged_buffer_of[petal_i]] = true;
+        for (uint32_t input_i = 0; input_i < node->inputs_length; ++input_i) {
+            uint32_t input = node->inputs[input_i];
+            if (input != FLOWER_INPUT && --consumers_left[input] == 0U && buffer_of[input] != UINT32_MAX)
+                buffers_free[buffer_of[input]] = true;
+        }
+    }
+
+    // Back each buffer with own output of petal (except the last one) or allocate it
+    bool *backing = buffers_free;
+    memset(backing, 0, petals_length * sizeof(bool));
+    uint8_t error_temp = ERROR_NONE;
+    if (flower->_pool_length > 0U) {
+        flower->_pool = (float **) calloc(flower->_pool_length, sizeof(float *));
+        flower->_pool_allocated = (bool *) calloc(flower->_pool_length, sizeof(bool));
+        if (!flower->_pool || !flower->_pool_allocated) {
+            logger(LOG_E, "flower_init", "Error allocating memory for flower->_pool");
+            error_temp = ERROR_MALLOC;
+        }
+    }
+    for (uint32_t buffer = 0; buffer < flower->_pool_length && error_temp == ERROR_NONE; ++buffer) {
+        uint32_t petal_i = 0U;
+        while (petal_i < petal_last && (backing[petal_i] || !flower->petals[petal_i]->output ||
+                                         flower->petals[petal_i]->output_shape->length < flower->_pool_lengths[buffer]))
+            petal_i++;
+        if (petal_i < petal_last) {
+            backing[petal_i] = true;
+            flower->_pool[buffer] = flower->petals[petal_i]->output;
+            continue;
+        }
+        flower->_pool[buffer] = (float *) malloc(flower->_pool_lengths[buffer] * sizeof(float));
+        flower->_pool_allocated[buffer] = true;
+        if (!flower->_pool[buffer]) {
+            logger(LOG_E, "flower_init", "Error allocating memory for inference buffer");
+            error_temp = ERROR_MALLOC;
+        }
+    }
+
+    for (uint32_t petal_i = 0; petal_i < petals_length && error_temp == ERROR_NONE; ++petal_i) {
+        flower->_outputs_own[petal_i] = flower->petals[petal_i]->output;
+        flower->_outputs[petal_i] =
+            buffer_of[petal_i] == UINT32_MAX ? flower->petals[petal_i]->output : flower->_pool[buffer_of[petal_i]];
+        if (merged_buffer_of[petal_i] != UINT32_MAX)
+            flower->_merged_inference[petal_i] = flower->_pool[merged_buffer_of[petal_i]];
+    }
+    free(merged_buffer_of);
+    free(buffers_free);
+    return error_temp;
+}
+
+/**
+ * @brief Checks graph of petals, sorts it topologically and allocates errors buffers and inference buffers (merged
+ * inputs for training are allocated by the first training forward pass)
+ *
+ * @param flower pointer to flower_s struct with _nodes
+ * @return uint8_t ERROR_NONE or error code in case of error
+ */
+static uint8_t flower_schedule(flower_s *flower) {
+    flower_schedule_destroy(flower);
+
+    uint32_t *temp = (uint32_t *) malloc(2U * flower->petals_length * sizeof(uint32_t));
+    flower->_order = (uint32_t *) malloc(flower->petals_length * sizeof(uint32_t));
+    flower->_merged = (float **) calloc(flower->petals_length, sizeof(float *));
+    flower->_errors = (float **) calloc(flower->petals_length, sizeof(float *));
+    flower->_errors_first = (uint32_t *) malloc(flower->petals_length * sizeof(uint32_t));
+    flower->_buffers_lengths = (uint32_t *) malloc(flower->petals_length * sizeof(uint32_t));
+    flower->_outputs = (float **) calloc(flower->petals_length, sizeof(float *));
+    flower->_outputs_own = (float **) calloc(flower->petals_length, sizeof(float *));
+    flower->_merged_inference = (float **) calloc(flower->petals_length, sizeof(float *));
+    if (!temp || !flower->_order || !flower->_merged || !flower->_errors || !flower->_errors_first ||
+        !flower->_buffers_lengths || !flower->_outputs || !flower->_outputs_own || !flower->_merged_inference) {
+        logger(LOG_E, "flower_init", "Error allocating memory for schedule of petals");
+        free(temp);
+        return ERROR_MALLOC;
+    }
+
+    // Check graph and sort it
+    uint8_t error_temp = flower_check_nodes(flower, temp);
+    if (error_temp == ERROR_NONE)
+        error_temp = flower_sort(flower, temp);
+
+    // Buffers of errors and inference buffers
+    if (error_temp == ERROR_NONE) {
+        uint32_t *consumers = (uint32_t *) malloc(flower->petals_length * sizeof(uint32_t));
+        if (!consumers)
+            error_temp = ERROR_MALLOC;
+        else {
+            memcpy(consumers, temp, flower->petals_length * sizeof(uint32_t));
+            error_temp = flower_plan_errors(flower, consumers, temp);
+            if (error_temp == ERROR_NONE)
+                error_temp = flower_plan_outputs(flower, consumers, temp);
+            free(consumers);
+        }
+    }
+    free(temp);
+    return error_temp;
+}
+
+/**
+ * @brief Initializes flower using array of petals connected into a chain
  *
  * @param petals pointer to an array of pointers of petals
  * @param petals_length number of petals
  * @return flower_s* initialized flower
  */
 flower_s *flower_init(petal_s **petals, uint32_t petals_length) {
+    return flower_init_graph(petals, petals_length, NULL);
+}
+
+/**
+ * @brief Initializes flower using array of petals and their inputs (directed acyclic graph)
+ * Petal can take outputs of multiple petals (summed or concatenated) and it's output can be used by multiple petals
+ * (errors of them are summed during backpropagation). Petals are propagated in topological order and buffers of
+ * errors are shared by petals which errors are not needed at the same time
+ *
+ * @param petals pointer to an array of pointers of petals (the first petal must take flower's input and the last
+ * petal must be the only petal which output is not used by other petals)
+ * @param petals_length number of petals
+ * @param nodes pointer to an array of petals_length inputs of each petal (must exist until flower is destroyed) or
+ * NULL to connect petals into a chain
+ * @return flower_s* initialized flower
+ */
+flower_s *flower_init_graph(petal_s **petals, uint32_t petals_length, flower_node_s *nodes) {
     // Log
     logger(LOG_I, "flower_init", "Initializing flower with %u petals", petals_length);
 
@@ -51,6 +552,9 @@ flower_s *flower_init(petal_s **petals, uint32_t petals_length) {
         return NULL;
     }
 
+    // Validate after each batch on entire validation dataset by default
+    flower->validation = (validation_s){VALIDATION_INTERVAL_BATCHES, 1.f, 1.f};
+
     // Check length of array of petals
     if (petals_length < 1) {
         logger(LOG_E, "flower_init", "A flower cannot have zero petals");
@@ -65,6 +569,14 @@ flower_s *flower_init(petal_s **petals, uint32_t petals_length) {
     flower->petals = petals;
     flower->petals_length = petals_length;
 
+    // Connect petals and schedule them
+    if (nodes)
+        flower->_nodes = nodes;
+    else
+        flower->error_code = flower_chain_nodes(flower);
+    if (flower->error_code == ERROR_NONE)
+        flower->error_code = flower_schedule(flower);
+
     return flower;
 }
 
@@ -77,6 +589,120 @@ flower_s *flower_init(petal_s **petals, uint32_t petals_length) {
  */
 float *flower_predict(flower_s *flower, float *input) { return flower_forward(flower, input, false); }
 
+/**
+ * @brief Returns input of petal (merges outputs of input petals in case of multiple inputs)
+ *
+ * @param flower pointer to initialized flower_s struct
+ * @param petal_i index of petal
+ * @param input pointer to array of flower's input data
+ * @param merged pointer to buffer of merged inputs (flower->_merged for training or flower->_merged_inference)
+ * @param merge true to merge inputs (during forward propagation) or false to return previously merged ones
+ * @return float* pointer to petal's input
+ */
+static float *flower_petal_input(flower_s *flower, uint32_t petal_i, float *input, float *merged, bool merge) {
+    flower_node_s *node = &flower->_nodes[petal_i];
+    if (node->inputs_length == 1U)
+        return node->inputs[0] == FLOWER_INPUT ? input : flower->petals[node->inputs[0]]->output;
+
+    if (merge) {
+        uint32_t offset = 0U;
+        for (uint32_t input_i = 0; input_i < node->inputs_length; ++input_i) {
+            petal_s *petal_input = flower->petals[node->inputs[input_i]];
+            uint32_t length = petal_input->output_shape->length;
+
+            // Sum
+            if (node->merge == FLOWER_MERGE_ADD && input_i > 0U)
+                for (uint32_t i = 0; i < length; ++i)
+                    merged[i] += petal_input->output[i];
+
+            // Copy (first input of sum or concatenation)
+            else {
+                memcpy(merged + offset, petal_input->output, length * sizeof(float));
+                if (node->merge == FLOWER_MERGE_CONCAT)
+                    offset += length;
+            }
+        }
+    }
+    return merged;
+}
+
+/**
+ * @brief Restores own output of each petal after inference
+ *
+ * @param flower pointer to initialized flower_s struct
+ */
+static void flower_outputs_restore(flower_s *flower) {
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i)
+        flower->petals[petal_i]->output = flower->_outputs_own[petal_i];
+}
+
+/**
+ * @brief Forward propagation through each petal in topological order
+ * During inference outputs and merged inputs are written into shared buffers (see flower_plan_outputs()), so only
+ * output of the last petal is kept. During training each petal uses it's own output and merged input (they are kept
+ * for backpropagation)
+ *
+ * @param flower pointer to initialized flower_s struct
+ * @param input pointer to array of input data or NULL if input_sparse is used
+ * @param input_sparse pointer to sparse input data or NULL
+ * @param training true to enable training mode (to apply dropout)
+ * @param positions number of petals to propagate in topological order (petals_length to propagate entire flower)
+ * @return float* pointer to output layer of the last propagated petal
+ */
+static float *flower_forward_graph(flower_s *flower, float *input, const sparse_s *input_sparse, bool training,
+                                   uint32_t positions) {
+    for (uint32_t position = 0; position < positions; ++position) {
+        uint32_t petal_i = flower->_order[position];
+        petal_s *petal = flower->petals[petal_i];
+        bool sparse = input_sparse && flower->_nodes[petal_i].inputs[0] == FLOWER_INPUT;
+
+        // Shared buffers during inference or merged inputs kept for backpropagation
+        float *merged = flower->_merged_inference[petal_i];
+        if (!training)
+            petal->output = flower->_outputs[petal_i];
+        else if (flower->_nodes[petal_i].inputs_length > 1U) {
+            if (!flower->_merged[petal_i]) {
+                flower->_merged[petal_i] = (float *) malloc(petal->input_shape->length * sizeof(float));
+                if (!flower->_merged[petal_i]) {
+                    logger(LOG_E, "flower_forward", "Error allocating memory for merged input");
+                    flower->error_code = ERROR_MALLOC;
+                    return NULL;
+                }
+            }
+            merged = flower->_merged[petal_i];
+        }
+
+        // Forward propagation thought each petal
+        PROFILE_START(time_forward);
+        if (sparse)
+            petal_forward_sparse(petal, input_sparse, training);
+        else
+            petal_forward(petal, flower_petal_input(flower, petal_i, input, merged, true), training);
+        PROFILE_STOP(petal->_profile, time_forward, time_forward);
+        if (sparse) {
+            PETAL_PROFILE_COST_SPARSE(petal, input_sparse->length, false);
+        } else {
+            PETAL_PROFILE_COST(petal, false);
+        }
+
+        // Check for error
+        if (petal->error_code != ERROR_NONE) {
+            logger(LOG_E, "flower_forward", "Error during forward propagation: %s", error_to_str[petal->error_code]);
+            flower->error_code = petal->error_code;
+            if (!training)
+                flower_outputs_restore(flower);
+            return NULL;
+        }
+    }
+
+    // Restore own outputs (the last petal uses it's own output anyway)
+    if (!training)
+        flower_outputs_restore(flower);
+
+    // Return last propagated petal's output layer (the last petal is the last one in topological order)
+    return flower->petals[flower->_order[positions - 1U]]->output;
+}
+
 /**
  * @brief Forward propagation through each petal
  *
@@ -86,24 +712,370 @@ float *flower_predict(flower_s *flower, float *input) { return flower_forward(fl
  * @return float* pointer to the last petal's output layer
  */
 float *flower_forward(flower_s *flower, float *input, bool training) {
-    for (uint32_t i = 0; i < flower->petals_length; ++i) {
-        // Forward propagation thought each petal
-        if (i == 0)
-            petal_forward(flower->petals[i], input, training);
+    return flower_forward_graph(flower, input, NULL, training, flower->petals_length);
+}
+
+/**
+ * @brief Forward propagation of sparse input through each petal (petals which take flower's input must be
+ * PETAL_TYPE_DENSE_1D)
+ *
+ * @param flower pointer to initialized flower_s struct
+ * @param input pointer to sparse_s struct with indices (less than 1st petal's input length) and values of
+ * non-zero inputs
+ * @param training true to enable training mode (to apply dropout)
+ * @return float* pointer to the last petal's output layer
+ */
+float *flower_forward_sparse(flower_s *flower, const sparse_s *input, bool training) {
+    return flower_forward_graph(flower, NULL, input, training, flower->petals_length);
+}
+
+/**
+ * @brief Adds errors on input of petal into errors on output of it's input petals (errors of concatenated inputs are
+ * split). The first consumer overwrites errors instead of adding them
+ *
+ * @param flower pointer to initialized flower_s struct
+ * @param petal_i index of backpropagated petal
+ */
+static void flower_backward_errors(flower_s *flower, uint32_t petal_i) {
+    flower_node_s *node = &flower->_nodes[petal_i];
+    petal_s *petal = flower->petals[petal_i];
+    uint32_t offset = 0U;
+    for (uint32_t input_i = 0; input_i < node->inputs_length; ++input_i) {
+        uint32_t input = node->inputs[input_i];
+        if (input == FLOWER_INPUT)
+            continue;
+        uint32_t length = flower->petals[input]->output_shape->length;
+        const float *errors = petal->error_on_input + offset;
+        if (node->merge == FLOWER_MERGE_CONCAT)
+            offset += length;
+
+        // Only consumer (errors are used directly)
+        float *errors_input = flower->_errors[input];
+        if (errors_input == petal->error_on_input)
+            continue;
+
+        if (flower->_errors_first[input] == petal_i)
+            memcpy(errors_input, errors, length * sizeof(float));
         else
-            petal_forward(flower->petals[i], flower->petals[i - 1U]->output, training);
+            for (uint32_t i = 0; i < length; ++i)
+                errors_input[i] += errors[i];
+    }
+}
+
+/**
+ * @brief Backpropagation through each petal in reverse topological order
+ *
+ * @param flower pointer to initialized flower_s struct
+ * @param input pointer to array of input data of the last forward pass
+ * @param loss_derivatives pointer to array of loss function derivatives
+ * @param position_last position (in topological order) of the last petal to backpropagate (0 to backpropagate all)
+ * @return true if no errors
+ * @return false in case of error (flower->error_code is set)
+ */
+static bool flower_backward(flower_s *flower, float *input, float *loss_derivatives, uint32_t position_last) {
+    for (uint32_t position = flower->petals_length; position-- > position_last;) {
+        uint32_t petal_i = flower->_order[position];
+        petal_s *petal = flower->petals[petal_i];
+
+        // Backpropagate and calculate gradients
+        PROFILE_START(time_petal_backward);
+        petal_backward(petal, flower->_errors[petal_i] ? flower->_errors[petal_i] : loss_derivatives,
+                       flower_petal_input(flower, petal_i, input, flower->_merged[petal_i], false));
+        PROFILE_STOP(petal->_profile, time_backward, time_petal_backward);
+        PETAL_PROFILE_COST(petal, true);
 
         // Check for error
-        if (flower->petals[i]->error_code != ERROR_NONE) {
-            logger(LOG_E, "flower_forward", "Error during forward propagation: %s",
-                   error_to_str[flower->petals[i]->error_code]);
-            flower->error_code = flower->petals[i]->error_code;
-            return NULL;
+        if (petal->error_code != ERROR_NONE) {
+            logger(LOG_E, "flower_backward", "Error during backpropagation: %s", error_to_str[petal->error_code]);
+            flower->error_code = petal->error_code;
+            return false;
+        }
+
+        // Pass errors to input petals
+        if (!petal->first)
+            flower_backward_errors(flower, petal_i);
+    }
+    return true;
+}
+
+/**
+ * @brief Merges each PETAL_TYPE_BATCH_NORM petal into preceding PETAL_TYPE_DENSE_1D petal (for inference)
+ * Weights and bias weights of dense petal are replaced with W * scale / std and
+ * (b - running mean) * scale / std + shift of each output, then batch normalization petal is removed from
+ * flower->petals array (in place) and it's activation is moved into dense petal. Dense petal must have bias weights
+ * and linear activation (or no activation). Dropout of removed petals is discarded. Only flowers initialized as a chain
+ * (see flower_init()) can be folded
+ *
+ * @param flower pointer to initialized flower_s struct
+ * @param destroy_petals true to destroy removed petals (see flower_destroy())
+ * @param destroy_weights_array true to also destroy scale array of removed petals
+ * @param destroy_bias_weights_array true to also destroy shift array of removed petals
+ * @return uint32_t number of folded (removed) petals
+ */
+uint32_t flower_fold_batchnorm(flower_s *flower, bool destroy_petals, bool destroy_weights_array,
+                               bool destroy_bias_weights_array) {
+    if (!flower->_nodes_owned) {
+        logger(LOG_W, "flower_fold_batchnorm", "Only flowers of chained petals can be folded");
+        return 0U;
+    }
+
+    uint32_t folded = 0U;
+    uint32_t petal_i = 1U;
+    while (petal_i < flower->petals_length) {
+        petal_s *norm = flower->petals[petal_i];
+        petal_s *dense = flower->petals[petal_i - 1U];
+
+        // Check that petal can be folded
+        if (norm->petal_type != PETAL_TYPE_BATCH_NORM || dense->petal_type != PETAL_TYPE_DENSE_1D ||
+            !dense->weights || !dense->weights->weights || !dense->bias_weights || !dense->bias_weights->weights ||
+            (dense->activation && dense->activation->type != ACTIVATION_LINEAR) ||
+            (norm->activation && norm->activation->type == ACTIVATION_SOFTMAX)) {
+            if (norm->petal_type == PETAL_TYPE_BATCH_NORM)
+                logger(LOG_W, "flower_fold_batchnorm", "Petal %u can't be folded into previous one", petal_i);
+            petal_i++;
+            continue;
+        }
+
+        // Dense output (before linear activation) is a * W * x + a * b + c
+        float linear_alpha = dense->activation ? dense->activation->linear_alpha : 1.f;
+        float linear_const = dense->activation ? dense->activation->linear_const : 0.f;
+        uint32_t features = batch_norm_features(norm);
+        uint32_t input_length = dense->input_shape->length;
+        for (uint32_t output_i = 0; output_i < dense->output_shape->length; ++output_i) {
+            uint32_t feature = output_i % features;
+            float scale = (norm->weights ? norm->weights->weights[feature] : 1.f) /
+                          sqrtf(norm->_running_variance[feature] + NORM_EPSILON);
+            float shift = norm->bias_weights ? norm->bias_weights->weights[feature] : 0.f;
+
+            float *weights_row = dense->weights->weights + (uint64_t) output_i * input_length;
+            for (uint32_t input_i = 0; input_i < input_length; ++input_i)
+                weights_row[input_i] *= linear_alpha * scale;
+            float *bias = &dense->bias_weights->weights[output_i];
+            *bias = (linear_alpha * *bias + linear_const - norm->_running_mean[feature]) * scale + shift;
+        }
+
+        // Move activation of normalization petal
+        activation_destroy(dense->activation);
+        dense->activation = norm->activation;
+        norm->activation = NULL;
+
+        // Remove petal
+        logger(LOG_I, "flower_fold_batchnorm", "Petal %u folded into previous one", petal_i);
+        if (destroy_petals)
+            petal_destroy(norm, true, destroy_weights_array, destroy_bias_weights_array);
+        for (uint32_t i = petal_i; i < flower->petals_length - 1U; ++i)
+            flower->petals[i] = flower->petals[i + 1U];
+        flower->petals_length--;
+        folded++;
+    }
+
+    // Reconnect remaining petals
+    if (folded > 0U) {
+        flower->error_code = flower_chain_nodes(flower);
+        if (flower->error_code == ERROR_NONE)
+            flower->error_code = flower_schedule(flower);
+    }
+    return folded;
+}
+
+/**
+ * @brief Calculates average loss and accuracy on validation dataset (or it's subset) in inference mode
+ *
+ * @param flower pointer to initialized flower_s struct
+ * @param metrics pointer to initialized metrics_s struct or NULL
+ * @param inputs pointer to array of arrays of validation input data
+ * @param outputs_true pointer to array of arrays of validation output data
+ * @param outputs_true_sparse pointer to array of label_s arrays of sparse validation output data
+ * @param indices pointer to array of sample indices to validate on or NULL to use samples from 0 to length - 1
+ * @param length number of samples to validate on
+ * @param output_temp temp array for converting sparse labels (must have the same size as last petal's output)
+ * @param loss pointer to variable to store average loss into
+ * @param accuracy pointer to variable to store average accuracy into
+ * @return uint8_t ERROR_NONE or error code in case of error
+ */
+static uint8_t flower_validate(flower_s *flower, metrics_s *metrics, float **inputs, float **outputs_true,
+                               labels_s **outputs_true_sparse, uint32_t *indices, uint32_t length, float *output_temp,
+                               float *loss, float *accuracy) {
+    uint32_t output_length = flower->petals[flower->petals_length - 1]->output_shape->length;
+    float loss_sum = 0.f;
+    float accuracy_sum = 0.f;
+    uint8_t error_temp;
+
+    for (uint32_t i = 0; i < length; ++i) {
+        uint32_t sample_index = indices ? indices[i] : i;
+
+        // Forward propagation (inference mode)
+        float *predicted = flower_forward(flower, inputs[sample_index], false);
+
+        // Check for error
+        if (!predicted)
+            return flower->error_code;
+
+        // Use temp output array in case of sparse labels
+        float *expected = outputs_true_sparse ? output_temp : outputs_true[sample_index];
+        if (outputs_true_sparse)
+            labels_to_petal_output(outputs_true_sparse[sample_index], output_temp, output_length, 0.f, 1.f);
+
+        // Calculate _loss
+        error_temp = loss_forward(flower->_loss, predicted, expected, output_length);
+        if (error_temp != ERROR_NONE) {
+            logger(LOG_E, "flower_validate", "Error calculating _loss during validation: %s",
+                   error_to_str[error_temp]);
+            return error_temp;
+        }
+
+        // Add to sum to calculate mean
+        loss_sum += flower->_loss->loss[0];
+        accuracy_sum += metrics_calculate_accuracy(metrics, predicted, expected, output_length, 0.5f);
+    }
+
+    // Calculate mean stats
+    *loss = loss_sum / (float) length;
+    *accuracy = accuracy_sum / (float) length;
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Calls metrics' built-in callbacks and flower's callbacks of specified event
+ *
+ * @param flower pointer to flower_s struct
+ * @param metrics pointer to metrics_s struct or NULL
+ * @param event CALLBACK_ON_BATCH_END, CALLBACK_ON_EPOCH_END or CALLBACK_ON_VALIDATION
+ * @param data pointer to callback_data_s struct with current training stats
+ */
+static void flower_callbacks_call(flower_s *flower, metrics_s *metrics, uint8_t event, callback_data_s *data) {
+    if (metrics) {
+        callbacks_s *metrics_callbacks = &metrics->callbacks;
+        callbacks_call(&metrics_callbacks, 1U, event, data);
+    }
+    callbacks_call(flower->callbacks, flower->callbacks_length, event, data);
+}
+
+/**
+ * @brief Initializes random stream for shuffling or picking validation subset
+ * If flower->rng_streams is false, stream's seed is taken from rk_state_global (so rk_seed_() still makes training
+ * reproducible)
+ *
+ * @param flower pointer to flower_s struct
+ * @param stream pointer to rk_stream_s struct to initialize
+ * @param id_1 first stream id (epoch index)
+ * @param id_2 second stream id (batch index or RK_STREAM_ID_NONE)
+ * @param id_3 third stream id (RK_STREAM_ID_NONE)
+ */
+static void flower_stream_init(flower_s *flower, rk_stream_s *stream, uint32_t id_1, uint32_t id_2, uint32_t id_3) {
+    uint64_t seed = flower->rng_seed;
+    if (!flower->rng_streams)
+        seed = ((uint64_t) rk_random_() << 32U) | (uint64_t) rk_random_();
+    rk_stream_init(stream, seed, id_1, id_2, id_3);
+}
+
+/**
+ * @brief Frees flower_train() temp arrays, switches dropout of each petal back to rk_state_global and batch
+ * normalization petals back to running statistics
+ *
+ * @param flower pointer to flower_s struct
+ * @param output_temp temp array for true output data in case of sparse labels or NULL
+ * @param validation_indices array of validation samples indices or NULL
+ */
+static void flower_train_cleanup(flower_s *flower, float *output_temp, uint32_t *validation_indices) {
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i) {
+        flower->petals[petal_i]->_rng_stream_enabled = false;
+        flower->petals[petal_i]->_batch_norm_stage = BATCH_NORM_STAGE_RUNNING;
+    }
+    free(output_temp);
+    free(validation_indices);
+}
+
+/**
+ * @brief Binds dropout of each petal to it's own counter-based random stream of the sample, so masks don't depend on
+ * the order of samples and are the same in each pass over mini-batch
+ *
+ * @param flower pointer to flower_s struct
+ * @param seed seed of streams
+ * @param epoch_index index of epoch
+ * @param sample_index index of sample
+ */
+static void flower_bind_streams(flower_s *flower, uint64_t seed, uint32_t epoch_index, uint32_t sample_index) {
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i) {
+        rk_stream_init(&flower->petals[petal_i]->_rng_stream, seed, epoch_index, sample_index, petal_i);
+        flower->petals[petal_i]->_rng_stream_enabled = true;
+    }
+}
+
+/**
+ * @brief Calculates statistics of mini-batch and means of errors over it for each PETAL_TYPE_BATCH_NORM petal, so
+ * training pass normalizes each sample with statistics of mini-batch and backpropagates errors through them
+ * Statistics of each petal depend on statistics of previous ones, so each petal takes forward pass over mini-batch
+ * (up to this petal) in topological order. Means of errors depend on means of errors of next petals, so then each
+ * petal (except the first one) takes forward and backward pass (down to this petal) in reverse order. Gradients of
+ * weights accumulated by these passes are discarded
+ *
+ * @param flower pointer to flower_s struct with initialized _loss
+ * @param inputs pointer to array of arrays of training input data
+ * @param outputs_true pointer to array of arrays of training output data
+ * @param outputs_true_sparse pointer to array of label_s arrays of sparse training output data or NULL
+ * @param sample_index_from index of the first sample of mini-batch
+ * @param sample_index_to index after the last sample of mini-batch
+ * @param output_temp temp array for converting sparse labels (must have the same size as last petal's output)
+ * @param seed seed of dropout streams of samples (see flower_bind_streams())
+ * @param epoch_index index of epoch
+ * @return uint8_t ERROR_NONE or error code in case of error
+ */
+static uint8_t flower_batch_norm_prepare(flower_s *flower, float **inputs, float **outputs_true,
+                                         labels_s **outputs_true_sparse, uint32_t sample_index_from,
+                                         uint32_t sample_index_to, float *output_temp, uint64_t seed,
+                                         uint32_t epoch_index) {
+    uint32_t output_length = flower->petals[flower->petals_length - 1]->output_shape->length;
+
+    // Statistics in topological order
+    for (uint32_t position = 0; position < flower->petals_length; ++position) {
+        petal_s *norm = flower->petals[flower->_order[position]];
+        if (norm->petal_type != PETAL_TYPE_BATCH_NORM)
+            continue;
+        batch_norm_batch_begin(norm);
+        for (uint32_t sample_index = sample_index_from; sample_index < sample_index_to; ++sample_index) {
+            flower_bind_streams(flower, seed, epoch_index, sample_index);
+            if (!flower_forward_graph(flower, inputs[sample_index], NULL, true, position + 1U))
+                return flower->error_code;
         }
+        batch_norm_batch_statistics(norm);
     }
 
-    // Return last petal's output layer
-    return flower->petals[flower->petals_length - 1]->output;
+    // Means of errors in reverse topological order
+    for (uint32_t position = flower->petals_length; position-- > 0U;) {
+        petal_s *norm = flower->petals[flower->_order[position]];
+        if (norm->petal_type != PETAL_TYPE_BATCH_NORM || norm->first)
+            continue;
+        for (uint32_t sample_index = sample_index_from; sample_index < sample_index_to; ++sample_index) {
+            flower_bind_streams(flower, seed, epoch_index, sample_index);
+            float *predicted = flower_forward_graph(flower, inputs[sample_index], NULL, true, flower->petals_length);
+            if (!predicted)
+                return flower->error_code;
+
+            // Use temp output array in case of sparse labels
+            float *expected = outputs_true_sparse ? output_temp : outputs_true[sample_index];
+            if (outputs_true_sparse)
+                labels_to_petal_output(outputs_true_sparse[sample_index], output_temp, output_length, 0.f, 1.f);
+            uint8_t error_temp = loss_forward(flower->_loss, predicted, expected, output_length);
+            if (error_temp != ERROR_NONE) {
+                logger(LOG_E, "flower_train", "Error calculating _loss: %s", error_to_str[error_temp]);
+                return error_temp;
+            }
+            loss_backward(flower->_loss, output_length);
+            if (!flower_backward(flower, inputs[sample_index], flower->_loss->loss, position))
+                return flower->error_code;
+        }
+        batch_norm_batch_errors(norm);
+    }
+
+    // Discard gradients
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i) {
+        weights_s *weights[2] = {flower->petals[petal_i]->weights, flower->petals[petal_i]->bias_weights};
+        for (uint8_t i = 0; i < 2U; ++i)
+            if (weights[i] && weights[i]->gradients)
+                memset(weights[i]->gradients, 0, weights[i]->length_total * sizeof(float));
+    }
+    return ERROR_NONE;
 }
 
 /**
@@ -117,7 +1089,9 @@ float *flower_forward(flower_s *flower, float *input, bool training) {
  * momentum - accelerates gradient descent and dampens oscillations (for OPTIMIZER_SGD_MOMENTUM)
  * beta_1 - hyperparameter (for OPTIMIZER_RMS_PROP and OPTIMIZER_ADAM) Default: 0.9
  * beta_2 - hyperparameter (for OPTIMIZER_ADAM) Default: 0.999
- * @param metrics pointer to initialized metrics_s struct
+ * scheduler - pointer to scheduler_s struct or NULL to keep learning rate constant
+ * (optimizer->learning_rate is used as base learning rate and is not modified)
+ * @param metrics pointer to initialized metrics_s struct or NULL (prints progress bar using built-in callbacks)
  * @param inputs_train pointer to array of arrays of training input data (train dataset)
  * @param outputs_true_train pointer to array of arrays of training output data (train dataset)
  * @param outputs_true_train_sparse pointer to array of label_s arrays of sparse training output data (1 = [0, 1, ...])
@@ -128,6 +1102,15 @@ float *flower_forward(flower_s *flower, float *input, bool training) {
  * @param validation_length number of validation samples (size of validation dataset)
  * @param batch_size samples per batch
  * @param epochs total number of training epochs
+ * NOTE: validation is performed according to flower->validation (after each batch on entire dataset by default)
+ * NOTE: flower->callbacks are called after each batch, validation and epoch
+ * NOTE: training stops early and best weights are restored according to flower->early_stopping (if not NULL)
+ * NOTE: if flower->rng_streams is true, shuffling, dropout masks and validation subsets don't use rk_state_global
+ * and are bit-identical for the same flower->rng_seed
+ * NOTE: PETAL_TYPE_BATCH_NORM petals normalize with mean and variance of each mini-batch and errors are
+ * backpropagated through them. Each batch normalization petal costs an extra pass over mini-batch to calculate
+ * statistics (forward up to it) and an extra forward and backward pass to calculate means of errors (running
+ * statistics are updated once per mini-batch and used only for inference and flower_fold_batchnorm())
  */
 void flower_train(flower_s *flower, uint8_t loss_type, optimizer_s *optimizer, metrics_s *metrics, float **inputs_train,
                   float **outputs_true_train, labels_s **outputs_true_train_sparse, uint32_t train_length,
@@ -159,7 +1142,7 @@ void flower_train(flower_s *flower, uint8_t loss_type, optimizer_s *optimizer, m
 
     // Initialize array for storing true output data in case of sparse labels
     float *output_temp = NULL;
-    if (outputs_true_train_sparse) {
+    if (outputs_true_train_sparse || outputs_true_validation_sparse) {
         output_temp = malloc(flower->petals[flower->petals_length - 1]->output_shape->length * sizeof(float));
         if (!output_temp) {
             logger(LOG_E, "flower_train", "Error allocating memory for output_temp array");
@@ -169,7 +1152,7 @@ void flower_train(flower_s *flower, uint8_t loss_type, optimizer_s *optimizer, m
     }
 
     // Calculate number of batches
-    uint32_t batches_per_epoch = train_length / batch_size;
+    uint32_t batches_per_epoch = batch_size > 0U ? train_length / batch_size : 0U;
     if (batches_per_epoch * batch_size < train_length)
         batches_per_epoch++;
 
@@ -178,9 +1161,60 @@ void flower_train(flower_s *flower, uint8_t loss_type, optimizer_s *optimizer, m
         logger(LOG_E, "flower_train", "Batch size (%u) must be less then dataset length (%u) that should be not 0",
                batch_size, train_length);
         flower->error_code = ERROR_WRONG_BATCH_SIZE;
+        flower_train_cleanup(flower, output_temp, NULL);
         return;
     }
 
+    // Calculate validation interval in batches
+    uint32_t validation_interval = 1U;
+    if (flower->validation.interval_type == VALIDATION_INTERVAL_EPOCH_FRACTION)
+        validation_interval = (uint32_t) roundf(flower->validation.interval * (float) batches_per_epoch);
+    else
+        validation_interval = (uint32_t) flower->validation.interval;
+    if (validation_interval == 0U)
+        validation_interval = 1U;
+
+    // Calculate size of validation subset and initialize array of indices to randomly pick samples from
+    uint32_t validation_subset_length = validation_length;
+    uint32_t *validation_indices = NULL;
+    if (validation_length > 0U && flower->validation.subset_ratio > 0.f && flower->validation.subset_ratio < 1.f) {
+        validation_subset_length = (uint32_t) ceilf(flower->validation.subset_ratio * (float) validation_length);
+        validation_indices = malloc(validation_length * sizeof(uint32_t));
+        if (!validation_indices) {
+            logger(LOG_E, "flower_train", "Error allocating memory for validation_indices array");
+            flower->error_code = ERROR_MALLOC;
+            flower_train_cleanup(flower, output_temp, NULL);
+            return;
+        }
+        for (uint32_t i = 0; i < validation_length; ++i)
+            validation_indices[i] = i;
+    }
+
+    // Reset learning rate scheduler
+    scheduler_reset(optimizer->scheduler);
+    uint64_t steps_total = (uint64_t) epochs * (uint64_t) batches_per_epoch;
+
+    // Reset early stopping (and free previous snapshots)
+    early_stopping_reset(flower->early_stopping);
+
+    // Batch normalization petals use statistics of each mini-batch
+    bool batch_norm = false;
+    for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i)
+        batch_norm |= flower->petals[petal_i]->petal_type == PETAL_TYPE_BATCH_NORM;
+
+    // Optimizer for each step with scheduled learning rate
+    optimizer_s optimizer_step = *optimizer;
+
+    // Last validation results (kept between validations)
+    float accuracy_validation_avg = 0.f;
+    float loss_validation_avg = 0.f;
+
+    // Stats for callbacks
+    callback_data_s callback_data = (callback_data_s){0};
+    callback_data.epochs_total = epochs;
+    callback_data.batches_per_epoch = batches_per_epoch;
+    uint64_t time_training_start = timer_get_ns();
+
     // Log
     logger(LOG_I, "flower_train", "Training started");
 
@@ -189,9 +1223,31 @@ void flower_train(flower_s *flower, uint8_t loss_type, optimizer_s *optimizer, m
         // Log epoch number
         logger(LOG_I, "flower_train", "Epoch: %u/%u", epoch_index + 1, epochs);
 
-        // Shuffle train dataset
-        shuffle_2d(inputs_train, outputs_true_train, train_length, flower->petals[0]->input_shape->length,
-                   flower->petals[flower->petals_length - 1]->output_shape->length);
+        // Shuffle train dataset (sparse labels are shuffled with a copy of the same stream to keep them with inputs)
+        rk_stream_s shuffle_stream, shuffle_stream_labels;
+        flower_stream_init(flower, &shuffle_stream, epoch_index, RK_STREAM_ID_NONE, RK_STREAM_ID_NONE);
+        shuffle_stream_labels = shuffle_stream;
+        if (!shuffle_2d(inputs_train, outputs_true_train, train_length,
+                        flower->petals[0]->input_shape->length * sizeof(float),
+                        flower->petals[flower->petals_length - 1]->output_shape->length * sizeof(float),
+                        &shuffle_stream)) {
+            flower->error_code = ERROR_MALLOC;
+            flower_train_cleanup(flower, output_temp, validation_indices);
+            return;
+        }
+        if (outputs_true_train_sparse)
+            shuffle_labels(outputs_true_train_sparse, train_length, &shuffle_stream_labels);
+
+        uint64_t time_epoch_start = timer_get_ns();
+        callback_data.epoch_index = epoch_index;
+
+        // Epoch's stats for scheduler, early stopping and callbacks
+        float accuracy_train_epoch_avg = 0.f;
+        float loss_train_epoch_avg = 0.f;
+        uint32_t batches_trained = 0U;
+        uint32_t samples_trained_epoch = 0U;
+        uint64_t time_batch_epoch = 0U, time_forward_epoch = 0U, time_backward_epoch = 0U;
+        uint64_t time_optimizer_epoch = 0U, time_validation_epoch = 0U;
 
         // Iterate each batch
         for (uint32_t batch_index = 0; batch_index < batches_per_epoch; ++batch_index) {
@@ -205,23 +1261,50 @@ void flower_train(flower_s *flower, uint8_t loss_type, optimizer_s *optimizer, m
 
             // Variables to store accuracy and losses
             float accuracy_train_batch_avg = 0.f;
-            float accuracy_validation_avg = 0.f;
             float loss_train_batch_avg = 0.f;
-            float loss_validation_avg = 0.f;
 
             // Variable to check for error
             uint8_t error_temp;
 
+            // Timings of this batch (in nanoseconds)
+            uint64_t time_batch_start = timer_get_ns();
+            uint64_t time_forward = 0U, time_backward = 0U, time_optimizer = 0U, time_temp;
+
             // --------------------------- //
             // -----  TRAINING STAGE ----- //
             // --------------------------- //
+            // Statistics of mini-batch for batch normalization (dropout masks of each sample must be the same in
+            // each pass, so without flower->rng_streams they are bound to streams seeded once per batch)
+            uint64_t streams_seed = flower->rng_seed;
+            if (batch_norm) {
+                if (!flower->rng_streams)
+                    streams_seed = ((uint64_t) rk_random_() << 32U) | (uint64_t) rk_random_();
+                time_temp = timer_get_ns();
+                error_temp = flower_batch_norm_prepare(flower, inputs_train, outputs_true_train,
+                                                       outputs_true_train_sparse, sample_index_from, sample_index_to,
+                                                       output_temp, streams_seed, epoch_index);
+                time_forward += timer_get_ns() - time_temp;
+                if (error_temp != ERROR_NONE) {
+                    flower->error_code = error_temp;
+                    flower_train_cleanup(flower, output_temp, validation_indices);
+                    return;
+                }
+            }
+
             for (uint32_t sample_index = sample_index_from; sample_index < sample_index_to; ++sample_index) {
+                // Bind dropout of each petal to its own stream, so masks don't depend on the order of samples
+                if (flower->rng_streams || batch_norm)
+                    flower_bind_streams(flower, streams_seed, epoch_index, sample_index);
+
                 // ----- FORWARD PROPAGATION ----- //
+                time_temp = timer_get_ns();
                 float *predicted = flower_forward(flower, inputs_train[sample_index], true);
 
                 // Check for error
-                if (!predicted)
+                if (!predicted) {
+                    flower_train_cleanup(flower, output_temp, validation_indices);
                     return;
+                }
 
                 // Use temp output array in case of sparse labels
                 if (outputs_true_train_sparse) {
@@ -243,9 +1326,12 @@ void flower_train(flower_s *flower, uint8_t loss_type, optimizer_s *optimizer, m
                 if (error_temp != ERROR_NONE) {
                     logger(LOG_E, "flower_train", "Error calculating _loss: %s", error_to_str[error_temp]);
                     flower->error_code = error_temp;
+                    flower_train_cleanup(flower, output_temp, validation_indices);
                     return;
                 }
 
+                time_forward += timer_get_ns() - time_temp;
+
                 // Add to sum to calculate mean
                 loss_train_batch_avg += flower->_loss->loss[0];
 
@@ -260,115 +1346,238 @@ void flower_train(flower_s *flower, uint8_t loss_type, optimizer_s *optimizer, m
                         flower->petals[flower->petals_length - 1]->output_shape->length, 0.5f);
 
                 // ----- BACKWARD PROPAGATION ----- //
+                time_temp = timer_get_ns();
                 loss_backward(flower->_loss, flower->petals[flower->petals_length - 1]->output_shape->length);
 
                 // Backpropagate petals
-                for (int32_t petal_i = flower->petals_length - 1; petal_i >= 0; --petal_i) {
-                    // Backpropagate and calculate gradients
-                    if (petal_i == flower->petals_length - 1)
-                        petal_backward(flower->petals[petal_i], flower->_loss->loss,
-                                       flower->petals[petal_i - 1]->output);
-                    else if (petal_i == 0)
-                        petal_backward(flower->petals[petal_i], flower->petals[petal_i + 1]->error_on_input,
-                                       inputs_train[sample_index]);
-                    else
-                        petal_backward(flower->petals[petal_i], flower->petals[petal_i + 1]->error_on_input,
-                                       flower->petals[petal_i - 1]->output);
-
-                    // Check for error
-                    if (flower->petals[petal_i]->error_code != ERROR_NONE) {
-                        logger(LOG_E, "flower_train", "Error during backpropagation: %s",
-                               error_to_str[flower->petals[petal_i]->error_code]);
-                        flower->error_code = flower->petals[petal_i]->error_code;
-                        return;
-                    }
+                if (!flower_backward(flower, inputs_train[sample_index], flower->_loss->loss, 0U)) {
+                    flower_train_cleanup(flower, output_temp, validation_indices);
+                    return;
                 }
+                time_backward += timer_get_ns() - time_temp;
             }
 
             // Calculate mean stats
             loss_train_batch_avg /= (float) (sample_index_to - sample_index_from);
             accuracy_train_batch_avg /= (float) (sample_index_to - sample_index_from);
+            accuracy_train_epoch_avg += accuracy_train_batch_avg;
+            loss_train_epoch_avg += loss_train_batch_avg;
+            batches_trained++;
 
             // --------------------------- //
             // -----  WEIGHTS UPDATE ----- //
             // --------------------------- //
+            optimizer_step.learning_rate =
+                scheduler_get_learning_rate(optimizer->scheduler, optimizer->learning_rate,
+                                            (uint64_t) epoch_index * batches_per_epoch + batch_index, steps_total);
+            time_temp = timer_get_ns();
             for (uint32_t petal_i = 0; petal_i < flower->petals_length; ++petal_i) {
-                error_temp = weights_update(flower->petals[petal_i]->weights, optimizer);
+                PROFILE_START(time_petal_update);
+                error_temp = weights_update(flower->petals[petal_i]->weights, &optimizer_step);
                 if (error_temp == ERROR_NONE)
-                    error_temp = weights_update(flower->petals[petal_i]->bias_weights, optimizer);
+                    error_temp = weights_update(flower->petals[petal_i]->bias_weights, &optimizer_step);
+                PROFILE_STOP(flower->petals[petal_i]->_profile, time_update, time_petal_update);
+                PROFILE_ADD(flower->petals[petal_i]->_profile, calls_update, 1U);
                 if (error_temp != ERROR_NONE) {
                     logger(LOG_E, "flower_train", "Error updating weights: %s", error_to_str[error_temp]);
                     flower->error_code = error_temp;
+                    flower_train_cleanup(flower, output_temp, validation_indices);
                     return;
                 }
             }
+            time_optimizer = timer_get_ns() - time_temp;
+            uint64_t time_batch = timer_get_ns() - time_batch_start;
 
             // ----------------------------- //
             // -----  VALIDATION STAGE ----- //
             // ----------------------------- //
-            if (validation_length > 0) {
-                for (uint32_t sample_index = 0; sample_index < validation_length; ++sample_index) {
-                    // Forward propagation
-                    float *predicted = flower_forward(flower, inputs_validation[sample_index], false);
-
-                    // Check for error
-                    if (!predicted)
-                        return;
-
-                    // Use temp output array in case of sparse labels
-                    if (outputs_true_validation_sparse) {
-                        // Convert into output data
-                        labels_to_petal_output(outputs_true_validation_sparse[sample_index], output_temp,
-                                               flower->petals[flower->petals_length - 1]->output_shape->length, 0.f,
-                                               1.f);
-
-                        // Calculate _loss using sparse labeling
-                        error_temp = loss_forward(flower->_loss, predicted, output_temp,
-                                                  flower->petals[flower->petals_length - 1]->output_shape->length);
-                    }
+            // Validate each validation_interval batches and at the end of each epoch
+            if (validation_length > 0 &&
+                ((batch_index + 1U) % validation_interval == 0U || batch_index == batches_per_epoch - 1U)) {
+                time_temp = timer_get_ns();
 
-                    // Calculate _loss using array labeling
-                    else
-                        error_temp = loss_forward(flower->_loss, predicted, outputs_true_validation[sample_index],
-                                                  flower->petals[flower->petals_length - 1]->output_shape->length);
-
-                    // Check _loss calculation error
-                    if (error_temp != ERROR_NONE) {
-                        logger(LOG_E, "flower_train", "Error calculating _loss during validation: %s",
-                               error_to_str[error_temp]);
-                        flower->error_code = error_temp;
-                        return;
+                // Randomly pick subset of validation dataset (partial Fisher-Yates shuffle)
+                if (validation_indices) {
+                    rk_stream_s validation_stream;
+                    flower_stream_init(flower, &validation_stream, epoch_index, batch_index, RK_STREAM_ID_NONE);
+                    for (uint32_t i = 0; i < validation_subset_length; ++i) {
+                        uint32_t swap_index = i + rk_stream_bounded(&validation_stream, validation_length - i);
+                        uint32_t index_temp = validation_indices[i];
+                        validation_indices[i] = validation_indices[swap_index];
+                        validation_indices[swap_index] = index_temp;
                     }
+                }
 
-                    // Add to sum to calculate mean
-                    loss_validation_avg += flower->_loss->loss[0];
-
-                    // Calculate accuracy and add to sum to calculate mean
-                    if (outputs_true_validation_sparse)
-                        accuracy_validation_avg += metrics_calculate_accuracy(
-                            metrics, predicted, output_temp,
-                            flower->petals[flower->petals_length - 1]->output_shape->length, 0.5f);
-                    else
-                        accuracy_validation_avg += metrics_calculate_accuracy(
-                            metrics, predicted, outputs_true_validation[sample_index],
-                            flower->petals[flower->petals_length - 1]->output_shape->length, 0.5f);
+                error_temp = flower_validate(flower, metrics, inputs_validation, outputs_true_validation,
+                                             outputs_true_validation_sparse, validation_indices,
+                                             validation_subset_length, output_temp, &loss_validation_avg,
+                                             &accuracy_validation_avg);
+                if (error_temp != ERROR_NONE) {
+                    flower->error_code = error_temp;
+                    flower_train_cleanup(flower, output_temp, validation_indices);
+                    return;
                 }
 
-                // Calculate mean stats
-                loss_validation_avg /= (float) validation_length;
-                accuracy_validation_avg /= (float) validation_length;
+                time_temp = timer_get_ns() - time_temp;
+                time_validation_epoch += time_temp;
+
+                callback_data.samples_validation = validation_subset_length;
+                callback_data.loss_validation = loss_validation_avg;
+                callback_data.accuracy_validation = accuracy_validation_avg;
+                callback_data.time_validation = timer_ns_to_s(time_temp);
+                callback_data.time_epoch = timer_ns_to_s(timer_get_ns() - time_epoch_start);
+                callback_data.time_training = timer_ns_to_s(timer_get_ns() - time_training_start);
+                flower_callbacks_call(flower, metrics, CALLBACK_ON_VALIDATION, &callback_data);
             }
 
-            // -------------------- //
-            // -----  METRICS ----- //
-            // -------------------- //
-            metrics_calculate_batch(metrics, epoch_index, epochs, batch_index, batches_per_epoch, loss_train_batch_avg,
-                                    loss_validation_avg, accuracy_train_batch_avg, accuracy_validation_avg);
+            // ---------------------- //
+            // -----  CALLBACKS ----- //
+            // ---------------------- //
+            callback_data.batch_index = batch_index;
+            callback_data.samples_batch = sample_index_to - sample_index_from;
+            callback_data.samples_trained += sample_index_to - sample_index_from;
+            callback_data.loss_train = loss_train_batch_avg;
+            callback_data.accuracy_train = accuracy_train_batch_avg;
+            callback_data.learning_rate = optimizer_step.learning_rate;
+            callback_data.time_batch = timer_ns_to_s(time_batch);
+            callback_data.time_forward = timer_ns_to_s(time_forward);
+            callback_data.time_backward = timer_ns_to_s(time_backward);
+            callback_data.time_optimizer = timer_ns_to_s(time_optimizer);
+            callback_data.samples_per_second =
+                time_batch > 0U ? (float) callback_data.samples_batch / (float) callback_data.time_batch : 0.f;
+            callback_data.time_epoch = timer_ns_to_s(timer_get_ns() - time_epoch_start);
+            callback_data.time_training = timer_ns_to_s(timer_get_ns() - time_training_start);
+            flower_callbacks_call(flower, metrics, CALLBACK_ON_BATCH_END, &callback_data);
+
+            // Add to epoch's stats
+            samples_trained_epoch += callback_data.samples_batch;
+            time_batch_epoch += time_batch;
+            time_forward_epoch += time_forward;
+            time_backward_epoch += time_backward;
+            time_optimizer_epoch += time_optimizer;
 
             // End of batch
         }
+
+        // Update scheduler using validation loss (or training loss if there is no validation dataset)
+        if (batches_trained > 0U) {
+            accuracy_train_epoch_avg /= (float) batches_trained;
+            loss_train_epoch_avg /= (float) batches_trained;
+        }
+        scheduler_epoch_end(optimizer->scheduler,
+                            validation_length > 0 ? loss_validation_avg : loss_train_epoch_avg);
+
+        // Call callbacks with epoch's average training stats
+        callback_data.loss_train = loss_train_epoch_avg;
+        callback_data.accuracy_train = accuracy_train_epoch_avg;
+        callback_data.time_batch = timer_ns_to_s(time_batch_epoch);
+        callback_data.time_forward = timer_ns_to_s(time_forward_epoch);
+        callback_data.time_backward = timer_ns_to_s(time_backward_epoch);
+        callback_data.time_optimizer = timer_ns_to_s(time_optimizer_epoch);
+        callback_data.time_validation = timer_ns_to_s(time_validation_epoch);
+        callback_data.samples_per_second =
+            time_batch_epoch > 0U ? (float) samples_trained_epoch / (float) callback_data.time_batch : 0.f;
+        callback_data.time_epoch = timer_ns_to_s(timer_get_ns() - time_epoch_start);
+        callback_data.time_training = timer_ns_to_s(timer_get_ns() - time_training_start);
+        flower_callbacks_call(flower, metrics, CALLBACK_ON_EPOCH_END, &callback_data);
+
+        // Check early stopping (use training stats instead of validation if there is no validation dataset)
+        bool stop = false;
+        uint8_t error_temp = early_stopping_epoch_end(
+            flower->early_stopping, flower->petals, flower->petals_length, epoch_index, loss_train_epoch_avg,
+            accuracy_train_epoch_avg, validation_length > 0 ? loss_validation_avg : loss_train_epoch_avg,
+            validation_length > 0 ? accuracy_validation_avg : accuracy_train_epoch_avg, &stop);
+        if (error_temp != ERROR_NONE) {
+            flower->error_code = error_temp;
+            flower_train_cleanup(flower, output_temp, validation_indices);
+            return;
+        }
+        if (stop) {
+            logger(LOG_I, "flower_train", "Early stopping after epoch %u/%u", epoch_index + 1, epochs);
+            break;
+        }
+
         // End of epoch
     }
+
+    // Restore best weights
+    early_stopping_restore(flower->early_stopping, flower->petals, flower->petals_length);
+
+    // Clean up and use rk_state_global for dropout outside of flower_train()
+    flower_train_cleanup(flower, output_temp, validation_indices);
+}
+
+/**
+ * @brief Resets accumulated profiling stats of each petal (does nothing without PROFILING definition)
+ *
+ * @param flower pointer to flower_s struct
+ */
+void flower_profile_reset(flower_s *flower) {
+#ifdef PROFILING
+    for (uint32_t i = 0; i < flower->petals_length; ++i)
+        flower->petals[i]->_profile = (profile_s){0};
+#else
+    (void) flower;
+#endif
+}
+
+/**
+ * @brief Prints accumulated per-petal profiling stats
+ * NOTE: stats are collected only if library is compiled with PROFILING definition (-DPROFILING=ON). Otherwise only
+ * "Profiling is disabled" line (or {"profiling": false} JSON) is printed
+ *
+ * @param flower pointer to flower_s struct
+ * @param stream output stream (ex. stdout or opened file)
+ * @param format PROFILE_REPORT_TABLE for human-readable table or PROFILE_REPORT_JSON for JSON
+ */
+void flower_profile_report(flower_s *flower, FILE *stream, uint8_t format) {
+#ifndef PROFILING
+    logger(LOG_W, "flower_profile_report", "Compiled without PROFILING definition");
+    (void) flower;
+    if (format == PROFILE_REPORT_JSON)
+        fprintf(stream, "{\"profiling\": false}\n");
+    else
+        fprintf(stream, "Profiling is disabled (compile with PROFILING definition)\n");
+#else
+    // Calculate total time to find hot petals
+    uint64_t time_total = 0U;
+    for (uint32_t i = 0; i < flower->petals_length; ++i)
+        time_total += flower->petals[i]->_profile.time_forward + flower->petals[i]->_profile.time_backward +
+                      flower->petals[i]->_profile.time_update;
+
+    // JSON
+    if (format == PROFILE_REPORT_JSON) {
+        fprintf(stream, "{\"profiling\": true, \"petals\": [");
+        for (uint32_t i = 0; i < flower->petals_length; ++i) {
+            profile_s *profile = &flower->petals[i]->_profile;
+            fprintf(stream,
+                    "%s\n  {\"index\": %u, \"type\": %u, \"calls_forward\": %lu, \"calls_backward\": %lu, "
+                    "\"calls_update\": %lu, \"time_forward_ns\": %lu, \"time_backward_ns\": %lu, "
+                    "\"time_activation_ns\": %lu, \"time_update_ns\": %lu, \"flops\": %lu, \"bytes\": %lu}",
+                    i > 0 ? "," : "", i, flower->petals[i]->petal_type, (unsigned long) profile->calls_forward,
+                    (unsigned long) profile->calls_backward, (unsigned long) profile->calls_update,
+                    (unsigned long) profile->time_forward, (unsigned long) profile->time_backward,
+                    (unsigned long) profile->time_activation, (unsigned long) profile->time_update,
+                    (unsigned long) profile->flops, (unsigned long) profile->bytes);
+        }
+        fprintf(stream, "\n], \"time_total_ns\": %lu}\n", (unsigned long) time_total);
+        return;
+    }
+
+    // Table
+    fprintf(stream, "%5s | %4s | %10s | %10s | %10s | %10s | %10s | %10s | %10s | %6s\n", "Petal", "Type", "Fwd calls",
+            "Fwd ms", "Bwd ms", "Act ms", "Upd ms", "GFLOP", "MB", "Time %");
+    for (uint32_t i = 0; i < flower->petals_length; ++i) {
+        profile_s *profile = &flower->petals[i]->_profile;
+        uint64_t time_petal = profile->time_forward + profile->time_backward + profile->time_update;
+        fprintf(stream, "%5u | %4u | %10lu | %10.3f | %10.3f | %10.3f | %10.3f | %10.4f | %10.3f | %6.2f\n", i,
+                flower->petals[i]->petal_type, (unsigned long) profile->calls_forward,
+                (double) profile->time_forward / 1e6, (double) profile->time_backward / 1e6,
+                (double) profile->time_activation / 1e6, (double) profile->time_update / 1e6,
+                (double) profile->flops / 1e9, (double) profile->bytes / 1e6,
+                time_total > 0U ? 100. * (double) time_petal / (double) time_total : 0.);
+    }
+#endif
 }
 
 /**
@@ -387,6 +1596,24 @@ size_t flower_estimate_min_size(flower_s *flower) {
         for (uint32_t i = 0; i < flower->petals_length; ++i)
             min_size += petal_estimate_min_size(flower->petals[i]);
 
+        // Graph and it's schedule
+        min_size += flower->petals_length * (2U * sizeof(uint32_t) + 6U * sizeof(void *) + sizeof(uint32_t));
+        if (flower->_nodes_owned)
+            min_size += flower->petals_length * (sizeof(flower_node_s) + sizeof(uint32_t));
+        for (uint32_t i = 0; flower->_merged && i < flower->petals_length; ++i)
+            if (flower->_merged[i])
+                min_size += flower->petals[i]->input_shape->length * sizeof(float);
+        for (uint32_t i = 0; flower->_buffers && i < flower->_buffers_length; ++i)
+            min_size += flower->_buffers_lengths[i] * sizeof(float);
+
+        // Inference buffers (only allocated ones, others are own outputs of petals)
+        if (flower->_pool_lengths)
+            min_size += 2U * flower->petals_length * sizeof(uint32_t);
+        min_size += flower->_pool_length * (sizeof(float *) + sizeof(bool));
+        for (uint32_t i = 0; flower->_pool_allocated && i < flower->_pool_length; ++i)
+            if (flower->_pool_allocated[i])
+                min_size += flower->_pool_lengths[i] * sizeof(float);
+
         // _loss
         if (flower->petals_length > 0)
             min_size +=
@@ -409,6 +1636,12 @@ void flower_destroy(flower_s *flower, bool destroy_petals, bool destroy_weights_
     if (destroy_petals)
         for (uint32_t i = 0; i < flower->petals_length; ++i)
             petal_destroy(flower->petals[i], true, destroy_weights_array, destroy_bias_weights_array);
+    early_stopping_destroy(flower->early_stopping);
     loss_destroy(flower->_loss);
+    flower_schedule_destroy(flower);
+    if (flower->_nodes_owned) {
+        free(flower->_nodes);
+        free(flower->_chain_inputs);
+    }
     free(flower);
 }
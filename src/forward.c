@@ -20,13 +20,148 @@
  * You should have received a copy of the GNU Affero General Public License
  * long with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
+#include "attention.h"
+#include "conv.h"
 #include "dropout.h"
+#include "embedding.h"
 #include "errors.h"
+#include "gemm.h"
 #include "logger.h"
+#include "norm.h"
 #include "petal.h"
+#include "pool.h"
+#include "profile.h"
+#include "rnn.h"
+#include "sparse.h"
+
+/**
+ * @brief Calculates outputs of 1D dense petal from output_from to output_to as gemv() of rows of weights
+ *
+ * @param petal pointer to petal struct
+ * @param input pointer to 1D array of input data
+ * @param output_from index of first output to calculate
+ * @param output_to index of last output to calculate + 1
+ */
+static inline void dense_1d_forward_rows(petal_s *petal, float *input, uint32_t output_from, uint32_t output_to) {
+    // Dot with weights
+    if (petal->weights && petal->weights->weights)
+        gemv(false, output_to - output_from, petal->input_shape->length, 1.f,
+             petal->weights->weights + (size_t) output_from * petal->input_shape->length, input, 0.f,
+             petal->output + output_from);
+
+    // Sums without weights
+    else {
+        float sum = 0.f;
+        for (uint32_t input_i = 0; input_i < petal->input_shape->length; ++input_i)
+            sum += input[input_i];
+        for (uint32_t output_i = output_from; output_i < output_to; ++output_i)
+            petal->output[output_i] = sum;
+    }
+
+    // Add bias weights
+    if (petal->bias_weights && petal->bias_weights->weights)
+        for (uint32_t output_i = output_from; output_i < output_to; ++output_i)
+            petal->output[output_i] += petal->bias_weights->weights[output_i];
+}
+
+/**
+ * @brief Calculates one output of 1D dense petal from sparse input (only non-zero inputs are multiplied)
+ *
+ * @param petal pointer to petal struct
+ * @param input pointer to sparse_s struct with indices and values of non-zero inputs
+ * @param output_i index of output to calculate
+ */
+static inline void dense_1d_forward_row_sparse(petal_s *petal, const sparse_s *input, uint32_t output_i) {
+    float output = 0.f;
+
+    // Gather weights of non-zero inputs
+    if (petal->weights && petal->weights->weights) {
+        const float *weights_row = petal->weights->weights + (size_t) output_i * petal->input_shape->length;
+        for (uint32_t nonzero_i = 0; nonzero_i < input->length; ++nonzero_i)
+            output += weights_row[input->indices[nonzero_i]] * input->values[nonzero_i];
+    }
+
+    // Sums without weights
+    else
+        for (uint32_t nonzero_i = 0; nonzero_i < input->length; ++nonzero_i)
+            output += input->values[nonzero_i];
+
+    // Add bias weights
+    if (petal->bias_weights && petal->bias_weights->weights)
+        output += petal->bias_weights->weights[output_i];
+
+    petal->output[output_i] = output;
+}
+
+/**
+ * @brief Generates new scaled dropout keep-mask if needed (it's applied with a single multiplication after
+ * activation)
+ *
+ * @param petal pointer to petal struct
+ * @param training true for training (to apply dropouts) or false for inference mode
+ * @param dropout_enabled pointer to variable to store true if keep-mask was generated
+ * @return true if no errors
+ * @return false in case of dropout error (petal->error_code is set)
+ */
+static bool petal_forward_dropout(petal_s *petal, bool training, bool *dropout_enabled) {
+    *dropout_enabled = false;
+    if (training && petal->params.dropout > 0.f && petal->bit_array && petal->_dropout_mask) {
+        uint8_t dropout_error =
+            dropout_generate_mask(petal->bit_array, petal->_dropout_mask, petal->params.dropout,
+                                  petal->params.dropout_mode, petal->_rng_stream_enabled ? &petal->_rng_stream : NULL);
+        if (dropout_error != ERROR_NONE) {
+            logger(LOG_E, "petal_forward", "Error generating dropout mask: %s", error_to_str[dropout_error]);
+            petal->error_code = dropout_error;
+            return false;
+        }
+        *dropout_enabled = true;
+    }
+    return true;
+}
+
+/**
+ * @brief Activates petal's output and applies dropout keep-mask
+ *
+ * @param petal pointer to petal struct (petal->output must contain output before activation)
+ * @param dropout_enabled true if keep-mask was generated by petal_forward_dropout()
+ */
+static void petal_forward_activate(petal_s *petal, bool dropout_enabled) {
+    // Exclude dropped outputs from softmax sum (exp(-inf) = 0), so kept probabilities don't depend on number of drops
+    if (dropout_enabled && petal->activation && petal->activation->type == ACTIVATION_SOFTMAX) {
+        bool kept_any = false;
+        for (uint32_t i = 0; i < petal->output_shape->length && !kept_any; ++i)
+            kept_any = petal->_dropout_mask[i] != 0.f;
+        for (uint32_t i = 0; i < petal->output_shape->length && kept_any; ++i)
+            if (petal->_dropout_mask[i] == 0.f)
+                petal->output[i] = -INFINITY;
+    }
+
+    // Activate output if needed
+    uint8_t activation_error = ERROR_NONE;
+    PROFILE_START(time_activation);
+    if (petal->activation)
+        activation_error = activation_forward(petal->activation, petal->output, petal->output_shape->length);
+    PROFILE_STOP(petal->_profile, time_activation, time_activation);
+
+    // Zero dropped outputs and scale kept ones
+    if (dropout_enabled)
+        dropout_apply_mask(petal->output, petal->_dropout_mask, petal->output_shape->length);
+
+    // Check errors (just in case)
+    uint8_t bit_array_error = petal->bit_array ? petal->bit_array->error_code : ERROR_NONE;
+    if (activation_error != ERROR_NONE || bit_array_error != ERROR_NONE) {
+        if (activation_error != ERROR_NONE)
+            logger(LOG_E, "petal_forward", "Activation error: %s", error_to_str[activation_error]);
+        if (bit_array_error != ERROR_NONE)
+            logger(LOG_E, "petal_forward", "Bit array error: %s", error_to_str[bit_array_error]);
+        petal->error_code = activation_error > bit_array_error ? activation_error : bit_array_error;
+    }
+}
 
 /**
  * @brief Petal forward propagation
@@ -36,32 +171,14 @@
  * @param training true for training (to apply dropouts) or false for inference mode
  */
 void petal_forward(petal_s *petal, float *input, bool training) {
-    // Calculate dropout
-    bool dropout_enabled = false;
-    if (training && petal->params.dropout > 0.f && petal->bit_array) {
-        // Clear previous dropout
-        bit_array_clear(petal->bit_array);
-
-        // Generate new dropout
-        dropout_generate_indices(petal->bit_array, petal->params.dropout);
-        if (petal->bit_array->error_code != ERROR_NONE) {
-            logger(LOG_E, "petal_forward", "Error generating dropout indices: %s",
-                   error_to_str[petal->bit_array->error_code]);
-            petal->error_code = petal->bit_array->error_code;
-            return;
-        }
-        dropout_enabled = true;
-    }
+    bool dropout_enabled;
+    if (!petal_forward_dropout(petal, training, &dropout_enabled))
+        return;
 
     // Direct (no weights, input and output are the same size)
     if (petal->petal_type == PETAL_TYPE_DIRECT) {
-        // Copy input to the output and apply dropout if needed
-        for (uint32_t i = 0; i < petal->output_shape->length; ++i) {
-            if (dropout_enabled && bit_array_get_bit(petal->bit_array, i))
-                petal->output[i] = 0.f;
-            else
-                petal->output[i] = input[i];
-        }
+        // Copy input to the output
+        memcpy(petal->output, input, petal->output_shape->length * sizeof(float));
     }
 
     // Normalizes all input data using "center" and "deviation" regardless of the number of dimensions
@@ -76,15 +193,11 @@ void petal_forward(petal_s *petal, float *input, bool training) {
                 max_value = input[i];
         }
 
-        // Normalize and apply dropout if needed
+        // Normalize
         for (uint32_t i = 0; i < petal->output_shape->length; ++i) {
-            if (dropout_enabled && bit_array_get_bit(petal->bit_array, i))
-                petal->output[i] = 0.f;
-            else {
-                petal->output[i] = ((input[i] - min_value) / (max_value - min_value + EPSILON));
-                petal->output[i] =
-                    petal->output[i] * 2.f * petal->params.deviation + petal->params.center - petal->params.deviation;
-            }
+            petal->output[i] = ((input[i] - min_value) / (max_value - min_value + EPSILON));
+            petal->output[i] =
+                petal->output[i] * 2.f * petal->params.deviation + petal->params.center - petal->params.deviation;
         }
     }
 
@@ -107,16 +220,12 @@ void petal_forward(petal_s *petal, float *input, bool training) {
                     max_value = input[index];
             }
 
-            // Normalize and apply dropout if needed
+            // Normalize
             for (uint32_t col_i = 0; col_i < petal->output_shape->cols; ++col_i) {
                 index = row_index + col_i;
-                if (dropout_enabled && bit_array_get_bit(petal->bit_array, index))
-                    petal->output[index] = 0.f;
-                else {
-                    petal->output[index] = ((input[index] - min_value) / (max_value - min_value + EPSILON));
-                    petal->output[index] = petal->output[index] * 2.f * petal->params.deviation + petal->params.center -
-                                           petal->params.deviation;
-                }
+                petal->output[index] = ((input[index] - min_value) / (max_value - min_value + EPSILON));
+                petal->output[index] = petal->output[index] * 2.f * petal->params.deviation + petal->params.center -
+                                       petal->params.deviation;
             }
         }
     }
@@ -137,50 +246,92 @@ void petal_forward(petal_s *petal, float *input, bool training) {
                     max_value = input[index];
             }
 
-            // Normalize and apply dropout if needed
+            // Normalize
             for (uint32_t i = 0; i < petal->output_shape->length; i += petal->output_shape->depth) {
                 index = channel_i + i;
-                if (dropout_enabled && bit_array_get_bit(petal->bit_array, index))
-                    petal->output[index] = 0.f;
-                else {
-                    petal->output[index] = ((input[index] - min_value) / (max_value - min_value + EPSILON));
-                    petal->output[index] = petal->output[index] * 2.f * petal->params.deviation + petal->params.center -
-                                           petal->params.deviation;
-                }
+                petal->output[index] = ((input[index] - min_value) / (max_value - min_value + EPSILON));
+                petal->output[index] = petal->output[index] * 2.f * petal->params.deviation + petal->params.center -
+                                       petal->params.deviation;
             }
         }
     }
 
     // 1D dense petal (fully-connected 1D petal with 2D weights and 1D bias weights)
     else if (petal->petal_type == PETAL_TYPE_DENSE_1D) {
-        // Calculate dot
-        uint32_t input_row;
-        for (uint32_t output_i = 0; output_i < petal->output_shape->length; ++output_i) {
-            // Reset output
-            petal->output[output_i] = 0.f;
-
-            // Row index
-            input_row = output_i * petal->input_shape->length;
-
-            // Don't calculate dot if we need to drop this output
-            if (!dropout_enabled || !bit_array_get_bit(petal->bit_array, output_i)) {
-                // Dot with weights
-                if (petal->weights && petal->weights->weights)
-                    for (uint32_t input_i = 0; input_i < petal->input_shape->length; ++input_i)
-                        petal->output[output_i] += petal->weights->weights[input_row + input_i] * input[input_i];
-
-                // Sums without weights
-                else
-                    for (uint32_t input_i = 0; input_i < petal->input_shape->length; ++input_i)
-                        petal->output[output_i] += input[input_i];
-
-                // Add bias weights
-                if (petal->bias_weights && petal->bias_weights->weights)
-                    petal->output[output_i] += petal->bias_weights->weights[output_i];
+        // Calculate dot only for kept outputs (dropped outputs are zeros and will be zeroed by keep-mask anyway)
+        if (dropout_enabled) {
+            memset(petal->output, 0, petal->output_shape->length * sizeof(float));
+            BIT_ARRAY_FOR_EACH_CLEAR(petal->bit_array, output_i) {
+                dense_1d_forward_rows(petal, input, output_i, output_i + 1U);
             }
         }
+
+        // Calculate all outputs with a single gemv()
+        else
+            dense_1d_forward_rows(petal, input, 0U, petal->output_shape->length);
+    }
+
+    // 2D convolution (one kernel per output channel) using algorithm selected during petal_init()
+    else if (petal->petal_type == PETAL_TYPE_CONV_2D) {
+        uint32_t positions = petal->output_shape->rows * petal->output_shape->cols;
+        uint32_t filters = petal->output_shape->depth;
+
+        // im2col + GEMM
+        if (petal->_conv_algorithm == CONV_ALGORITHM_IM2COL) {
+            conv_im2col(petal, input, petal->_columns);
+            gemm(false, true, positions, filters, petal_conv_2d_kernel_length(petal), 1.f, petal->_columns,
+                 petal->weights->weights, 0.f, petal->output);
+        }
+
+        // Direct or Winograd
+        else {
+            memset(petal->output, 0, petal->output_shape->length * sizeof(float));
+            if (petal->_conv_algorithm == CONV_ALGORITHM_WINOGRAD)
+                conv_winograd_forward(petal, input);
+            else
+                conv_direct_forward(petal, input);
+        }
+
+        // Add bias weights
+        if (petal->bias_weights && petal->bias_weights->weights)
+            for (uint32_t position = 0; position < positions; ++position)
+                for (uint32_t filter = 0; filter < filters; ++filter)
+                    petal->output[position * filters + filter] += petal->bias_weights->weights[filter];
     }
 
+    // 2D max-pooling (argmax of each output is recorded only during training for backpropagation)
+    else if (petal->petal_type == PETAL_TYPE_MAX_POOL_2D)
+        pool_max_forward(petal, input, training ? petal->_pool_indices : NULL);
+
+    // 2D average pooling
+    else if (petal->petal_type == PETAL_TYPE_AVG_POOL_2D)
+        pool_avg_forward(petal, input);
+
+    // Batch normalization with scale and shift
+    else if (petal->petal_type == PETAL_TYPE_BATCH_NORM)
+        batch_norm_forward(petal, input, training);
+
+    // Layer normalization of each row with scale and shift
+    else if (petal->petal_type == PETAL_TYPE_LAYER_NORM)
+        layer_norm_forward(petal, input, training);
+
+    // Embedding lookup
+    else if (petal->petal_type == PETAL_TYPE_EMBEDDING) {
+        uint8_t error_temp = embedding_forward(petal, input);
+        if (error_temp != ERROR_NONE) {
+            petal->error_code = error_temp;
+            return;
+        }
+    }
+
+    // LSTM or GRU over timesteps (rows)
+    else if (petal->petal_type == PETAL_TYPE_LSTM || petal->petal_type == PETAL_TYPE_GRU)
+        rnn_forward(petal, input);
+
+    // Multi-head self-attention over rows
+    else if (petal->petal_type == PETAL_TYPE_ATTENTION)
+        attention_forward(petal, input);
+
     // Wrong type
     else {
         logger(LOG_E, "petal_forward", "Wrong petal type: %u", petal->petal_type);
@@ -188,27 +339,50 @@ void petal_forward(petal_s *petal, float *input, bool training) {
         return;
     }
 
-    // Activate output if needed
-    uint8_t activation_error = ERROR_NONE;
-    if (petal->activation)
-        activation_error =
-            activation_forward(petal->activation, petal->output, petal->output_shape->length, petal->bit_array);
+    petal_forward_activate(petal, dropout_enabled);
+}
 
-    // Normalize sum after activation if dropout is enabled
-    if (dropout_enabled) {
-        float dropout_scaling = 1.f / (1.f - petal->params.dropout + EPSILON);
-        for (uint32_t i = 0; i < petal->output_shape->length; ++i)
-            if (petal->output[i] != 0.f)
-                petal->output[i] *= dropout_scaling;
+/**
+ * @brief Petal forward propagation of sparse input (only for PETAL_TYPE_DENSE_1D). Only non-zero inputs are
+ * multiplied, so cost scales with number of them instead of petal->input_shape->length
+ *
+ * @param petal pointer to petal struct
+ * @param input pointer to sparse_s struct with indices (less than petal->input_shape->length) and values of non-zero
+ * inputs
+ * @param training true for training (to apply dropouts) or false for inference mode
+ */
+void petal_forward_sparse(petal_s *petal, const sparse_s *input, bool training) {
+    if (petal->petal_type != PETAL_TYPE_DENSE_1D) {
+        logger(LOG_E, "petal_forward_sparse", "Sparse input is supported only by PETAL_TYPE_DENSE_1D");
+        petal->error_code = ERROR_PETAL_WRONG_TYPE;
+        return;
     }
 
-    // Check errors (just in case)
-    uint8_t bit_array_error = petal->bit_array ? petal->bit_array->error_code : ERROR_NONE;
-    if (activation_error != ERROR_NONE || bit_array_error != ERROR_NONE) {
-        if (activation_error != ERROR_NONE)
-            logger(LOG_E, "petal_forward", "Activation error: %s", error_to_str[activation_error]);
-        if (bit_array_error != ERROR_NONE)
-            logger(LOG_E, "petal_forward", "Bit array error: %s", error_to_str[bit_array_error]);
-        petal->error_code = activation_error > bit_array_error ? activation_error : bit_array_error;
+    // Check indices once, so rows can be gathered without checks
+    for (uint32_t nonzero_i = 0; nonzero_i < input->length; ++nonzero_i)
+        if (input->indices[nonzero_i] >= petal->input_shape->length) {
+            logger(LOG_E, "petal_forward_sparse", "Index %u is out of bounds for input with size %u",
+                   input->indices[nonzero_i], petal->input_shape->length);
+            petal->error_code = ERROR_PETAL_WRONG_INDEX;
+            return;
+        }
+
+    bool dropout_enabled;
+    if (!petal_forward_dropout(petal, training, &dropout_enabled))
+        return;
+
+    // Calculate dot only for kept outputs (dropped outputs are zeros and will be zeroed by keep-mask anyway)
+    if (dropout_enabled) {
+        memset(petal->output, 0, petal->output_shape->length * sizeof(float));
+        BIT_ARRAY_FOR_EACH_CLEAR(petal->bit_array, output_i) {
+            dense_1d_forward_row_sparse(petal, input, output_i);
+        }
     }
+
+    // Calculate dot for each output
+    else
+        for (uint32_t output_i = 0; output_i < petal->output_shape->length; ++output_i)
+            dense_1d_forward_row_sparse(petal, input, output_i);
+
+    petal_forward_activate(petal, dropout_enabled);
 }
@@ -0,0 +1,154 @@
+/**
+ * @file gemm.c
+ * @author Fern Lane
+ * @brief Blocked single-precision matrix multiplication and matrix-vector product (used by dense, convolution and
+ * attention petals)
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gemm.h"
+
+/**
+ * @brief Calculates C = alpha * op(A) * op(B) + beta * C (all matrices are dense and row-major)
+ * op(B) is packed into contiguous blocks, so inner loop is always a vectorizable multiply-add over rows of C
+ * Rows of C are calculated in parallel if compiled with OpenMP
+ *
+ * @param transpose_a false if A is m x k matrix or true if A is k x m matrix
+ * @param transpose_b false if B is k x n matrix or true if B is n x k matrix
+ * @param m number of rows of op(A) and C
+ * @param n number of columns of op(B) and C
+ * @param k number of columns of op(A) and rows of op(B)
+ * @param alpha factor of op(A) * op(B)
+ * @param a pointer to matrix A
+ * @param b pointer to matrix B
+ * @param beta factor of C (0 to overwrite C without reading it)
+ * @param c pointer to m x n matrix C
+ */
+void gemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, float alpha, const float *a,
+          const float *b, float beta, float *c) {
+    // Scale C (don't read it in case of beta = 0 to not propagate NaNs from uninitialized memory)
+    if (beta == 0.f) {
+        for (uint64_t i = 0; i < (uint64_t) m * n; ++i)
+            c[i] = 0.f;
+    } else if (beta != 1.f) {
+        for (uint64_t i = 0; i < (uint64_t) m * n; ++i)
+            c[i] *= beta;
+    }
+
+    float b_block[GEMM_BLOCK_K * GEMM_BLOCK_N];
+    for (uint32_t k_from = 0; k_from < k; k_from += GEMM_BLOCK_K) {
+        uint32_t k_block = k - k_from < GEMM_BLOCK_K ? k - k_from : GEMM_BLOCK_K;
+        for (uint32_t n_from = 0; n_from < n; n_from += GEMM_BLOCK_N) {
+            uint32_t n_block = n - n_from < GEMM_BLOCK_N ? n - n_from : GEMM_BLOCK_N;
+
+            // Pack block of op(B) into k_block x n_block row-major matrix
+            for (uint32_t k_i = 0; k_i < k_block; ++k_i)
+                for (uint32_t n_i = 0; n_i < n_block; ++n_i)
+                    b_block[k_i * n_block + n_i] = transpose_b ? b[(uint64_t) (n_from + n_i) * k + k_from + k_i]
+                                                               : b[(uint64_t) (k_from + k_i) * n + n_from + n_i];
+
+            // Multiply-add each row of op(A) block with packed op(B) block
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+            for (int64_t m_i = 0; m_i < (int64_t) m; ++m_i) {
+                float *c_row = c + (uint64_t) m_i * n + n_from;
+                for (uint32_t k_i = 0; k_i < k_block; ++k_i) {
+                    float a_value = transpose_a ? a[(uint64_t) (k_from + k_i) * m + m_i]
+                                                : a[(uint64_t) m_i * k + k_from + k_i];
+                    a_value *= alpha;
+                    if (a_value == 0.f)
+                        continue;
+                    const float *b_row = b_block + k_i * n_block;
+                    for (uint32_t n_i = 0; n_i < n_block; ++n_i)
+                        c_row[n_i] += a_value * b_row[n_i];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Calculates y = alpha * op(A) * x + beta * y (A is dense row-major m x n matrix)
+ * Each dot product of A * x is summed in GEMV_LANES independent partial sums, so it can be vectorized. A^T * x is
+ * calculated as multiply-adds of rows of A (zero elements of x are skipped) in blocks of GEMM_BLOCK_N columns
+ * Rows of A * x and column blocks of A^T * x are calculated in parallel if compiled with OpenMP
+ *
+ * @param transpose_a false to multiply by A (x has n elements, y has m) or true to multiply by A^T (x has m elements,
+ * y has n)
+ * @param m number of rows of A
+ * @param n number of columns of A
+ * @param alpha factor of op(A) * x
+ * @param a pointer to matrix A
+ * @param x pointer to vector x
+ * @param beta factor of y (0 to overwrite y without reading it)
+ * @param y pointer to vector y
+ */
+void gemv(bool transpose_a, uint32_t m, uint32_t n, float alpha, const float *a, const float *x, float beta,
+          float *y) {
+    // y = alpha * A * x + beta * y
+    if (!transpose_a) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (m >= GEMM_BLOCK_K)
+#endif
+        for (int64_t m_i = 0; m_i < (int64_t) m; ++m_i) {
+            const float *a_row = a + (uint64_t) m_i * n;
+            float sums[GEMV_LANES] = {0.f};
+            uint32_t n_i = 0;
+            for (; n_i + GEMV_LANES <= n; n_i += GEMV_LANES)
+                for (uint32_t lane = 0; lane < GEMV_LANES; ++lane)
+                    sums[lane] += a_row[n_i + lane] * x[n_i + lane];
+            for (; n_i < n; ++n_i)
+                sums[0] += a_row[n_i] * x[n_i];
+            float sum = 0.f;
+            for (uint32_t lane = 0; lane < GEMV_LANES; ++lane)
+                sum += sums[lane];
+            y[m_i] = alpha * sum + (beta == 0.f ? 0.f : beta * y[m_i]);
+        }
+        return;
+    }
+
+    // y = alpha * A^T * x + beta * y (don't read y in case of beta = 0)
+    if (beta == 0.f) {
+        for (uint32_t n_i = 0; n_i < n; ++n_i)
+            y[n_i] = 0.f;
+    } else if (beta != 1.f) {
+        for (uint32_t n_i = 0; n_i < n; ++n_i)
+            y[n_i] *= beta;
+    }
+    int64_t blocks = (int64_t) ((n + GEMM_BLOCK_N - 1U) / GEMM_BLOCK_N);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (blocks > 1)
+#endif
+    for (int64_t block = 0; block < blocks; ++block) {
+        uint32_t n_from = (uint32_t) block * GEMM_BLOCK_N;
+        uint32_t n_block = n - n_from < GEMM_BLOCK_N ? n - n_from : GEMM_BLOCK_N;
+        float *y_block = y + n_from;
+        for (uint32_t m_i = 0; m_i < m; ++m_i) {
+            float x_value = alpha * x[m_i];
+            if (x_value == 0.f)
+                continue;
+            const float *a_row = a + (uint64_t) m_i * n + n_from;
+            for (uint32_t n_i = 0; n_i < n_block; ++n_i)
+                y_block[n_i] += x_value * a_row[n_i];
+        }
+    }
+}
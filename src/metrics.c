@@ -25,9 +25,8 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
-#include <unistd.h>
 
+#include "callbacks.h"
 #include "labeling.h"
 #include "logger.h"
 #include "metrics.h"
@@ -48,8 +47,8 @@ metrics_s *metrics_init(uint32_t log_interval) {
         return NULL;
     }
 
-    // Default epoch index
-    metrics->_epoch_index_prev = -1;
+    // Print progress bar after each batch
+    metrics->callbacks = (callbacks_s){metrics_on_batch_end, NULL, NULL, metrics};
 
     return metrics;
 }
@@ -64,6 +63,12 @@ void metrics_add(metrics_s *metrics, uint8_t metric) {
     if (!metrics)
         return;
 
+    // Check metric
+    if (metric > METRICS_MAX) {
+        logger(LOG_E, "metrics_add", "Wrong metric: %u", metric);
+        return;
+    }
+
     // Check if already exists
     for (uint8_t i = 0; i < metrics->metrics_length; ++i)
         if (metrics->metrics[i] == metric) {
@@ -119,48 +124,21 @@ void metrics_remove(metrics_s *metrics, uint8_t metric) {
  * @brief Calculates and prints (if needed) metrics for each batch
  *
  * @param metrics pointer to metrics_s struct or NULL
- * @param epoch_index index of current epoch (from 0 to epochs_total - 1)
- * @param epochs_total number of epochs
- * @param batch_index index of current batch (from 0 to batches_per_epoch - 1)
- * @param batches_per_epoch number of batches per epoch
- * @param loss_train average training loss of this batch
- * @param loss_validation average validation loss of this batch
- * @param accuracy_train average training accuracy of this batch
- * @param accuracy_validation average validation accuracy of this batch
+ * @param data pointer to callback_data_s struct with stats of current batch
  */
-void metrics_calculate_batch(metrics_s *metrics, uint32_t epoch_index, uint32_t epochs_total, uint32_t batch_index,
-                             uint32_t batches_per_epoch, float loss_train, float loss_validation, float accuracy_train,
-                             float accuracy_validation) {
+void metrics_calculate_batch(metrics_s *metrics, callback_data_s *data) {
     // Ignore everything if no metrics were specified
     if (!metrics || metrics->metrics_length == 0)
         return;
 
-    // New epoch
-    if (epoch_index != metrics->_epoch_index_prev) {
-        // Save current time
-        time(&metrics->_epoch_time_start);
-
-        // First start / new training
-        if (epoch_index == 0)
-            time(&metrics->_training_time_start);
-
-        // Save epoch index
-        metrics->_epoch_index_prev = epoch_index;
-    }
-
-    // Last batch in epoch -> print and reset epoch index to make sure new epoch will be recorded correctly next time
-    bool last_batch = batch_index >= batches_per_epoch - 1;
-    if (last_batch)
-        metrics->_epoch_index_prev = -1;
-
-    // Get current time
-    time(&metrics->_time_now);
+    // Last batch in epoch -> print new line
+    bool last_batch = data->batch_index >= data->batches_per_epoch - 1;
 
     // Reset line to print progress bar on top
     printf("\r");
 
     // Draw progress bar on top of previous one
-    float progress = ((float) batch_index + 1.f) / (float) batches_per_epoch;
+    float progress = ((float) data->batch_index + 1.f) / (float) data->batches_per_epoch;
     uint16_t progress_bar_position = progress * METRICS_PROGRESS_BAR_WIDTH;
     printf("[");
     for (uint16_t i = 0; i < METRICS_PROGRESS_BAR_WIDTH; ++i) {
@@ -171,26 +149,18 @@ void metrics_calculate_batch(metrics_s *metrics, uint32_t epoch_index, uint32_t
         else
             printf(" ");
     }
-    int16_t batch_index_digits = floorf(log10f(batches_per_epoch) + 1);
-    printf("] %*u/%*u", batch_index_digits, batch_index + 1, batch_index_digits, batches_per_epoch);
+    int16_t batch_index_digits = floorf(log10f(data->batches_per_epoch) + 1);
+    printf("] %*u/%*u", batch_index_digits, data->batch_index + 1, batch_index_digits, data->batches_per_epoch);
 
     // Iterate all metrics
     for (uint8_t i = 0; i < metrics->metrics_length; ++i) {
         // Time
         if (metrics->metrics[i] == METRICS_TIME_ELAPSED) {
-            // Calculate time difference between first epoch and now
-            int32_t epoch_time_diff = difftime(metrics->_time_now, metrics->_epoch_time_start);
-
-            // Formatted time
-            uint16_t epoch_hours;
-            uint8_t epoch_minutes, epoch_seconds;
-
-            // Check time (just in case) and format epoch time
-            if (epoch_time_diff >= 0) {
-                epoch_hours = epoch_time_diff / 3600;
-                epoch_minutes = (epoch_time_diff % 3600) / 60;
-                epoch_seconds = epoch_time_diff % 60;
-            }
+            // Format epoch time
+            uint32_t epoch_time_diff = (uint32_t) data->time_epoch;
+            uint16_t epoch_hours = epoch_time_diff / 3600;
+            uint8_t epoch_minutes = (epoch_time_diff % 3600) / 60;
+            uint8_t epoch_seconds = epoch_time_diff % 60;
 
             // Log epoch elapsed time
             printf(" | %02u:%02u:%02u", epoch_hours, epoch_minutes, epoch_seconds);
@@ -198,19 +168,43 @@ void metrics_calculate_batch(metrics_s *metrics, uint32_t epoch_index, uint32_t
 
         // Train loss
         else if (metrics->metrics[i] == METRICS_LOSS_TRAIN)
-            printf(" | Tloss: %8.4f", loss_train);
+            printf(" | Tloss: %8.4f", data->loss_train);
 
         // Train accuracy
         else if (metrics->metrics[i] == METRICS_ACCURACY_TRAIN)
-            printf(" | Tacc: %6.2f%%", accuracy_train * 100.f);
+            printf(" | Tacc: %6.2f%%", data->accuracy_train * 100.f);
 
         // Validation loss
         else if (metrics->metrics[i] == METRICS_LOSS_VALIDATION)
-            printf(" | Vloss: %8.4f", loss_validation);
+            printf(" | Vloss: %8.4f", data->loss_validation);
 
         // Validation accuracy
         else if (metrics->metrics[i] == METRICS_ACCURACY_VALIDATION)
-            printf(" | Vacc: %6.2f%%", accuracy_validation * 100.f);
+            printf(" | Vacc: %6.2f%%", data->accuracy_validation * 100.f);
+
+        // Training throughput
+        else if (metrics->metrics[i] == METRICS_SAMPLES_PER_SECOND)
+            printf(" | %9.1f samples/s", data->samples_per_second);
+
+        // Time of training batch
+        else if (metrics->metrics[i] == METRICS_MS_PER_BATCH)
+            printf(" | %8.3f ms/batch", data->time_batch * 1000.);
+
+        // Time of forward propagation of batch
+        else if (metrics->metrics[i] == METRICS_TIME_FORWARD)
+            printf(" | Fwd: %8.3f ms", data->time_forward * 1000.);
+
+        // Time of backpropagation of batch
+        else if (metrics->metrics[i] == METRICS_TIME_BACKWARD)
+            printf(" | Bwd: %8.3f ms", data->time_backward * 1000.);
+
+        // Time of weights update
+        else if (metrics->metrics[i] == METRICS_TIME_OPTIMIZER)
+            printf(" | Opt: %8.3f ms", data->time_optimizer * 1000.);
+
+        // Time of last validation
+        else if (metrics->metrics[i] == METRICS_TIME_VALIDATION)
+            printf(" | Val: %8.3f ms", data->time_validation * 1000.);
     }
 
     // Flush progress bar and metrics
@@ -220,25 +214,25 @@ void metrics_calculate_batch(metrics_s *metrics, uint32_t epoch_index, uint32_t
     if (last_batch)
         printf("\n");
 
-    if (last_batch && epoch_index == epochs_total - 1) {
-        // Calculate time difference between first epoch and now
-        int32_t train_time_diff = difftime(metrics->_time_now, metrics->_training_time_start);
-
-        // Formatted time
-        uint16_t train_hours;
-        uint8_t train_minutes, train_seconds;
-
-        // Check time (just in case) and format epoch time
-        if (train_time_diff >= 0) {
-            train_hours = train_time_diff / 3600;
-            train_minutes = (train_time_diff % 3600) / 60;
-            train_seconds = train_time_diff % 60;
-            logger(LOG_I, "Metrics", "Training finished in %02u:%02u:%02u", train_hours, train_minutes, train_seconds);
-        } else
-            logger(LOG_I, "Metrics", "Training finished");
+    if (last_batch && data->epoch_index == data->epochs_total - 1) {
+        // Format training time
+        uint32_t train_time_diff = (uint32_t) data->time_training;
+        uint16_t train_hours = train_time_diff / 3600;
+        uint8_t train_minutes = (train_time_diff % 3600) / 60;
+        uint8_t train_seconds = train_time_diff % 60;
+        logger(LOG_I, "Metrics", "Training finished in %02u:%02u:%02u (%.3f s)", train_hours, train_minutes,
+               train_seconds, data->time_training);
     }
+}
 
-    // sleep(1);
+/**
+ * @brief Built-in CALLBACK_ON_BATCH_END callback that prints progress bar using metrics_calculate_batch()
+ *
+ * @param data pointer to callback_data_s struct with current training stats
+ * @param user_data pointer to metrics_s struct
+ */
+void metrics_on_batch_end(callback_data_s *data, void *user_data) {
+    metrics_calculate_batch((metrics_s *) user_data, data);
 }
 
 /**
@@ -0,0 +1,312 @@
+/**
+ * @file norm.c
+ * @author Fern Lane
+ * @brief Normalization petals with trainable scale (weights) and shift (bias weights)
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "norm.h"
+#include "petal.h"
+
+/**
+ * @brief Calculates number of features of PETAL_TYPE_BATCH_NORM petal (each one has it's own statistics, scale and
+ * shift): number of channels for multichannel data (statistics are shared across rows and cols) or input length for
+ * single channel data (ex. output of PETAL_TYPE_DENSE_1D)
+ *
+ * @param petal pointer to petal struct
+ * @return uint32_t number of features
+ */
+uint32_t batch_norm_features(petal_s *petal) {
+    return petal->input_shape->depth > 1U ? petal->input_shape->depth : petal->input_shape->length;
+}
+
+/**
+ * @brief Normalizes each feature using running statistics or statistics of mini-batch, then scales and shifts it
+ * Training forward pass depends on petal->_batch_norm_stage:
+ * BATCH_NORM_STAGE_RUNNING - statistics of the sample are added into running mean and variance first (exponentially
+ * weighted with petal->params.momentum) and they are used for normalization (single samples outside of flower_train())
+ * BATCH_NORM_STAGE_STATISTICS - input is only accumulated into statistics of mini-batch (output is not calculated)
+ * BATCH_NORM_STAGE_BATCH - mean and variance of mini-batch (see batch_norm_batch_statistics()) are used
+ * Inference always uses running statistics
+ *
+ * @param petal pointer to PETAL_TYPE_BATCH_NORM petal
+ * @param input pointer to input data (petal->input_shape)
+ * @param training true to use statistics of training stage and cache normalized input for backpropagation
+ */
+void batch_norm_forward(petal_s *petal, const float *input, bool training) {
+    uint32_t features = batch_norm_features(petal);
+    uint32_t positions = petal->input_shape->length / features;
+    float *scale = petal->weights ? petal->weights->weights : NULL;
+    float *shift = petal->bias_weights ? petal->bias_weights->weights : NULL;
+    uint8_t stage = training ? petal->_batch_norm_stage : BATCH_NORM_STAGE_RUNNING;
+
+    // Accumulate sums of values and squares shifted by running mean (to avoid cancellation)
+    if (stage == BATCH_NORM_STAGE_STATISTICS) {
+        float *sums = petal->_batch_stats + features;
+        float *sums_squares = petal->_batch_stats + 2U * features;
+        for (uint32_t position = 0; position < positions; ++position) {
+            const float *input_row = input + position * features;
+            for (uint32_t feature = 0; feature < features; ++feature) {
+                float value = input_row[feature] - petal->_running_mean[feature];
+                sums[feature] += value;
+                sums_squares[feature] += value * value;
+            }
+        }
+        petal->_batch_samples++;
+        return;
+    }
+
+    // Update running statistics (exponentially weighted mean and variance)
+    if (training && stage == BATCH_NORM_STAGE_RUNNING) {
+        float momentum = petal->params.momentum;
+        float positions_inv = 1.f / (float) positions;
+        for (uint32_t feature = 0; feature < features; ++feature) {
+            // Mean and variance of feature in this sample (variance is 0 for single channel data)
+            float sum = 0.f, sum_squares = 0.f;
+            for (uint32_t position = 0; position < positions; ++position) {
+                float value = input[position * features + feature];
+                sum += value;
+                sum_squares += value * value;
+            }
+            float mean = sum * positions_inv;
+            float variance = fmaxf(sum_squares * positions_inv - mean * mean, 0.f);
+
+            float delta = mean - petal->_running_mean[feature];
+            petal->_running_mean[feature] += momentum * delta;
+            petal->_running_variance[feature] =
+                (1.f - momentum) * (petal->_running_variance[feature] + momentum * delta * delta) + momentum * variance;
+        }
+    }
+
+    // Mean and inverse standard deviations (inverse standard deviations of mini-batch are already calculated)
+    const float *mean = petal->_running_mean;
+    if (stage == BATCH_NORM_STAGE_BATCH)
+        mean = petal->_batch_stats;
+    else
+        for (uint32_t feature = 0; feature < features; ++feature)
+            petal->_inv_std[feature] = 1.f / sqrtf(petal->_running_variance[feature] + NORM_EPSILON);
+
+    // Normalize, scale and shift
+    for (uint32_t position = 0; position < positions; ++position) {
+        const float *input_row = input + position * features;
+        float *output_row = petal->output + position * features;
+        float *normalized_row = petal->_normalized + position * features;
+        for (uint32_t feature = 0; feature < features; ++feature) {
+            float normalized = (input_row[feature] - mean[feature]) * petal->_inv_std[feature];
+            if (training)
+                normalized_row[feature] = normalized;
+            output_row[feature] = (scale ? normalized * scale[feature] : normalized) + (shift ? shift[feature] : 0.f);
+        }
+    }
+}
+
+/**
+ * @brief Calculates gradients of scale and shift and backpropagates errors
+ * Running statistics are constants. Statistics of mini-batch (BATCH_NORM_STAGE_BATCH) depend on inputs of all samples
+ * of mini-batch, so errors are backpropagated through them using means of errors over mini-batch (see
+ * batch_norm_batch_errors()): error_on_input = inv_std * (g - mean(g) - normalized * mean(g * normalized)), where
+ * g = error * scale. Errors and errors * normalized input are also accumulated to calculate these means
+ *
+ * @param petal pointer to PETAL_TYPE_BATCH_NORM petal (petal->output must contain errors before activation)
+ */
+void batch_norm_backward(petal_s *petal) {
+    uint32_t features = batch_norm_features(petal);
+    uint32_t positions = petal->input_shape->length / features;
+    weights_s *scale = petal->weights;
+    weights_s *shift = petal->bias_weights;
+    bool batch = petal->_batch_norm_stage == BATCH_NORM_STAGE_BATCH;
+    float *sums = petal->_batch_stats + features;
+    float *sums_normalized = petal->_batch_stats + 2U * features;
+    const float *means = petal->_batch_stats + 3U * features;
+    const float *means_normalized = petal->_batch_stats + 4U * features;
+    for (uint32_t position = 0; position < positions; ++position) {
+        const float *error_row = petal->output + position * features;
+        const float *normalized_row = petal->_normalized + position * features;
+        for (uint32_t feature = 0; feature < features; ++feature) {
+            if (scale && scale->trainable)
+                scale->gradients[feature] += error_row[feature] * normalized_row[feature];
+            if (shift && shift->trainable)
+                shift->gradients[feature] += error_row[feature];
+        }
+        if (petal->first)
+            continue;
+
+        float *error_on_input_row = petal->error_on_input + position * features;
+        for (uint32_t feature = 0; feature < features; ++feature) {
+            float error = error_row[feature];
+            if (batch) {
+                sums[feature] += error;
+                sums_normalized[feature] += error * normalized_row[feature];
+                error -= means[feature] + normalized_row[feature] * means_normalized[feature];
+            }
+            error_on_input_row[feature] = error * petal->_inv_std[feature] * (scale ? scale->weights[feature] : 1.f);
+        }
+    }
+}
+
+/**
+ * @brief Starts accumulation of statistics of mini-batch (BATCH_NORM_STAGE_STATISTICS): each following training
+ * forward pass adds it's input into them
+ *
+ * @param petal pointer to PETAL_TYPE_BATCH_NORM petal
+ */
+void batch_norm_batch_begin(petal_s *petal) {
+    uint32_t features = batch_norm_features(petal);
+    memset(petal->_batch_stats, 0, BATCH_NORM_BATCH_STATS * features * sizeof(float));
+    petal->_batch_samples = 0U;
+    petal->_batch_norm_stage = BATCH_NORM_STAGE_STATISTICS;
+}
+
+/**
+ * @brief Calculates mean and inverse standard deviation of accumulated mini-batch, adds them into running statistics
+ * (exponentially weighted with petal->params.momentum, unbiased variance) and switches petal to BATCH_NORM_STAGE_BATCH
+ * (means of errors are 0 until batch_norm_batch_errors() is called)
+ *
+ * @param petal pointer to PETAL_TYPE_BATCH_NORM petal
+ */
+void batch_norm_batch_statistics(petal_s *petal) {
+    uint32_t features = batch_norm_features(petal);
+    float count = (float) petal->_batch_samples * (float) (petal->input_shape->length / features);
+    float momentum = petal->params.momentum;
+    float *sums = petal->_batch_stats + features;
+    float *sums_squares = petal->_batch_stats + 2U * features;
+    for (uint32_t feature = 0; feature < features; ++feature) {
+        float mean_shifted = count > 0.f ? sums[feature] / count : 0.f;
+        float variance = count > 0.f ? fmaxf(sums_squares[feature] / count - mean_shifted * mean_shifted, 0.f) : 0.f;
+        float mean = mean_shifted + petal->_running_mean[feature];
+        petal->_batch_stats[feature] = mean;
+        petal->_inv_std[feature] = 1.f / sqrtf(variance + NORM_EPSILON);
+
+        petal->_running_mean[feature] += momentum * (mean - petal->_running_mean[feature]);
+        if (count > 1.f)
+            variance *= count / (count - 1.f);
+        petal->_running_variance[feature] += momentum * (variance - petal->_running_variance[feature]);
+    }
+    memset(sums, 0, 4U * features * sizeof(float));
+    petal->_batch_norm_stage = BATCH_NORM_STAGE_BATCH;
+}
+
+/**
+ * @brief Calculates means of errors and errors * normalized input accumulated by backpropagation of each sample of
+ * mini-batch (all samples must be backpropagated through this petal once) and resets sums
+ *
+ * @param petal pointer to PETAL_TYPE_BATCH_NORM petal in BATCH_NORM_STAGE_BATCH
+ */
+void batch_norm_batch_errors(petal_s *petal) {
+    uint32_t features = batch_norm_features(petal);
+    float count = (float) petal->_batch_samples * (float) (petal->input_shape->length / features);
+    float *sums = petal->_batch_stats + features;
+    float *means = petal->_batch_stats + 3U * features;
+    for (uint32_t i = 0; i < 2U * features; ++i) {
+        means[i] = count > 0.f ? sums[i] / count : 0.f;
+        sums[i] = 0.f;
+    }
+}
+
+/**
+ * @brief Normalizes each row (cols * depth values) using it's own mean and variance, then scales and shifts each
+ * element of row. Mean and variance are calculated in a single pass as sums of values and squares shifted by the
+ * first value of row (to avoid cancellation when mean is much larger than deviation)
+ *
+ * @param petal pointer to PETAL_TYPE_LAYER_NORM petal
+ * @param input pointer to input data (petal->input_shape)
+ * @param training true to cache normalized input for backpropagation
+ */
+void layer_norm_forward(petal_s *petal, const float *input, bool training) {
+    uint32_t row_length = petal->input_shape->cols * petal->input_shape->depth;
+    float row_length_inv = 1.f / (float) row_length;
+    float *scale = petal->weights ? petal->weights->weights : NULL;
+    float *shift = petal->bias_weights ? petal->bias_weights->weights : NULL;
+    for (uint32_t row = 0; row < petal->input_shape->rows; ++row) {
+        const float *input_row = input + row * row_length;
+        float *output_row = petal->output + row * row_length;
+
+        // Shifted sums of values and squares
+        float offset = input_row[0];
+        float sum = 0.f, sum_squares = 0.f;
+        for (uint32_t i = 0; i < row_length; ++i) {
+            float value = input_row[i] - offset;
+            sum += value;
+            sum_squares += value * value;
+        }
+        float mean_shifted = sum * row_length_inv;
+        float variance = fmaxf(sum_squares * row_length_inv - mean_shifted * mean_shifted, 0.f);
+        float mean = mean_shifted + offset;
+        float inv_std = 1.f / sqrtf(variance + NORM_EPSILON);
+        petal->_inv_std[row] = inv_std;
+
+        // Normalize, scale and shift
+        float *normalized_row = petal->_normalized + row * row_length;
+        for (uint32_t i = 0; i < row_length; ++i) {
+            float normalized = (input_row[i] - mean) * inv_std;
+            if (training)
+                normalized_row[i] = normalized;
+            output_row[i] = (scale ? normalized * scale[i] : normalized) + (shift ? shift[i] : 0.f);
+        }
+    }
+}
+
+/**
+ * @brief Calculates gradients of scale and shift and backpropagates errors through statistics of each row using
+ * cached normalized input and inverse standard deviation:
+ * error_on_input = inv_std / N * (N * g - sum(g) - normalized * sum(g * normalized)), where g = error * scale
+ *
+ * @param petal pointer to PETAL_TYPE_LAYER_NORM petal (petal->output must contain errors before activation)
+ */
+void layer_norm_backward(petal_s *petal) {
+    uint32_t row_length = petal->input_shape->cols * petal->input_shape->depth;
+    float row_length_inv = 1.f / (float) row_length;
+    weights_s *scale = petal->weights;
+    weights_s *shift = petal->bias_weights;
+    for (uint32_t row = 0; row < petal->input_shape->rows; ++row) {
+        const float *error_row = petal->output + row * row_length;
+        const float *normalized_row = petal->_normalized + row * row_length;
+
+        // Gradients of scale and shift
+        if (scale && scale->trainable)
+            for (uint32_t i = 0; i < row_length; ++i)
+                scale->gradients[i] += error_row[i] * normalized_row[i];
+        if (shift && shift->trainable)
+            for (uint32_t i = 0; i < row_length; ++i)
+                shift->gradients[i] += error_row[i];
+        if (petal->first)
+            continue;
+
+        // Mean of errors of normalized values and their projection onto normalized values
+        float sum = 0.f, sum_normalized = 0.f;
+        for (uint32_t i = 0; i < row_length; ++i) {
+            float error = scale ? error_row[i] * scale->weights[i] : error_row[i];
+            sum += error;
+            sum_normalized += error * normalized_row[i];
+        }
+        float mean = sum * row_length_inv;
+        float mean_normalized = sum_normalized * row_length_inv;
+
+        float inv_std = petal->_inv_std[row];
+        float *error_on_input_row = petal->error_on_input + row * row_length;
+        for (uint32_t i = 0; i < row_length; ++i) {
+            float error = scale ? error_row[i] * scale->weights[i] : error_row[i];
+            error_on_input_row[i] = inv_std * (error - mean - normalized_row[i] * mean_normalized);
+        }
+    }
+}
@@ -26,12 +26,28 @@
 #include <stdlib.h>
 
 #include "activation.h"
+#include "attention.h"
+#include "conv.h"
 #include "dropout.h"
+#include "embedding.h"
 #include "errors.h"
 #include "logger.h"
+#include "norm.h"
 #include "petal.h"
+#include "pool.h"
+#include "rnn.h"
 #include "weights.h"
 
+/**
+ * @brief Calculates length of one kernel of PETAL_TYPE_CONV_2D petal (number of weights per output channel)
+ *
+ * @param petal pointer to petal struct
+ * @return uint32_t kernel rows * kernel cols * input depth
+ */
+uint32_t petal_conv_2d_kernel_length(petal_s *petal) {
+    return petal->params.kernel_rows * petal->params.kernel_cols * petal->input_shape->depth;
+}
+
 /**
  * @brief Initializes petal's struct and petal's weights if needed
  * Sets petal->error_code in case of error
@@ -48,13 +64,19 @@
  * cols - width (or size for 1D) of output data,
  * depth - number of channels of output data,
  * length - calculates internally
- * @param weights pointer to weights_s struct (for PETAL_TYPE_DENSE_1D) or NULL for other types:
+ * @param weights pointer to weights_s struct (for PETAL_TYPE_DENSE_1D and PETAL_TYPE_CONV_2D or scale of
+ * PETAL_TYPE_BATCH_NORM and PETAL_TYPE_LAYER_NORM, initialize it with WEIGHTS_INIT_CONSTANT and center 1, or
+ * embedding table of PETAL_TYPE_EMBEDDING, or (input features + hidden size) x (gates * hidden size) input and
+ * recurrent weights of PETAL_TYPE_LSTM and PETAL_TYPE_GRU, or row length x (4 * row length) queries, keys, values and
+ * output projections of PETAL_TYPE_ATTENTION) or NULL for other types:
  * trainable - 1 if weights will be trained or 0 if not,
  * initializer - weights initializer (WEIGHTS_INIT_...),
  * weights - pass NULL to initialize weights or pointer to previously initialized weights,
  * center - constant for WEIGHTS_INIT_CONSTANT or center of distribution for other initializers,
  * deviation - deviation of distribution (ignored for WEIGHTS_INIT_CONSTANT),
- * @param bias_weights pointer to weights_s struct (for PETAL_TYPE_DENSE_1D) or NULL for other types:
+ * @param bias_weights pointer to weights_s struct (for PETAL_TYPE_DENSE_1D and PETAL_TYPE_CONV_2D or shift of
+ * PETAL_TYPE_BATCH_NORM and PETAL_TYPE_LAYER_NORM, or bias of each gate of PETAL_TYPE_LSTM and PETAL_TYPE_GRU, or
+ * 4 * row length bias of projections of PETAL_TYPE_ATTENTION) or NULL:
  * trainable - 1 if bias weights will be trained or 0 if not,
  * initializer - bias weights initializer (WEIGHTS_INIT_...),
  * weights - pass NULL to initialize bias weights or pointer to previously initialized bias weights,
@@ -72,6 +94,15 @@
  * dropout - ratio of dropped outputs (0 to 1) (Default: 0.0)
  * center - center of normalization for PETAL_TYPE_NORMALIZE_... (Default: 0.0)
  * deviation - deviation of normalization for PETAL_TYPE_NORMALIZE_... (Default: 1.0)
+ * dropout_mode - DROPOUT_MODE_EXACT or DROPOUT_MODE_BERNOULLI (Default: DROPOUT_MODE_EXACT)
+ * kernel_rows, kernel_cols - kernel size for PETAL_TYPE_CONV_2D (output depth is number of kernels) or window size
+ * for PETAL_TYPE_..._POOL_2D (output depth must be equal to input depth)
+ * stride, padding, dilation - for PETAL_TYPE_CONV_2D and PETAL_TYPE_..._POOL_2D (Default: 1, 0, 1)
+ * conv_algorithm - CONV_ALGORITHM_... for PETAL_TYPE_CONV_2D (Default: CONV_ALGORITHM_AUTO)
+ * momentum - weight of each mini-batch in running statistics of PETAL_TYPE_BATCH_NORM
+ * (Default: BATCH_NORM_MOMENTUM_DEFAULT)
+ * vocabulary_size - number of rows of embedding table for PETAL_TYPE_EMBEDDING (up to EMBEDDING_MAX_VOCABULARY_SIZE)
+ * heads - number of heads of PETAL_TYPE_ATTENTION (row length must be divisible by it) (Default: 1)
  * @return petal_s* petal's struct
  */
 petal_s *petal_init(uint8_t petal_type, bool first, petal_shape_s *input_shape, petal_shape_s *output_shape,
@@ -98,22 +129,50 @@ petal_s *petal_init(uint8_t petal_type, bool first, petal_shape_s *input_shape,
     petal->bias_weights = bias_weights;
     petal->activation = activation;
     petal->bit_array = NULL;
+    petal->_dropout_mask = NULL;
+    petal->_rng_stream_enabled = false;
+    petal->_columns = NULL;
+    petal->_conv_kernel = NULL;
+    petal->_pool_indices = NULL;
+    petal->_running_mean = NULL;
+    petal->_running_variance = NULL;
+    petal->_inv_std = NULL;
+    petal->_normalized = NULL;
+    petal->_batch_norm_stage = BATCH_NORM_STAGE_RUNNING;
+    petal->_batch_samples = 0U;
+    petal->_batch_stats = NULL;
+    petal->_rnn_gates = NULL;
+    petal->_rnn_cells = NULL;
+    petal->_rnn_hidden = NULL;
+    petal->_rnn_gates_grad = NULL;
+    petal->_rnn_temp = NULL;
+    petal->_attention_qkv = NULL;
+    petal->_attention_heads = NULL;
+    petal->_attention_temp = NULL;
+    petal->_attention_grad = NULL;
+    petal->_attention_stats = NULL;
+    petal->_attention_tile = NULL;
     if (petal->activation)
         petal->activation->_derivatives_temp = NULL;
 
     // Copy params
-    if (params) {
-        petal->params.dropout = params->dropout;
-        petal->params.center = params->center;
-        petal->params.deviation = params->deviation;
-    }
+    if (params)
+        petal->params = *params;
 
     // Initialize params with default values
     else {
+        petal->params = (petal_params_s){0};
         petal->params.dropout = 0.f;
         petal->params.center = 0.f;
         petal->params.deviation = 1.f;
+        petal->params.dropout_mode = DROPOUT_MODE_EXACT;
     }
+    if (petal->params.stride == 0U)
+        petal->params.stride = 1U;
+    if (petal->params.dilation == 0U)
+        petal->params.dilation = 1U;
+    if (petal->params.momentum == 0.f)
+        petal->params.momentum = BATCH_NORM_MOMENTUM_DEFAULT;
 
     // Check petal type
     if (petal_type > PETAL_TYPE_MAX) {
@@ -141,6 +200,13 @@ petal_s *petal_init(uint8_t petal_type, bool first, petal_shape_s *input_shape,
         return petal;
     }
 
+    // Check dropout mode
+    if (petal->params.dropout_mode > DROPOUT_MODE_MAX) {
+        logger(LOG_E, "petal_init", "Wrong dropout mode: %u", petal->params.dropout_mode);
+        petal->error_code = ERROR_PETAL_WRONG_DROPOUT_MODE;
+        return petal;
+    }
+
     // Calculate total input and output size
     input_shape->length = input_shape->rows * input_shape->cols * input_shape->depth;
     output_shape->length = output_shape->rows * output_shape->cols * output_shape->depth;
@@ -154,7 +220,8 @@ petal_s *petal_init(uint8_t petal_type, bool first, petal_shape_s *input_shape,
 
     // Check if sizes match each other for some types
     if (petal_type == PETAL_TYPE_DIRECT || petal_type == PETAL_TYPE_NORMALIZE_ALL ||
-        petal_type == PETAL_TYPE_NORMALIZE_IN_ROWS || petal_type == PETAL_TYPE_NORMALIZE_IN_CHANNELS) {
+        petal_type == PETAL_TYPE_NORMALIZE_IN_ROWS || petal_type == PETAL_TYPE_NORMALIZE_IN_CHANNELS ||
+        petal_type == PETAL_TYPE_BATCH_NORM || petal_type == PETAL_TYPE_LAYER_NORM) {
         if (input_shape->cols != output_shape->cols || input_shape->rows != output_shape->rows ||
             input_shape->depth != output_shape->depth) {
             logger(LOG_E, "petal_init", "Input and output shapes are not equal");
@@ -163,15 +230,146 @@ petal_s *petal_init(uint8_t petal_type, bool first, petal_shape_s *input_shape,
         }
     }
 
+    // Check that kernel fits into input and output shape matches it
+    if (petal_type == PETAL_TYPE_CONV_2D) {
+        uint32_t output_rows = conv_output_size(input_shape->rows, petal->params.kernel_rows, petal->params.stride,
+                                                petal->params.padding, petal->params.dilation);
+        uint32_t output_cols = conv_output_size(input_shape->cols, petal->params.kernel_cols, petal->params.stride,
+                                                petal->params.padding, petal->params.dilation);
+        if (output_rows == 0U || output_cols == 0U || output_rows != output_shape->rows ||
+            output_cols != output_shape->cols) {
+            logger(LOG_E, "petal_init", "Kernel doesn't fit into input or output shape is not %ux%u", output_rows,
+                   output_cols);
+            petal->error_code = ERROR_PETAL_WRONG_KERNEL;
+            return petal;
+        }
+        if (!weights) {
+            logger(LOG_E, "petal_init", "Convolution petal requires weights");
+            petal->error_code = ERROR_PETAL_WRONG_KERNEL;
+            return petal;
+        }
+
+        // Choose algorithm
+        petal->_conv_algorithm = conv_select_algorithm(petal);
+        if (petal->_conv_algorithm == CONV_ALGORITHM_AUTO) {
+            logger(LOG_E, "petal_init", "Convolution algorithm %u is not available for this kernel",
+                   petal->params.conv_algorithm);
+            petal->error_code = ERROR_PETAL_WRONG_KERNEL;
+            return petal;
+        }
+        logger(LOG_I, "petal_init", "Convolution algorithm: %u", petal->_conv_algorithm);
+    }
+
+    // Check that window fits into input and output shape matches it (pooling doesn't mix channels)
+    if (petal_type == PETAL_TYPE_MAX_POOL_2D || petal_type == PETAL_TYPE_AVG_POOL_2D) {
+        uint32_t output_rows = conv_output_size(input_shape->rows, petal->params.kernel_rows, petal->params.stride,
+                                                petal->params.padding, petal->params.dilation);
+        uint32_t output_cols = conv_output_size(input_shape->cols, petal->params.kernel_cols, petal->params.stride,
+                                                petal->params.padding, petal->params.dilation);
+        if (output_rows == 0U || output_cols == 0U || output_rows != output_shape->rows ||
+            output_cols != output_shape->cols) {
+            logger(LOG_E, "petal_init", "Pooling window doesn't fit into input or output shape is not %ux%u",
+                   output_rows, output_cols);
+            petal->error_code = ERROR_PETAL_WRONG_KERNEL;
+            return petal;
+        }
+        if (input_shape->depth != output_shape->depth) {
+            logger(LOG_E, "petal_init", "Input and output depths of pooling petal are not equal");
+            petal->error_code = ERROR_PETAL_SHAPES_NOT_EQUAL;
+            return petal;
+        }
+    }
+
+    // Check that input is one id per row, output row is embedding and table fits into weights
+    if (petal_type == PETAL_TYPE_EMBEDDING) {
+        if (input_shape->cols != 1U || input_shape->depth != 1U || output_shape->rows != input_shape->rows) {
+            logger(LOG_E, "petal_init", "Embedding petal input must be rows x 1 x 1 ids and output must have %u rows",
+                   input_shape->rows);
+            petal->error_code = ERROR_PETAL_SHAPES_NOT_EQUAL;
+            return petal;
+        }
+        if (petal->params.vocabulary_size == 0U || petal->params.vocabulary_size > EMBEDDING_MAX_VOCABULARY_SIZE) {
+            logger(LOG_E, "petal_init", "Wrong vocabulary size: %u", petal->params.vocabulary_size);
+            petal->error_code = ERROR_PETAL_WRONG_INDEX;
+            return petal;
+        }
+        if ((uint64_t) petal->params.vocabulary_size * output_shape->cols * output_shape->depth > UINT32_MAX) {
+            logger(LOG_E, "petal_init", "Embedding table is too big");
+            petal->error_code = ERROR_PETAL_SHAPE_TOO_BIG;
+            return petal;
+        }
+        if (!weights) {
+            logger(LOG_E, "petal_init", "Embedding petal requires weights");
+            petal->error_code = ERROR_PETAL_WRONG_INDEX;
+            return petal;
+        }
+    }
+
+    // Check that output is hidden state of each timestep (input row) or only of the last one
+    if (petal_type == PETAL_TYPE_LSTM || petal_type == PETAL_TYPE_GRU) {
+        if (output_shape->rows != input_shape->rows && output_shape->rows != 1U) {
+            logger(LOG_E, "petal_init", "Recurrent petal output must have %u or 1 rows", input_shape->rows);
+            petal->error_code = ERROR_PETAL_SHAPES_NOT_EQUAL;
+            return petal;
+        }
+        if ((uint64_t) (input_shape->cols * input_shape->depth + output_shape->cols * output_shape->depth) *
+                output_shape->cols * output_shape->depth * 4U >
+            UINT32_MAX) {
+            logger(LOG_E, "petal_init", "Recurrent petal weights are too big");
+            petal->error_code = ERROR_PETAL_SHAPE_TOO_BIG;
+            return petal;
+        }
+        if (!weights) {
+            logger(LOG_E, "petal_init", "Recurrent petal requires weights");
+            petal->error_code = ERROR_PETAL_WRONG_WEIGHTS_INIT;
+            return petal;
+        }
+    }
+
+    // Check that output has the same shape as input and rows can be split into heads
+    if (petal_type == PETAL_TYPE_ATTENTION) {
+        uint32_t row_length = input_shape->cols * input_shape->depth;
+        if (output_shape->rows != input_shape->rows || output_shape->cols * output_shape->depth != row_length ||
+            row_length % attention_heads(petal) != 0U) {
+            logger(LOG_E, "petal_init",
+                   "Attention petal output must have the same shape as input and row length %u must be divisible by "
+                   "number of heads %u",
+                   row_length, attention_heads(petal));
+            petal->error_code = ERROR_PETAL_SHAPES_NOT_EQUAL;
+            return petal;
+        }
+        if ((uint64_t) row_length * row_length * 4U > UINT32_MAX ||
+            (uint64_t) input_shape->rows * row_length * 3U > UINT32_MAX) {
+            logger(LOG_E, "petal_init", "Attention petal weights or projections are too big");
+            petal->error_code = ERROR_PETAL_SHAPE_TOO_BIG;
+            return petal;
+        }
+        if (!weights) {
+            logger(LOG_E, "petal_init", "Attention petal requires weights");
+            petal->error_code = ERROR_PETAL_WRONG_WEIGHTS_INIT;
+            return petal;
+        }
+    }
+
     // Initialize dropout
     if (petal->params.dropout > 0.f) {
         petal->bit_array = bit_array_init(output_shape->length);
+        if (!petal->bit_array) {
+            petal->error_code = ERROR_MALLOC;
+            return petal;
+        }
         if (petal->bit_array->error_code != ERROR_NONE) {
             logger(LOG_E, "petal_init", "Dropout bit array initialization error: %s",
                    error_to_str[petal->bit_array->error_code]);
             petal->error_code = petal->bit_array->error_code;
             return petal;
         }
+        petal->_dropout_mask = (float *) calloc(output_shape->length, sizeof(float));
+        if (!petal->_dropout_mask) {
+            logger(LOG_E, "petal_init", "Error allocating memory for petal->_dropout_mask");
+            petal->error_code = ERROR_MALLOC;
+            return petal;
+        }
     }
 
     // Initialize output
@@ -187,7 +385,7 @@ petal_s *petal_init(uint8_t petal_type, bool first, petal_shape_s *input_shape,
 
     // Initialize gradients error temp (errors for backpropagation)
     if (!petal->first) {
-        petal->error_on_input = (float *) calloc(output_shape->length, sizeof(float));
+        petal->error_on_input = (float *) calloc(input_shape->length, sizeof(float));
         if (!petal->error_on_input) {
             logger(LOG_E, "petal_init", "Error allocating memory for petal->error_on_input");
             petal->error_code = ERROR_MALLOC;
@@ -196,12 +394,167 @@ petal_s *petal_init(uint8_t petal_type, bool first, petal_shape_s *input_shape,
     } else
         petal->error_on_input = NULL;
 
+    // Initialize im2col matrix (or Winograd tile) and repacked weights
+    if (petal->petal_type == PETAL_TYPE_CONV_2D) {
+        if (conv_columns_length(petal) > 0U) {
+            petal->_columns = (float *) malloc(conv_columns_length(petal) * sizeof(float));
+            if (!petal->_columns) {
+                logger(LOG_E, "petal_init", "Error allocating memory for petal->_columns");
+                petal->error_code = ERROR_MALLOC;
+                return petal;
+            }
+        }
+        if (conv_kernel_buffer_length(petal) > 0U) {
+            petal->_conv_kernel = (float *) malloc(conv_kernel_buffer_length(petal) * sizeof(float));
+            if (!petal->_conv_kernel) {
+                logger(LOG_E, "petal_init", "Error allocating memory for petal->_conv_kernel");
+                petal->error_code = ERROR_MALLOC;
+                return petal;
+            }
+        }
+    }
+
+    // Initialize argmax indices of max-pooling (there is nothing to backpropagate into if it's the first petal)
+    if (petal->petal_type == PETAL_TYPE_MAX_POOL_2D && !petal->first) {
+        petal->_pool_indices = (uint32_t *) malloc(output_shape->length * sizeof(uint32_t));
+        if (!petal->_pool_indices) {
+            logger(LOG_E, "petal_init", "Error allocating memory for petal->_pool_indices");
+            petal->error_code = ERROR_MALLOC;
+            return petal;
+        }
+    }
+
+    // Initialize running statistics (mean 0, variance 1), statistics of mini-batch and normalization cache
+    if (petal->petal_type == PETAL_TYPE_BATCH_NORM) {
+        uint32_t features = batch_norm_features(petal);
+        petal->_running_mean = (float *) calloc(features, sizeof(float));
+        petal->_running_variance = (float *) malloc(features * sizeof(float));
+        petal->_inv_std = (float *) malloc(features * sizeof(float));
+        petal->_normalized = (float *) calloc(input_shape->length, sizeof(float));
+        petal->_batch_stats = (float *) calloc(BATCH_NORM_BATCH_STATS * features, sizeof(float));
+        if (!petal->_running_mean || !petal->_running_variance || !petal->_inv_std || !petal->_normalized ||
+            !petal->_batch_stats) {
+            logger(LOG_E, "petal_init", "Error allocating memory for running statistics");
+            petal->error_code = ERROR_MALLOC;
+            return petal;
+        }
+        for (uint32_t feature = 0; feature < features; ++feature)
+            petal->_running_variance[feature] = 1.f;
+
+        // Scale and shift of each feature
+        uint8_t error_temp = weights_check_init(weights, features);
+        if (error_temp == ERROR_NONE)
+            error_temp = weights_check_init(bias_weights, features);
+        if (error_temp != ERROR_NONE) {
+            logger(LOG_E, "petal_init", "Error checking and initializing scale or shift: %s",
+                   error_to_str[error_temp]);
+            petal->error_code = error_temp;
+            return petal;
+        }
+    }
+
+    // Initialize normalization cache, scale and shift of each element of row
+    if (petal->petal_type == PETAL_TYPE_LAYER_NORM) {
+        petal->_inv_std = (float *) malloc(input_shape->rows * sizeof(float));
+        petal->_normalized = (float *) calloc(input_shape->length, sizeof(float));
+        if (!petal->_inv_std || !petal->_normalized) {
+            logger(LOG_E, "petal_init", "Error allocating memory for normalization cache");
+            petal->error_code = ERROR_MALLOC;
+            return petal;
+        }
+        uint8_t error_temp = weights_check_init(weights, input_shape->cols * input_shape->depth);
+        if (error_temp == ERROR_NONE)
+            error_temp = weights_check_init(bias_weights, input_shape->cols * input_shape->depth);
+        if (error_temp != ERROR_NONE) {
+            logger(LOG_E, "petal_init", "Error checking and initializing scale or shift: %s",
+                   error_to_str[error_temp]);
+            petal->error_code = error_temp;
+            return petal;
+        }
+    }
+
+    // Initialize embedding table with sparse (looked up rows only) updates and bias weights
+    if (petal->petal_type == PETAL_TYPE_EMBEDDING) {
+        uint32_t embedding_size = output_shape->cols * output_shape->depth;
+        uint8_t error_temp = weights_check_init(weights, petal->params.vocabulary_size * embedding_size);
+        if (error_temp == ERROR_NONE)
+            error_temp = weights_sparse_init(weights, embedding_size);
+        if (error_temp == ERROR_NONE)
+            error_temp = weights_check_init(bias_weights, embedding_size);
+        if (error_temp != ERROR_NONE) {
+            logger(LOG_E, "petal_init", "Error checking and initializing embedding table: %s",
+                   error_to_str[error_temp]);
+            petal->error_code = error_temp;
+            return petal;
+        }
+    }
+
+    // Initialize states of each timestep for backpropagation through time, input and recurrent weights and bias of
+    // each gate
+    if (petal->petal_type == PETAL_TYPE_LSTM || petal->petal_type == PETAL_TYPE_GRU) {
+        uint32_t timesteps = input_shape->rows;
+        uint32_t hidden_size = rnn_hidden_size(petal);
+        uint32_t gates_length = rnn_gates(petal) * hidden_size;
+        petal->_rnn_gates = (float *) malloc((size_t) timesteps * gates_length * sizeof(float));
+        petal->_rnn_cells = (float *) malloc((size_t) timesteps * hidden_size * sizeof(float));
+        petal->_rnn_hidden = (float *) calloc((size_t) (timesteps + 1U) * hidden_size, sizeof(float));
+        petal->_rnn_gates_grad = (float *) malloc((petal->petal_type == PETAL_TYPE_GRU ? 2U : 1U) * (size_t) timesteps *
+                                                  gates_length * sizeof(float));
+        petal->_rnn_temp = (float *) malloc(gates_length * sizeof(float));
+        if (!petal->_rnn_gates || !petal->_rnn_cells || !petal->_rnn_hidden || !petal->_rnn_gates_grad ||
+            !petal->_rnn_temp) {
+            logger(LOG_E, "petal_init", "Error allocating memory for recurrent states");
+            petal->error_code = ERROR_MALLOC;
+            return petal;
+        }
+        uint8_t error_temp = weights_check_init(
+            weights, (input_shape->cols * input_shape->depth + hidden_size) * gates_length);
+        if (error_temp == ERROR_NONE)
+            error_temp = weights_check_init(bias_weights, gates_length);
+        if (error_temp != ERROR_NONE) {
+            logger(LOG_E, "petal_init", "Error checking and initializing weights: %s", error_to_str[error_temp]);
+            petal->error_code = error_temp;
+            return petal;
+        }
+    }
+
+    // Initialize projections and outputs of heads for backpropagation, tile of scores and projections weights
+    if (petal->petal_type == PETAL_TYPE_ATTENTION) {
+        size_t sequence = input_shape->rows;
+        size_t row_length = input_shape->cols * input_shape->depth;
+        petal->_attention_qkv = (float *) malloc(3U * sequence * row_length * sizeof(float));
+        petal->_attention_heads = (float *) malloc(sequence * row_length * sizeof(float));
+        petal->_attention_temp = (float *) malloc(3U * sequence * row_length * sizeof(float));
+        petal->_attention_grad = (float *) malloc(3U * sequence * row_length * sizeof(float));
+        petal->_attention_stats = (float *) malloc((attention_heads(petal) + 1U) * sequence * sizeof(float));
+        petal->_attention_tile = (float *) malloc(2U * ATTENTION_TILE_QUERIES * ATTENTION_TILE_KEYS * sizeof(float));
+        if (!petal->_attention_qkv || !petal->_attention_heads || !petal->_attention_temp || !petal->_attention_grad ||
+            !petal->_attention_stats || !petal->_attention_tile) {
+            logger(LOG_E, "petal_init", "Error allocating memory for attention buffers");
+            petal->error_code = ERROR_MALLOC;
+            return petal;
+        }
+        uint8_t error_temp = weights_check_init(weights, 4U * row_length * row_length);
+        if (error_temp == ERROR_NONE)
+            error_temp = weights_check_init(bias_weights, 4U * row_length);
+        if (error_temp != ERROR_NONE) {
+            logger(LOG_E, "petal_init", "Error checking and initializing weights: %s", error_to_str[error_temp]);
+            petal->error_code = error_temp;
+            return petal;
+        }
+    }
+
     // Weights and errors initialization
-    if (petal->petal_type == PETAL_TYPE_DENSE_1D) {
-        // Check and initialize weights and bias weights
-        uint8_t error_temp = weights_check_init(weights, petal->input_shape->length * petal->output_shape->length);
+    if (petal->petal_type == PETAL_TYPE_DENSE_1D || petal->petal_type == PETAL_TYPE_CONV_2D) {
+        // Check and initialize weights (one kernel per output channel for convolution) and bias weights
+        uint32_t weights_length = petal->petal_type == PETAL_TYPE_CONV_2D
+                                      ? petal_conv_2d_kernel_length(petal) * petal->output_shape->depth
+                                      : petal->input_shape->length * petal->output_shape->length;
+        uint8_t error_temp = weights_check_init(weights, weights_length);
         if (error_temp == ERROR_NONE) {
-            error_temp = weights_check_init(bias_weights, petal->output_shape->length);
+            error_temp = weights_check_init(bias_weights, petal->petal_type == PETAL_TYPE_CONV_2D
+                                                              ? petal->output_shape->depth
+                                                              : petal->output_shape->length);
             if (error_temp != ERROR_NONE) {
                 logger(LOG_E, "petal_init", "Error checking and initializing bias_weights: %s",
                        error_to_str[error_temp]);
@@ -218,6 +571,237 @@ petal_s *petal_init(uint8_t petal_type, bool first, petal_shape_s *input_shape,
     return petal;
 }
 
+/**
+ * @brief Estimates number of floating-point operations and bytes touched by one forward or backward call
+ * (without activation and dropout)
+ *
+ * @param petal pointer to petal struct
+ * @param backward true to estimate backpropagation or false to estimate forward propagation
+ * @param flops pointer to variable to store number of floating-point operations
+ * @param bytes pointer to variable to store number of bytes read and written
+ */
+void petal_estimate_cost(petal_s *petal, bool backward, uint64_t *flops, uint64_t *bytes) {
+    uint64_t input_length = petal->input_shape->length;
+    uint64_t output_length = petal->output_shape->length;
+    *flops = 0U;
+    *bytes = 0U;
+
+    // Direct petals just copy input (or error) to the output
+    if (petal->petal_type == PETAL_TYPE_DIRECT) {
+        *bytes = (input_length + output_length) * sizeof(float);
+    }
+
+    // Min / max search (2 comparisons) and normalization (5 operations) for each value
+    else if (petal->petal_type == PETAL_TYPE_NORMALIZE_ALL || petal->petal_type == PETAL_TYPE_NORMALIZE_IN_ROWS ||
+             petal->petal_type == PETAL_TYPE_NORMALIZE_IN_CHANNELS) {
+        if (!backward) {
+            *flops = 7U * input_length;
+            *bytes = (2U * input_length + output_length) * sizeof(float);
+        } else
+            *bytes = (input_length + output_length) * sizeof(float);
+    }
+
+    // Convolution: direct convolution FLOPs (Winograd does less, but effective FLOPs are reported) and im2col copy
+    // for CONV_ALGORITHM_IM2COL (backward: weights gradients, input errors and col2im)
+    else if (petal->petal_type == PETAL_TYPE_CONV_2D) {
+        uint64_t positions = (uint64_t) petal->output_shape->rows * petal->output_shape->cols;
+        uint64_t kernel_length = petal_conv_2d_kernel_length(petal);
+        uint64_t filters = petal->output_shape->depth;
+        uint64_t columns_length = petal->_conv_algorithm == CONV_ALGORITHM_IM2COL ? positions * kernel_length : 0U;
+        if (!backward) {
+            *flops = 2U * positions * kernel_length * filters + output_length;
+            *bytes = (input_length + 2U * columns_length + kernel_length * filters + 2U * output_length) *
+                     sizeof(float);
+        } else {
+            *flops = 4U * positions * kernel_length * filters + output_length + columns_length;
+            *bytes = (2U * input_length + 4U * columns_length + 3U * kernel_length * filters + 2U * output_length) *
+                     sizeof(float);
+        }
+    }
+
+    // Pooling: one comparison or addition for each window element (backward: one scatter for each max-pooling output or
+    // window element of average pooling)
+    else if (petal->petal_type == PETAL_TYPE_MAX_POOL_2D || petal->petal_type == PETAL_TYPE_AVG_POOL_2D) {
+        uint64_t window_length = (uint64_t) petal->params.kernel_rows * petal->params.kernel_cols;
+        bool max_pool = petal->petal_type == PETAL_TYPE_MAX_POOL_2D;
+        if (!backward) {
+            *flops = window_length * output_length + (max_pool ? 0U : output_length);
+            *bytes = (window_length * output_length + output_length) * sizeof(float) +
+                     (max_pool ? output_length * sizeof(uint32_t) : 0U);
+        } else if (max_pool) {
+            *flops = output_length;
+            *bytes = (input_length + 2U * output_length) * sizeof(float) + output_length * sizeof(uint32_t);
+        } else {
+            *flops = 2U * window_length * output_length;
+            *bytes = (input_length + 2U * window_length * output_length + output_length) * sizeof(float);
+        }
+    }
+
+    // Batch normalization: statistics (training only, counted anyway), normalization, scale and shift
+    // (backward: gradients of scale and shift and input errors)
+    else if (petal->petal_type == PETAL_TYPE_BATCH_NORM) {
+        uint64_t features = batch_norm_features(petal);
+        if (!backward) {
+            *flops = 8U * input_length + 8U * features;
+            *bytes = (2U * input_length + output_length + 5U * features) * sizeof(float);
+        } else {
+            *flops = 5U * output_length;
+            *bytes = (2U * input_length + output_length + 6U * features) * sizeof(float);
+        }
+    }
+
+    // Layer normalization: single pass statistics, normalization, scale and shift (backward: gradients of scale and
+    // shift, two reductions and input errors)
+    else if (petal->petal_type == PETAL_TYPE_LAYER_NORM) {
+        uint64_t row_length = (uint64_t) petal->input_shape->cols * petal->input_shape->depth;
+        if (!backward) {
+            *flops = 9U * input_length;
+            *bytes = (2U * input_length + output_length + 2U * row_length) * sizeof(float);
+        } else {
+            *flops = 12U * output_length;
+            *bytes = (input_length + 3U * output_length + 5U * row_length) * sizeof(float);
+        }
+    }
+
+    // Embedding: copy of looked up rows and bias (backward: accumulation of their gradients)
+    else if (petal->petal_type == PETAL_TYPE_EMBEDDING) {
+        if (!backward) {
+            *flops = output_length;
+            *bytes = (input_length + 2U * output_length) * sizeof(float);
+        } else {
+            *flops = 2U * output_length;
+            *bytes = (input_length + 3U * output_length) * sizeof(float);
+        }
+    }
+
+    // Recurrent: input projections of all timesteps, recurrent part of each timestep and gates (backward: gates
+    // errors, gradients of input and recurrent weights, errors of hidden state and errors on input)
+    else if (petal->petal_type == PETAL_TYPE_LSTM || petal->petal_type == PETAL_TYPE_GRU) {
+        uint64_t timesteps = petal->input_shape->rows;
+        uint64_t hidden_size = rnn_hidden_size(petal);
+        uint64_t gates_length = rnn_gates(petal) * hidden_size;
+        uint64_t weights_length = (petal->input_shape->cols * petal->input_shape->depth + hidden_size) * gates_length;
+        if (!backward) {
+            *flops = 2U * timesteps * weights_length + 5U * timesteps * gates_length;
+            *bytes = (weights_length + input_length + 2U * timesteps * gates_length + 3U * timesteps * hidden_size +
+                      output_length) *
+                     sizeof(float);
+        } else {
+            *flops = 4U * timesteps * weights_length + 10U * timesteps * gates_length;
+            *bytes = (3U * weights_length + 2U * input_length + 3U * timesteps * gates_length +
+                      3U * timesteps * hidden_size + output_length) *
+                     sizeof(float);
+        }
+    }
+
+    // Attention: projections, scores and weighted sum of values of each head (tiles of keys and values are read once
+    // per tile of queries) and output projection (backward: gradients of projections, recalculated scores, errors of
+    // values, scores, queries and keys and errors on input)
+    else if (petal->petal_type == PETAL_TYPE_ATTENTION) {
+        uint64_t sequence = petal->input_shape->rows;
+        uint64_t row_length = petal->input_shape->cols * petal->input_shape->depth;
+        uint64_t heads = attention_heads(petal);
+        uint64_t weights_length = 4U * row_length * row_length;
+        uint64_t query_tiles = (sequence + ATTENTION_TILE_QUERIES - 1U) / ATTENTION_TILE_QUERIES;
+        if (!backward) {
+            *flops = 2U * sequence * weights_length + 4U * sequence * sequence * row_length +
+                     4U * heads * sequence * sequence;
+            *bytes = (weights_length + input_length + 9U * sequence * row_length +
+                      2U * query_tiles * sequence * row_length + output_length) *
+                     sizeof(float);
+        } else {
+            *flops = 4U * sequence * weights_length + 10U * sequence * sequence * row_length +
+                     4U * heads * sequence * sequence;
+            *bytes = (3U * weights_length + 2U * input_length + 17U * sequence * row_length +
+                      6U * query_tiles * sequence * row_length + output_length) *
+                     sizeof(float);
+        }
+    }
+
+    // Dense: multiply-add for each weight, weights are read once and gradients are read and written once
+    else if (petal->petal_type == PETAL_TYPE_DENSE_1D) {
+        if (!backward) {
+            *flops = 2U * input_length * output_length + output_length;
+            *bytes = (input_length * output_length + input_length + 2U * output_length) * sizeof(float);
+        } else {
+            *flops = 4U * input_length * output_length + 2U * output_length;
+            *bytes = (3U * input_length * output_length + 3U * input_length + 4U * output_length) * sizeof(float);
+        }
+    }
+}
+
+#ifdef PROFILING
+/**
+ * @brief Adds estimated FLOPs and bytes of one forward or backward call and increments number of calls
+ * (use PETAL_PROFILE_COST() macro to compile it out without PROFILING definition)
+ *
+ * @param petal pointer to petal struct
+ * @param backward true for backpropagation or false for forward propagation
+ */
+void petal_profile_cost(petal_s *petal, bool backward) {
+    uint64_t flops, bytes;
+    petal_estimate_cost(petal, backward, &flops, &bytes);
+    petal->_profile.flops += flops;
+    petal->_profile.bytes += bytes;
+    if (backward)
+        petal->_profile.calls_backward++;
+    else
+        petal->_profile.calls_forward++;
+}
+#endif
+
+/**
+ * @brief Estimates number of floating-point operations and bytes touched by one petal_forward_sparse() or
+ * petal_backward_sparse() call (without activation and dropout). Weights (or gradients) of zero inputs are not
+ * touched, so cost scales with number of non-zero inputs
+ *
+ * @param petal pointer to petal struct (PETAL_TYPE_DENSE_1D)
+ * @param nonzeros number of non-zero inputs (sparse_s length)
+ * @param backward true to estimate backpropagation or false to estimate forward propagation
+ * @param flops pointer to variable to store number of floating-point operations
+ * @param bytes pointer to variable to store number of bytes read and written
+ */
+void petal_estimate_cost_sparse(petal_s *petal, uint32_t nonzeros, bool backward, uint64_t *flops,
+                                uint64_t *bytes) {
+    uint64_t nonzeros_length = nonzeros;
+    uint64_t output_length = petal->output_shape->length;
+
+    // Indices and values are read once and each weight of non-zero input is gathered once
+    if (!backward) {
+        *flops = 2U * nonzeros_length * output_length + output_length;
+        *bytes = nonzeros_length * (sizeof(uint32_t) + sizeof(float)) +
+                 (nonzeros_length * output_length + 2U * output_length) * sizeof(float);
+    }
+
+    // Each gradient of non-zero input is read and written once (no errors on input)
+    else {
+        *flops = 2U * nonzeros_length * output_length + output_length;
+        *bytes = nonzeros_length * (sizeof(uint32_t) + sizeof(float)) +
+                 (2U * nonzeros_length * output_length + 4U * output_length) * sizeof(float);
+    }
+}
+
+#ifdef PROFILING
+/**
+ * @brief Adds estimated FLOPs and bytes of one petal_forward_sparse() or petal_backward_sparse() call and
+ * increments number of calls (use PETAL_PROFILE_COST_SPARSE() macro to compile it out without PROFILING definition)
+ *
+ * @param petal pointer to petal struct
+ * @param nonzeros number of non-zero inputs (sparse_s length)
+ * @param backward true for backpropagation or false for forward propagation
+ */
+void petal_profile_cost_sparse(petal_s *petal, uint32_t nonzeros, bool backward) {
+    uint64_t flops, bytes;
+    petal_estimate_cost_sparse(petal, nonzeros, backward, &flops, &bytes);
+    petal->_profile.flops += flops;
+    petal->_profile.bytes += bytes;
+    if (backward)
+        petal->_profile.calls_backward++;
+    else
+        petal->_profile.calls_forward++;
+}
+#endif
+
 /**
  * @brief Estimates minimum size allocated by petal
  *
@@ -254,9 +838,13 @@ size_t petal_estimate_min_size(petal_s *petal) {
         if (petal->bit_array) {
             min_size += sizeof(bit_array_s);
             if (petal->bit_array->data)
-                min_size += petal->output_shape->length * sizeof(BIT_ARRAY_TYPE);
+                min_size += petal->bit_array->_length_in_types * sizeof(BIT_ARRAY_TYPE);
         }
 
+        // _dropout_mask
+        if (petal->_dropout_mask)
+            min_size += petal->output_shape->length * sizeof(float);
+
         // output
         if (petal->output) {
             if (petal->activation && petal->activation->type == ACTIVATION_SOFTMAX)
@@ -267,7 +855,50 @@ size_t petal_estimate_min_size(petal_s *petal) {
 
         // error_on_input
         if (petal->error_on_input)
-            min_size += petal->output_shape->length * sizeof(float);
+            min_size += petal->input_shape->length * sizeof(float);
+
+        // _columns and _conv_kernel
+        if (petal->_columns)
+            min_size += conv_columns_length(petal) * sizeof(float);
+        if (petal->_conv_kernel)
+            min_size += conv_kernel_buffer_length(petal) * sizeof(float);
+
+        // _pool_indices
+        if (petal->_pool_indices)
+            min_size += petal->output_shape->length * sizeof(uint32_t);
+
+        // Running statistics and normalization cache
+        if (petal->_running_mean)
+            min_size += batch_norm_features(petal) * sizeof(float);
+        if (petal->_running_variance)
+            min_size += batch_norm_features(petal) * sizeof(float);
+        if (petal->_inv_std)
+            min_size += (petal->petal_type == PETAL_TYPE_LAYER_NORM ? petal->input_shape->rows
+                                                                     : batch_norm_features(petal)) *
+                        sizeof(float);
+        if (petal->_normalized)
+            min_size += petal->input_shape->length * sizeof(float);
+        if (petal->_batch_stats)
+            min_size += BATCH_NORM_BATCH_STATS * batch_norm_features(petal) * sizeof(float);
+
+        // Recurrent states
+        if (petal->_rnn_gates) {
+            size_t timesteps = petal->input_shape->rows;
+            size_t hidden_size = rnn_hidden_size(petal);
+            size_t gates_length = rnn_gates(petal) * hidden_size;
+            min_size += timesteps * gates_length * sizeof(float);
+            min_size += timesteps * hidden_size * sizeof(float);
+            min_size += (timesteps + 1U) * hidden_size * sizeof(float);
+            min_size += (petal->petal_type == PETAL_TYPE_GRU ? 2U : 1U) * timesteps * gates_length * sizeof(float);
+            min_size += gates_length * sizeof(float);
+        }
+
+        // Attention buffers
+        if (petal->_attention_qkv) {
+            min_size += 10U * petal->input_shape->length * sizeof(float);
+            min_size += (attention_heads(petal) + 1U) * petal->input_shape->rows * sizeof(float);
+            min_size += 2U * ATTENTION_TILE_QUERIES * ATTENTION_TILE_KEYS * sizeof(float);
+        }
     }
     return min_size;
 }
@@ -291,5 +922,45 @@ void petal_destroy(petal_s *petal, bool destroy_weights_structs, bool destroy_we
     if (petal->error_on_input)
         free(petal->error_on_input);
     bit_array_destroy(petal->bit_array);
+    if (petal->_dropout_mask)
+        free(petal->_dropout_mask);
+    if (petal->_columns)
+        free(petal->_columns);
+    if (petal->_conv_kernel)
+        free(petal->_conv_kernel);
+    if (petal->_pool_indices)
+        free(petal->_pool_indices);
+    if (petal->_running_mean)
+        free(petal->_running_mean);
+    if (petal->_running_variance)
+        free(petal->_running_variance);
+    if (petal->_inv_std)
+        free(petal->_inv_std);
+    if (petal->_normalized)
+        free(petal->_normalized);
+    if (petal->_batch_stats)
+        free(petal->_batch_stats);
+    if (petal->_rnn_gates)
+        free(petal->_rnn_gates);
+    if (petal->_rnn_cells)
+        free(petal->_rnn_cells);
+    if (petal->_rnn_hidden)
+        free(petal->_rnn_hidden);
+    if (petal->_rnn_gates_grad)
+        free(petal->_rnn_gates_grad);
+    if (petal->_rnn_temp)
+        free(petal->_rnn_temp);
+    if (petal->_attention_qkv)
+        free(petal->_attention_qkv);
+    if (petal->_attention_heads)
+        free(petal->_attention_heads);
+    if (petal->_attention_temp)
+        free(petal->_attention_temp);
+    if (petal->_attention_grad)
+        free(petal->_attention_grad);
+    if (petal->_attention_stats)
+        free(petal->_attention_stats);
+    if (petal->_attention_tile)
+        free(petal->_attention_tile);
     free(petal);
 }
@@ -0,0 +1,215 @@
+/**
+ * @file pool.c
+ * @author Fern Lane
+ * @brief Max and average 2D pooling (windows are applied to each channel independently)
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "petal.h"
+#include "pool.h"
+
+/**
+ * @brief Calculates number of window elements that are inside input (not in padding)
+ *
+ * @param petal pointer to PETAL_TYPE_AVG_POOL_2D petal
+ * @param output_row row of output
+ * @param output_col column of output
+ * @return uint32_t number of input pixels in window
+ */
+static uint32_t pool_window_size(petal_s *petal, uint32_t output_row, uint32_t output_col) {
+    petal_params_s *params = &petal->params;
+    uint32_t rows = 0U, cols = 0U;
+    for (uint32_t kernel_row = 0; kernel_row < params->kernel_rows; ++kernel_row) {
+        int64_t input_row =
+            (int64_t) output_row * params->stride + (int64_t) kernel_row * params->dilation - params->padding;
+        if (input_row >= 0 && input_row < petal->input_shape->rows)
+            rows++;
+    }
+    for (uint32_t kernel_col = 0; kernel_col < params->kernel_cols; ++kernel_col) {
+        int64_t input_col =
+            (int64_t) output_col * params->stride + (int64_t) kernel_col * params->dilation - params->padding;
+        if (input_col >= 0 && input_col < petal->input_shape->cols)
+            cols++;
+    }
+    return rows * cols;
+}
+
+/**
+ * @brief Calculates maximum of each window (padding is ignored, windows that are entirely inside padding are 0)
+ * Input and output are rows x cols x depth with interleaved channels
+ *
+ * @param petal pointer to PETAL_TYPE_MAX_POOL_2D petal
+ * @param input pointer to input data (petal->input_shape)
+ * @param indices pointer to array (petal->output_shape->length) to store index of input element selected for each
+ * output (POOL_INDEX_NONE for empty windows) or NULL to skip recording (inference)
+ */
+void pool_max_forward(petal_s *petal, const float *input, uint32_t *indices) {
+    petal_shape_s *input_shape = petal->input_shape;
+    petal_params_s *params = &petal->params;
+    uint32_t depth = input_shape->depth;
+    float *output = petal->output;
+    for (uint32_t output_row = 0; output_row < petal->output_shape->rows; ++output_row) {
+        for (uint32_t output_col = 0; output_col < petal->output_shape->cols; ++output_col) {
+            for (uint32_t channel = 0; channel < depth; ++channel)
+                output[channel] = -INFINITY;
+            if (indices)
+                for (uint32_t channel = 0; channel < depth; ++channel)
+                    indices[channel] = POOL_INDEX_NONE;
+
+            bool empty = true;
+            for (uint32_t kernel_row = 0; kernel_row < params->kernel_rows; ++kernel_row) {
+                int64_t input_row = (int64_t) output_row * params->stride + (int64_t) kernel_row * params->dilation -
+                                    params->padding;
+                if (input_row < 0 || input_row >= input_shape->rows)
+                    continue;
+                for (uint32_t kernel_col = 0; kernel_col < params->kernel_cols; ++kernel_col) {
+                    int64_t input_col = (int64_t) output_col * params->stride +
+                                        (int64_t) kernel_col * params->dilation - params->padding;
+                    if (input_col < 0 || input_col >= input_shape->cols)
+                        continue;
+                    empty = false;
+
+                    uint32_t input_index = ((uint32_t) input_row * input_shape->cols + (uint32_t) input_col) * depth;
+                    const float *input_pixel = input + input_index;
+
+                    // Record argmax only during training (index is selected arithmetically, so loop can be vectorized)
+                    if (indices) {
+                        for (uint32_t channel = 0; channel < depth; ++channel) {
+                            float value = input_pixel[channel], max_value = output[channel];
+                            uint32_t max_index = indices[channel];
+                            bool greater = value > max_value;
+                            output[channel] = greater ? value : max_value;
+                            indices[channel] = max_index + (uint32_t) greater * (input_index + channel - max_index);
+                        }
+                    } else
+                        for (uint32_t channel = 0; channel < depth; ++channel) {
+                            float value = input_pixel[channel], max_value = output[channel];
+                            output[channel] = value > max_value ? value : max_value;
+                        }
+                }
+            }
+            if (empty)
+                memset(output, 0, depth * sizeof(float));
+
+            output += depth;
+            if (indices)
+                indices += depth;
+        }
+    }
+}
+
+/**
+ * @brief Scatters errors into input elements selected by pool_max_forward() (without recalculating windows)
+ *
+ * @param petal pointer to PETAL_TYPE_MAX_POOL_2D petal (petal->output must contain errors before activation)
+ * @param indices pointer to array of indices recorded by pool_max_forward() during training forward pass
+ */
+void pool_max_backward(petal_s *petal, const uint32_t *indices) {
+    memset(petal->error_on_input, 0, petal->input_shape->length * sizeof(float));
+    for (uint32_t output_i = 0; output_i < petal->output_shape->length; ++output_i)
+        if (indices[output_i] != POOL_INDEX_NONE)
+            petal->error_on_input[indices[output_i]] += petal->output[output_i];
+}
+
+/**
+ * @brief Calculates average of each window (padding is not counted, windows that are entirely inside padding are 0)
+ * Input and output are rows x cols x depth with interleaved channels
+ *
+ * @param petal pointer to PETAL_TYPE_AVG_POOL_2D petal
+ * @param input pointer to input data (petal->input_shape)
+ */
+void pool_avg_forward(petal_s *petal, const float *input) {
+    petal_shape_s *input_shape = petal->input_shape;
+    petal_params_s *params = &petal->params;
+    uint32_t depth = input_shape->depth;
+    float *output = petal->output;
+    memset(output, 0, petal->output_shape->length * sizeof(float));
+    for (uint32_t output_row = 0; output_row < petal->output_shape->rows; ++output_row) {
+        for (uint32_t output_col = 0; output_col < petal->output_shape->cols; ++output_col) {
+            for (uint32_t kernel_row = 0; kernel_row < params->kernel_rows; ++kernel_row) {
+                int64_t input_row = (int64_t) output_row * params->stride + (int64_t) kernel_row * params->dilation -
+                                    params->padding;
+                if (input_row < 0 || input_row >= input_shape->rows)
+                    continue;
+                for (uint32_t kernel_col = 0; kernel_col < params->kernel_cols; ++kernel_col) {
+                    int64_t input_col = (int64_t) output_col * params->stride +
+                                        (int64_t) kernel_col * params->dilation - params->padding;
+                    if (input_col < 0 || input_col >= input_shape->cols)
+                        continue;
+                    const float *input_pixel =
+                        input + ((uint32_t) input_row * input_shape->cols + (uint32_t) input_col) * depth;
+                    for (uint32_t channel = 0; channel < depth; ++channel)
+                        output[channel] += input_pixel[channel];
+                }
+            }
+
+            uint32_t window_size = pool_window_size(petal, output_row, output_col);
+            if (window_size > 0U) {
+                float scale = 1.f / (float) window_size;
+                for (uint32_t channel = 0; channel < depth; ++channel)
+                    output[channel] *= scale;
+            }
+            output += depth;
+        }
+    }
+}
+
+/**
+ * @brief Spreads errors evenly over input elements of each window
+ *
+ * @param petal pointer to PETAL_TYPE_AVG_POOL_2D petal (petal->output must contain errors before activation)
+ */
+void pool_avg_backward(petal_s *petal) {
+    petal_shape_s *input_shape = petal->input_shape;
+    petal_params_s *params = &petal->params;
+    uint32_t depth = input_shape->depth;
+    const float *output = petal->output;
+    memset(petal->error_on_input, 0, input_shape->length * sizeof(float));
+    for (uint32_t output_row = 0; output_row < petal->output_shape->rows; ++output_row) {
+        for (uint32_t output_col = 0; output_col < petal->output_shape->cols; ++output_col) {
+            uint32_t window_size = pool_window_size(petal, output_row, output_col);
+            if (window_size == 0U) {
+                output += depth;
+                continue;
+            }
+            float scale = 1.f / (float) window_size;
+            for (uint32_t kernel_row = 0; kernel_row < params->kernel_rows; ++kernel_row) {
+                int64_t input_row = (int64_t) output_row * params->stride + (int64_t) kernel_row * params->dilation -
+                                    params->padding;
+                if (input_row < 0 || input_row >= input_shape->rows)
+                    continue;
+                for (uint32_t kernel_col = 0; kernel_col < params->kernel_cols; ++kernel_col) {
+                    int64_t input_col = (int64_t) output_col * params->stride +
+                                        (int64_t) kernel_col * params->dilation - params->padding;
+                    if (input_col < 0 || input_col >= input_shape->cols)
+                        continue;
+                    float *error_pixel = petal->error_on_input +
+                                         ((uint32_t) input_row * input_shape->cols + (uint32_t) input_col) * depth;
+                    for (uint32_t channel = 0; channel < depth; ++channel)
+                        error_pixel[channel] += output[channel] * scale;
+                }
+            }
+            output += depth;
+        }
+    }
+}
@@ -22,6 +22,7 @@
  * You should have received a copy of the GNU Affero General Public License
  * long with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <math.h>
 #include <stdint.h>
 
 #include "random.h"
@@ -58,6 +59,14 @@ inline double rk_double_() { return rk_double(&rk_state_global); }
  */
 inline float rk_float_() { return rk_float(&rk_state_global); }
 
+/**
+ * @brief rk_bounded() but for rk_state_global
+ *
+ * @param bound upper bound (must be greater than 0)
+ * @return uint32_t uniformly distributed value in the [0, bound) interval
+ */
+uint32_t rk_bounded_(uint32_t bound) { return rk_bounded(&rk_state_global, bound); }
+
 /**
  * @brief Initializes rk_state by using seed
  * NOTE: Please make sure rk_seed_() or rk_seed() called at least ones
@@ -76,42 +85,54 @@ void rk_seed(uint32_t seed, rk_state_s *state) {
 }
 
 /**
- * @brief Slightly optimized reference implementation of the Mersenne Twister
+ * @brief Generates next RK_STATE_LEN untempered words of the Mersenne Twister and resets state->pos
  *
  * @param state pointer to rk_state_s struct
- * @return uint32_t uniformly distributed value in the [0, 4294967295] interval (including both ends)
  */
-inline uint32_t rk_random(rk_state_s *state) {
-    uint32_t y;
-
-    if (state->pos == RK_STATE_LEN) {
-        uint32_t i;
+static void rk_twist(rk_state_s *state) {
+    uint32_t y, i;
 
-        for (i = 0; i < N - M; i++) {
-            y = (state->key[i] & UPPER_MASK) | (state->key[i + 1] & LOWER_MASK);
-            state->key[i] = state->key[i + M] ^ (y >> 1U) ^ (-(y & 1U) & MATRIX_A);
-        }
-        for (i; i < N - 1; i++) {
-            y = (state->key[i] & UPPER_MASK) | (state->key[i + 1] & LOWER_MASK);
-            state->key[i] = state->key[i + (M - N)] ^ (y >> 1U) ^ (-(y & 1U) & MATRIX_A);
-        }
-        y = (state->key[N - 1] & UPPER_MASK) | (state->key[0] & LOWER_MASK);
-        state->key[N - 1] = state->key[M - 1U] ^ (y >> 1U) ^ (-(y & 1U) & MATRIX_A);
-
-        state->pos = 0;
+    for (i = 0; i < N - M; i++) {
+        y = (state->key[i] & UPPER_MASK) | (state->key[i + 1] & LOWER_MASK);
+        state->key[i] = state->key[i + M] ^ (y >> 1U) ^ (-(y & 1U) & MATRIX_A);
+    }
+    for (; i < N - 1; i++) {
+        y = (state->key[i] & UPPER_MASK) | (state->key[i + 1] & LOWER_MASK);
+        state->key[i] = state->key[i + (M - N)] ^ (y >> 1U) ^ (-(y & 1U) & MATRIX_A);
     }
+    y = (state->key[N - 1] & UPPER_MASK) | (state->key[0] & LOWER_MASK);
+    state->key[N - 1] = state->key[M - 1U] ^ (y >> 1U) ^ (-(y & 1U) & MATRIX_A);
 
-    y = state->key[state->pos++];
+    state->pos = 0;
+}
 
-    // Tempering
+/**
+ * @brief Mersenne Twister tempering of one word of state
+ *
+ * @param y untempered word
+ * @return uint32_t tempered word
+ */
+static inline uint32_t rk_temper(uint32_t y) {
     y ^= (y >> 11U);
     y ^= (y << 7U) & 0x9d2c5680UL;
     y ^= (y << 15U) & 0xefc60000UL;
     y ^= (y >> 18U);
-
     return y;
 }
 
+/**
+ * @brief Slightly optimized reference implementation of the Mersenne Twister
+ *
+ * @param state pointer to rk_state_s struct
+ * @return uint32_t uniformly distributed value in the [0, 4294967295] interval (including both ends)
+ */
+inline uint32_t rk_random(rk_state_s *state) {
+    if (state->pos == RK_STATE_LEN)
+        rk_twist(state);
+
+    return rk_temper(state->key[state->pos++]);
+}
+
 /**
  * @brief rk_random() but for double
  *
@@ -142,3 +163,269 @@ inline float rk_float(rk_state_s *state) {
     // float result = ((float) a * 67108864.f + (float) b) / 9007199254740992.f;
     // return result > .000001f ? (result < .999999f ? result : .999999f) : .000001f;
 }
+
+/**
+ * @brief Generates unbiased random integer in range using Lemire's nearly divisionless method
+ * (multiplication instead of modulo, additional draws happen with probability less than bound / 2^32)
+ *
+ * @param state pointer to rk_state_s struct
+ * @param bound upper bound (must be greater than 0)
+ * @return uint32_t uniformly distributed value in the [0, bound) interval
+ */
+uint32_t rk_bounded(rk_state_s *state, uint32_t bound) {
+    uint64_t product = (uint64_t) rk_random(state) * bound;
+    uint32_t low = (uint32_t) product;
+    if (low < bound) {
+        // 2^32 mod bound
+        uint32_t threshold = -bound % bound;
+        while (low < threshold) {
+            product = (uint64_t) rk_random(state) * bound;
+            low = (uint32_t) product;
+        }
+    }
+    return (uint32_t) (product >> 32U);
+}
+
+/**
+ * @brief Philox4x32-10 block function (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+ * Output is a bijection of counter for each key, so different counters always give independent blocks
+ *
+ * @param counter 4 32-bit words of counter
+ * @param key 2 32-bit words of key
+ * @param output pointer to array of 4 words to write random block into
+ */
+void rk_philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t output[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    uint64_t product_0, product_1;
+    for (uint32_t round = 0; round < RK_PHILOX_ROUNDS; ++round) {
+        product_0 = (uint64_t) RK_PHILOX_M0 * c0;
+        product_1 = (uint64_t) RK_PHILOX_M1 * c2;
+        c0 = (uint32_t) (product_1 >> 32U) ^ c1 ^ k0;
+        c1 = (uint32_t) product_1;
+        c2 = (uint32_t) (product_0 >> 32U) ^ c3 ^ k1;
+        c3 = (uint32_t) product_0;
+
+        // Bump key (Weyl sequence)
+        k0 += (uint32_t) RK_PHILOX_W0;
+        k1 += (uint32_t) RK_PHILOX_W1;
+    }
+    output[0] = c0;
+    output[1] = c1;
+    output[2] = c2;
+    output[3] = c3;
+}
+
+/**
+ * @brief Initializes counter-based random stream
+ * Streams with the same seed and ids always generate the same sequence
+ *
+ * @param stream pointer to rk_stream_s struct
+ * @param seed any 64-bit value
+ * @param id_1 first stream id (ex. epoch index)
+ * @param id_2 second stream id (ex. sample index)
+ * @param id_3 third stream id (ex. petal index)
+ */
+void rk_stream_init(rk_stream_s *stream, uint64_t seed, uint32_t id_1, uint32_t id_2, uint32_t id_3) {
+    stream->key[0] = (uint32_t) seed;
+    stream->key[1] = (uint32_t) (seed >> 32U);
+    stream->counter[0] = 0U;
+    stream->counter[1] = id_1;
+    stream->counter[2] = id_2;
+    stream->counter[3] = id_3;
+    stream->pos = 4U;
+}
+
+/**
+ * @brief Generates next random word of counter-based stream (one Philox block per 4 words)
+ *
+ * @param stream pointer to rk_stream_s struct
+ * @return uint32_t uniformly distributed value in the [0, 4294967295] interval (including both ends)
+ */
+uint32_t rk_stream_random(rk_stream_s *stream) {
+    if (stream->pos == 4U) {
+        rk_philox4x32(stream->counter, stream->key, stream->buffer);
+        stream->counter[0]++;
+        stream->pos = 0U;
+    }
+    return stream->buffer[stream->pos++];
+}
+
+/**
+ * @brief rk_stream_random() but for float
+ *
+ * @param stream pointer to rk_stream_s struct
+ * @return float a uniformly distributed value in the (0, 1] interval (24 random bits)
+ */
+float rk_stream_float(rk_stream_s *stream) {
+    return (float) ((rk_stream_random(stream) >> 8U) + 1U) * (1.f / 16777216.f);
+}
+
+/**
+ * @brief rk_bounded() but for counter-based stream
+ *
+ * @param stream pointer to rk_stream_s struct
+ * @param bound upper bound (must be greater than 0)
+ * @return uint32_t uniformly distributed value in the [0, bound) interval
+ */
+uint32_t rk_stream_bounded(rk_stream_s *stream, uint32_t bound) {
+    uint64_t product = (uint64_t) rk_stream_random(stream) * bound;
+    uint32_t low = (uint32_t) product;
+    if (low < bound) {
+        // 2^32 mod bound
+        uint32_t threshold = -bound % bound;
+        while (low < threshold) {
+            product = (uint64_t) rk_stream_random(stream) * bound;
+            low = (uint32_t) product;
+        }
+    }
+    return (uint32_t) (product >> 32U);
+}
+
+/**
+ * @brief Fills array with the same sequence of words as length calls of rk_random() would return, but tempers whole
+ * chunks of state at once (branch-free loop that compiler can vectorize)
+ *
+ * @param state pointer to rk_state_s struct
+ * @param dst pointer to array of length words
+ * @param length number of words to generate
+ */
+static void rk_fill_random(rk_state_s *state, uint32_t *dst, uint32_t length) {
+    while (length > 0U) {
+        if (state->pos == RK_STATE_LEN)
+            rk_twist(state);
+
+        uint32_t chunk = RK_STATE_LEN - state->pos;
+        if (chunk > length)
+            chunk = length;
+        const uint32_t *key = state->key + state->pos;
+        for (uint32_t i = 0; i < chunk; ++i)
+            dst[i] = rk_temper(key[i]);
+
+        state->pos += chunk;
+        dst += chunk;
+        length -= chunk;
+    }
+}
+
+/**
+ * @brief Fills array with the same sequence of words as length calls of rk_stream_random() would return
+ *
+ * @param stream pointer to rk_stream_s struct
+ * @param dst pointer to array of length words
+ * @param length number of words to generate
+ */
+static void rk_stream_fill_random(rk_stream_s *stream, uint32_t *dst, uint32_t length) {
+    for (uint32_t i = 0; i < length; ++i)
+        dst[i] = rk_stream_random(stream);
+}
+
+/**
+ * @brief Converts random words into uniformly distributed floats (one word per float)
+ *
+ * @param words pointer to array of length random words
+ * @param dst pointer to array of length floats
+ * @param length number of floats
+ * @param low lower bound (excluded)
+ * @param high upper bound (included)
+ */
+static void rk_words_to_uniform(const uint32_t *words, float *dst, uint32_t length, float low, float high) {
+    float range = high - low;
+    for (uint32_t i = 0; i < length; ++i)
+        dst[i] = low + range * ((float) ((words[i] >> 8U) + 1U) * (1.f / 16777216.f));
+}
+
+/**
+ * @brief Converts pairs of random words into normally distributed floats using Box-Muller transform
+ * (no rejection loop unlike polar method, so each pair of floats always takes exactly 2 random words)
+ *
+ * @param words pointer to array of (length + 1) / 2 * 2 random words
+ * @param dst pointer to array of length floats
+ * @param length number of floats
+ * @param mean center of distribution
+ * @param deviation standard deviation
+ */
+static void rk_words_to_gaussian(const uint32_t *words, float *dst, uint32_t length, float mean, float deviation) {
+    for (uint32_t i = 0; i < (length + 1U) / 2U; ++i) {
+        // u_1: (0, 1] to keep logarithm finite, u_2: [0, 1)
+        float u_1 = (float) ((words[2U * i] >> 8U) + 1U) * (1.f / 16777216.f);
+        float u_2 = (float) (words[2U * i + 1U] >> 8U) * (1.f / 16777216.f);
+        float radius = sqrtf(-2.f * logf(u_1)) * deviation;
+        float theta = RK_TWO_PI * u_2;
+        dst[2U * i] = radius * cosf(theta) + mean;
+        if (2U * i + 1U < length)
+            dst[2U * i + 1U] = radius * sinf(theta) + mean;
+    }
+}
+
+/**
+ * @brief Fills array with uniformly distributed floats (one random word per float instead of two in rk_float())
+ *
+ * @param state pointer to rk_state_s struct
+ * @param dst pointer to array of length floats
+ * @param length number of floats to generate
+ * @param low lower bound (excluded)
+ * @param high upper bound (included)
+ */
+void rk_fill_uniform(rk_state_s *state, float *dst, uint32_t length, float low, float high) {
+    uint32_t words[RK_FILL_CHUNK];
+    for (uint32_t from = 0; from < length; from += RK_FILL_CHUNK) {
+        uint32_t chunk = length - from < RK_FILL_CHUNK ? length - from : RK_FILL_CHUNK;
+        rk_fill_random(state, words, chunk);
+        rk_words_to_uniform(words, dst + from, chunk, low, high);
+    }
+}
+
+/**
+ * @brief Fills array with normally distributed floats using Box-Muller transform
+ *
+ * @param state pointer to rk_state_s struct
+ * @param dst pointer to array of length floats
+ * @param length number of floats to generate
+ * @param mean center of distribution
+ * @param deviation standard deviation
+ */
+void rk_fill_gaussian(rk_state_s *state, float *dst, uint32_t length, float mean, float deviation) {
+    uint32_t words[RK_FILL_CHUNK];
+    for (uint32_t from = 0; from < length; from += RK_FILL_CHUNK) {
+        uint32_t chunk = length - from < RK_FILL_CHUNK ? length - from : RK_FILL_CHUNK;
+        rk_fill_random(state, words, (chunk + 1U) / 2U * 2U);
+        rk_words_to_gaussian(words, dst + from, chunk, mean, deviation);
+    }
+}
+
+/**
+ * @brief rk_fill_uniform() but for counter-based stream
+ *
+ * @param stream pointer to rk_stream_s struct
+ * @param dst pointer to array of length floats
+ * @param length number of floats to generate
+ * @param low lower bound (excluded)
+ * @param high upper bound (included)
+ */
+void rk_stream_fill_uniform(rk_stream_s *stream, float *dst, uint32_t length, float low, float high) {
+    uint32_t words[RK_FILL_CHUNK];
+    for (uint32_t from = 0; from < length; from += RK_FILL_CHUNK) {
+        uint32_t chunk = length - from < RK_FILL_CHUNK ? length - from : RK_FILL_CHUNK;
+        rk_stream_fill_random(stream, words, chunk);
+        rk_words_to_uniform(words, dst + from, chunk, low, high);
+    }
+}
+
+/**
+ * @brief rk_fill_gaussian() but for counter-based stream
+ *
+ * @param stream pointer to rk_stream_s struct
+ * @param dst pointer to array of length floats
+ * @param length number of floats to generate
+ * @param mean center of distribution
+ * @param deviation standard deviation
+ */
+void rk_stream_fill_gaussian(rk_stream_s *stream, float *dst, uint32_t length, float mean, float deviation) {
+    uint32_t words[RK_FILL_CHUNK];
+    for (uint32_t from = 0; from < length; from += RK_FILL_CHUNK) {
+        uint32_t chunk = length - from < RK_FILL_CHUNK ? length - from : RK_FILL_CHUNK;
+        rk_stream_fill_random(stream, words, (chunk + 1U) / 2U * 2U);
+        rk_words_to_gaussian(words, dst + from, chunk, mean, deviation);
+    }
+}
@@ -0,0 +1,289 @@
+/**
+ * @file rnn.c
+ * @author Fern Lane
+ * @brief LSTM and GRU forward propagation and backpropagation through time with fused gate GEMMs
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gemm.h"
+#include "petal.h"
+#include "rnn.h"
+
+// Number of partial sums of dot products of recurrent backpropagation
+#define RNN_DOT_LANES 16U
+
+/**
+ * @brief Calculates sigmoid of one value
+ *
+ * @param x input value
+ * @return float 1 / (1 + e^(-x))
+ */
+static inline float rnn_sigmoid(float x) { return 1.f / (1.f + expf(-x)); }
+
+/**
+ * @brief Number of gates of recurrent petal
+ *
+ * @param petal pointer to PETAL_TYPE_LSTM or PETAL_TYPE_GRU petal
+ * @return uint32_t 4 for LSTM (input, forget, cell and output gates) or 3 for GRU (update, reset and new gates)
+ */
+uint32_t rnn_gates(petal_s *petal) { return petal->petal_type == PETAL_TYPE_LSTM ? 4U : 3U; }
+
+/**
+ * @brief Size of hidden state of recurrent petal (output cols * depth)
+ *
+ * @param petal pointer to PETAL_TYPE_LSTM or PETAL_TYPE_GRU petal
+ * @return uint32_t number of hidden units
+ */
+uint32_t rnn_hidden_size(petal_s *petal) { return petal->output_shape->cols * petal->output_shape->depth; }
+
+/**
+ * @brief Adds recurrent part of gates: gates (1 x gates_length) += hidden (1 x hidden_size) * recurrent weights
+ * (hidden_size x gates_length). Rows of weights are added with a vectorizable multiply-add (no packing like in gemm())
+ *
+ * @param hidden pointer to previous hidden state
+ * @param recurrent_weights pointer to recurrent weights
+ * @param hidden_size number of hidden units
+ * @param gates_length number of gates * hidden_size
+ * @param gates pointer to gates of current timestep
+ */
+static void rnn_recurrent_forward(const float *hidden, const float *recurrent_weights, uint32_t hidden_size,
+                                  uint32_t gates_length, float *gates) {
+    for (uint32_t hidden_i = 0; hidden_i < hidden_size; ++hidden_i) {
+        float hidden_value = hidden[hidden_i];
+        if (hidden_value == 0.f)
+            continue;
+        const float *weights_row = recurrent_weights + (size_t) hidden_i * gates_length;
+        for (uint32_t gate_i = 0; gate_i < gates_length; ++gate_i)
+            gates[gate_i] += hidden_value * weights_row[gate_i];
+    }
+}
+
+/**
+ * @brief Backpropagates errors of gates into previous hidden state: hidden_errors (1 x hidden_size) +=
+ * recurrent weights (hidden_size x gates_length) * gates_errors (gates_length)
+ *
+ * @param recurrent_weights pointer to recurrent weights
+ * @param gates_errors pointer to errors of gates (before activation) of current timestep
+ * @param hidden_size number of hidden units
+ * @param gates_length number of gates * hidden_size
+ * @param hidden_errors pointer to errors of previous hidden state
+ */
+static void rnn_recurrent_backward(const float *recurrent_weights, const float *gates_errors, uint32_t hidden_size,
+                                   uint32_t gates_length, float *hidden_errors) {
+    for (uint32_t hidden_i = 0; hidden_i < hidden_size; ++hidden_i) {
+        const float *weights_row = recurrent_weights + (size_t) hidden_i * gates_length;
+
+        // Independent partial sums, so dot product is vectorized without reordering of floating-point additions
+        float sums[RNN_DOT_LANES] = {0.f};
+        uint32_t gate_i = 0;
+        for (; gate_i + RNN_DOT_LANES <= gates_length; gate_i += RNN_DOT_LANES)
+            for (uint32_t lane = 0; lane < RNN_DOT_LANES; ++lane)
+                sums[lane] += weights_row[gate_i + lane] * gates_errors[gate_i + lane];
+        float sum = 0.f;
+        for (uint32_t lane = 0; lane < RNN_DOT_LANES; ++lane)
+            sum += sums[lane];
+        for (; gate_i < gates_length; ++gate_i)
+            sum += weights_row[gate_i] * gates_errors[gate_i];
+        hidden_errors[hidden_i] += sum;
+    }
+}
+
+/**
+ * @brief LSTM or GRU forward propagation over timesteps (rows of input)
+ * Weights are (features + hidden_size) x (gates * hidden_size) matrix: input weights of all gates followed by
+ * recurrent weights of all gates. Input projections of all timesteps are calculated with a single gemm() call, only
+ * recurrent part is sequential. Activated gates, cells (LSTM) or recurrent part of new gate (GRU) and hidden states
+ * are kept for backpropagation through time
+ *
+ * LSTM: i, f, o = sigmoid, g = tanh, c = f * c_prev + i * g, h = o * tanh(c)
+ * GRU: z, r = sigmoid, n = tanh(x * W_n + b_n + r * (h_prev * U_n)), h = (1 - z) * n + z * h_prev
+ *
+ * @param petal pointer to PETAL_TYPE_LSTM or PETAL_TYPE_GRU petal
+ * @param input pointer to timesteps x features input
+ */
+void rnn_forward(petal_s *petal, const float *input) {
+    uint32_t timesteps = petal->input_shape->rows;
+    uint32_t features = petal->input_shape->cols * petal->input_shape->depth;
+    uint32_t hidden_size = rnn_hidden_size(petal);
+    uint32_t gates_length = rnn_gates(petal) * hidden_size;
+    const float *input_weights = petal->weights->weights;
+    const float *recurrent_weights = input_weights + (size_t) features * gates_length;
+
+    // Input projections of all timesteps (timesteps x gates_length) = input * input weights + bias
+    gemm(false, false, timesteps, gates_length, features, 1.f, input, input_weights, 0.f, petal->_rnn_gates);
+    if (petal->bias_weights && petal->bias_weights->weights)
+        for (uint32_t timestep = 0; timestep < timesteps; ++timestep)
+            for (uint32_t gate_i = 0; gate_i < gates_length; ++gate_i)
+                petal->_rnn_gates[timestep * gates_length + gate_i] += petal->bias_weights->weights[gate_i];
+
+    // Recurrent part (first row of _rnn_hidden is initial zero state)
+    for (uint32_t timestep = 0; timestep < timesteps; ++timestep) {
+        float *gates = petal->_rnn_gates + (size_t) timestep * gates_length;
+        const float *hidden_prev = petal->_rnn_hidden + (size_t) timestep * hidden_size;
+        float *hidden = petal->_rnn_hidden + (size_t) (timestep + 1U) * hidden_size;
+        float *cells = petal->_rnn_cells + (size_t) timestep * hidden_size;
+
+        if (petal->petal_type == PETAL_TYPE_LSTM) {
+            const float *cells_prev = cells - hidden_size;
+            rnn_recurrent_forward(hidden_prev, recurrent_weights, hidden_size, gates_length, gates);
+            for (uint32_t i = 0; i < hidden_size; ++i) {
+                float gate_i = rnn_sigmoid(gates[i]);
+                float gate_f = rnn_sigmoid(gates[hidden_size + i]);
+                float gate_g = tanhf(gates[2U * hidden_size + i]);
+                float gate_o = rnn_sigmoid(gates[3U * hidden_size + i]);
+                float cell = gate_i * gate_g + (timestep > 0U ? gate_f * cells_prev[i] : 0.f);
+                gates[i] = gate_i;
+                gates[hidden_size + i] = gate_f;
+                gates[2U * hidden_size + i] = gate_g;
+                gates[3U * hidden_size + i] = gate_o;
+                cells[i] = cell;
+                hidden[i] = gate_o * tanhf(cell);
+            }
+        }
+
+        // GRU needs recurrent part of new gate separately (it's multiplied by reset gate)
+        else {
+            float *recurrent = petal->_rnn_temp;
+            memset(recurrent, 0, gates_length * sizeof(float));
+            rnn_recurrent_forward(hidden_prev, recurrent_weights, hidden_size, gates_length, recurrent);
+            for (uint32_t i = 0; i < hidden_size; ++i) {
+                float gate_z = rnn_sigmoid(gates[i] + recurrent[i]);
+                float gate_r = rnn_sigmoid(gates[hidden_size + i] + recurrent[hidden_size + i]);
+                float gate_n = tanhf(gates[2U * hidden_size + i] + gate_r * recurrent[2U * hidden_size + i]);
+                gates[i] = gate_z;
+                gates[hidden_size + i] = gate_r;
+                gates[2U * hidden_size + i] = gate_n;
+                cells[i] = recurrent[2U * hidden_size + i];
+                hidden[i] = (1.f - gate_z) * gate_n + gate_z * hidden_prev[i];
+            }
+        }
+    }
+
+    // Hidden state of each timestep or only of the last one
+    if (petal->output_shape->rows == timesteps)
+        memcpy(petal->output, petal->_rnn_hidden + hidden_size, (size_t) timesteps * hidden_size * sizeof(float));
+    else
+        memcpy(petal->output, petal->_rnn_hidden + (size_t) timesteps * hidden_size, hidden_size * sizeof(float));
+}
+
+/**
+ * @brief LSTM or GRU backpropagation through time
+ * Errors of gates (before activation) are calculated sequentially from the last timestep, then gradients of input
+ * and recurrent weights and errors on input are calculated with a single gemm() call each
+ *
+ * @param petal pointer to PETAL_TYPE_LSTM or PETAL_TYPE_GRU petal (petal->output must contain errors on output
+ * before activation, see petal_backward())
+ * @param input pointer to the same input as in the last rnn_forward() call
+ */
+void rnn_backward(petal_s *petal, const float *input) {
+    uint32_t timesteps = petal->input_shape->rows;
+    uint32_t features = petal->input_shape->cols * petal->input_shape->depth;
+    uint32_t hidden_size = rnn_hidden_size(petal);
+    uint32_t gates_length = rnn_gates(petal) * hidden_size;
+    const float *input_weights = petal->weights->weights;
+    const float *recurrent_weights = input_weights + (size_t) features * gates_length;
+    bool sequences = petal->output_shape->rows == timesteps;
+
+    // Errors of gates for input weights and for recurrent weights (they differ only in new gate of GRU)
+    float *gates_errors_input = petal->_rnn_gates_grad;
+    float *gates_errors_recurrent =
+        petal->petal_type == PETAL_TYPE_GRU ? petal->_rnn_gates_grad + (size_t) timesteps * gates_length
+                                            : petal->_rnn_gates_grad;
+
+    // Errors of hidden state and cell from next timestep
+    float *hidden_errors = petal->_rnn_temp;
+    float *cell_errors = petal->_rnn_temp + hidden_size;
+    memset(petal->_rnn_temp, 0, 2U * hidden_size * sizeof(float));
+
+    for (uint32_t timestep = timesteps; timestep-- > 0U;) {
+        const float *output_errors =
+            sequences ? petal->output + (size_t) timestep * hidden_size
+                      : (timestep == timesteps - 1U ? petal->output : NULL);
+        const float *gates = petal->_rnn_gates + (size_t) timestep * gates_length;
+        const float *hidden_prev = petal->_rnn_hidden + (size_t) timestep * hidden_size;
+        const float *cells = petal->_rnn_cells + (size_t) timestep * hidden_size;
+        float *errors_input = gates_errors_input + (size_t) timestep * gates_length;
+        float *errors_recurrent = gates_errors_recurrent + (size_t) timestep * gates_length;
+
+        if (petal->petal_type == PETAL_TYPE_LSTM) {
+            const float *cells_prev = cells - hidden_size;
+            for (uint32_t i = 0; i < hidden_size; ++i) {
+                float hidden_error = hidden_errors[i] + (output_errors ? output_errors[i] : 0.f);
+                float gate_i = gates[i];
+                float gate_f = gates[hidden_size + i];
+                float gate_g = gates[2U * hidden_size + i];
+                float gate_o = gates[3U * hidden_size + i];
+                float cell_tanh = tanhf(cells[i]);
+                float cell_prev = timestep > 0U ? cells_prev[i] : 0.f;
+                float cell_error = cell_errors[i] + hidden_error * gate_o * (1.f - cell_tanh * cell_tanh);
+                errors_input[i] = cell_error * gate_g * gate_i * (1.f - gate_i);
+                errors_input[hidden_size + i] = cell_error * cell_prev * gate_f * (1.f - gate_f);
+                errors_input[2U * hidden_size + i] = cell_error * gate_i * (1.f - gate_g * gate_g);
+                errors_input[3U * hidden_size + i] = hidden_error * cell_tanh * gate_o * (1.f - gate_o);
+                cell_errors[i] = cell_error * gate_f;
+                hidden_errors[i] = 0.f;
+            }
+        } else {
+            for (uint32_t i = 0; i < hidden_size; ++i) {
+                float hidden_error = hidden_errors[i] + (output_errors ? output_errors[i] : 0.f);
+                float gate_z = gates[i];
+                float gate_r = gates[hidden_size + i];
+                float gate_n = gates[2U * hidden_size + i];
+                float error_n = hidden_error * (1.f - gate_z) * (1.f - gate_n * gate_n);
+                float error_z = hidden_error * (hidden_prev[i] - gate_n) * gate_z * (1.f - gate_z);
+                float error_r = error_n * cells[i] * gate_r * (1.f - gate_r);
+                errors_input[i] = error_z;
+                errors_input[hidden_size + i] = error_r;
+                errors_input[2U * hidden_size + i] = error_n;
+                errors_recurrent[i] = error_z;
+                errors_recurrent[hidden_size + i] = error_r;
+                errors_recurrent[2U * hidden_size + i] = error_n * gate_r;
+                hidden_errors[i] = hidden_error * gate_z;
+            }
+        }
+
+        // Initial state is constant
+        if (timestep > 0U)
+            rnn_recurrent_backward(recurrent_weights, errors_recurrent, hidden_size, gates_length, hidden_errors);
+    }
+
+    // Gradients of input weights (features x gates_length) += input^T * gates errors and recurrent weights
+    // (hidden_size x gates_length) += previous hidden states^T * gates errors
+    if (petal->weights->trainable) {
+        gemm(true, false, features, gates_length, timesteps, 1.f, input, gates_errors_input, 1.f,
+             petal->weights->gradients);
+        gemm(true, false, hidden_size, gates_length, timesteps, 1.f, petal->_rnn_hidden, gates_errors_recurrent, 1.f,
+             petal->weights->gradients + (size_t) features * gates_length);
+    }
+
+    // Gradients of bias weights
+    if (petal->bias_weights && petal->bias_weights->trainable)
+        for (uint32_t timestep = 0; timestep < timesteps; ++timestep)
+            for (uint32_t gate_i = 0; gate_i < gates_length; ++gate_i)
+                petal->bias_weights->gradients[gate_i] += gates_errors_input[timestep * gates_length + gate_i];
+
+    // Errors on input (timesteps x features) = gates errors * input weights^T
+    if (!petal->first)
+        gemm(false, true, timesteps, features, gates_length, 1.f, gates_errors_input, input_weights, 0.f,
+             petal->error_on_input);
+}
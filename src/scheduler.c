@@ -0,0 +1,152 @@
+/**
+ * @file scheduler.c
+ * @author Fern Lane
+ * @brief Learning rate schedulers
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "logger.h"
+#include "scheduler.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * @brief Resets internal state of scheduler (called at the beginning of each flower_train())
+ *
+ * @param scheduler pointer to scheduler_s struct or NULL
+ */
+void scheduler_reset(scheduler_s *scheduler) {
+    if (!scheduler)
+        return;
+    scheduler->_factor = 1.f;
+    scheduler->_loss_best = INFINITY;
+    scheduler->_epochs_waiting = 0U;
+}
+
+/**
+ * @brief Calculates learning rate for current optimizer step
+ *
+ * @param scheduler pointer to scheduler_s struct or NULL (NULL = constant learning rate)
+ * @param learning_rate_base optimizer's learning rate (peak learning rate for SCHEDULER_ONE_CYCLE and
+ * SCHEDULER_COSINE_WARMUP)
+ * @param step index of current optimizer step (batch) from the start of training
+ * @param steps_total total number of optimizer steps (epochs * batches per epoch)
+ * @return float learning rate for current step
+ */
+float scheduler_get_learning_rate(scheduler_s *scheduler, float learning_rate_base, uint64_t step,
+                                  uint64_t steps_total) {
+    if (!scheduler || scheduler->type == SCHEDULER_CONSTANT)
+        return learning_rate_base;
+
+    // Prevent division by zero
+    uint32_t decay_steps = scheduler->decay_steps > 0U ? scheduler->decay_steps : 1U;
+    if (steps_total == 0U)
+        steps_total = 1U;
+
+    // Step decay
+    // lr = base * gamma ^ floor(step / decay_steps)
+    if (scheduler->type == SCHEDULER_STEP)
+        return learning_rate_base * powf(scheduler->gamma, (float) (step / decay_steps));
+
+    // Exponential decay
+    // lr = base * gamma ^ (step / decay_steps)
+    else if (scheduler->type == SCHEDULER_EXPONENTIAL)
+        return learning_rate_base * powf(scheduler->gamma, (float) step / (float) decay_steps);
+
+    // Linear warmup followed by cosine annealing
+    // lr = min + (base - min) * (1 + cos(pi * progress)) / 2
+    else if (scheduler->type == SCHEDULER_COSINE_WARMUP) {
+        if (step < scheduler->warmup_steps)
+            return learning_rate_base * (float) (step + 1U) / (float) scheduler->warmup_steps;
+
+        float progress = 1.f;
+        if (steps_total > scheduler->warmup_steps)
+            progress = (float) (step - scheduler->warmup_steps) / (float) (steps_total - scheduler->warmup_steps);
+        if (progress > 1.f)
+            progress = 1.f;
+        return scheduler->learning_rate_min + .5f * (learning_rate_base - scheduler->learning_rate_min) *
+                                                  (1.f + cosf((float) M_PI * progress));
+    }
+
+    // One-cycle policy: cosine increase from min to base and then cosine decrease from base to min
+    else if (scheduler->type == SCHEDULER_ONE_CYCLE) {
+        uint64_t steps_up = (uint64_t) ((float) steps_total * scheduler->warmup_ratio);
+        if (steps_up == 0U)
+            steps_up = 1U;
+
+        float progress;
+        float learning_rate_from, learning_rate_to;
+        if (step < steps_up) {
+            progress = (float) step / (float) steps_up;
+            learning_rate_from = scheduler->learning_rate_min;
+            learning_rate_to = learning_rate_base;
+        } else {
+            progress = steps_total > steps_up ? (float) (step - steps_up) / (float) (steps_total - steps_up) : 1.f;
+            if (progress > 1.f)
+                progress = 1.f;
+            learning_rate_from = learning_rate_base;
+            learning_rate_to = scheduler->learning_rate_min;
+        }
+        return learning_rate_to +
+               .5f * (learning_rate_from - learning_rate_to) * (1.f + cosf((float) M_PI * progress));
+    }
+
+    // Reduce on plateau (factor is updated by scheduler_epoch_end())
+    else if (scheduler->type == SCHEDULER_REDUCE_ON_PLATEAU) {
+        float learning_rate = learning_rate_base * scheduler->_factor;
+        return learning_rate > scheduler->learning_rate_min ? learning_rate : scheduler->learning_rate_min;
+    }
+
+    // Wrong type
+    logger(LOG_W, "scheduler_get_learning_rate", "Wrong scheduler type: %u. Using constant learning rate",
+           scheduler->type);
+    return learning_rate_base;
+}
+
+/**
+ * @brief Updates scheduler at the end of each epoch (used by SCHEDULER_REDUCE_ON_PLATEAU)
+ *
+ * @param scheduler pointer to scheduler_s struct or NULL
+ * @param loss monitored loss (validation loss or training loss if there is no validation dataset)
+ */
+void scheduler_epoch_end(scheduler_s *scheduler, float loss) {
+    if (!scheduler || scheduler->type != SCHEDULER_REDUCE_ON_PLATEAU)
+        return;
+
+    // Improved
+    if (loss < scheduler->_loss_best - scheduler->min_delta) {
+        scheduler->_loss_best = loss;
+        scheduler->_epochs_waiting = 0U;
+        return;
+    }
+
+    // Reduce learning rate if there were no improvements for too long
+    scheduler->_epochs_waiting++;
+    if (scheduler->_epochs_waiting >= scheduler->patience) {
+        scheduler->_factor *= scheduler->gamma;
+        scheduler->_epochs_waiting = 0U;
+        logger(LOG_I, "scheduler_epoch_end", "No improvement. Learning rate factor reduced to %.6f",
+               scheduler->_factor);
+    }
+}
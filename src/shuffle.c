@@ -26,58 +26,77 @@
 #include <string.h>
 
 #include "errors.h"
+#include "labeling.h"
 #include "logger.h"
 #include "random.h"
 
 /**
- * @brief Shuffles internal arrays of 2d arrays
+ * @brief Shuffles internal arrays of 2d arrays (unbiased Fisher-Yates shuffle, rows of both arrays are swapped in
+ * the same way). The same stream (seed and ids) always gives the same permutation
  *
  * @param array_1 2D array pointer
- * @param array_2 2D array pointer
+ * @param array_2 2D array pointer or NULL to shuffle only array_1
  * @param array_length number of internal arrays in each array (rows)
  * @param element_size_1 size of each internal array inside array_1 in bytes (cols * sizeof(type of element))
  * @param element_size_2 size of each internal array inside array_2 in bytes (cols * sizeof(type of element))
+ * @param stream pointer to rk_stream_s struct or NULL to use rk_state_global
  * @return true shuffled successfully
  * @return false memory allocation error
  */
 bool shuffle_2d(float **array_1, float **array_2, uint32_t array_length, uint32_t element_size_1,
-                uint32_t element_size_2) {
-    // Allocate buffer with size of internal data
-    float *buffer_1 = malloc(element_size_1);
-    if (!buffer_1) {
-        logger(LOG_E, "shuffle_2d", "Error allocating memory for *buffer_1 array");
-        return false;
-    }
-    float *buffer_2 = malloc(element_size_2);
-    if (!buffer_2) {
-        logger(LOG_E, "shuffle_2d", "Error allocating memory for *buffer_2 array");
+                uint32_t element_size_2, rk_stream_s *stream) {
+    // Allocate buffer with size of the largest internal data
+    float *buffer = malloc(array_2 && element_size_2 > element_size_1 ? element_size_2 : element_size_1);
+    if (!buffer) {
+        logger(LOG_E, "shuffle_2d", "Error allocating memory for *buffer array");
         return false;
     }
 
-    // Randomly swap elements
-    for (uint32_t i = 0; i < array_length; i++) {
+    // Swap each element with random one from [0, i]
+    for (uint32_t i = array_length > 0U ? array_length - 1U : 0U; i > 0U; --i) {
         // Generate random index
-        uint32_t move_to_index = rk_random_() % array_length;
+        uint32_t move_to_index = stream ? rk_stream_bounded(stream, i + 1U) : rk_bounded_(i + 1U);
 
         // Ignore same index
         if (i == move_to_index)
             continue;
 
         // Swap elements in array_1
-        memcpy(buffer_1, array_1[move_to_index], element_size_1);
+        memcpy(buffer, array_1[move_to_index], element_size_1);
         memcpy(array_1[move_to_index], array_1[i], element_size_1);
-        memcpy(array_1[i], buffer_1, element_size_1);
+        memcpy(array_1[i], buffer, element_size_1);
 
         // Swap elements in array_2
-        memcpy(buffer_2, array_2[move_to_index], element_size_2);
-        memcpy(array_2[move_to_index], array_2[i], element_size_2);
-        memcpy(array_2[i], buffer_2, element_size_2);
+        if (array_2) {
+            memcpy(buffer, array_2[move_to_index], element_size_2);
+            memcpy(array_2[move_to_index], array_2[i], element_size_2);
+            memcpy(array_2[i], buffer, element_size_2);
+        }
     }
 
     // Clear memory
-    free(buffer_1);
-    free(buffer_2);
+    free(buffer);
 
     // No errors
     return true;
 }
+
+/**
+ * @brief Shuffles array of sparse labels in the same way as shuffle_2d() does
+ * (call it with a copy of the stream that was passed to shuffle_2d() to keep labels and data together)
+ *
+ * @param labels pointer to array of pointers of labels_s structs
+ * @param labels_length number of labels_s structs
+ * @param stream pointer to rk_stream_s struct or NULL to use rk_state_global
+ */
+void shuffle_labels(labels_s **labels, uint32_t labels_length, rk_stream_s *stream) {
+    labels_s labels_temp;
+    for (uint32_t i = labels_length > 0U ? labels_length - 1U : 0U; i > 0U; --i) {
+        uint32_t move_to_index = stream ? rk_stream_bounded(stream, i + 1U) : rk_bounded_(i + 1U);
+        if (i == move_to_index)
+            continue;
+        labels_temp = *labels[move_to_index];
+        *labels[move_to_index] = *labels[i];
+        *labels[i] = labels_temp;
+    }
+}
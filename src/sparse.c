@@ -0,0 +1,109 @@
+/**
+ * @file sparse.c
+ * @author Fern Lane
+ * @brief Converts vectors between dense and sparse (indices and values) representations
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "logger.h"
+#include "sparse.h"
+
+/**
+ * @brief Converts dense vector into sparse_s struct (indices and values of non-zero elements)
+ *
+ * @param dense pointer to array of data
+ * @param dense_length length of dense array
+ * @return sparse_s* pointer to struct containing non-zero elements or NULL in case of allocation error
+ */
+sparse_s *dense_to_sparse(const float *dense, uint32_t dense_length) {
+    // Allocate sparse_s struct
+    sparse_s *sparse = (sparse_s *) calloc(1U, sizeof(sparse_s));
+    if (!sparse) {
+        logger(LOG_E, "dense_to_sparse", "Error allocating memory for sparse_s struct");
+        return NULL;
+    }
+
+    // Count non-zero elements to allocate arrays only once
+    for (uint32_t i = 0; i < dense_length; ++i)
+        if (dense[i] != 0.f)
+            sparse->length++;
+    if (sparse->length == 0U)
+        return sparse;
+
+    // Allocate arrays
+    sparse->indices = (uint32_t *) malloc(sparse->length * sizeof(uint32_t));
+    sparse->values = (float *) malloc(sparse->length * sizeof(float));
+    if (!sparse->indices || !sparse->values) {
+        logger(LOG_E, "dense_to_sparse", "Error allocating memory for sparse->indices or sparse->values arrays");
+        sparse_destroy(sparse);
+        return NULL;
+    }
+
+    // Copy non-zero elements
+    uint32_t nonzero_i = 0U;
+    for (uint32_t i = 0; i < dense_length; ++i)
+        if (dense[i] != 0.f) {
+            sparse->indices[nonzero_i] = i;
+            sparse->values[nonzero_i] = dense[i];
+            nonzero_i++;
+        }
+
+    return sparse;
+}
+
+/**
+ * @brief Converts sparse_s struct into dense vector (values of repeated indices are summed)
+ *
+ * @param sparse pointer to struct containing non-zero elements
+ * @param dense pointer to target array to store data
+ * @param dense_length length of target array
+ */
+void sparse_to_dense(const sparse_s *sparse, float *dense, uint32_t dense_length) {
+    // Fill entire array with zeros
+    for (uint32_t i = 0; i < dense_length; ++i)
+        dense[i] = 0.f;
+
+    for (uint32_t i = 0; i < sparse->length; ++i) {
+        // Check index and add value
+        if (sparse->indices[i] < dense_length)
+            dense[sparse->indices[i]] += sparse->values[i];
+
+        // Log error
+        else
+            logger(LOG_E, "sparse_to_dense", "Index %u is out of bounds for array with size %u", sparse->indices[i],
+                   dense_length);
+    }
+}
+
+/**
+ * @brief Frees memory allocated by sparse struct
+ *
+ * @param sparse pointer to sparse_s struct
+ */
+void sparse_destroy(sparse_s *sparse) {
+    if (sparse) {
+        if (sparse->indices)
+            free(sparse->indices);
+        if (sparse->values)
+            free(sparse->values);
+        free(sparse);
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * @file timer.c
+ * @author Fern Lane
+ * @brief High-resolution monotonic timer
+ *
+ * @copyright Copyright (c) 2023-2024 Fern Lane
+ *
+ * This file is part of the PetalFlow distribution <https://github.com/F33RNI/PetalFlow>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * long with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "timer.h"
+
+/**
+ * @brief Returns current time of monotonic clock
+ * (clock_gettime(CLOCK_MONOTONIC) or QueryPerformanceCounter() on Windows)
+ *
+ * @return uint64_t nanoseconds since unspecified starting point (use only to calculate time differences)
+ */
+uint64_t timer_get_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t) (counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t) (counter.QuadPart % frequency.QuadPart) * 1000000000ULL / (uint64_t) frequency.QuadPart;
+#else
+    struct timespec time_spec;
+    clock_gettime(CLOCK_MONOTONIC, &time_spec);
+    return (uint64_t) time_spec.tv_sec * 1000000000ULL + (uint64_t) time_spec.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Converts nanoseconds into seconds
+ *
+ * @param ns time in nanoseconds
+ * @return double time in seconds
+ */
+double timer_ns_to_s(uint64_t ns) {
+    return (double) ns / 1e9;
+}
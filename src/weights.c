@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bit_array.h"
 #include "errors.h"
 #include "logger.h"
 #include "optimizers.h"
@@ -96,35 +97,40 @@ uint8_t weights_init(weights_s *weights, bool from_self) {
     }
 
     // Initialize weights
-    // All elemets = center (zeros / ones / constant)
-    if (weights->initializer == WEIGHTS_INIT_CONSTANT) {
-        for (uint32_t i = 0; i < weights->length_total; ++i)
-            weights->weights[i] = weights->center;
+    // Keep zeros (weights will be loaded later)
+    if (weights->initializer == WEIGHTS_INIT_NONE) {
+        // Nothing to do (weights are allocated using calloc)
     }
 
-    // Uniform random distribution
-    else if (weights->initializer == WEIGHTS_INIT_RANDOM_UNIFORM) {
+    // All elemets = center (zeros / ones / constant)
+    else if (weights->initializer == WEIGHTS_INIT_CONSTANT) {
         for (uint32_t i = 0; i < weights->length_total; ++i)
-            weights->weights[i] = (rk_float_() * 2.0 * weights->deviation) + weights->center - weights->deviation;
+            weights->weights[i] = weights->center;
     }
 
-    // Gaussian normal distribution
-    else if (weights->initializer == WEIGHTS_INIT_RANDOM_GAUSSIAN) {
-        float x, y, rsq, f;
-        for (uint32_t i = 0; i < weights->length_total; i += 2) {
-            do {
-                // x and y: -1 to 1
-                x = rk_float_() * 2.f - 1.0;
-                y = rk_float_() * 2.f - 1.0;
-                rsq = x * x + y * y;
-            } while (rsq >= 1.f || rsq == 0.f);
-
-            f = sqrtf(-2.f * logf(rsq) / rsq);
-
-            // Assign two elements at ones
-            weights->weights[i] = x * f * weights->deviation + weights->center;
-            if (i < weights->length_total - 1)
-                weights->weights[i + 1] = y * f * weights->deviation + weights->center;
+    // Uniform random or gaussian normal distribution. Each chunk has its own random stream (seeded once from
+    // rk_state_global), so values don't depend on number of threads and order in which chunks are initialized
+    else if (weights->initializer == WEIGHTS_INIT_RANDOM_UNIFORM ||
+             weights->initializer == WEIGHTS_INIT_RANDOM_GAUSSIAN) {
+        uint64_t seed = ((uint64_t) rk_random_() << 32U) | (uint64_t) rk_random_();
+        int64_t chunks = (int64_t) ((weights->length_total + WEIGHTS_INIT_CHUNK - 1U) / WEIGHTS_INIT_CHUNK);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int64_t chunk_i = 0; chunk_i < chunks; ++chunk_i) {
+            uint32_t from = (uint32_t) chunk_i * WEIGHTS_INIT_CHUNK;
+            uint32_t length = weights->length_total - from;
+            if (length > WEIGHTS_INIT_CHUNK)
+                length = WEIGHTS_INIT_CHUNK;
+
+            rk_stream_s stream;
+            rk_stream_init(&stream, seed, (uint32_t) chunk_i, RK_STREAM_ID_NONE, RK_STREAM_ID_NONE);
+            if (weights->initializer == WEIGHTS_INIT_RANDOM_UNIFORM)
+                rk_stream_fill_uniform(&stream, weights->weights + from, length,
+                                       weights->center - weights->deviation, weights->center + weights->deviation);
+            else
+                rk_stream_fill_gaussian(&stream, weights->weights + from, length, weights->center,
+                                        weights->deviation);
         }
     }
 
@@ -168,42 +174,23 @@ uint8_t weights_init(weights_s *weights, bool from_self) {
 }
 
 /**
- * @brief Updates weights (learning)
+ * @brief Applies optimizer to each stride-th weight from index_from to index_to (exclusive) and resets their gradients
  *
- * @param weights pointer to weights struct with calculated gradients
+ * @param weights pointer to weights_s struct with allocated temp arrays
  * @param optimizer pointer to optimizer_s struct
- * @return uint8_t ERROR_NONE or error code in case of error
+ * @param index_from index of first weight to update
+ * @param index_to index after last weight to update
+ * @param stride step between updated weights (1 for range of weights or row length for column of weights)
+ * @param moment_correction bias correction of moments (for OPTIMIZER_ADAM)
+ * @param velocity_correction bias correction of velocities (for OPTIMIZER_ADAM)
  */
-uint8_t weights_update(weights_s *weights, optimizer_s *optimizer) {
-    // Ignore if weights are non-trainable
-    if (!weights || !weights->trainable)
-        return ERROR_NONE;
-
-    // Allocate temp arrays for learning optimizers
-    bool first_run = false;
-    if (!weights->velocities_or_cache) {
-        first_run = true;
-        weights->velocities_or_cache = calloc(weights->length_total, sizeof(float));
-        if (!weights->velocities_or_cache) {
-            logger(LOG_E, "weights_update", "Error allocating memory for weights->velocities_or_cache");
-            return ERROR_MALLOC;
-        }
-    }
-    if (optimizer->type == OPTIMIZER_ADAM) {
-        if (!weights->moments) {
-            first_run = true;
-            weights->moments = calloc(weights->length_total, sizeof(float));
-            if (!weights->moments) {
-                logger(LOG_E, "weights_update", "Error allocating memory for weights->moments");
-                return ERROR_MALLOC;
-            }
-        }
-    }
-
+static inline void weights_update_range(weights_s *weights, optimizer_s *optimizer, uint32_t index_from,
+                                        uint32_t index_to, uint32_t stride, float moment_correction,
+                                        float velocity_correction) {
     // Stochastic / regular gradient descend with momentum
     if (optimizer->type == OPTIMIZER_SGD_MOMENTUM) {
         if (optimizer->momentum > 0.f)
-            for (uint32_t i = 0; i < weights->length_total; ++i) {
+            for (uint32_t i = index_from; i < index_to; i += stride) {
                 // Calculate velocities
                 weights->velocities_or_cache[i] = optimizer->momentum * weights->velocities_or_cache[i] -
                                                   optimizer->learning_rate * weights->gradients[i];
@@ -212,14 +199,14 @@ uint8_t weights_update(weights_s *weights, optimizer_s *optimizer) {
                 weights->weights[i] += weights->velocities_or_cache[i];
             }
         else
-            for (uint32_t i = 0; i < weights->length_total; ++i)
+            for (uint32_t i = index_from; i < index_to; i += stride)
                 // Update weights
                 weights->weights[i] -= optimizer->learning_rate * weights->gradients[i];
     }
 
     // RMS Prop
     else if (optimizer->type == OPTIMIZER_RMS_PROP) {
-        for (uint32_t i = 0; i < weights->length_total; ++i) {
+        for (uint32_t i = index_from; i < index_to; i += stride) {
             // Update velocities
             weights->velocities_or_cache[i] = optimizer->beta_1 * weights->velocities_or_cache[i] +
                                               (1.f - optimizer->beta_1) * weights->gradients[i] * weights->gradients[i];
@@ -232,7 +219,7 @@ uint8_t weights_update(weights_s *weights, optimizer_s *optimizer) {
 
     // AdaGrad
     else if (optimizer->type == OPTIMIZER_ADA_GRAD) {
-        for (uint32_t i = 0; i < weights->length_total; ++i) {
+        for (uint32_t i = index_from; i < index_to; i += stride) {
             // Update cache
             weights->velocities_or_cache[i] += weights->gradients[i] * weights->gradients[i];
 
@@ -243,9 +230,9 @@ uint8_t weights_update(weights_s *weights, optimizer_s *optimizer) {
     }
 
     // Adam
-    else if (optimizer->type == OPTIMIZER_ADAM) {
+    else {
         float moment_hat, velocity_hat;
-        for (uint32_t i = 0; i < weights->length_total; ++i) {
+        for (uint32_t i = index_from; i < index_to; i += stride) {
             // Update moments
             weights->moments[i] =
                 optimizer->beta_1 * weights->moments[i] + (1.f - optimizer->beta_1) * weights->gradients[i];
@@ -255,26 +242,146 @@ uint8_t weights_update(weights_s *weights, optimizer_s *optimizer) {
                                               (1.f - optimizer->beta_2) * weights->gradients[i] * weights->gradients[i];
 
             // Weights correction
-            moment_hat = weights->moments[i] / (1.f - powf(optimizer->beta_1, (float) weights->_learning_step + 1.f));
-            velocity_hat = weights->velocities_or_cache[i] /
-                           (1.f - powf(optimizer->beta_2, (float) weights->_learning_step + 1.f));
+            moment_hat = weights->moments[i] / moment_correction;
+            velocity_hat = weights->velocities_or_cache[i] / velocity_correction;
 
             // Update weights
             weights->weights[i] -= optimizer->learning_rate * moment_hat / (sqrtf(velocity_hat) + EPSILON);
+        }
+    }
+
+    // Reset gradient sums
+    if (stride == 1U)
+        memset(weights->gradients + index_from, 0, (index_to - index_from) * sizeof(float));
+    else
+        for (uint32_t i = index_from; i < index_to; i += stride)
+            weights->gradients[i] = 0.f;
+}
 
-            // Increment step
-            weights->_learning_step++;
+/**
+ * @brief Enables sparse (row-wise) updates: weights_update() will update only rows marked by
+ * weights_sparse_mark_row() since previous update (lazy optimizer: moments and velocities of other rows are not decayed)
+ *
+ * @param weights pointer to initialized weights_s struct
+ * @param row_length number of weights in each row (length_total must be divisible by it)
+ * @return uint8_t ERROR_NONE or error code in case of error
+ */
+uint8_t weights_sparse_init(weights_s *weights, uint32_t row_length) {
+    if (!weights || !weights->trainable)
+        return ERROR_NONE;
+    weights->_sparse_row_length = row_length;
+    if (!weights->_sparse_rows) {
+        weights->_sparse_rows = bit_array_init(weights->length_total / row_length);
+        if (!weights->_sparse_rows) {
+            logger(LOG_E, "weights_sparse_init", "Error allocating memory for weights->_sparse_rows");
+            return ERROR_MALLOC;
         }
+        if (weights->_sparse_rows->error_code != ERROR_NONE)
+            return weights->_sparse_rows->error_code;
     }
+    return ERROR_NONE;
+}
 
-    // Wrong type
-    else {
+/**
+ * @brief Enables column sparse updates: weights_update() will update only columns marked by weights_sparse_mark_col()
+ * since previous update (lazy optimizer). Used by PETAL_TYPE_DENSE_1D with sparse input (weights are output-major, so
+ * weights of each input are column of weights)
+ *
+ * @param weights pointer to initialized weights_s struct
+ * @param row_length number of weights in each row (length_total must be divisible by it)
+ * @return uint8_t ERROR_NONE or error code in case of error
+ */
+uint8_t weights_sparse_cols_init(weights_s *weights, uint32_t row_length) {
+    if (!weights || !weights->trainable)
+        return ERROR_NONE;
+    weights->_sparse_row_length = row_length;
+    if (!weights->_sparse_cols) {
+        weights->_sparse_cols = bit_array_init(row_length);
+        if (!weights->_sparse_cols) {
+            logger(LOG_E, "weights_sparse_cols_init", "Error allocating memory for weights->_sparse_cols");
+            return ERROR_MALLOC;
+        }
+        if (weights->_sparse_cols->error_code != ERROR_NONE)
+            return weights->_sparse_cols->error_code;
+    }
+    return ERROR_NONE;
+}
+
+/**
+ * @brief Updates weights (learning)
+ * Only rows marked by weights_sparse_mark_row() are updated if sparse updates are enabled by weights_sparse_init()
+ * and only columns marked by weights_sparse_mark_col() are updated (column by column) if column sparse updates are
+ * enabled by weights_sparse_cols_init() (all weights are updated at once if each column is marked)
+ *
+ * @param weights pointer to weights struct with calculated gradients
+ * @param optimizer pointer to optimizer_s struct
+ * @return uint8_t ERROR_NONE or error code in case of error
+ */
+uint8_t weights_update(weights_s *weights, optimizer_s *optimizer) {
+    // Ignore if weights are non-trainable
+    if (!weights || !weights->trainable)
+        return ERROR_NONE;
+
+    // Check optimizer
+    if (optimizer->type != OPTIMIZER_SGD_MOMENTUM && optimizer->type != OPTIMIZER_RMS_PROP &&
+        optimizer->type != OPTIMIZER_ADA_GRAD && optimizer->type != OPTIMIZER_ADAM) {
         logger(LOG_E, "weights_update", "Wrong optimizer type: %u", optimizer->type);
         return ERROR_OPTIMIZER_WRONG_TYPE;
     }
 
-    // Reset gradient sums
-    memset(weights->gradients, 0, weights->length_total * sizeof(float));
+    // Allocate temp arrays for learning optimizers
+    if (!weights->velocities_or_cache) {
+        weights->velocities_or_cache = calloc(weights->length_total, sizeof(float));
+        if (!weights->velocities_or_cache) {
+            logger(LOG_E, "weights_update", "Error allocating memory for weights->velocities_or_cache");
+            return ERROR_MALLOC;
+        }
+    }
+    if (optimizer->type == OPTIMIZER_ADAM) {
+        if (!weights->moments) {
+            weights->moments = calloc(weights->length_total, sizeof(float));
+            if (!weights->moments) {
+                logger(LOG_E, "weights_update", "Error allocating memory for weights->moments");
+                return ERROR_MALLOC;
+            }
+        }
+    }
+
+    // Bias corrections of Adam (_learning_step counts updates)
+    float moment_correction = 1.f, velocity_correction = 1.f;
+    if (optimizer->type == OPTIMIZER_ADAM) {
+        moment_correction = 1.f - powf(optimizer->beta_1, (float) weights->_learning_step + 1.f);
+        velocity_correction = 1.f - powf(optimizer->beta_2, (float) weights->_learning_step + 1.f);
+        weights->_learning_step++;
+    }
+
+    // Update only marked rows
+    if (weights->_sparse_rows) {
+        uint32_t row_length = weights->_sparse_row_length;
+        BIT_ARRAY_FOR_EACH_SET(weights->_sparse_rows, row) {
+            weights_update_range(weights, optimizer, row * row_length, row * row_length + row_length, 1U,
+                                 moment_correction, velocity_correction);
+        }
+        bit_array_clear(weights->_sparse_rows);
+    }
+
+    // Update only marked columns
+    else if (weights->_sparse_cols && bit_array_count(weights->_sparse_cols) < weights->_sparse_row_length) {
+        uint32_t row_length = weights->_sparse_row_length;
+        BIT_ARRAY_FOR_EACH_SET(weights->_sparse_cols, col) {
+            weights_update_range(weights, optimizer, col, weights->length_total, row_length, moment_correction,
+                                 velocity_correction);
+        }
+        bit_array_clear(weights->_sparse_cols);
+    }
+
+    // Update all weights
+    else {
+        weights_update_range(weights, optimizer, 0U, weights->length_total, 1U, moment_correction,
+                             velocity_correction);
+        if (weights->_sparse_cols)
+            bit_array_clear(weights->_sparse_cols);
+    }
 
     // No error
     return ERROR_NONE;
@@ -307,6 +414,14 @@ size_t weights_estimate_min_size(weights_s *weights) {
         // velocities_or_cache
         if (weights->velocities_or_cache)
             min_size += weights->length_total * sizeof(float);
+
+        // _sparse_rows
+        if (weights->_sparse_rows)
+            min_size += sizeof(bit_array_s) + weights->_sparse_rows->_length_in_types * sizeof(BIT_ARRAY_TYPE);
+
+        // _sparse_cols
+        if (weights->_sparse_cols)
+            min_size += sizeof(bit_array_s) + weights->_sparse_cols->_length_in_types * sizeof(BIT_ARRAY_TYPE);
     }
     return min_size;
 }
@@ -333,6 +448,8 @@ void weights_destroy(weights_s *weights, bool destroy_struct, bool destroy_inter
             free(weights->moments);
         if (weights->velocities_or_cache)
             free(weights->velocities_or_cache);
+        bit_array_destroy(weights->_sparse_rows);
+        bit_array_destroy(weights->_sparse_cols);
         if (destroy_struct)
             free(weights);
     }
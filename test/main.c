@@ -28,7 +28,9 @@
 #include <string.h>
 
 #include "activation.h"
+#include "conv.h"
 #include "dropout.h"
+#include "early_stopping.h"
 #include "errors.h"
 #include "flower.h"
 #include "loss.h"
@@ -36,6 +38,9 @@
 #include "optimizers.h"
 #include "petal.h"
 #include "random.h"
+#include "scheduler.h"
+#include "sparse.h"
+#include "timer.h"
 
 // h for approximating derivative
 #define PERTURB_H 0.001f
@@ -178,11 +183,11 @@ bool check_activation(activation_s *activation, float *test_data, uint32_t test_
     }
 
     // Forward
-    activation_forward(activation, test_temp_forward, test_data_length, NULL);
+    activation_forward(activation, test_temp_forward, test_data_length);
     print_array(test_temp_forward, 1U, test_data_length, 1U);
 
     // Forward + epsilon
-    activation_forward(activation, test_temp, test_data_length, NULL);
+    activation_forward(activation, test_temp, test_data_length);
 
     // Calculate derivative approximation
     for (uint32_t i = 0; i < test_data_length; ++i)
@@ -192,7 +197,7 @@ bool check_activation(activation_s *activation, float *test_data, uint32_t test_
     // Softmax
     if (activation->type == ACTIVATION_SOFTMAX) {
         printf("Derivative:\n");
-        activation_backward(activation, test_temp_forward, test_data_length, NULL);
+        activation_backward(activation, test_temp_forward, test_data_length);
         print_array(test_temp_forward, test_data_length, test_data_length, 1U);
         float softmax_check[] = {
             0.011520363521412946f,  -0.00036932676448486745f, -0.0010039341868832707f, -0.0027289760764688253f,
@@ -209,7 +214,7 @@ bool check_activation(activation_s *activation, float *test_data, uint32_t test_
     else {
         // Backward
         printf("Derivative:\t\t\t\t");
-        activation_backward(activation, test_temp_forward, test_data_length, NULL);
+        activation_backward(activation, test_temp_forward, test_data_length);
         print_array(test_temp_forward, 1U, test_data_length, 1U);
 
         // Check
@@ -409,7 +414,7 @@ uint8_t test_dropout(uint32_t bit_size, float target_ratio) {
     bit_array_s *bit_array = bit_array_init(bit_size);
 
     // Calculate dropout
-    dropout_generate_indices(bit_array, target_ratio);
+    dropout_generate_indices(bit_array, target_ratio, NULL);
 
     // Calculate ones and print array
     printf("Array of bits: ");
@@ -439,6 +444,452 @@ uint8_t test_dropout(uint32_t bit_size, float target_ratio) {
     return 1;
 }
 
+/**
+ * @brief Tests Bernoulli dropout: ratio of dropped bits must be close to probability
+ *
+ * @param length array size
+ * @param target_ratio drop probability (0 to 1)
+ * @return uint8_t number of fails (0 or 1)
+ */
+uint8_t test_dropout_bernoulli(uint32_t length, float target_ratio) {
+    printf("\nTesting Bernoulli dropout on array with size %u and ratio: %.2f\n", length, target_ratio);
+
+    bit_array_s *bit_array = bit_array_init(length);
+    dropout_generate_bernoulli(bit_array, target_ratio, NULL);
+    float dropped_ratio = (float) bit_array_count(bit_array) / (float) length;
+    printf("Dropped: %u (%.4f%%)\n", bit_array_count(bit_array), dropped_ratio * 100.f);
+    bit_array_destroy(bit_array);
+
+    // 5 standard deviations
+    float tolerance = 5.f * sqrtf(target_ratio * (1.f - target_ratio) / (float) length) + 1e-6f;
+    if (fabsf(target_ratio - dropped_ratio) <= tolerance) {
+        printf("Passed\n");
+        return 0;
+    }
+    printf("Failed\n");
+    return 1;
+}
+
+/**
+ * @brief Tests bit array accessors, popcount and set / cleared bits iteration across word boundaries
+ *
+ * @return uint8_t number of fails (0 or 1)
+ */
+uint8_t test_bit_array() {
+    printf("\nTesting bit array\n");
+
+    // 130 bits = 3 words with 2 used bits in the last one
+    bit_array_s *bit_array = bit_array_init(130U);
+    uint32_t indices[] = {0U, 63U, 64U, 129U};
+    for (uint8_t i = 0; i < 4U; ++i)
+        bit_array_set_bit(bit_array, indices[i]);
+
+    // Iterate set bits
+    uint8_t fails = 0U;
+    uint32_t found = 0U;
+    BIT_ARRAY_FOR_EACH_SET(bit_array, index) {
+        if (found >= 4U || index != indices[found])
+            fails = 1U;
+        found++;
+    }
+    printf("Set bits: %u, popcount: %u, first cleared: %u\n", found, bit_array_count(bit_array),
+           bit_array_next_clear(bit_array, 0U));
+    if (found != 4U || bit_array_count(bit_array) != 4U || bit_array_next_clear(bit_array, 0U) != 1U ||
+        bit_array_next_clear(bit_array, 63U) != 65U)
+        fails = 1U;
+
+    // Invert (padding bits must stay cleared)
+    bit_array_not(bit_array);
+    uint32_t cleared = 0U;
+    BIT_ARRAY_FOR_EACH_CLEAR(bit_array, index) {
+        if (!bit_array_get_bit_unchecked(bit_array, index) && index == indices[cleared])
+            cleared++;
+    }
+    printf("After NOT popcount: %u, cleared: %u\n", bit_array_count(bit_array), cleared);
+    if (bit_array_count(bit_array) != 126U || cleared != 4U || bit_array_next_set(bit_array, 129U) != 130U)
+        fails = 1U;
+
+    // Out-of-bounds access of checked accessor
+    bit_array_get_bit(bit_array, 130U);
+    if (bit_array->error_code != ERROR_BITMAP_ACCESS_OUT_OF_BOUNDS)
+        fails = 1U;
+
+    bit_array_destroy(bit_array);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests dropout keep-mask generation and applying
+ *
+ * @param length mask size
+ * @param target_ratio how many indices to drop (ratio 0 to 1)
+ * @return uint8_t number of fails (0 or 1)
+ */
+uint8_t test_dropout_mask(uint32_t length, float target_ratio) {
+    printf("\nTesting dropout mask with size %u and ratio: %.2f\n", length, target_ratio);
+
+    bit_array_s *bit_array = bit_array_init(length);
+    float *mask = calloc(length, sizeof(float));
+    float *layer = malloc(length * sizeof(float));
+    for (uint32_t i = 0; i < length; ++i)
+        layer[i] = 1.f;
+
+    // Generate and apply mask
+    uint8_t error = dropout_generate_mask(bit_array, mask, target_ratio, DROPOUT_MODE_EXACT, NULL);
+    dropout_apply_mask(layer, mask, length);
+
+    // Each value must be dropped or scaled
+    float scaling = target_ratio < 1.f ? 1.f / (1.f - target_ratio) : 0.f;
+    uint32_t dropped = 0U;
+    bool values_ok = true;
+    for (uint32_t i = 0; i < length; ++i) {
+        if (layer[i] == 0.f)
+            dropped++;
+        else if (fabsf(layer[i] - scaling) > 1e-6f)
+            values_ok = false;
+    }
+    float dropped_ratio = (float) dropped / (float) length;
+    printf("Dropped: %u (%.4f%%), scaling: %.4f\n", dropped, dropped_ratio * 100.f, scaling);
+
+    bit_array_destroy(bit_array);
+    free(mask);
+    free(layer);
+
+    if (error == ERROR_NONE && values_ok && fabsf(target_ratio - dropped_ratio) < 0.001f) {
+        printf("Passed\n");
+        return 0;
+    }
+    printf("Failed\n");
+    return 1;
+}
+
+/**
+ * @brief Tests that dropped outputs of dense petal with softmax activation are excluded from softmax sum (kept
+ * outputs are softmax of kept pre-activations scaled by 1 / (1 - ratio))
+ *
+ * @param target_ratio how many outputs to drop (ratio 0 to 1)
+ * @return uint8_t number of fails (0 or 1)
+ */
+uint8_t test_dropout_softmax(float target_ratio) {
+    printf("\nTesting dropout of softmax outputs with ratio: %.2f\n", target_ratio);
+    rk_seed_(0);
+
+    // Dense 8 -> 10 with softmax
+    petal_shape_s input_shape = (petal_shape_s){1U, 8U, 1U, 0UL};
+    petal_shape_s output_shape = (petal_shape_s){1U, 10U, 1U, 0UL};
+    weights_s weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s bias = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    activation_s *activation = malloc(sizeof(activation_s));
+    *activation = (activation_s){ACTIVATION_SOFTMAX, 1.f, 0.f, 0.f, 0.f, 1.f, NULL};
+    petal_params_s params = (petal_params_s){target_ratio, 0.f, 1.f, DROPOUT_MODE_EXACT};
+    petal_s *petal =
+        petal_init(PETAL_TYPE_DENSE_1D, false, &input_shape, &output_shape, &weights, &bias, activation, &params);
+    float input[8];
+    rk_fill_uniform(&rk_state_global, input, 8U, -1.f, 1.f);
+    petal_forward(petal, input, true);
+
+    // Softmax of kept pre-activations
+    float expected[10], exp_sum = 0.f;
+    uint32_t dropped = 0U;
+    for (uint32_t output_i = 0; output_i < 10U; ++output_i) {
+        expected[output_i] = 0.f;
+        if (petal->_dropout_mask[output_i] == 0.f) {
+            dropped++;
+            continue;
+        }
+        float sum = bias.weights[output_i];
+        for (uint32_t input_i = 0; input_i < 8U; ++input_i)
+            sum += weights.weights[output_i * 8U + input_i] * input[input_i];
+        expected[output_i] = expf(sum);
+        exp_sum += expected[output_i];
+    }
+    bool values_ok = petal->error_code == ERROR_NONE;
+    for (uint32_t output_i = 0; output_i < 10U; ++output_i) {
+        if (expected[output_i] != 0.f)
+            expected[output_i] = expected[output_i] / exp_sum / (1.f - target_ratio);
+        if (fabsf(petal->output[output_i] - expected[output_i]) > 1e-5f)
+            values_ok = false;
+    }
+    printf("Dropped: %u, outputs: ", dropped);
+    print_array(petal->output, 1U, 10U, 1U);
+
+    petal_destroy(petal, false, true, true);
+
+    if (values_ok && dropped == (uint32_t) roundf(target_ratio * 10.f)) {
+        printf("Passed\n");
+        return 0;
+    }
+    printf("Failed\n");
+    return 1;
+}
+
+/**
+ * @brief Tests learning rate schedulers by checking learning rate at specific steps
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_scheduler() {
+    printf("\nTesting learning rate schedulers\n");
+
+    // Fails counter
+    uint8_t fails = 0U;
+
+    // Step decay: 0.1 -> 0.01 after 10 steps
+    scheduler_s scheduler = (scheduler_s){SCHEDULER_STEP, 10U, .1f};
+    scheduler_reset(&scheduler);
+    printf("Step decay at steps 0, 9, 10:\t\t%.4f %.4f %.4f\n",
+           scheduler_get_learning_rate(&scheduler, .1f, 0U, 100U),
+           scheduler_get_learning_rate(&scheduler, .1f, 9U, 100U),
+           scheduler_get_learning_rate(&scheduler, .1f, 10U, 100U));
+    if (fabsf(scheduler_get_learning_rate(&scheduler, .1f, 9U, 100U) - .1f) > 1e-6f ||
+        fabsf(scheduler_get_learning_rate(&scheduler, .1f, 10U, 100U) - .01f) > 1e-6f)
+        fails++;
+
+    // Exponential decay: 0.1 -> 0.01 in 10 steps (continuous)
+    scheduler.type = SCHEDULER_EXPONENTIAL;
+    printf("Exponential decay at steps 5, 10:\t%.4f %.4f\n", scheduler_get_learning_rate(&scheduler, .1f, 5U, 100U),
+           scheduler_get_learning_rate(&scheduler, .1f, 10U, 100U));
+    if (fabsf(scheduler_get_learning_rate(&scheduler, .1f, 10U, 100U) - .01f) > 1e-6f)
+        fails++;
+
+    // Cosine with 10 steps of warmup
+    scheduler = (scheduler_s){SCHEDULER_COSINE_WARMUP, 0U, 0.f, 10U, 0.f, .001f};
+    scheduler_reset(&scheduler);
+    printf("Cosine with warmup at steps 0, 9, 55, 100:\t%.4f %.4f %.4f %.4f\n",
+           scheduler_get_learning_rate(&scheduler, .1f, 0U, 100U),
+           scheduler_get_learning_rate(&scheduler, .1f, 9U, 100U),
+           scheduler_get_learning_rate(&scheduler, .1f, 55U, 100U),
+           scheduler_get_learning_rate(&scheduler, .1f, 100U, 100U));
+    if (fabsf(scheduler_get_learning_rate(&scheduler, .1f, 9U, 100U) - .1f) > 1e-6f ||
+        fabsf(scheduler_get_learning_rate(&scheduler, .1f, 55U, 100U) - .0505f) > 1e-4f ||
+        fabsf(scheduler_get_learning_rate(&scheduler, .1f, 100U, 100U) - .001f) > 1e-6f)
+        fails++;
+
+    // One cycle with peak at 30% of training
+    scheduler = (scheduler_s){SCHEDULER_ONE_CYCLE, 0U, 0.f, 0U, .3f, .001f};
+    scheduler_reset(&scheduler);
+    printf("One cycle at steps 0, 30, 100:\t\t%.4f %.4f %.4f\n", scheduler_get_learning_rate(&scheduler, .1f, 0U, 100U),
+           scheduler_get_learning_rate(&scheduler, .1f, 30U, 100U),
+           scheduler_get_learning_rate(&scheduler, .1f, 100U, 100U));
+    if (fabsf(scheduler_get_learning_rate(&scheduler, .1f, 0U, 100U) - .001f) > 1e-6f ||
+        fabsf(scheduler_get_learning_rate(&scheduler, .1f, 30U, 100U) - .1f) > 1e-6f ||
+        fabsf(scheduler_get_learning_rate(&scheduler, .1f, 100U, 100U) - .001f) > 1e-6f)
+        fails++;
+
+    // Reduce on plateau with patience of 2 epochs
+    scheduler = (scheduler_s){SCHEDULER_REDUCE_ON_PLATEAU, 0U, .5f, 0U, 0.f, 0.f, 2U, 0.f};
+    scheduler_reset(&scheduler);
+    scheduler_epoch_end(&scheduler, 1.f);
+    scheduler_epoch_end(&scheduler, 1.f);
+    scheduler_epoch_end(&scheduler, 1.f);
+    printf("Reduce on plateau after 2 bad epochs:\t%.4f\n", scheduler_get_learning_rate(&scheduler, .1f, 0U, 100U));
+    if (fabsf(scheduler_get_learning_rate(&scheduler, .1f, 0U, 100U) - .05f) > 1e-6f)
+        fails++;
+
+    if (fails == 0U)
+        printf("Passed\n");
+    else
+        printf("Failed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests early stopping and restoring of the best weights
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_early_stopping() {
+    printf("\nTesting early stopping\n");
+
+    // Fails counter
+    uint8_t fails = 0U;
+
+    // Petal with 4 trainable weights and no bias weights
+    float weights_array[4] = {1.f, 1.f, 1.f, 1.f};
+    weights_s weights = (weights_s){true, WEIGHTS_INIT_CONSTANT, 4U, weights_array};
+    petal_s petal = {0};
+    petal.weights = &weights;
+    petal_s *petals[1] = {&petal};
+
+    // Stop after 2 epochs without improvement of validation loss
+    early_stopping_s early_stopping = (early_stopping_s){METRICS_LOSS_VALIDATION, 2U, 0.f, true};
+    early_stopping_reset(&early_stopping);
+
+    float losses_validation[4] = {1.f, .5f, .6f, .7f};
+    bool stop = false;
+    uint32_t epochs_trained = 0U;
+    for (uint32_t epoch_index = 0; epoch_index < 4U && !stop; ++epoch_index) {
+        // "Train"
+        for (uint8_t i = 0; i < 4U; ++i)
+            weights_array[i] = (float) (epoch_index + 1U);
+        epochs_trained++;
+
+        if (early_stopping_epoch_end(&early_stopping, petals, 1U, epoch_index, 0.f, 0.f,
+                                     losses_validation[epoch_index], 0.f, &stop) != ERROR_NONE)
+            fails++;
+    }
+    early_stopping_restore(&early_stopping, petals, 1U);
+
+    // Must stop after 4th epoch and restore weights from 2nd epoch
+    printf("Epochs trained: %u, best epoch: %u, restored weights: ", epochs_trained, early_stopping._epoch_best + 1U);
+    print_array(weights_array, 1U, 4U, 1U);
+    if (!stop || epochs_trained != 4U || early_stopping._epoch_best != 1U || weights_array[0] != 2.f ||
+        weights_array[3] != 2.f || early_stopping._snapshots)
+        fails++;
+
+    if (fails == 0U)
+        printf("Passed\n");
+    else
+        printf("Failed\n");
+    return fails;
+}
+
+/**
+ * @struct test_running_stats_s
+ * Running statistics of batch normalization petal at the end of each epoch
+ */
+struct test_running_stats_s {
+    petal_s *norm;
+    uint32_t epochs;
+    float means[8][3], variances[8][3];
+};
+
+/**
+ * @brief Training callback that copies running statistics of batch normalization petal
+ *
+ * @param data pointer to callback_data_s struct
+ * @param user_data pointer to test_running_stats_s struct
+ */
+void test_callback_running_stats(callback_data_s *data, void *user_data) {
+    struct test_running_stats_s *stats = (struct test_running_stats_s *) user_data;
+    memcpy(stats->means[data->epoch_index], stats->norm->_running_mean, 3U * sizeof(float));
+    memcpy(stats->variances[data->epoch_index], stats->norm->_running_variance, 3U * sizeof(float));
+    stats->epochs++;
+}
+
+/**
+ * @brief Trains dense + batch normalization flower with early stopping and checks that running statistics are
+ * restored from the best epoch together with weights
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_early_stopping_batch_norm() {
+    printf("\nTesting early stopping with batch normalization\n");
+    uint8_t fails = 0U;
+    rk_seed_(0);
+
+    // Dense (4 -> 3) + batch normalization
+    petal_shape_s dense_input_shape = (petal_shape_s){1U, 4U, 1U, 0UL};
+    petal_shape_s dense_output_shape = (petal_shape_s){1U, 3U, 1U, 0UL};
+    petal_shape_s norm_shape = (petal_shape_s){1U, 3U, 1U, 0UL};
+    weights_s dense_weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s dense_bias = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s norm_scale = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 1.f, 0.f, NULL, NULL, 0U};
+    weights_s norm_shift = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 0.f, NULL, NULL, 0U};
+    petal_params_s params = (petal_params_s){0.f, 0.f, 1.f, DROPOUT_MODE_EXACT};
+    params.momentum = .1f;
+    petal_s *petals[] = {
+        petal_init(PETAL_TYPE_DENSE_1D, true, &dense_input_shape, &dense_output_shape, &dense_weights, &dense_bias,
+                   NULL, NULL),
+        petal_init(PETAL_TYPE_BATCH_NORM, false, &dense_output_shape, &norm_shape, &norm_scale, &norm_shift, NULL,
+                   &params)};
+    flower_s *flower = flower_init(petals, 2U);
+
+    // Record running statistics at the end of each epoch
+    struct test_running_stats_s stats = {0};
+    stats.norm = petals[1];
+    callbacks_s callbacks_epoch = (callbacks_s){NULL, test_callback_running_stats, NULL, &stats};
+    callbacks_s *callbacks[] = {&callbacks_epoch};
+    flower->callbacks = callbacks;
+    flower->callbacks_length = 1U;
+
+    // Only the first epoch counts as improvement (min_delta is huge), so training stops after 3 epochs
+    early_stopping_s early_stopping = (early_stopping_s){METRICS_LOSS_TRAIN, 2U, 1e9f, true};
+    flower->early_stopping = &early_stopping;
+
+    // Random dataset
+    float *inputs[32], *outputs[32];
+    for (uint32_t i = 0; i < 32U; ++i) {
+        inputs[i] = malloc(4U * sizeof(float));
+        outputs[i] = malloc(3U * sizeof(float));
+        rk_fill_uniform(&rk_state_global, inputs[i], 4U, -3.f, 3.f);
+        rk_fill_uniform(&rk_state_global, outputs[i], 3U, -1.f, 1.f);
+    }
+
+    optimizer_s optimizer = (optimizer_s){OPTIMIZER_ADAM, .01f, 0.f, .89f, .99f};
+    flower_train(flower, LOSS_MEAN_SQUARED_ERROR, &optimizer, NULL, inputs, outputs, NULL, 32U, NULL, NULL, NULL, 0U,
+                 8U, 8U);
+    fails += flower->error_code != ERROR_NONE;
+
+    // Statistics must change after the best epoch and be restored from it
+    printf("Epochs trained: %u, best epoch: %u\n", stats.epochs, early_stopping._epoch_best + 1U);
+    printf("Running mean of best epoch: ");
+    print_array(stats.means[0], 1U, 3U, 1U);
+    printf("Running mean of last epoch: ");
+    print_array(stats.means[2], 1U, 3U, 1U);
+    printf("Restored running mean: ");
+    print_array(petals[1]->_running_mean, 1U, 3U, 1U);
+    if (stats.epochs != 3U || early_stopping._epoch_best != 0U ||
+        memcmp(stats.means[0], stats.means[2], 3U * sizeof(float)) == 0 ||
+        memcmp(stats.variances[0], stats.variances[2], 3U * sizeof(float)) == 0 ||
+        memcmp(petals[1]->_running_mean, stats.means[0], 3U * sizeof(float)) != 0 ||
+        memcmp(petals[1]->_running_variance, stats.variances[0], 3U * sizeof(float)) != 0)
+        fails++;
+
+    for (uint32_t i = 0; i < 32U; ++i) {
+        free(inputs[i]);
+        free(outputs[i]);
+    }
+    petal_destroy(petals[0], false, true, true);
+    petal_destroy(petals[1], false, true, true);
+    flower_destroy(flower, false, false, false);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Checks that monotonic timer never goes backwards and has sub-millisecond resolution
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_timer() {
+    printf("\nTesting monotonic timer\n");
+
+    // Find smallest non-zero difference between two timer readings
+    uint64_t time_prev = timer_get_ns();
+    uint64_t diff_min = UINT64_MAX;
+    bool backwards = false;
+    for (uint32_t i = 0; i < 100000U; ++i) {
+        uint64_t time_now = timer_get_ns();
+        if (time_now < time_prev)
+            backwards = true;
+        else if (time_now > time_prev && time_now - time_prev < diff_min)
+            diff_min = time_now - time_prev;
+        time_prev = time_now;
+    }
+    printf("Smallest time step: %lu ns\n", (unsigned long) diff_min);
+
+    if (!backwards && diff_min < 1000000U) {
+        printf("Passed\n");
+        return 0U;
+    }
+    printf("Failed\n");
+    return 1U;
+}
+
+/**
+ * @brief Training callback that increments counter
+ *
+ * @param data pointer to callback_data_s struct
+ * @param user_data pointer to uint32_t counter
+ */
+void test_callback_count(callback_data_s *data, void *user_data) {
+    (*(uint32_t *) user_data)++;
+}
+
 /**
  * @brief Tests all normalization petal types
  *
@@ -617,6 +1068,9 @@ uint8_t test_dense() {
     // Fails counter
     uint8_t fails = 0U;
 
+    // Reset seed to not depend on random numbers used by previous tests
+    rk_seed_(0);
+
     // 1000 numbers from -10 to 10: 80% train, 20% validation
     uint32_t train_dataset_length = 800;
     uint32_t validation_dataset_length = 200;
@@ -675,6 +1129,18 @@ uint8_t test_dense() {
     petal_s *petals[] = {petal_hidden1, petal_hidden2, petal_output};
     flower_s *flower = flower_init(petals, 3U);
 
+    // Validate twice per epoch on random half of validation dataset
+    flower->validation = (validation_s){VALIDATION_INTERVAL_EPOCH_FRACTION, .5f, .5f};
+
+    // Count calls of each callback
+    uint32_t batches_counter = 0U, epochs_counter = 0U, validations_counter = 0U;
+    callbacks_s callbacks_batch = (callbacks_s){test_callback_count, NULL, NULL, &batches_counter};
+    callbacks_s callbacks_epoch = (callbacks_s){NULL, test_callback_count, NULL, &epochs_counter};
+    callbacks_s callbacks_validation = (callbacks_s){NULL, NULL, test_callback_count, &validations_counter};
+    callbacks_s *callbacks[] = {&callbacks_batch, &callbacks_epoch, &callbacks_validation};
+    flower->callbacks = callbacks;
+    flower->callbacks_length = 3U;
+
     // Show prediction before training
     printf("Before training [1.0, 2.0] -> [1 > 2, 1 <= 2]:\t\t");
     print_array(flower_predict(flower, (float[]){1.f, 2.f}), 1U, 2U, 1U);
@@ -689,6 +1155,8 @@ uint8_t test_dense() {
     metrics_add(metrics, METRICS_ACCURACY_TRAIN);
     metrics_add(metrics, METRICS_LOSS_VALIDATION);
     metrics_add(metrics, METRICS_ACCURACY_VALIDATION);
+    metrics_add(metrics, METRICS_SAMPLES_PER_SECOND);
+    metrics_add(metrics, METRICS_MS_PER_BATCH);
 
     // Train
     uint32_t epochs = 10;
@@ -697,6 +1165,12 @@ uint8_t test_dense() {
                  train_dataset_outputs, NULL, train_dataset_length, validation_dataset_inputs,
                  validation_dataset_outputs, NULL, validation_dataset_length, batch_size, epochs);
 
+    // 20 batches per epoch with 2 validations per epoch
+    printf("Callbacks on batch end, epoch end, validation: %u %u %u\n", batches_counter, epochs_counter,
+           validations_counter);
+    if (batches_counter != epochs * 20U || epochs_counter != epochs || validations_counter != epochs * 2U)
+        fails++;
+
     // Test training result on a new data
     float *result;
     printf("After training [1.0, 10.0] -> [1 > 2, 1 <= 2]:\t\t");
@@ -723,6 +1197,17 @@ uint8_t test_dense() {
         fails++;
     }
 
+    // Print per-petal profiling stats
+#ifdef PROFILING
+    flower_profile_report(flower, stdout, PROFILE_REPORT_TABLE);
+    flower_profile_report(flower, stdout, PROFILE_REPORT_JSON);
+    if (petal_output->_profile.calls_backward != train_dataset_length * epochs ||
+        petal_output->_profile.calls_update != epochs * 20U || petal_output->_profile.flops == 0U) {
+        printf("Wrong profiling stats\n");
+        fails++;
+    }
+#endif
+
     // Print flower weight
     printf("Min flower size: %lu bytes\n", flower_estimate_min_size(flower));
 
@@ -758,87 +1243,1433 @@ uint8_t test_dense() {
 }
 
 /**
- * @brief Performs test of pseudo random number generator by validating rk_random_() and rk_float_() 5 times each
- * NOTE: call rk_seed_(0) for that to work
+ * @brief Calculates sum of petal's outputs multiplied by coefficients (simple loss for gradient check)
  *
- * @return uint8_t number of fails (mismatches)
+ * @param petal pointer to petal_s struct
+ * @param input pointer to input data
+ * @param coefficients pointer to array of petal->output_shape->length coefficients
+ * @return float weighted sum of outputs
  */
-uint8_t test_random() {
-    // Print about message
-    printf("\nChecking whether the PRNG works correctly\n");
+float petal_weighted_sum(petal_s *petal, float *input, float *coefficients) {
+    petal_forward(petal, input, false);
+    float sum = 0.f;
+    for (uint32_t i = 0; i < petal->output_shape->length; ++i)
+        sum += petal->output[i] * coefficients[i];
+    return sum;
+}
 
-    // Fails counter
+/**
+ * @brief Compares analytical gradients of petal's weights and inputs with numerical ones (central differences of
+ * petal_weighted_sum()) and prints number of mismatches
+ *
+ * @param petal pointer to petal_s struct
+ * @param input pointer to input data (restored after each step)
+ * @param coefficients pointer to array of petal->output_shape->length coefficients
+ * @param weights array of pointers to petal's weights_s structs to check (or NULL)
+ * @param weights_length number of elements in weights array
+ * @param tolerance max. difference (multiplied by gradient if it's greater than 1)
+ * @return uint32_t number of mismatches
+ */
+uint32_t check_petal_gradients(petal_s *petal, float *input, float *coefficients, weights_s **weights,
+                               uint8_t weights_length, float tolerance) {
+    // Analytical gradients
+    petal_forward(petal, input, true);
+    petal_backward(petal, coefficients, input);
+
+    // Numerical gradients of weights and inputs
+    float delta = 1e-2f;
+    uint32_t mismatches = 0U;
+    for (uint8_t weights_i = 0; weights_i < weights_length; ++weights_i) {
+        for (uint32_t i = 0; i < weights[weights_i]->length_total; ++i) {
+            float weight = weights[weights_i]->weights[i];
+            weights[weights_i]->weights[i] = weight + delta;
+            float sum_plus = petal_weighted_sum(petal, input, coefficients);
+            weights[weights_i]->weights[i] = weight - delta;
+            float sum_minus = petal_weighted_sum(petal, input, coefficients);
+            weights[weights_i]->weights[i] = weight;
+            float gradient = weights[weights_i]->gradients[i];
+            if (fabsf((sum_plus - sum_minus) / (2.f * delta) - gradient) > tolerance * fmaxf(1.f, fabsf(gradient)))
+                mismatches++;
+        }
+    }
+    for (uint32_t i = 0; i < petal->input_shape->length; ++i) {
+        float value = input[i];
+        input[i] = value + delta;
+        float sum_plus = petal_weighted_sum(petal, input, coefficients);
+        input[i] = value - delta;
+        float sum_minus = petal_weighted_sum(petal, input, coefficients);
+        input[i] = value;
+        float error = petal->error_on_input[i];
+        if (fabsf((sum_plus - sum_minus) / (2.f * delta) - error) > tolerance * fmaxf(1.f, fabsf(error)))
+            mismatches++;
+    }
+    printf("Gradients mismatches: %u\n", mismatches);
+    return mismatches;
+}
+
+/**
+ * @brief Tests forward pass of dense petal against straightforward dot products and its gradients of weights and
+ * inputs against numerical ones
+ *
+ * @param inputs input length (more than GEMM_BLOCK_N to check multiple column blocks of gemv())
+ * @param outputs output length
+ * @return uint8_t number of fails
+ */
+uint8_t test_dense_gradients(uint32_t inputs, uint32_t outputs) {
+    printf("\nTesting dense petal %u -> %u forward pass and gradients\n", inputs, outputs);
     uint8_t fails = 0U;
+    rk_seed_(0);
 
-    // Test first 5 integers
-    if (rk_random_() != 2357136044U)
-        fails++;
-    if (rk_random_() != 2546248239U)
-        fails++;
-    if (rk_random_() != 3071714933U)
-        fails++;
-    if (rk_random_() != 3626093760U)
-        fails++;
-    if (rk_random_() != 2588848963U)
-        fails++;
+    petal_shape_s input_shape = (petal_shape_s){1U, inputs, 1U, 0UL};
+    petal_shape_s output_shape = (petal_shape_s){1U, outputs, 1U, 0UL};
+    weights_s weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, .5f, NULL, NULL, 0U};
+    weights_s bias = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, .5f, NULL, NULL, 0U};
+    petal_s *petal = petal_init(PETAL_TYPE_DENSE_1D, false, &input_shape, &output_shape, &weights, &bias, NULL, NULL);
+    float *input = malloc(inputs * sizeof(float));
+    float *coefficients = malloc(outputs * sizeof(float));
+    rk_fill_uniform(&rk_state_global, input, inputs, -1.f, 1.f);
+    rk_fill_uniform(&rk_state_global, coefficients, outputs, -1.f, 1.f);
+
+    // Forward pass
+    petal_forward(petal, input, false);
+    for (uint32_t output_i = 0; output_i < outputs; ++output_i) {
+        double expected = bias.weights[output_i];
+        for (uint32_t input_i = 0; input_i < inputs; ++input_i)
+            expected += (double) weights.weights[output_i * inputs + input_i] * input[input_i];
+        if (fabs(petal->output[output_i] - expected) > 1e-4)
+            fails++;
+    }
+    printf("Forward pass: %s\n", fails ? "mismatch" : "OK");
 
-    // Test next 5 floats
-    if (rk_float_() != .85794562101364135742f)
-        fails++;
-    if (rk_float_() != .84725171327590942383f)
-        fails++;
-    if (rk_float_() != .62356370687484741211f)
-        fails++;
-    if (rk_float_() != .38438171148300170898f)
-        fails++;
-    if (rk_float_() != .29753458499908447266f)
-        fails++;
+    // Analytical and numerical gradients
+    weights_s *weights_all[] = {&weights, &bias};
+    fails += check_petal_gradients(petal, input, coefficients, weights_all, 2U, 1e-3f) > 0U;
 
-    // Check
-    if (fails == 0)
-        printf("PRNG works correctly\n");
-    else
-        printf("PRNG DOES NOT WORK CORRECTLY!\n");
+    free(input);
+    free(coefficients);
+    petal_destroy(petal, false, true, true);
 
+    printf(fails ? "Failed\n" : "Passed\n");
     return fails;
 }
 
 /**
- * @brief Automatically performs tests of most function
+ * @brief Tests 2D convolution petal: forward pass against direct convolution and gradients of weights and inputs
+ * against numerical ones
  *
- * @return int 0 if all test passed, number of fails otherwise
+ * @param stride step of kernel
+ * @param padding number of zeros on each side of input
+ * @param dilation step between kernel elements
+ * @param kernel_rows height of kernel
+ * @param kernel_cols width of kernel
+ * @param algorithm CONV_ALGORITHM_...
+ * @return uint8_t number of fails
  */
-int main() {
-    // Fails counter
-    uint16_t fails = 0U;
+uint8_t test_conv_2d(uint32_t stride, uint32_t padding, uint32_t dilation, uint32_t kernel_rows, uint32_t kernel_cols,
+                     uint8_t algorithm) {
+    printf("\nTesting 2D convolution (algorithm %u) with kernel: %ux%u, stride: %u, padding: %u, dilation: %u\n",
+           algorithm, kernel_rows, kernel_cols, stride, padding, dilation);
+    uint8_t fails = 0U;
 
-    // Set random seed (seed must be 0 for test_random to work and also for results to be consistant)
-    // rk_seed_(time(NULL) & 0xFFFFFFFFUL);
-    rk_seed_(0);
+    // 7x6x2 input, 3 filters
+    petal_shape_s input_shape = (petal_shape_s){7U, 6U, 2U, 0UL};
+    petal_params_s params = (petal_params_s){0.f,        0.f,    1.f,     DROPOUT_MODE_EXACT, kernel_rows,
+                                             kernel_cols, stride, padding, dilation,           algorithm};
+    petal_shape_s output_shape =
+        (petal_shape_s){conv_output_size(7U, kernel_rows, stride, padding, dilation),
+                        conv_output_size(6U, kernel_cols, stride, padding, dilation), 3U, 0UL};
+    weights_s weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s bias_weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    petal_s *petal =
+        petal_init(PETAL_TYPE_CONV_2D, false, &input_shape, &output_shape, &weights, &bias_weights, NULL, &params);
+    if (petal->error_code != ERROR_NONE) {
+        printf("Failed to initialize petal: %s\n", error_to_str[petal->error_code]);
+        petal_destroy(petal, false, true, true);
+        return 1U;
+    }
 
-    printf("\n--------------------------------- BEGIN TESTS ----------------------------------\n");
+    float *input = malloc(input_shape.length * sizeof(float));
+    float *coefficients = malloc(output_shape.length * sizeof(float));
+    rk_fill_uniform(&rk_state_global, input, input_shape.length, -1.f, 1.f);
+    rk_fill_uniform(&rk_state_global, coefficients, output_shape.length, -1.f, 1.f);
+
+    // Direct convolution
+    petal_forward(petal, input, false);
+    for (uint32_t row = 0; row < output_shape.rows; ++row) {
+        for (uint32_t col = 0; col < output_shape.cols; ++col) {
+            for (uint32_t filter = 0; filter < output_shape.depth; ++filter) {
+                float expected = bias_weights.weights[filter];
+                for (uint32_t kernel_row = 0; kernel_row < kernel_rows; ++kernel_row) {
+                    for (uint32_t kernel_col = 0; kernel_col < kernel_cols; ++kernel_col) {
+                        int32_t input_row = row * stride + kernel_row * dilation - padding;
+                        int32_t input_col = col * stride + kernel_col * dilation - padding;
+                        if (input_row < 0 || input_row >= 7 || input_col < 0 || input_col >= 6)
+                            continue;
+                        for (uint32_t channel = 0; channel < 2U; ++channel)
+                            expected += input[(input_row * 6U + input_col) * 2U + channel] *
+                                        weights.weights[((filter * kernel_rows + kernel_row) * kernel_cols +
+                                                         kernel_col) *
+                                                            2U +
+                                                        channel];
+                    }
+                }
+                if (fabsf(petal->output[(row * output_shape.cols + col) * 3U + filter] - expected) > 1e-5f)
+                    fails++;
+            }
+        }
+    }
+    printf("Forward pass: %s\n", fails ? "mismatch" : "OK");
 
-    // Validate random
-    fails += test_random();
-    printf("\n--------------------------------------------------------------------------------\n");
+    // Analytical and numerical gradients
+    weights_s *weights_all[] = {&weights};
+    fails += check_petal_gradients(petal, input, coefficients, weights_all, 1U, 1e-3f) > 0U;
 
-    // Test activation
-    fails += test_activation_full();
-    printf("\n--------------------------------------------------------------------------------\n");
+    free(input);
+    free(coefficients);
+    petal_destroy(petal, false, true, true);
 
-    // Test loss
-    fails += test_loss_full();
-    printf("\n--------------------------------------------------------------------------------\n");
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
 
-    // Test dropout
-    fails += test_dropout(50U, 0.f);
-    fails += test_dropout(50U, .2f);
-    fails += test_dropout(50U, .8f);
-    fails += test_dropout(50U, 1.f);
-    printf("\n--------------------------------------------------------------------------------\n");
+/**
+ * @brief Tests forward pass of 2D max / average pooling petal against straightforward implementation and
+ * backpropagation against numerical gradients
+ *
+ * @param petal_type PETAL_TYPE_MAX_POOL_2D or PETAL_TYPE_AVG_POOL_2D
+ * @param kernel_size window rows and cols
+ * @param stride step of window
+ * @param padding number of ignored elements on each side of input
+ * @return uint8_t number of fails
+ */
+uint8_t test_pool_2d(uint8_t petal_type, uint32_t kernel_size, uint32_t stride, uint32_t padding) {
+    printf("\nTesting 2D %s pooling with window: %ux%u, stride: %u, padding: %u\n",
+           petal_type == PETAL_TYPE_MAX_POOL_2D ? "max" : "average", kernel_size, kernel_size, stride, padding);
+    uint8_t fails = 0U;
 
-    // Test normalization
-    fails += test_normalization();
+    // 7x6x2 input
+    petal_shape_s input_shape = (petal_shape_s){7U, 6U, 2U, 0UL};
+    petal_params_s params = (petal_params_s){0.f, 0.f, 1.f, DROPOUT_MODE_EXACT, kernel_size, kernel_size, stride,
+                                             padding, 1U};
+    petal_shape_s output_shape = (petal_shape_s){conv_output_size(7U, kernel_size, stride, padding, 1U),
+                                                 conv_output_size(6U, kernel_size, stride, padding, 1U), 2U, 0UL};
+    petal_s *petal = petal_init(petal_type, false, &input_shape, &output_shape, NULL, NULL, NULL, &params);
+    if (petal->error_code != ERROR_NONE) {
+        printf("Failed to initialize petal: %s\n", error_to_str[petal->error_code]);
+        petal_destroy(petal, false, true, true);
+        return 1U;
+    }
+
+    // Distinct values (permutation of 0.1 steps), so small deltas don't change argmax
+    float *input = malloc(input_shape.length * sizeof(float));
+    float *coefficients = malloc(output_shape.length * sizeof(float));
+    for (uint32_t i = 0; i < input_shape.length; ++i)
+        input[i] = (float) ((i * 7919U) % input_shape.length) * 0.1f - 4.f;
+    rk_fill_uniform(&rk_state_global, coefficients, output_shape.length, -1.f, 1.f);
+
+    // Straightforward pooling (inference and training forward passes must be equal)
+    for (uint8_t training = 0; training < 2U; ++training) {
+        petal_forward(petal, input, training);
+        for (uint32_t row = 0; row < output_shape.rows; ++row) {
+            for (uint32_t col = 0; col < output_shape.cols; ++col) {
+                for (uint32_t channel = 0; channel < 2U; ++channel) {
+                    float expected = petal_type == PETAL_TYPE_MAX_POOL_2D ? -INFINITY : 0.f;
+                    uint32_t window_size = 0U;
+                    for (uint32_t kernel_row = 0; kernel_row < kernel_size; ++kernel_row) {
+                        for (uint32_t kernel_col = 0; kernel_col < kernel_size; ++kernel_col) {
+                            int32_t input_row = row * stride + kernel_row - padding;
+                            int32_t input_col = col * stride + kernel_col - padding;
+                            if (input_row < 0 || input_row >= 7 || input_col < 0 || input_col >= 6)
+                                continue;
+                            float value = input[(input_row * 6U + input_col) * 2U + channel];
+                            if (petal_type == PETAL_TYPE_MAX_POOL_2D)
+                                expected = value > expected ? value : expected;
+                            else
+                                expected += value;
+                            window_size++;
+                        }
+                    }
+                    if (petal_type == PETAL_TYPE_AVG_POOL_2D)
+                        expected /= (float) window_size;
+                    if (fabsf(petal->output[(row * output_shape.cols + col) * 2U + channel] - expected) > 1e-5f)
+                        fails++;
+                }
+            }
+        }
+    }
+    printf("Forward pass: %s\n", fails ? "mismatch" : "OK");
+
+    // Analytical and numerical gradients
+    fails += check_petal_gradients(petal, input, coefficients, NULL, 0U, 1e-3f) > 0U;
+
+    free(input);
+    free(coefficients);
+    petal_destroy(petal, false, true, true);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests batch normalization petal: running statistics, forward pass, gradients of scale, shift and inputs
+ * against numerical ones and folding into preceding dense petal
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_batch_norm() {
+    printf("\nTesting batch normalization\n");
+    uint8_t fails = 0U;
+    rk_seed_(0);
+
+    // 2x2x3 input (statistics of each channel)
+    petal_shape_s input_shape = (petal_shape_s){2U, 2U, 3U, 0UL};
+    petal_shape_s output_shape = (petal_shape_s){2U, 2U, 3U, 0UL};
+    weights_s scale = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 1.f, 0.f, NULL, NULL, 0U};
+    weights_s shift = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 0.f, NULL, NULL, 0U};
+    petal_params_s params = (petal_params_s){0.f, 0.f, 1.f, DROPOUT_MODE_EXACT};
+    params.momentum = .02f;
+    petal_s *petal = petal_init(PETAL_TYPE_BATCH_NORM, false, &input_shape, &output_shape, &scale, &shift, NULL,
+                                &params);
+    if (petal->error_code != ERROR_NONE) {
+        printf("Failed to initialize petal: %s\n", error_to_str[petal->error_code]);
+        petal_destroy(petal, false, true, true);
+        return 1U;
+    }
+
+    // Channel c is uniform in [2c - 2, 2c + 2] (mean 2c, variance 4/3)
+    float *input = malloc(input_shape.length * sizeof(float));
+    float *coefficients = malloc(output_shape.length * sizeof(float));
+    for (uint32_t sample = 0; sample < 2000U; ++sample) {
+        rk_fill_uniform(&rk_state_global, input, input_shape.length, -2.f, 2.f);
+        for (uint32_t i = 0; i < input_shape.length; ++i)
+            input[i] += 2.f * (float) (i % 3U);
+        petal_forward(petal, input, true);
+    }
+    for (uint32_t channel = 0; channel < 3U; ++channel) {
+        printf("Channel %u running mean: %f, variance: %f\n", channel, petal->_running_mean[channel],
+               petal->_running_variance[channel]);
+        if (fabsf(petal->_running_mean[channel] - 2.f * (float) channel) > .2f ||
+            fabsf(petal->_running_variance[channel] - 4.f / 3.f) > .3f)
+            fails++;
+    }
+
+    // Forward pass with random scale and shift
+    rk_fill_uniform(&rk_state_global, scale.weights, 3U, .5f, 1.5f);
+    rk_fill_uniform(&rk_state_global, shift.weights, 3U, -1.f, 1.f);
+    rk_fill_uniform(&rk_state_global, coefficients, output_shape.length, -1.f, 1.f);
+    petal_forward(petal, input, false);
+    for (uint32_t i = 0; i < input_shape.length; ++i) {
+        uint32_t channel = i % 3U;
+        float expected = (input[i] - petal->_running_mean[channel]) /
+                             sqrtf(petal->_running_variance[channel] + NORM_EPSILON) * scale.weights[channel] +
+                         shift.weights[channel];
+        if (fabsf(petal->output[i] - expected) > 1e-4f)
+            fails++;
+    }
+    printf("Forward pass: %s\n", fails ? "mismatch" : "OK");
+
+    // Analytical and numerical gradients
+    weights_s *weights_all[] = {&scale, &shift};
+    fails += check_petal_gradients(petal, input, coefficients, weights_all, 2U, 1e-3f) > 0U;
+    free(input);
+    free(coefficients);
+    petal_destroy(petal, false, true, true);
+
+    // Dense (4 -> 3) + batch normalization with tanh activation
+    petal_shape_s dense_input_shape = (petal_shape_s){1U, 4U, 1U, 0UL};
+    petal_shape_s dense_output_shape = (petal_shape_s){1U, 3U, 1U, 0UL};
+    petal_shape_s norm_shape = (petal_shape_s){1U, 3U, 1U, 0UL};
+    weights_s dense_weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s dense_bias = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s norm_scale = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 1.f, .5f, NULL, NULL, 0U};
+    weights_s norm_shift = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, .5f, NULL, NULL, 0U};
+    activation_s *activation = malloc(sizeof(activation_s));
+    *activation = (activation_s){ACTIVATION_TANH, 1.f, 0.f, 0.f, 0.f, 1.f, NULL};
+    petal_s *petals[] = {
+        petal_init(PETAL_TYPE_DENSE_1D, true, &dense_input_shape, &dense_output_shape, &dense_weights, &dense_bias,
+                   NULL, NULL),
+        petal_init(PETAL_TYPE_BATCH_NORM, false, &dense_output_shape, &norm_shape, &norm_scale, &norm_shift,
+                   activation, &params)};
+    flower_s *flower = flower_init(petals, 2U);
+    petal_s *norm = petals[1];
+
+    // Collect statistics
+    float dense_input[4];
+    for (uint32_t sample = 0; sample < 500U; ++sample) {
+        rk_fill_uniform(&rk_state_global, dense_input, 4U, -3.f, 3.f);
+        flower_forward(flower, dense_input, true);
+    }
+
+    // Compare predictions before and after folding
+    float predictions[5][3];
+    float inputs[5][4];
+    for (uint32_t sample = 0; sample < 5U; ++sample) {
+        rk_fill_uniform(&rk_state_global, inputs[sample], 4U, -3.f, 3.f);
+        memcpy(predictions[sample], flower_predict(flower, inputs[sample]), 3U * sizeof(float));
+    }
+    uint32_t folded = flower_fold_batchnorm(flower, false, false, false);
+    printf("Folded petals: %u\n", folded);
+    if (folded != 1U || flower->petals_length != 1U || !petals[0]->activation ||
+        petals[0]->activation->type != ACTIVATION_TANH)
+        fails++;
+    for (uint32_t sample = 0; sample < 5U; ++sample) {
+        float *prediction = flower_predict(flower, inputs[sample]);
+        for (uint32_t i = 0; i < 3U; ++i)
+            if (fabsf(prediction[i] - predictions[sample][i]) > 1e-5f)
+                fails++;
+    }
+    printf("Predictions after folding: %s\n", fails ? "mismatch" : "OK");
+
+    petal_destroy(norm, false, true, true);
+    petal_destroy(petals[0], false, true, true);
+    flower_destroy(flower, false, false, false);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Training callback that copies average loss of batch
+ *
+ * @param data pointer to callback_data_s struct
+ * @param user_data pointer to float variable
+ */
+void test_callback_batch_loss(callback_data_s *data, void *user_data) { *(float *) user_data = data->loss_train; }
+
+/**
+ * @brief Trains flower on a single mini-batch with SGD and returns average loss of it
+ *
+ * @param flower pointer to flower_s struct (flower->callbacks must copy loss into loss)
+ * @param inputs pointer to array of arrays of input data
+ * @param outputs pointer to array of arrays of output data
+ * @param length number of samples (size of mini-batch)
+ * @param learning_rate learning rate of SGD
+ * @param loss pointer to variable into which callback copies loss
+ * @return float average loss of mini-batch before update
+ */
+float test_train_batch(flower_s *flower, float **inputs, float **outputs, uint32_t length, float learning_rate,
+                       float *loss) {
+    optimizer_s optimizer = (optimizer_s){OPTIMIZER_SGD_MOMENTUM, learning_rate, 0.f, 0.f, 0.f};
+    flower_train(flower, LOSS_MEAN_SQUARED_ERROR, &optimizer, NULL, inputs, outputs, NULL, length, NULL, NULL, NULL,
+                 0U, length, 1U);
+    return *loss;
+}
+
+/**
+ * @brief Trains dense + batch normalization + dense + batch normalization flower on a single mini-batch and checks
+ * gradients (sums of each sample's gradients) of all weights against numerical gradients of the mini-batch loss, so
+ * errors must be backpropagated through statistics of mini-batch (ex. gradients of bias of dense petal before batch
+ * normalization are 0)
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_batch_norm_mini_batch() {
+    printf("\nTesting batch normalization with statistics of mini-batch\n");
+    uint8_t fails = 0U;
+    rk_seed_(0);
+
+    // Dense (3 -> 4) + batch normalization with tanh + dense (4 -> 2) + batch normalization
+    petal_shape_s shape_3 = (petal_shape_s){1U, 3U, 1U, 0UL};
+    petal_shape_s shape_4 = (petal_shape_s){1U, 4U, 1U, 0UL};
+    petal_shape_s shape_2 = (petal_shape_s){1U, 2U, 1U, 0UL};
+    weights_s weights[8];
+    for (uint8_t i = 0; i < 8U; ++i)
+        weights[i] = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, i % 4U == 2U ? 1.f : 0.f, .5f,
+                                 NULL, NULL, 0U};
+    activation_s *activation = malloc(sizeof(activation_s));
+    *activation = (activation_s){ACTIVATION_TANH, 1.f, 0.f, 0.f, 0.f, 1.f, NULL};
+    petal_params_s params = (petal_params_s){0.f, 0.f, 1.f, DROPOUT_MODE_EXACT};
+    petal_s *petals[] = {
+        petal_init(PETAL_TYPE_DENSE_1D, true, &shape_3, &shape_4, &weights[0], &weights[1], NULL, NULL),
+        petal_init(PETAL_TYPE_BATCH_NORM, false, &shape_4, &shape_4, &weights[2], &weights[3], activation, &params),
+        petal_init(PETAL_TYPE_DENSE_1D, false, &shape_4, &shape_2, &weights[4], &weights[5], NULL, NULL),
+        petal_init(PETAL_TYPE_BATCH_NORM, false, &shape_2, &shape_2, &weights[6], &weights[7], NULL, &params)};
+    flower_s *flower = flower_init(petals, 4U);
+
+    float loss = 0.f;
+    callbacks_s callbacks_batch = (callbacks_s){test_callback_batch_loss, NULL, NULL, &loss};
+    callbacks_s *callbacks[] = {&callbacks_batch};
+    flower->callbacks = callbacks;
+    flower->callbacks_length = 1U;
+
+    // Random mini-batch
+    float *inputs[6], *outputs[6];
+    for (uint32_t i = 0; i < 6U; ++i) {
+        inputs[i] = malloc(3U * sizeof(float));
+        outputs[i] = malloc(2U * sizeof(float));
+        rk_fill_uniform(&rk_state_global, inputs[i], 3U, -3.f, 3.f);
+        rk_fill_uniform(&rk_state_global, outputs[i], 2U, -1.f, 1.f);
+    }
+
+    // Analytical gradients (SGD with learning rate 1 subtracts them from weights)
+    float analytical[8][12];
+    for (uint8_t i = 0; i < 8U; ++i)
+        memcpy(analytical[i], weights[i].weights, weights[i].length_total * sizeof(float));
+    test_train_batch(flower, inputs, outputs, 6U, 1.f, &loss);
+    for (uint8_t i = 0; i < 8U; ++i)
+        for (uint32_t j = 0; j < weights[i].length_total; ++j) {
+            float weight = analytical[i][j];
+            analytical[i][j] -= weights[i].weights[j];
+            weights[i].weights[j] = weight;
+        }
+
+    // Numerical gradients of sum of losses of mini-batch (learning rate 0 keeps weights)
+    uint32_t mismatches = 0U;
+    float bias_gradient_max = 0.f;
+    for (uint8_t i = 0; i < 8U; ++i)
+        for (uint32_t j = 0; j < weights[i].length_total; ++j) {
+            float weight = weights[i].weights[j];
+            weights[i].weights[j] = weight + 1e-2f;
+            float loss_plus = test_train_batch(flower, inputs, outputs, 6U, 0.f, &loss);
+            weights[i].weights[j] = weight - 1e-2f;
+            float loss_minus = test_train_batch(flower, inputs, outputs, 6U, 0.f, &loss);
+            weights[i].weights[j] = weight;
+            float numerical = 6.f * (loss_plus - loss_minus) / 2e-2f;
+            if (fabsf(analytical[i][j] - numerical) > 1e-2f * fmaxf(1.f, fabsf(numerical))) {
+                printf("Weights %u [%u]: analytical %f, numerical %f\n", i, j, analytical[i][j], numerical);
+                mismatches++;
+            }
+            if (i == 1U || i == 5U)
+                bias_gradient_max = fmaxf(bias_gradient_max, fabsf(analytical[i][j]));
+        }
+    printf("Gradient mismatches: %u, max. gradient of bias before normalization: %f\n", mismatches,
+           bias_gradient_max);
+    if (mismatches > 0U || bias_gradient_max > 1e-4f)
+        fails++;
+
+    for (uint32_t i = 0; i < 6U; ++i) {
+        free(inputs[i]);
+        free(outputs[i]);
+    }
+    for (uint8_t i = 0; i < 4U; ++i)
+        petal_destroy(petals[i], false, true, true);
+    flower_destroy(flower, false, false, false);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests layer normalization petal: forward pass against two-pass statistics (including inputs with large
+ * offset) and gradients of scale, shift and inputs against numerical ones
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_layer_norm() {
+    printf("\nTesting layer normalization\n");
+    uint8_t fails = 0U;
+
+    // 3 rows of 4x2 values
+    petal_shape_s input_shape = (petal_shape_s){3U, 4U, 2U, 0UL};
+    petal_shape_s output_shape = (petal_shape_s){3U, 4U, 2U, 0UL};
+    weights_s scale = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 1.f, .5f, NULL, NULL, 0U};
+    weights_s shift = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, .5f, NULL, NULL, 0U};
+    petal_s *petal =
+        petal_init(PETAL_TYPE_LAYER_NORM, false, &input_shape, &output_shape, &scale, &shift, NULL, NULL);
+    if (petal->error_code != ERROR_NONE) {
+        printf("Failed to initialize petal: %s\n", error_to_str[petal->error_code]);
+        petal_destroy(petal, false, true, true);
+        return 1U;
+    }
+
+    // Two-pass statistics without and with large offset
+    float *input = malloc(input_shape.length * sizeof(float));
+    float *coefficients = malloc(output_shape.length * sizeof(float));
+    float offsets[2] = {0.f, 1000.f};
+    for (uint8_t offset_i = 0; offset_i < 2U; ++offset_i) {
+        rk_fill_uniform(&rk_state_global, input, input_shape.length, -1.f, 1.f);
+        for (uint32_t i = 0; i < input_shape.length; ++i)
+            input[i] += offsets[offset_i];
+        petal_forward(petal, input, false);
+        for (uint32_t row = 0; row < 3U; ++row) {
+            double mean = 0., variance = 0.;
+            for (uint32_t i = 0; i < 8U; ++i)
+                mean += input[row * 8U + i];
+            mean /= 8.;
+            for (uint32_t i = 0; i < 8U; ++i)
+                variance += (input[row * 8U + i] - mean) * (input[row * 8U + i] - mean);
+            variance /= 8.;
+            for (uint32_t i = 0; i < 8U; ++i) {
+                double expected =
+                    (input[row * 8U + i] - mean) / sqrt(variance + NORM_EPSILON) * scale.weights[i] + shift.weights[i];
+                if (fabs(petal->output[row * 8U + i] - expected) > 1e-3)
+                    fails++;
+            }
+        }
+        printf("Forward pass with offset %.0f: %s\n", offsets[offset_i], fails ? "mismatch" : "OK");
+    }
+
+    // Analytical and numerical gradients
+    rk_fill_uniform(&rk_state_global, input, input_shape.length, -1.f, 1.f);
+    rk_fill_uniform(&rk_state_global, coefficients, output_shape.length, -1.f, 1.f);
+    weights_s *weights_all[] = {&scale, &shift};
+    fails += check_petal_gradients(petal, input, coefficients, weights_all, 2U, 1e-3f) > 0U;
+
+    free(input);
+    free(coefficients);
+    petal_destroy(petal, false, true, true);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests LSTM or GRU petal: forward pass against straightforward implementation and gradients of weights,
+ * bias weights and inputs against numerical ones
+ *
+ * @param petal_type PETAL_TYPE_LSTM or PETAL_TYPE_GRU
+ * @param output_rows number of timesteps (hidden state of each timestep) or 1 (hidden state of the last timestep)
+ * @return uint8_t number of fails
+ */
+uint8_t test_rnn(uint8_t petal_type, uint32_t output_rows) {
+    printf("\nTesting %s petal with %u output rows\n", petal_type == PETAL_TYPE_LSTM ? "LSTM" : "GRU", output_rows);
+    uint8_t fails = 0U;
+
+    // 5 timesteps of 3 features -> 4 hidden units
+    uint32_t timesteps = 5U, features = 3U, hidden_size = 4U;
+    uint32_t gates = petal_type == PETAL_TYPE_LSTM ? 4U : 3U;
+    uint32_t gates_length = gates * hidden_size;
+    petal_shape_s input_shape = (petal_shape_s){timesteps, features, 1U, 0UL};
+    petal_shape_s output_shape = (petal_shape_s){output_rows, hidden_size, 1U, 0UL};
+    weights_s weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, .5f, NULL, NULL, 0U};
+    weights_s bias = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, .5f, NULL, NULL, 0U};
+    petal_s *petal = petal_init(petal_type, false, &input_shape, &output_shape, &weights, &bias, NULL, NULL);
+    if (petal->error_code != ERROR_NONE) {
+        printf("Failed to initialize petal: %s\n", error_to_str[petal->error_code]);
+        petal_destroy(petal, false, true, true);
+        return 1U;
+    }
+
+    // Forward pass
+    float *input = malloc(input_shape.length * sizeof(float));
+    float *coefficients = malloc(output_shape.length * sizeof(float));
+    rk_fill_uniform(&rk_state_global, input, input_shape.length, -1.f, 1.f);
+    petal_forward(petal, input, true);
+    double hidden[4] = {0.}, cell[4] = {0.}, hidden_new[4], pre[16];
+    for (uint32_t timestep = 0; timestep < timesteps; ++timestep) {
+        for (uint32_t gate_i = 0; gate_i < gates_length; ++gate_i) {
+            pre[gate_i] = bias.weights[gate_i];
+            for (uint32_t feature = 0; feature < features; ++feature)
+                pre[gate_i] += input[timestep * features + feature] * weights.weights[feature * gates_length + gate_i];
+        }
+        for (uint32_t i = 0; i < hidden_size; ++i) {
+            double recurrent[4] = {0.};
+            for (uint32_t gate = 0; gate < gates; ++gate)
+                for (uint32_t j = 0; j < hidden_size; ++j)
+                    recurrent[gate] +=
+                        hidden[j] * weights.weights[(features + j) * gates_length + gate * hidden_size + i];
+            if (petal_type == PETAL_TYPE_LSTM) {
+                double gate_i = 1. / (1. + exp(-(pre[i] + recurrent[0])));
+                double gate_f = 1. / (1. + exp(-(pre[hidden_size + i] + recurrent[1])));
+                double gate_g = tanh(pre[2U * hidden_size + i] + recurrent[2]);
+                double gate_o = 1. / (1. + exp(-(pre[3U * hidden_size + i] + recurrent[3])));
+                cell[i] = gate_f * cell[i] + gate_i * gate_g;
+                hidden_new[i] = gate_o * tanh(cell[i]);
+            } else {
+                double gate_z = 1. / (1. + exp(-(pre[i] + recurrent[0])));
+                double gate_r = 1. / (1. + exp(-(pre[hidden_size + i] + recurrent[1])));
+                double gate_n = tanh(pre[2U * hidden_size + i] + gate_r * recurrent[2]);
+                hidden_new[i] = (1. - gate_z) * gate_n + gate_z * hidden[i];
+            }
+        }
+        memcpy(hidden, hidden_new, sizeof(hidden));
+        for (uint32_t i = 0; i < hidden_size; ++i)
+            if ((output_rows == timesteps || timestep == timesteps - 1U) &&
+                fabs(petal->output[(output_rows == timesteps ? timestep : 0U) * hidden_size + i] - hidden[i]) > 1e-5)
+                fails++;
+    }
+    printf("Forward pass: %s\n", fails ? "mismatch" : "OK");
+
+    // Analytical and numerical gradients
+    rk_fill_uniform(&rk_state_global, coefficients, output_shape.length, -1.f, 1.f);
+    weights_s *weights_all[] = {&weights, &bias};
+    fails += check_petal_gradients(petal, input, coefficients, weights_all, 2U, 1e-3f) > 0U;
+
+    free(input);
+    free(coefficients);
+    petal_destroy(petal, false, true, true);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests multi-head self-attention petal: forward pass against attention with full softmax and gradients of
+ * weights and inputs against numerical ones
+ *
+ * @param heads number of heads
+ * @param sequence number of rows (more than ATTENTION_TILE_KEYS to check online softmax over multiple tiles)
+ * @return uint8_t number of fails
+ */
+uint8_t test_attention(uint32_t heads, uint32_t sequence) {
+    printf("\nTesting attention petal with %u heads and sequence of %u\n", heads, sequence);
+    uint8_t fails = 0U;
+
+    // sequence x 8 -> sequence x 8
+    uint32_t row_length = 8U, head_size = row_length / heads;
+    petal_shape_s input_shape = (petal_shape_s){sequence, row_length, 1U, 0UL};
+    petal_shape_s output_shape = (petal_shape_s){sequence, row_length, 1U, 0UL};
+    weights_s weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, .5f, NULL, NULL, 0U};
+    weights_s bias = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, .5f, NULL, NULL, 0U};
+    petal_params_s params = (petal_params_s){0};
+    params.heads = heads;
+    petal_s *petal =
+        petal_init(PETAL_TYPE_ATTENTION, false, &input_shape, &output_shape, &weights, &bias, NULL, &params);
+    if (petal->error_code != ERROR_NONE) {
+        printf("Failed to initialize petal: %s\n", error_to_str[petal->error_code]);
+        petal_destroy(petal, false, true, true);
+        return 1U;
+    }
+
+    // Forward pass
+    float *input = malloc(input_shape.length * sizeof(float));
+    float *coefficients = malloc(output_shape.length * sizeof(float));
+    rk_fill_uniform(&rk_state_global, input, input_shape.length, -1.f, 1.f);
+    petal_forward(petal, input, true);
+
+    // Attention with full softmax
+    double *projections = calloc(sequence * 3U * row_length, sizeof(double));
+    double *attention = calloc(sequence * row_length, sizeof(double));
+    double *scores = malloc(sequence * sizeof(double));
+    for (uint32_t position = 0; position < sequence; ++position)
+        for (uint32_t j = 0; j < 3U * row_length; ++j) {
+            double sum = bias.weights[j];
+            for (uint32_t i = 0; i < row_length; ++i)
+                sum += input[position * row_length + i] * weights.weights[i * 3U * row_length + j];
+            projections[position * 3U * row_length + j] = sum;
+        }
+    for (uint32_t head = 0; head < heads; ++head)
+        for (uint32_t query = 0; query < sequence; ++query) {
+            double max = -INFINITY, sum = 0.;
+            for (uint32_t key = 0; key < sequence; ++key) {
+                double score = 0.;
+                for (uint32_t i = 0; i < head_size; ++i)
+                    score += projections[query * 3U * row_length + head * head_size + i] *
+                             projections[key * 3U * row_length + row_length + head * head_size + i];
+                scores[key] = score / sqrt((double) head_size);
+                max = scores[key] > max ? scores[key] : max;
+            }
+            for (uint32_t key = 0; key < sequence; ++key) {
+                scores[key] = exp(scores[key] - max);
+                sum += scores[key];
+            }
+            for (uint32_t key = 0; key < sequence; ++key)
+                for (uint32_t i = 0; i < head_size; ++i)
+                    attention[query * row_length + head * head_size + i] +=
+                        scores[key] / sum * projections[key * 3U * row_length + 2U * row_length + head * head_size + i];
+        }
+    double error_max = 0.;
+    for (uint32_t position = 0; position < sequence; ++position)
+        for (uint32_t j = 0; j < row_length; ++j) {
+            double output = bias.weights[3U * row_length + j];
+            for (uint32_t i = 0; i < row_length; ++i)
+                output += attention[position * row_length + i] *
+                          weights.weights[3U * row_length * row_length + i * row_length + j];
+            double error = fabs(output - petal->output[position * row_length + j]);
+            error_max = error > error_max ? error : error_max;
+        }
+    printf("Max. forward error: %.2e\n", error_max);
+    fails += error_max > 1e-4;
+
+    // Analytical and numerical gradients
+    rk_fill_uniform(&rk_state_global, coefficients, output_shape.length, -1.f, 1.f);
+    weights_s *weights_all[] = {&weights, &bias};
+    fails += check_petal_gradients(petal, input, coefficients, weights_all, 2U, 1e-3f) > 0U;
+
+    free(input);
+    free(coefficients);
+    free(projections);
+    free(attention);
+    free(scores);
+    petal_destroy(petal, false, true, true);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests bias correction of Adam: with constant gradients, moments and velocities after N updates must be
+ * (1 - beta_1^N) * g and (1 - beta_2^N) * g^2 and each update must change weights by learning_rate * g / |g|
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_adam_bias_correction() {
+    printf("\nTesting bias correction of Adam\n");
+    uint8_t fails = 0U;
+
+    weights_s weights = (weights_s){true, WEIGHTS_INIT_CONSTANT, 0U, NULL, NULL, 0.f, 0.f, NULL, NULL, 0U};
+    if (weights_check_init(&weights, 3U) != ERROR_NONE) {
+        printf("Failed to initialize weights\n");
+        return 1U;
+    }
+    float gradients[3] = {.5f, -2.f, 1.5f};
+    optimizer_s optimizer = (optimizer_s){OPTIMIZER_ADAM, .01f, 0.f, .89f, .99f};
+    uint32_t updates = 5U;
+    for (uint32_t update = 0; update < updates; ++update) {
+        memcpy(weights.gradients, gradients, 3U * sizeof(float));
+        fails += weights_update(&weights, &optimizer) != ERROR_NONE;
+    }
+
+    // Step is counted once per update
+    if (weights._learning_step != updates)
+        fails++;
+    printf("Learning step: %lu\n", (unsigned long) weights._learning_step);
+
+    uint32_t mismatches = 0U;
+    for (uint32_t i = 0; i < 3U; ++i) {
+        double moment = (1. - pow(optimizer.beta_1, updates)) * gradients[i];
+        double velocity = (1. - pow(optimizer.beta_2, updates)) * gradients[i] * gradients[i];
+        double weight = -(double) updates * optimizer.learning_rate * (gradients[i] > 0.f ? 1. : -1.);
+        if (fabs(weights.moments[i] - moment) > 1e-5 || fabs(weights.velocities_or_cache[i] - velocity) > 1e-5 ||
+            fabs(weights.weights[i] - weight) > 1e-5)
+            mismatches++;
+    }
+    printf("Mismatches: %u\n", mismatches);
+    fails += mismatches > 0U;
+
+    weights_destroy(&weights, false, true);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests embedding petal: lookup, sparse gradients, lazy Adam update of looked up rows only and wrong ids
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_embedding() {
+    printf("\nTesting embedding\n");
+    uint8_t fails = 0U;
+
+    // 3 ids -> 3 rows of 4 values from table of 50 rows
+    petal_shape_s input_shape = (petal_shape_s){3U, 1U, 1U, 0UL};
+    petal_shape_s output_shape = (petal_shape_s){3U, 4U, 1U, 0UL};
+    weights_s table = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    petal_params_s params = (petal_params_s){0.f, 0.f, 1.f, DROPOUT_MODE_EXACT};
+    params.vocabulary_size = 50U;
+    petal_s *petal = petal_init(PETAL_TYPE_EMBEDDING, true, &input_shape, &output_shape, &table, NULL, NULL, &params);
+    if (petal->error_code != ERROR_NONE) {
+        printf("Failed to initialize petal: %s\n", error_to_str[petal->error_code]);
+        petal_destroy(petal, false, true, true);
+        return 1U;
+    }
+    float *table_before = malloc(table.length_total * sizeof(float));
+    memcpy(table_before, table.weights, table.length_total * sizeof(float));
+
+    // Lookup (id 7 is used twice)
+    float ids[3] = {7.f, 42.f, 7.f};
+    petal_forward(petal, ids, true);
+    for (uint32_t row = 0; row < 3U; ++row)
+        if (memcmp(petal->output + row * 4U, table.weights + (uint32_t) ids[row] * 4U, 4U * sizeof(float)) != 0)
+            fails++;
+    printf("Lookup: %s\n", fails ? "mismatch" : "OK");
+
+    // Gradients of looked up rows only
+    float errors[12] = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f, 11.f, 12.f};
+    petal_backward(petal, errors, ids);
+    for (uint32_t row = 0; row < 50U; ++row) {
+        for (uint32_t i = 0; i < 4U; ++i) {
+            float expected = row == 7U ? errors[i] + errors[8U + i] : row == 42U ? errors[4U + i] : 0.f;
+            if (table.gradients[row * 4U + i] != expected)
+                fails++;
+        }
+    }
+    printf("Sparse gradients: %s\n", fails ? "mismatch" : "OK");
+
+    // Adam must update only rows 7 and 42
+    optimizer_s optimizer = (optimizer_s){OPTIMIZER_ADAM, .01f, 0.f, .89f, .99f};
+    weights_update(&table, &optimizer);
+    uint32_t rows_updated = 0U;
+    for (uint32_t row = 0; row < 50U; ++row) {
+        bool updated = memcmp(table.weights + row * 4U, table_before + row * 4U, 4U * sizeof(float)) != 0;
+        rows_updated += updated;
+        if (updated != (row == 7U || row == 42U))
+            fails++;
+    }
+    printf("Updated rows: %u\n", rows_updated);
+    for (uint32_t i = 0; i < table.length_total; ++i)
+        if (table.gradients[i] != 0.f)
+            fails++;
+
+    // Wrong ids
+    float ids_wrong[2][3] = {{1.f, 50.f, 2.f}, {1.f, 2.5f, -1.f}};
+    for (uint8_t i = 0; i < 2U; ++i) {
+        petal->error_code = ERROR_NONE;
+        petal_forward(petal, ids_wrong[i], false);
+        if (petal->error_code != ERROR_PETAL_WRONG_INDEX)
+            fails++;
+    }
+
+    free(table_before);
+    petal_destroy(petal, false, true, true);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests dense petal with sparse input: conversions, forward and backward must match dense input and
+ * out of range indices must be rejected
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_sparse_dense() {
+    printf("\nTesting dense petal with sparse input\n");
+    uint8_t fails = 0U;
+
+    // 1000 inputs (5 non-zeros) -> 8 outputs with tanh activation
+    petal_shape_s input_shape = (petal_shape_s){1U, 1000U, 1U, 0UL};
+    petal_shape_s output_shape = (petal_shape_s){1U, 8U, 1U, 0UL};
+    weights_s weights = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s bias = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    activation_s *activation = malloc(sizeof(activation_s));
+    *activation = (activation_s){ACTIVATION_TANH, 1.f, 0.f, 0.f, 0.f, 1.f, NULL};
+    petal_s *petal =
+        petal_init(PETAL_TYPE_DENSE_1D, true, &input_shape, &output_shape, &weights, &bias, activation, NULL);
+    if (petal->error_code != ERROR_NONE) {
+        printf("Failed to initialize petal: %s\n", error_to_str[petal->error_code]);
+        petal_destroy(petal, false, true, true);
+        return 1U;
+    }
+
+    // Conversions
+    float *input = calloc(1000U, sizeof(float));
+    float *input_restored = malloc(1000U * sizeof(float));
+    uint32_t nonzero_indices[5] = {3U, 17U, 400U, 401U, 999U};
+    for (uint32_t i = 0; i < 5U; ++i)
+        input[nonzero_indices[i]] = (float) i - 2.5f;
+    sparse_s *input_sparse = dense_to_sparse(input, 1000U);
+    if (input_sparse->length != 5U)
+        fails++;
+    sparse_to_dense(input_sparse, input_restored, 1000U);
+    if (memcmp(input, input_restored, 1000U * sizeof(float)) != 0)
+        fails++;
+    printf("Conversions: %s\n", fails ? "mismatch" : "OK");
+
+    // Dense forward and backward
+    float errors[8] = {.1f, -.2f, .3f, -.4f, .5f, -.6f, .7f, -.8f};
+    float output_dense[8];
+    petal_forward(petal, input, true);
+    memcpy(output_dense, petal->output, 8U * sizeof(float));
+    petal_backward(petal, errors, input);
+    float *gradients_dense = malloc(weights.length_total * sizeof(float));
+    float bias_gradients_dense[8];
+    memcpy(gradients_dense, weights.gradients, weights.length_total * sizeof(float));
+    memcpy(bias_gradients_dense, bias.gradients, 8U * sizeof(float));
+    memset(weights.gradients, 0, weights.length_total * sizeof(float));
+    memset(bias.gradients, 0, 8U * sizeof(float));
+
+    // Sparse forward and backward must give the same result
+    petal_forward_sparse(petal, input_sparse, true);
+    uint32_t mismatches = 0U;
+    for (uint32_t i = 0; i < 8U; ++i)
+        if (fabsf(petal->output[i] - output_dense[i]) > 1e-5f)
+            mismatches++;
+    petal_backward_sparse(petal, errors, input_sparse);
+    for (uint32_t i = 0; i < weights.length_total; ++i)
+        if (fabsf(weights.gradients[i] - gradients_dense[i]) > 1e-5f)
+            mismatches++;
+    for (uint32_t i = 0; i < 8U; ++i)
+        if (fabsf(bias.gradients[i] - bias_gradients_dense[i]) > 1e-5f)
+            mismatches++;
+    printf("Forward and backward mismatches: %u\n", mismatches);
+    fails += mismatches > 0U;
+
+    // Only columns of non-zero inputs are updated and their gradients are reset
+    optimizer_s optimizer = (optimizer_s){OPTIMIZER_ADAM, .01f, 0.f, .9f, .999f};
+    memcpy(gradients_dense, weights.weights, weights.length_total * sizeof(float));
+    weights_update(&weights, &optimizer);
+    uint32_t updated = 0U, wrong = 0U;
+    for (uint32_t i = 0; i < weights.length_total; ++i) {
+        bool nonzero = false;
+        for (uint32_t j = 0; j < 5U; ++j)
+            nonzero |= i % 1000U == nonzero_indices[j];
+        updated += weights.weights[i] != gradients_dense[i];
+        wrong += (weights.weights[i] != gradients_dense[i]) != nonzero || weights.gradients[i] != 0.f;
+    }
+    printf("Updated weights: %u, wrong: %u\n", updated, wrong);
+    if (updated != 40U || wrong > 0U || !weights._sparse_cols || bit_array_count(weights._sparse_cols) != 0U)
+        fails++;
+
+    // Dense backpropagation marks each column
+    petal_backward(petal, errors, input);
+    if (bit_array_count(weights._sparse_cols) != 1000U)
+        fails++;
+
+    // Wrong index
+    input_sparse->indices[4] = 1000U;
+    petal_forward_sparse(petal, input_sparse, false);
+    if (petal->error_code != ERROR_PETAL_WRONG_INDEX)
+        fails++;
+
+    free(input);
+    free(input_restored);
+    free(gradients_dense);
+    sparse_destroy(input_sparse);
+    petal_destroy(petal, false, true, true);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Calculates mean squared error of flower's prediction (for numerical gradients)
+ *
+ * @param flower pointer to initialized flower_s struct
+ * @param input pointer to array of input data
+ * @param target pointer to array of 2 expected outputs
+ * @return float mean squared error
+ */
+float test_flower_graph_loss(flower_s *flower, float *input, float *target) {
+    float *predicted = flower_forward(flower, input, false);
+    float loss = 0.f;
+    for (uint32_t i = 0; i < 2U; ++i)
+        loss += (target[i] - predicted[i]) * (target[i] - predicted[i]);
+    return loss / 2.f;
+}
+
+/**
+ * @brief Tests flower with graph of petals (residual sum and concatenation): compares weights updated by one step of
+ * SGD (learning rate 1) with numerical gradients and checks sharing of errors and inference buffers and wrong graphs
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_flower_graph() {
+    printf("\nTesting flower with graph of petals\n");
+    uint8_t fails = 0U;
+
+    // 0: 4 -> 6 (tanh), 1: 6 -> 6 (tanh), 2: 0 + 1 -> 6, 3: concat(2, 1) -> 2
+    uint32_t lengths_in[4] = {4U, 6U, 6U, 12U}, lengths_out[4] = {6U, 6U, 6U, 2U};
+    petal_shape_s input_shapes[4], output_shapes[4];
+    weights_s weights[4], bias[4];
+    petal_s *petals[4];
+    for (uint32_t petal_i = 0; petal_i < 4U; ++petal_i) {
+        input_shapes[petal_i] = (petal_shape_s){1U, lengths_in[petal_i], 1U, 0UL};
+        output_shapes[petal_i] = (petal_shape_s){1U, lengths_out[petal_i], 1U, 0UL};
+        weights[petal_i] = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, -.5f, .5f, NULL, NULL, 0U};
+        bias[petal_i] = (weights_s){true, WEIGHTS_INIT_RANDOM_UNIFORM, 0U, NULL, NULL, -.5f, .5f, NULL, NULL, 0U};
+        activation_s *activation = NULL;
+        if (petal_i < 2U) {
+            activation = malloc(sizeof(activation_s));
+            *activation = (activation_s){ACTIVATION_TANH, 1.f, 0.f, 0.f, 0.f, 1.f, NULL};
+        }
+        petals[petal_i] = petal_init(PETAL_TYPE_DENSE_1D, petal_i == 0U, &input_shapes[petal_i],
+                                     &output_shapes[petal_i], &weights[petal_i], &bias[petal_i], activation, NULL);
+        fails += petals[petal_i]->error_code != ERROR_NONE;
+    }
+    uint32_t inputs_0[1] = {FLOWER_INPUT}, inputs_1[1] = {0U}, inputs_2[2] = {0U, 1U}, inputs_3[2] = {2U, 1U};
+    flower_node_s nodes[4] = {{inputs_0, 1U, FLOWER_MERGE_ADD},
+                              {inputs_1, 1U, FLOWER_MERGE_ADD},
+                              {inputs_2, 2U, FLOWER_MERGE_ADD},
+                              {inputs_3, 2U, FLOWER_MERGE_CONCAT}};
+    flower_s *flower = flower_init_graph(petals, 4U, nodes);
+    if (fails || flower->error_code != ERROR_NONE) {
+        printf("Failed to initialize flower: %s\n", error_to_str[flower->error_code]);
+        fails++;
+    }
+
+    // Petals 0, 1 and 2 need summed errors, but petals 2 and 0 can share buffer
+    if (flower->_buffers_length != 2U)
+        fails++;
+    printf("Errors buffers: %u\n", flower->_buffers_length);
+
+    // Inference needs outputs of 0, 1 and 2 and merged input of 2 at once, merged input of 3 reuses output of 0 (the
+    // only buffer longer than outputs of petals, so the only one allocated)
+    uint32_t pool_allocated = 0U;
+    for (uint32_t buffer = 0; buffer < flower->_pool_length; ++buffer)
+        pool_allocated += flower->_pool_allocated[buffer];
+    if (flower->_pool_length != 4U || pool_allocated != 1U)
+        fails++;
+    printf("Inference buffers: %u (%u allocated)\n", flower->_pool_length, pool_allocated);
+
+    // Numerical gradients
+    float input[4] = {.3f, -.8f, .5f, .1f}, target[2] = {.4f, -.2f};
+    float *inputs[1] = {input}, *targets[1] = {target};
+    float *gradients[4];
+    float delta = 1e-2f;
+    for (uint32_t petal_i = 0; petal_i < 4U && !fails; ++petal_i) {
+        uint32_t length = weights[petal_i].length_total + bias[petal_i].length_total;
+        gradients[petal_i] = malloc(length * sizeof(float));
+        for (uint32_t i = 0; i < length; ++i) {
+            float *weight = i < weights[petal_i].length_total
+                                ? &weights[petal_i].weights[i]
+                                : &bias[petal_i].weights[i - weights[petal_i].length_total];
+            float value = *weight;
+            *weight = value + delta;
+            float loss_plus = test_flower_graph_loss(flower, input, target);
+            *weight = value - delta;
+            float loss_minus = test_flower_graph_loss(flower, input, target);
+            *weight = value;
+            gradients[petal_i][i] = (loss_plus - loss_minus) / (2.f * delta);
+        }
+    }
+
+    // One step of gradient descend
+    uint32_t mismatches = 0U;
+    if (!fails) {
+        float *weights_before[4];
+        for (uint32_t petal_i = 0; petal_i < 4U; ++petal_i) {
+            uint32_t length = weights[petal_i].length_total;
+            weights_before[petal_i] = malloc((length + bias[petal_i].length_total) * sizeof(float));
+            memcpy(weights_before[petal_i], weights[petal_i].weights, length * sizeof(float));
+            memcpy(weights_before[petal_i] + length, bias[petal_i].weights, bias[petal_i].length_total * sizeof(float));
+        }
+        optimizer_s optimizer = (optimizer_s){OPTIMIZER_SGD_MOMENTUM, 1.f, 0.f, 0.f, 0.f};
+        flower_train(flower, LOSS_MEAN_SQUARED_ERROR, &optimizer, NULL, inputs, targets, NULL, 1U, NULL, NULL, NULL,
+                     0U, 1U, 1U);
+        fails += flower->error_code != ERROR_NONE;
+        for (uint32_t petal_i = 0; petal_i < 4U; ++petal_i) {
+            uint32_t length = weights[petal_i].length_total;
+            for (uint32_t i = 0; i < length + bias[petal_i].length_total; ++i) {
+                float weight = i < length ? weights[petal_i].weights[i] : bias[petal_i].weights[i - length];
+                if (fabsf(weights_before[petal_i][i] - weight - gradients[petal_i][i]) > 2e-3f)
+                    mismatches++;
+            }
+            free(weights_before[petal_i]);
+            free(gradients[petal_i]);
+        }
+    }
+    printf("Gradients mismatches: %u\n", mismatches);
+    fails += mismatches > 0U;
+    flower_destroy(flower, false, false, false);
+
+    // Cycle (1 <-> 2) and wrong concatenated length
+    inputs_1[0] = 2U;
+    flower = flower_init_graph(petals, 4U, nodes);
+    fails += flower->error_code != ERROR_FLOWER_WRONG_GRAPH;
+    flower_destroy(flower, false, false, false);
+    inputs_1[0] = 0U;
+    nodes[3].inputs_length = 1U;
+    flower = flower_init_graph(petals, 4U, nodes);
+    fails += flower->error_code != ERROR_FLOWER_WRONG_GRAPH;
+    flower_destroy(flower, false, false, false);
+
+    for (uint32_t petal_i = 0; petal_i < 4U; ++petal_i)
+        petal_destroy(petals[petal_i], false, true, true);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Performs test of pseudo random number generator by validating rk_random_() and rk_float_() 5 times each
+ * NOTE: call rk_seed_(0) for that to work
+ *
+ * @return uint8_t number of fails (mismatches)
+ */
+uint8_t test_random() {
+    // Print about message
+    printf("\nChecking whether the PRNG works correctly\n");
+
+    // Fails counter
+    uint8_t fails = 0U;
+
+    // Test first 5 integers
+    if (rk_random_() != 2357136044U)
+        fails++;
+    if (rk_random_() != 2546248239U)
+        fails++;
+    if (rk_random_() != 3071714933U)
+        fails++;
+    if (rk_random_() != 3626093760U)
+        fails++;
+    if (rk_random_() != 2588848963U)
+        fails++;
+
+    // Test next 5 floats
+    if (rk_float_() != .85794562101364135742f)
+        fails++;
+    if (rk_float_() != .84725171327590942383f)
+        fails++;
+    if (rk_float_() != .62356370687484741211f)
+        fails++;
+    if (rk_float_() != .38438171148300170898f)
+        fails++;
+    if (rk_float_() != .29753458499908447266f)
+        fails++;
+
+    // Check
+    if (fails == 0)
+        printf("PRNG works correctly\n");
+    else
+        printf("PRNG DOES NOT WORK CORRECTLY!\n");
+
+    return fails;
+}
+
+/**
+ * @brief Tests Philox4x32-10 against known answers and checks that streams don't depend on the order of use
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_random_stream() {
+    printf("\nChecking counter-based random streams\n");
+    uint8_t fails = 0U;
+
+    // Known answers (Random123 test vectors)
+    const uint32_t counters[2][4] = {{0U, 0U, 0U, 0U}, {0x243F6A88UL, 0x85A308D3UL, 0x13198A2EUL, 0x03707344UL}};
+    const uint32_t keys[2][2] = {{0U, 0U}, {0xA4093822UL, 0x299F31D0UL}};
+    const uint32_t expected[2][4] = {{0x6627E8D5UL, 0xE169C58DUL, 0xBC57AC4CUL, 0x9B00DBD8UL},
+                                     {0xD16CFE09UL, 0x94FDCCEBUL, 0x5001E420UL, 0x24126EA1UL}};
+    uint32_t output[4];
+    for (uint8_t i = 0; i < 2U; ++i) {
+        rk_philox4x32(counters[i], keys[i], output);
+        for (uint8_t j = 0; j < 4U; ++j)
+            if (output[j] != expected[i][j])
+                fails++;
+    }
+
+    // Interleaved streams must give the same sequences as streams used one after another
+    rk_stream_s stream_1, stream_2;
+    uint32_t sequence_1[10], sequence_2[10];
+    rk_stream_init(&stream_1, 42U, 1U, 2U, 3U);
+    rk_stream_init(&stream_2, 42U, 1U, 2U, 4U);
+    for (uint8_t i = 0; i < 10U; ++i) {
+        sequence_1[i] = rk_stream_random(&stream_1);
+        sequence_2[i] = rk_stream_random(&stream_2);
+    }
+    rk_stream_init(&stream_2, 42U, 1U, 2U, 4U);
+    for (uint8_t i = 0; i < 10U; ++i)
+        if (rk_stream_random(&stream_2) != sequence_2[i])
+            fails++;
+    rk_stream_init(&stream_1, 42U, 1U, 2U, 3U);
+    for (uint8_t i = 0; i < 10U; ++i)
+        if (rk_stream_random(&stream_1) != sequence_1[i])
+            fails++;
+
+    // Different ids must give different sequences
+    if (memcmp(sequence_1, sequence_2, sizeof(sequence_1)) == 0)
+        fails++;
+
+    // Dropout masks with the same stream must be bit-identical
+    bit_array_s *bit_array_1 = bit_array_init(100U);
+    bit_array_s *bit_array_2 = bit_array_init(100U);
+    rk_stream_init(&stream_1, 7U, 0U, 5U, 1U);
+    rk_stream_init(&stream_2, 7U, 0U, 5U, 1U);
+    dropout_generate_indices(bit_array_1, .3f, &stream_1);
+    rk_random_();
+    dropout_generate_indices(bit_array_2, .3f, &stream_2);
+    if (memcmp(bit_array_1->data, bit_array_2->data, bit_array_1->_length_in_types * sizeof(BIT_ARRAY_TYPE)) != 0 ||
+        bit_array_count(bit_array_1) != 30U)
+        fails++;
+    bit_array_destroy(bit_array_1);
+    bit_array_destroy(bit_array_2);
+
+    if (fails == 0)
+        printf("Random streams work correctly\n");
+    else
+        printf("RANDOM STREAMS DO NOT WORK CORRECTLY!\n");
+
+    return fails;
+}
+
+/**
+ * @brief Tests bulk random fill: range of uniform values and mean / deviation of gaussian values
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_random_fill() {
+    printf("\nChecking bulk random fill\n");
+    uint8_t fails = 0U;
+
+    // Odd length to check last unpaired gaussian value and partial chunk
+    uint32_t length = 10001U;
+    float *array = malloc(length * sizeof(float));
+
+    rk_fill_uniform(&rk_state_global, array, length, -2.f, 3.f);
+    float min = array[0], max = array[0];
+    double sum = 0.;
+    for (uint32_t i = 0; i < length; ++i) {
+        min = array[i] < min ? array[i] : min;
+        max = array[i] > max ? array[i] : max;
+        sum += array[i];
+    }
+    printf("Uniform: min: %.4f, max: %.4f, mean: %.4f\n", min, max, sum / length);
+    if (min <= -2.f || max > 3.f || fabs(sum / length - .5) > .05)
+        fails++;
+
+    array[length - 1U] = NAN;
+    rk_fill_gaussian(&rk_state_global, array, length, 1.f, 2.f);
+    sum = 0.;
+    double sum_sq = 0.;
+    for (uint32_t i = 0; i < length; ++i) {
+        sum += array[i];
+        sum_sq += array[i] * array[i];
+    }
+    double mean = sum / length;
+    double deviation = sqrt(sum_sq / length - mean * mean);
+    printf("Gaussian: mean: %.4f, deviation: %.4f\n", mean, deviation);
+    if (isnan(array[length - 1U]) || fabs(mean - 1.) > .1 || fabs(deviation - 2.) > .1)
+        fails++;
+
+    free(array);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Tests that chunked weights initialization is reproducible for the same seed and WEIGHTS_INIT_NONE
+ * keeps zeros
+ *
+ * @return uint8_t number of fails
+ */
+uint8_t test_weights_init() {
+    printf("\nChecking weights initialization\n");
+    uint8_t fails = 0U;
+
+    // Few chunks with partial last one
+    uint32_t length = WEIGHTS_INIT_CHUNK * 2U + 3U;
+    weights_s weights_1 = (weights_s){true, WEIGHTS_INIT_RANDOM_GAUSSIAN, 0U, NULL, NULL, 0.f, 1.f, NULL, NULL, 0U};
+    weights_s weights_2 = weights_1;
+    rk_seed_(1U);
+    weights_check_init(&weights_1, length);
+    rk_seed_(1U);
+    weights_check_init(&weights_2, length);
+    if (memcmp(weights_1.weights, weights_2.weights, length * sizeof(float)) != 0)
+        fails++;
+
+    // Chunks must not repeat each other
+    if (memcmp(weights_1.weights, weights_1.weights + WEIGHTS_INIT_CHUNK, 16U * sizeof(float)) == 0)
+        fails++;
+    weights_destroy(&weights_1, false, true);
+    weights_destroy(&weights_2, false, true);
+
+    weights_s weights_none = (weights_s){false, WEIGHTS_INIT_NONE, 0U, NULL, NULL, 1.f, 1.f, NULL, NULL, 0U};
+    if (weights_check_init(&weights_none, 100U) != ERROR_NONE)
+        fails++;
+    for (uint32_t i = 0; i < 100U; ++i)
+        if (weights_none.weights[i] != 0.f)
+            fails++;
+    weights_destroy(&weights_none, false, true);
+
+    printf(fails ? "Failed\n" : "Passed\n");
+    return fails;
+}
+
+/**
+ * @brief Automatically performs tests of most function
+ *
+ * @return int 0 if all test passed, number of fails otherwise
+ */
+int main() {
+    // Fails counter
+    uint16_t fails = 0U;
+
+    // Set random seed (seed must be 0 for test_random to work and also for results to be consistant)
+    // rk_seed_(time(NULL) & 0xFFFFFFFFUL);
+    rk_seed_(0);
+
+    printf("\n--------------------------------- BEGIN TESTS ----------------------------------\n");
+
+    // Validate random
+    fails += test_random();
+    fails += test_random_stream();
+    fails += test_random_fill();
+    fails += test_weights_init();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test activation
+    fails += test_activation_full();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test loss
+    fails += test_loss_full();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test dropout
+    fails += test_dropout(50U, 0.f);
+    fails += test_dropout(50U, .2f);
+    fails += test_dropout(50U, .8f);
+    fails += test_dropout(50U, 1.f);
+    fails += test_bit_array();
+    fails += test_dropout_bernoulli(8200U, 0.f);
+    fails += test_dropout_bernoulli(8200U, .3f);
+    fails += test_dropout_bernoulli(8200U, .5f);
+    fails += test_dropout_bernoulli(8200U, 1.f);
+    fails += test_dropout_mask(50U, .2f);
+    fails += test_dropout_mask(50U, .8f);
+    fails += test_dropout_mask(50U, 1.f);
+    fails += test_dropout_softmax(.3f);
+    fails += test_dropout_softmax(1.f);
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test learning rate schedulers
+    fails += test_scheduler();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test early stopping
+    fails += test_early_stopping();
+    fails += test_early_stopping_batch_norm();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test timer
+    fails += test_timer();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test normalization
+    fails += test_normalization();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test dense petal (gemv() and gemm())
+    fails += test_dense_gradients(37U, 5U);
+    fails += test_dense_gradients(300U, 70U);
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test convolution
+    for (uint8_t algorithm = CONV_ALGORITHM_IM2COL; algorithm <= CONV_ALGORITHM_DIRECT; ++algorithm) {
+        fails += test_conv_2d(1U, 0U, 1U, 3U, 2U, algorithm);
+        fails += test_conv_2d(2U, 1U, 1U, 3U, 2U, algorithm);
+        fails += test_conv_2d(1U, 2U, 2U, 3U, 2U, algorithm);
+    }
+    fails += test_conv_2d(1U, 0U, 1U, 3U, 3U, CONV_ALGORITHM_WINOGRAD);
+    fails += test_conv_2d(1U, 1U, 1U, 3U, 3U, CONV_ALGORITHM_WINOGRAD);
+    fails += test_conv_2d(1U, 1U, 1U, 3U, 3U, CONV_ALGORITHM_AUTO);
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test pooling
+    fails += test_pool_2d(PETAL_TYPE_MAX_POOL_2D, 2U, 2U, 0U);
+    fails += test_pool_2d(PETAL_TYPE_MAX_POOL_2D, 3U, 2U, 1U);
+    fails += test_pool_2d(PETAL_TYPE_AVG_POOL_2D, 2U, 2U, 0U);
+    fails += test_pool_2d(PETAL_TYPE_AVG_POOL_2D, 3U, 1U, 1U);
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test batch normalization
+    fails += test_batch_norm();
+    fails += test_batch_norm_mini_batch();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test layer normalization
+    fails += test_layer_norm();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test embedding
+    fails += test_embedding();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test bias correction of Adam
+    fails += test_adam_bias_correction();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test dense petal with sparse input
+    fails += test_sparse_dense();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test flower with residual sum and concatenation of petals
+    fails += test_flower_graph();
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test recurrent petals (hidden state of each timestep and of the last one)
+    fails += test_rnn(PETAL_TYPE_LSTM, 5U);
+    fails += test_rnn(PETAL_TYPE_LSTM, 1U);
+    fails += test_rnn(PETAL_TYPE_GRU, 5U);
+    fails += test_rnn(PETAL_TYPE_GRU, 1U);
+    printf("\n--------------------------------------------------------------------------------\n");
+
+    // Test attention petal (single tile and multiple tiles of queries and keys)
+    fails += test_attention(1U, 5U);
+    fails += test_attention(2U, 70U);
     printf("\n--------------------------------------------------------------------------------\n");
 
     // Test flower with dense petals